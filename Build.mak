@@ -1,4 +1,4 @@
 
 # Include sub-directories makefiles
-$(call include_subdirs,src test)
+$(call include_subdirs,src test bench)
 
@@ -471,6 +471,11 @@ doc: $$(doc)
 .PHONY: test
 test: $$(test)
 
+# Phony rule to build and run all benchmarks (sub-makefiles can append targets
+# to build and run benchmarks to the $(bench) variable).
+.PHONY: bench
+bench: $$(bench)
+
 
 # Create build directory structure
 ###################################
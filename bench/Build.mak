@@ -0,0 +1,15 @@
+
+# Build the benchmark executable
+$B/bench-posixx: LINKER := $(CXX)
+$B/bench-posixx: $(call find_objects,cpp)
+
+# Run the benchmarks (the results are printed to stdout, one JSON object per
+# line, so they can be saved to compare them with other runs)
+.PHONY: bench-posixx
+bench-posixx: LDFLAGS += -lpthread
+bench-posixx: $B/bench-posixx
+	$(call exec,$< $(BENCH_ARGS))
+
+# Run our benchmarks when the "bench" goal is built
+bench += bench-posixx
+
@@ -0,0 +1,256 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef BENCH_BENCH_HPP_
+#define BENCH_BENCH_HPP_
+
+#include <posixx/histogram.hpp> // posixx::histogram
+
+#include <string> // std::string
+#include <vector> // std::vector
+#include <algorithm> // std::sort
+#include <cmath> // std::sqrt
+#include <sstream> // std::ostringstream
+#include <iostream> // std::cout
+#include <stdint.h> // uint64_t
+#include <time.h> // clock_gettime
+
+/*
+ * Minimal benchmarking harness.
+ *
+ * Benchmarks are defined using the BENCH() macro, which registers them to be
+ * run by main() (see main.cpp), in the order they are defined. Each benchmark
+ * prints one line per measured case in JSON format (one object per line) to
+ * stdout, using the report class, so the output can be easily processed by
+ * regression tracking tools. Any human oriented message should go to stderr.
+ */
+
+namespace bench {
+
+/// Benchmark function.
+typedef void (*function)();
+
+/// Registered benchmark.
+struct benchmark
+{
+	const char* name;
+	function run;
+};
+
+/// Get all the registered benchmarks.
+inline
+std::vector< benchmark >& registry()
+{
+	static std::vector< benchmark > r;
+	return r;
+}
+
+/// Register a benchmark (use BENCH() instead).
+struct registrar
+{
+	registrar(const char* name, function f)
+	{
+		benchmark b = { name, f };
+		registry().push_back(b);
+	}
+};
+
+/// Configuration, set from the command line by main().
+struct config
+{
+	/// Time budget for each measured case, in seconds.
+	double seconds;
+	/// Number of repetitions of each measured case (when applicable).
+	unsigned repetitions;
+};
+
+/// Get the configuration.
+inline
+config& conf()
+{
+	static config c = { 0.2, 5 };
+	return c;
+}
+
+/// Get the current (monotonic) time in nanoseconds.
+inline
+uint64_t now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast< uint64_t >(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/// Time budget for each measured case, in nanoseconds.
+inline
+uint64_t budget()
+{
+	return static_cast< uint64_t >(conf().seconds * 1e9);
+}
+
+/**
+ * Prevent the compiler from optimizing away a value (or what it points to).
+ */
+template < typename T >
+inline
+void keep(const T& value)
+{
+	__asm__ __volatile__ ("" : : "g" (&value) : "memory");
+}
+
+/// Statistics of a measurement made by measure().
+struct timing
+{
+	/// Iterations run in each repetition.
+	uint64_t iterations;
+	/// Repetitions made.
+	unsigned repetitions;
+	/// Median of the time per iteration (in nanoseconds).
+	double median;
+	/// Minimum time per iteration (in nanoseconds).
+	double min;
+	/// Maximum time per iteration (in nanoseconds).
+	double max;
+	/// Standard deviation of the time per iteration (in nanoseconds).
+	double stddev;
+};
+
+/**
+ * Measure the time per iteration of an operation.
+ *
+ * f should be a functor taking the number of iterations to run (as
+ * uint64_t). First the number of iterations is calibrated so each repetition
+ * takes about budget() / repetitions, then the measurement is repeated
+ * conf().repetitions times and the statistics are computed over all the
+ * repetitions (the median is the one to use to compare runs, the standard
+ * deviation tells how stable it is).
+ */
+template < typename F >
+timing measure(F f)
+{
+	uint64_t target = budget() / conf().repetitions;
+	// calibrate (this doubles as warm up)
+	uint64_t n = 1;
+	for (;;) {
+		uint64_t start = now();
+		f(n);
+		uint64_t elapsed = now() - start;
+		if (elapsed >= target / 10 || n >= (uint64_t(1) << 40)) {
+			if (elapsed < target)
+				n = elapsed ? n * target / elapsed : n * 10;
+			break;
+		}
+		n *= 2;
+	}
+	if (n == 0)
+		n = 1;
+	std::vector< double > t(conf().repetitions);
+	double sum = 0;
+	for (unsigned i = 0; i < t.size(); ++i) {
+		uint64_t start = now();
+		f(n);
+		t[i] = double(now() - start) / n;
+		sum += t[i];
+	}
+	std::sort(t.begin(), t.end());
+	timing r;
+	r.iterations = n;
+	r.repetitions = t.size();
+	r.median = t.size() % 2 ? t[t.size() / 2]
+			: (t[t.size() / 2 - 1] + t[t.size() / 2]) / 2;
+	r.min = t.front();
+	r.max = t.back();
+	double mean = sum / t.size();
+	double var = 0;
+	for (unsigned i = 0; i < t.size(); ++i)
+		var += (t[i] - mean) * (t[i] - mean);
+	r.stddev = std::sqrt(var / t.size());
+	return r;
+}
+
+/**
+ * Report of a measured case.
+ *
+ * Fields are added using tag() (strings) and num() (numbers) and the report
+ * is printed as a JSON object in a single line by print().
+ */
+struct report
+{
+
+	/// Start a report for the benchmark name.
+	explicit report(const std::string& name)
+	{
+		_os << "{\"bench\": \"" << name << "\"";
+	}
+
+	/// Add a string field.
+	report& tag(const char* key, const std::string& value)
+	{
+		_os << ", \"" << key << "\": \"" << value << "\"";
+		return *this;
+	}
+
+	/// Add a numeric field.
+	template < typename T >
+	report& num(const char* key, T value)
+	{
+		_os << ", \"" << key << "\": " << value;
+		return *this;
+	}
+
+	/// Add latency fields (in nanoseconds) from a histogram.
+	report& latency(const posixx::histogram& h)
+	{
+		return num("mean_ns", h.mean())
+			.num("p50_ns", h.percentile(50))
+			.num("p90_ns", h.percentile(90))
+			.num("p99_ns", h.percentile(99))
+			.num("p999_ns", h.percentile(99.9))
+			.num("max_ns", h.percentile(100));
+	}
+
+	/// Add timing fields (in nanoseconds per iteration).
+	report& time(const timing& t)
+	{
+		return num("iterations", t.iterations)
+			.num("repetitions", t.repetitions)
+			.num("median_ns", t.median)
+			.num("min_ns", t.min)
+			.num("max_ns", t.max)
+			.num("stddev_ns", t.stddev);
+	}
+
+	/// Print the report to stdout.
+	void print()
+	{
+		std::cout << _os.str() << "}" << std::endl;
+	}
+
+private:
+
+	std::ostringstream _os;
+
+};
+
+} // namespace bench
+
+/**
+ * Define and register a benchmark.
+ *
+ * Use it as a function definition:
+ * @code
+ * BENCH( my_benchmark )
+ * {
+ *	// measure and report
+ * }
+ * @endcode
+ */
+#define BENCH(name) \
+	static void name(); \
+	static ::bench::registrar name ## _registrar_(#name, &name); \
+	static void name()
+
+#endif // BENCH_BENCH_HPP_
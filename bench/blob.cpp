@@ -0,0 +1,144 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "bench.hpp" // BENCH, bench::measure, report, keep
+
+#include <posixx/linux/blob.hpp> // posixx::linux::blob
+#include <posixx/socket/unix.hpp> // posixx::socket::unix
+
+#include <vector> // std::vector
+#include <algorithm> // std::min
+#include <cstring> // memset
+#include <cstddef> // std::size_t
+#include <stdint.h> // uint64_t
+
+/*
+ * posixx::linux::blob benchmarks.
+ *
+ * Transfer of large payloads between two unix sockets (in the same thread),
+ * through the socket itself (a STREAM socket, in 64 KiB chunks, since the
+ * socket buffer can't hold the whole payload) and through sealed memfds,
+ * copying the payload (blob::send() of a buffer) or filling a blob::buffer
+ * in place. In all the cases the payload is produced by writing every byte
+ * (memset()) and consumed by reading one byte of each page.
+ */
+
+namespace {
+
+namespace sock = posixx::socket;
+namespace unix = posixx::socket::unix;
+namespace blob = posixx::linux::blob;
+
+const std::size_t sizes[] = { 262144, 1048576, 16777216 };
+
+const std::size_t chunk = 65536;
+
+const std::size_t page = 4096;
+
+uint64_t consume(const char* p, std::size_t n)
+{
+	uint64_t sum = 0;
+	for (std::size_t i = 0; i < n; i += page)
+		sum += p[i];
+	return sum;
+}
+
+struct socket_transfer
+{
+	unix::socket* tx;
+	unix::socket* rx;
+	std::vector< char >* src;
+	std::vector< char >* dst;
+	void operator () (uint64_t n) const
+	{
+		uint64_t sum = 0;
+		std::size_t size = src->size();
+		for (uint64_t i = 0; i < n; ++i) {
+			memset(&(*src)[0], int(i), size);
+			for (std::size_t done = 0; done < size; ) {
+				std::size_t c = std::min(chunk, size - done);
+				tx->send(&(*src)[done], c);
+				for (std::size_t r = 0; r < c; )
+					r += rx->recv(&(*dst)[done + r], c - r);
+				done += c;
+			}
+			sum += consume(&(*dst)[0], size);
+		}
+		bench::keep(sum);
+	}
+};
+
+struct blob_copy
+{
+	unix::socket* tx;
+	unix::socket* rx;
+	std::vector< char >* src;
+	void operator () (uint64_t n) const
+	{
+		uint64_t sum = 0;
+		blob::view v;
+		for (uint64_t i = 0; i < n; ++i) {
+			memset(&(*src)[0], int(i), src->size());
+			blob::send(*tx, &(*src)[0], src->size());
+			blob::recv(*rx, v);
+			sum += consume(v.data(), v.size());
+		}
+		bench::keep(sum);
+	}
+};
+
+struct blob_buffer
+{
+	unix::socket* tx;
+	unix::socket* rx;
+	std::size_t size;
+	void operator () (uint64_t n) const
+	{
+		uint64_t sum = 0;
+		blob::view v;
+		for (uint64_t i = 0; i < n; ++i) {
+			blob::buffer b(size);
+			memset(b.data(), int(i), size);
+			blob::send(*tx, b);
+			blob::recv(*rx, v);
+			sum += consume(v.data(), v.size());
+		}
+		bench::keep(sum);
+	}
+};
+
+void report(const char* impl, std::size_t size, const bench::timing& t)
+{
+	bench::report("blob_transfer")
+		.tag("impl", impl)
+		.num("size", size)
+		.time(t)
+		.print();
+}
+
+} // namespace
+
+BENCH( blob_transfer )
+{
+	unix::pair_type stream = unix::pair(sock::STREAM);
+	unix::pair_type seqpacket = unix::pair(sock::SEQPACKET);
+	for (std::size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s) {
+		std::size_t size = sizes[s];
+		std::vector< char > src(size), dst(size);
+		socket_transfer st = { stream.first, stream.second, &src,
+				&dst };
+		report("socket", size, bench::measure(st));
+		blob_copy bc = { seqpacket.first, seqpacket.second, &src };
+		report("blob_copy", size, bench::measure(bc));
+		blob_buffer bb = { seqpacket.first, seqpacket.second, size };
+		report("blob_buffer", size, bench::measure(bb));
+	}
+	delete stream.first;
+	delete stream.second;
+	delete seqpacket.first;
+	delete seqpacket.second;
+}
@@ -0,0 +1,427 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "bench.hpp" // BENCH, bench::measure, report, keep
+
+#include <posixx/buffer.hpp> // posixx::buffer
+#include <posixx/simd.hpp> // posixx::simd
+
+#include <vector> // std::vector
+#include <string> // std::string
+#include <list> // std::list
+#include <iterator> // std::iterator, std::input_iterator_tag
+#include <cstddef> // std::size_t
+#include <stdint.h> // uint64_t
+
+/*
+ * posixx::buffer operations benchmarks.
+ *
+ * Each operation is measured for posixx::buffer, std::vector<unsigned char>
+ * and std::string, with several sizes, using bench::measure(), so each case
+ * reports the median (and spread) time per operation over all the
+ * repetitions.
+ *
+ * The search operations (find, find_any, equal and hash) are only measured
+ * for posixx::buffer, once for each posixx::simd implementation level
+ * supported by the CPU.
+ *
+ * Note that basic_buffer::assign() appends to the current contents, so the
+ * assign benchmarks use a new container for each operation (for all the
+ * containers, so they are still comparable).
+ */
+
+namespace {
+
+typedef std::vector< unsigned char > vector;
+
+// Name of each container
+template < typename C > struct container;
+
+template <>
+struct container< posixx::buffer >
+{
+	static const char* name() { return "buffer"; }
+};
+
+template <>
+struct container< vector >
+{
+	static const char* name() { return "vector"; }
+};
+
+template <>
+struct container< std::string >
+{
+	static const char* name() { return "string"; }
+};
+
+// Sizes measured
+const std::size_t sizes[] = { 16, 256, 4096, 65536 };
+
+// Source data for the operations
+template < typename C >
+std::vector< typename C::value_type > source(std::size_t n)
+{
+	std::vector< typename C::value_type > v(n);
+	for (std::size_t i = 0; i < n; ++i)
+		v[i] = 'a' + i % 26;
+	return v;
+}
+
+// A real input iterator (single pass) over an array
+template < typename T >
+struct input_iterator:
+		std::iterator< std::input_iterator_tag, T >
+{
+	explicit input_iterator(const T* p): _p(p) {}
+	const T& operator * () const { return *_p; }
+	input_iterator& operator ++ () { ++_p; return *this; }
+	input_iterator operator ++ (int)
+	{ input_iterator tmp(*this); ++_p; return tmp; }
+	bool operator == (const input_iterator& x) const { return _p == x._p; }
+	bool operator != (const input_iterator& x) const { return _p != x._p; }
+private:
+	const T* _p;
+};
+
+// Base of all the operations, with some source data of size n
+template < typename C >
+struct operation
+{
+	typedef typename C::value_type value_type;
+	explicit operation(std::size_t n): n(n), src(source< C >(n)),
+		a(src.begin(), src.end()), b(src.begin(), src.end()) {}
+	std::size_t n;
+	std::vector< value_type > src;
+	C a;
+	C b;
+};
+
+template < typename C >
+struct construct_fill: operation< C >
+{
+	explicit construct_fill(std::size_t n): operation< C >(n) {}
+	void operator () (uint64_t iters)
+	{
+		for (uint64_t i = 0; i < iters; ++i) {
+			C c(this->n, 'x');
+			bench::keep(c[0]);
+		}
+	}
+};
+
+template < typename C >
+struct construct_range: operation< C >
+{
+	explicit construct_range(std::size_t n): operation< C >(n) {}
+	void operator () (uint64_t iters)
+	{
+		const typename C::value_type* p = &this->src[0];
+		for (uint64_t i = 0; i < iters; ++i) {
+			C c(p, p + this->n);
+			bench::keep(c[0]);
+		}
+	}
+};
+
+template < typename C >
+struct copy_construct: operation< C >
+{
+	explicit copy_construct(std::size_t n): operation< C >(n) {}
+	void operator () (uint64_t iters)
+	{
+		for (uint64_t i = 0; i < iters; ++i) {
+			C c(this->a);
+			bench::keep(c[0]);
+		}
+	}
+};
+
+template < typename C >
+struct copy_assign: operation< C >
+{
+	explicit copy_assign(std::size_t n): operation< C >(n) {}
+	void operator () (uint64_t iters)
+	{
+		for (uint64_t i = 0; i < iters; ++i) {
+			this->b = this->a;
+			bench::keep(this->b[0]);
+		}
+	}
+};
+
+// Grow one element at a time up to n
+template < typename C >
+struct resize_linear: operation< C >
+{
+	explicit resize_linear(std::size_t n): operation< C >(n) {}
+	void operator () (uint64_t iters)
+	{
+		for (uint64_t i = 0; i < iters; ++i) {
+			C c;
+			for (std::size_t s = 1; s <= this->n; ++s)
+				c.resize(s);
+			bench::keep(c[0]);
+		}
+	}
+};
+
+// Grow doubling the size up to n
+template < typename C >
+struct resize_double: operation< C >
+{
+	explicit resize_double(std::size_t n): operation< C >(n) {}
+	void operator () (uint64_t iters)
+	{
+		for (uint64_t i = 0; i < iters; ++i) {
+			C c;
+			for (std::size_t s = 1; s <= this->n; s *= 2)
+				c.resize(s);
+			bench::keep(c[0]);
+		}
+	}
+};
+
+// Shrink to half and grow back to n
+template < typename C >
+struct resize_shrink: operation< C >
+{
+	explicit resize_shrink(std::size_t n): operation< C >(n) {}
+	void operator () (uint64_t iters)
+	{
+		for (uint64_t i = 0; i < iters; ++i) {
+			this->a.resize(this->n / 2);
+			this->a.resize(this->n);
+			bench::keep(this->a[0]);
+		}
+	}
+};
+
+template < typename C >
+struct assign_pointer: operation< C >
+{
+	explicit assign_pointer(std::size_t n): operation< C >(n) {}
+	void operator () (uint64_t iters)
+	{
+		const typename C::value_type* p = &this->src[0];
+		for (uint64_t i = 0; i < iters; ++i) {
+			C c;
+			c.assign(p, p + this->n);
+			bench::keep(c[0]);
+		}
+	}
+};
+
+template < typename C >
+struct assign_forward: operation< C >
+{
+	explicit assign_forward(std::size_t n): operation< C >(n),
+		l(this->src.begin(), this->src.end()) {}
+	void operator () (uint64_t iters)
+	{
+		for (uint64_t i = 0; i < iters; ++i) {
+			C c;
+			c.assign(l.begin(), l.end());
+			bench::keep(c[0]);
+		}
+	}
+	std::list< typename C::value_type > l;
+};
+
+template < typename C >
+struct assign_input: operation< C >
+{
+	explicit assign_input(std::size_t n): operation< C >(n) {}
+	void operator () (uint64_t iters)
+	{
+		typedef input_iterator< typename C::value_type > iterator;
+		const typename C::value_type* p = &this->src[0];
+		for (uint64_t i = 0; i < iters; ++i) {
+			C c;
+			c.assign(iterator(p), iterator(p + this->n));
+			bench::keep(c[0]);
+		}
+	}
+};
+
+// Equal contents, so the whole containers are compared
+template < typename C >
+struct compare_equal: operation< C >
+{
+	explicit compare_equal(std::size_t n): operation< C >(n) {}
+	void operator () (uint64_t iters)
+	{
+		for (uint64_t i = 0; i < iters; ++i) {
+			bool r = this->a == this->b;
+			bench::keep(r);
+		}
+	}
+};
+
+// Only the last element differs
+template < typename C >
+struct compare_less: operation< C >
+{
+	explicit compare_less(std::size_t n): operation< C >(n)
+	{ ++this->b[n - 1]; }
+	void operator () (uint64_t iters)
+	{
+		for (uint64_t i = 0; i < iters; ++i) {
+			bool r = this->a < this->b;
+			bench::keep(r);
+		}
+	}
+};
+
+template < typename C >
+struct swap: operation< C >
+{
+	explicit swap(std::size_t n): operation< C >(n) {}
+	void operator () (uint64_t iters)
+	{
+		for (uint64_t i = 0; i < iters; ++i) {
+			this->a.swap(this->b);
+			bench::keep(this->a[0]);
+		}
+	}
+};
+
+// Measure and report one operation for a container and size
+template < typename Op >
+void measure(const char* bench_name, const char* op, const char* cont,
+		std::size_t n)
+{
+	Op o(n);
+	bench::timing t = bench::measure(o);
+	bench::report(bench_name)
+		.tag("op", op)
+		.tag("container", cont)
+		.num("size", n)
+		.time(t)
+		.num("mb_per_s", n / t.median * 1e3)
+		.print();
+}
+
+// Measure one operation for all the containers and sizes
+template < template < typename > class Op >
+void run(const char* bench_name, const char* op)
+{
+	for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		measure< Op< posixx::buffer > >(bench_name, op,
+				container< posixx::buffer >::name(), sizes[i]);
+		measure< Op< vector > >(bench_name, op,
+				container< vector >::name(), sizes[i]);
+		measure< Op< std::string > >(bench_name, op,
+				container< std::string >::name(), sizes[i]);
+	}
+}
+
+// Search operations (posixx::buffer only), none of them match so the whole
+// buffer is scanned
+struct search: operation< posixx::buffer >
+{
+	enum kind { FIND, FIND_ANY, FIND_STR, EQUAL, HASH };
+	search(kind k, std::size_t n): operation< posixx::buffer >(n), k(k) {}
+	void operator () (uint64_t iters)
+	{
+		static const unsigned char set[] = { '#', '$', '%', '\r' };
+		static const unsigned char str[] = { 'a', 'b', 'c', 'Z' };
+		for (uint64_t i = 0; i < iters; ++i) {
+			std::size_t r = 0;
+			switch (k) {
+			case FIND:
+				r = a.find('#');
+				break;
+			case FIND_ANY:
+				r = a.find_any(set, sizeof(set));
+				break;
+			case FIND_STR:
+				r = a.find(str, sizeof(str));
+				break;
+			case EQUAL:
+				r = a == b;
+				break;
+			case HASH:
+				r = hash_value(a);
+				break;
+			}
+			bench::keep(r);
+		}
+	}
+	kind k;
+};
+
+// Measure a search operation for all the sizes and supported levels
+void run_search(const char* op, search::kind k)
+{
+	static const char* levels[] = { "scalar", "sse2", "avx2" };
+	posixx::simd::level prev = posixx::simd::active();
+	for (int l = posixx::simd::SCALAR; l <= posixx::simd::supported(); ++l) {
+		posixx::simd::use(static_cast< posixx::simd::level >(l));
+		for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]);
+				++i) {
+			bench::timing t = bench::measure(search(k, sizes[i]));
+			bench::report("buffer_search")
+				.tag("op", op)
+				.tag("level", levels[l])
+				.num("size", sizes[i])
+				.time(t)
+				.num("mb_per_s", sizes[i] / t.median * 1e3)
+				.print();
+		}
+	}
+	posixx::simd::use(prev);
+}
+
+} // anonymous namespace
+
+BENCH( buffer_construct )
+{
+	run< construct_fill >("buffer_construct", "fill");
+	run< construct_range >("buffer_construct", "range");
+}
+
+BENCH( buffer_copy )
+{
+	run< copy_construct >("buffer_copy", "construct");
+	run< copy_assign >("buffer_copy", "assign");
+}
+
+BENCH( buffer_resize )
+{
+	run< resize_linear >("buffer_resize", "linear");
+	run< resize_double >("buffer_resize", "double");
+	run< resize_shrink >("buffer_resize", "shrink");
+}
+
+BENCH( buffer_assign )
+{
+	run< assign_pointer >("buffer_assign", "pointer");
+	run< assign_forward >("buffer_assign", "forward");
+	run< assign_input >("buffer_assign", "input");
+}
+
+BENCH( buffer_compare )
+{
+	run< compare_equal >("buffer_compare", "equal");
+	run< compare_less >("buffer_compare", "less");
+}
+
+BENCH( buffer_swap )
+{
+	run< swap >("buffer_swap", "swap");
+}
+
+BENCH( buffer_search )
+{
+	run_search("find", search::FIND);
+	run_search("find_any", search::FIND_ANY);
+	run_search("find_str", search::FIND_STR);
+	run_search("equal", search::EQUAL);
+	run_search("hash", search::HASH);
+}
+
@@ -0,0 +1,155 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "bench.hpp" // BENCH, bench::report, now, budget
+
+#include <posixx/linux/executor.hpp> // posixx::linux::executor
+#include <posixx/linux/queue.hpp> // posixx::linux::queue
+
+#include <vector> // std::vector
+#include <sched.h> // sched_yield
+#include <pthread.h> // pthread_create, pthread_join
+#include <stdint.h> // uint64_t
+
+/*
+ * posixx::linux::executor benchmarks.
+ *
+ * Bursts of small tasks are produced by a task running in a single worker
+ * (like a reactor handler reading a batch of requests) and the throughput
+ * in tasks per second is reported for the work-stealing executor, for the
+ * same executor with stealing disabled (strict affinity) and for a pool of
+ * threads consuming from a single shared queue.
+ */
+
+namespace {
+
+namespace lx = posixx::linux;
+
+const unsigned burst = 1024;
+const unsigned work = 200;
+
+struct job: lx::executor::task
+{
+	unsigned* remaining;
+	volatile unsigned sink;
+	void run()
+	{
+		unsigned x = 0;
+		for (unsigned i = 0; i < work; ++i)
+			x = x * 31 + i;
+		sink = x;
+		__atomic_sub_fetch(remaining, 1, __ATOMIC_RELEASE);
+	}
+};
+
+struct spawner: lx::executor::task
+{
+	lx::executor* e;
+	std::vector< job >* jobs;
+	void run()
+	{
+		for (unsigned i = 0; i < burst; ++i)
+			e->submit(&(*jobs)[i]);
+	}
+};
+
+void wait_for(unsigned* remaining)
+{
+	while (__atomic_load_n(remaining, __ATOMIC_ACQUIRE))
+		sched_yield();
+}
+
+void report(const char* kind, unsigned threads, uint64_t tasks,
+		uint64_t start, uint64_t stolen)
+{
+	double secs = (bench::now() - start) / 1e9;
+	bench::report("executor_burst")
+		.tag("kind", kind)
+		.num("threads", threads)
+		.num("tasks", tasks)
+		.num("stolen", stolen)
+		.num("seconds", secs)
+		.num("tasks_per_s", tasks / secs)
+		.print();
+}
+
+void executor(const char* kind, unsigned threads, bool steal)
+{
+	lx::executor::config c;
+	c.threads = threads;
+	c.steal = steal;
+	lx::executor e(c);
+	e.start();
+	unsigned remaining = 0;
+	std::vector< job > jobs(burst);
+	for (unsigned i = 0; i < burst; ++i)
+		jobs[i].remaining = &remaining;
+	spawner s;
+	s.e = &e;
+	s.jobs = &jobs;
+	uint64_t tasks = 0;
+	uint64_t start = bench::now();
+	uint64_t end = start + bench::budget();
+	while (bench::now() < end) {
+		remaining = burst;
+		e.submit(&s, 0);
+		wait_for(&remaining);
+		tasks += burst;
+	}
+	report(kind, threads, tasks, start, e.stolen());
+	e.stop();
+	e.join();
+}
+
+typedef lx::queue< lx::executor::task* > shared_queue;
+
+void* consumer(void* arg)
+{
+	shared_queue& q = *static_cast< shared_queue* >(arg);
+	lx::executor::task* t;
+	while (q.pop(t))
+		t->run();
+	return NULL;
+}
+
+void shared(unsigned threads)
+{
+	shared_queue q(4096);
+	std::vector< pthread_t > p(threads);
+	for (unsigned i = 0; i < threads; ++i)
+		pthread_create(&p[i], NULL, &consumer, &q);
+	unsigned remaining = 0;
+	std::vector< job > jobs(burst);
+	for (unsigned i = 0; i < burst; ++i)
+		jobs[i].remaining = &remaining;
+	uint64_t tasks = 0;
+	uint64_t start = bench::now();
+	uint64_t end = start + bench::budget();
+	while (bench::now() < end) {
+		remaining = burst;
+		for (unsigned i = 0; i < burst; ++i)
+			q.push(&jobs[i]);
+		wait_for(&remaining);
+		tasks += burst;
+	}
+	report("shared_queue", threads, tasks, start, 0);
+	q.close();
+	for (unsigned i = 0; i < threads; ++i)
+		pthread_join(p[i], NULL);
+}
+
+} // namespace
+
+BENCH( executor_burst )
+{
+	for (unsigned t = 1; t <= 4; t *= 2) {
+		executor("stealing", t, true);
+		executor("affinity", t, false);
+		shared(t);
+	}
+}
+
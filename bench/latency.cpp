@@ -0,0 +1,102 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "bench.hpp" // BENCH, bench::measure, report, keep
+
+#include <posixx/socket/latency.hpp> // posixx::socket::latency_stats
+#include <posixx/socket/unix.hpp> // posixx::socket::unix::traits
+#include <posixx/histogram.hpp> // posixx::histogram
+#include <posixx/tsc.hpp> // posixx::tsc
+
+#include <stdint.h> // uint64_t
+
+/*
+ * posixx::socket::latency_stats overhead benchmarks.
+ *
+ * The cost latency_stats adds to each system call is a start() plus a
+ * record(), measured here without any system call in between. Its parts
+ * are measured too, so it's easy to tell where the time goes: two reads of
+ * the clock (posixx::tsc, compared with the clock_gettime(2) it replaced)
+ * and a histogram::record().
+ */
+
+namespace {
+
+namespace sock = posixx::socket;
+namespace tsc = posixx::tsc;
+
+typedef sock::latency_stats< sock::unix::traits > policy;
+
+struct stats_op
+{
+	void operator () (uint64_t n) const
+	{
+		policy p;
+		for (uint64_t i = 0; i < n; ++i)
+			p.record(sock::SEND, p.start(sock::SEND), 1);
+	}
+};
+
+struct tsc_op
+{
+	void operator () (uint64_t n) const
+	{
+		uint64_t sum = 0;
+		for (uint64_t i = 0; i < n; ++i) {
+			tsc::ticks_type start = tsc::ticks();
+			sum += tsc::ns(tsc::ticks() - start);
+		}
+		bench::keep(sum);
+	}
+};
+
+struct monotonic_op
+{
+	void operator () (uint64_t n) const
+	{
+		uint64_t sum = 0;
+		for (uint64_t i = 0; i < n; ++i) {
+			uint64_t start = tsc::monotonic();
+			sum += tsc::monotonic() - start;
+		}
+		bench::keep(sum);
+	}
+};
+
+struct histogram_op
+{
+	posixx::histogram* h;
+	void operator () (uint64_t n) const
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			h->record(i & 0xffff);
+	}
+};
+
+void report(const char* op, const bench::timing& t)
+{
+	bench::report("latency_overhead")
+		.tag("op", op)
+		.tag("clock", tsc::available() ? "tsc" : "monotonic")
+		.time(t)
+		.print();
+}
+
+} // namespace
+
+BENCH( latency_overhead )
+{
+	// calibrate the clock before measuring
+	tsc::ticks();
+	report("start+record", bench::measure(stats_op()));
+	report("2x tsc", bench::measure(tsc_op()));
+	report("2x clock_gettime", bench::measure(monotonic_op()));
+	posixx::histogram h;
+	histogram_op hop = { &h };
+	report("histogram::record", bench::measure(hop));
+	bench::keep(h);
+}
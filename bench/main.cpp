@@ -0,0 +1,75 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "bench.hpp" // bench::registry, conf
+
+#include <string> // std::string
+#include <vector> // std::vector
+#include <iostream> // std::cerr
+#include <cstdlib> // std::atof, std::atoi, EXIT_*
+
+static
+void usage(const char* prog)
+{
+	std::cerr << "Usage: " << prog << " [options] [name...]\n"
+		"\n"
+		"Run the benchmarks matching any of the names (all if none is\n"
+		"given). A benchmark matches if its name starts with name.\n"
+		"\n"
+		"Options:\n"
+		"  -t SECONDS  time budget for each measured case (default "
+			<< bench::conf().seconds << ")\n"
+		"  -r N        repetitions of each measured case (default "
+			<< bench::conf().repetitions << ")\n"
+		"  -l          list the available benchmarks and exit\n";
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector< std::string > names;
+	bool list = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "-t" && i + 1 < argc)
+			bench::conf().seconds = std::atof(argv[++i]);
+		else if (arg == "-r" && i + 1 < argc)
+			bench::conf().repetitions = std::atoi(argv[++i]);
+		else if (arg == "-l")
+			list = true;
+		else if (!arg.empty() && arg[0] == '-') {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		else
+			names.push_back(arg);
+	}
+	if (bench::conf().seconds <= 0 || bench::conf().repetitions == 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const std::vector< bench::benchmark >& r = bench::registry();
+	for (std::vector< bench::benchmark >::const_iterator b = r.begin();
+			b != r.end(); ++b) {
+		bool selected = names.empty();
+		for (std::vector< std::string >::const_iterator n = names.begin();
+				n != names.end(); ++n)
+			if (std::string(b->name).compare(0, n->size(), *n) == 0)
+				selected = true;
+		if (!selected)
+			continue;
+		if (list) {
+			std::cout << b->name << std::endl;
+			continue;
+		}
+		std::cerr << "Running " << b->name << "..." << std::endl;
+		b->run();
+	}
+
+	return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,133 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "bench.hpp" // BENCH, bench::measure, report, keep
+
+#include <posixx/socket/peer_table.hpp> // posixx::socket::peer_table
+#include <posixx/socket/inet.hpp> // posixx::socket::inet
+
+#include <map> // std::map
+#include <vector> // std::vector
+#include <utility> // std::pair, std::make_pair
+#include <cstddef> // std::size_t
+#include <stdint.h> // uint32_t, uint64_t
+
+/*
+ * posixx::socket::peer_table benchmarks.
+ *
+ * Lookups of random (present) peers by inet::sockaddr, for several numbers
+ * of peers, compared with an std::map keyed by (address, port). The lookups
+ * are done one by one and in batches of 32 prefetching all the addresses
+ * first (as a server processing the packets got by recvmmsg(2) would).
+ */
+
+namespace {
+
+namespace inet = posixx::socket::inet;
+
+typedef posixx::socket::peer_table< inet::sockaddr, uint64_t > table;
+typedef std::map< std::pair< uint32_t, uint16_t >, uint64_t > map;
+
+const std::size_t sizes[] = { 1024, 65536, 1048576 };
+
+// Number of different addresses looked up (in random order)
+const std::size_t lookups = 4096;
+
+const std::size_t batch = 32;
+
+inet::sockaddr peer(uint32_t i)
+{
+	return inet::sockaddr(htonl(0x0a000000 | i >> 4), 1000 + (i & 0xf));
+}
+
+struct table_lookup
+{
+	const table* t;
+	const std::vector< inet::sockaddr >* addrs;
+	void operator () (uint64_t n) const
+	{
+		uint64_t sum = 0;
+		for (uint64_t i = 0; i < n; ++i)
+			sum += *t->find((*addrs)[i % lookups]);
+		bench::keep(sum);
+	}
+};
+
+struct table_batch_lookup
+{
+	const table* t;
+	const std::vector< inet::sockaddr >* addrs;
+	void operator () (uint64_t n) const
+	{
+		uint64_t sum = 0;
+		for (uint64_t i = 0; i < n; i += batch) {
+			std::size_t b = i % lookups;
+			for (std::size_t j = 0; j < batch; ++j)
+				t->prefetch((*addrs)[b + j]);
+			for (std::size_t j = 0; j < batch; ++j)
+				sum += *t->find((*addrs)[b + j]);
+		}
+		bench::keep(sum);
+	}
+};
+
+struct map_lookup
+{
+	const map* m;
+	const std::vector< inet::sockaddr >* addrs;
+	void operator () (uint64_t n) const
+	{
+		uint64_t sum = 0;
+		for (uint64_t i = 0; i < n; ++i) {
+			const inet::sockaddr& a = (*addrs)[i % lookups];
+			sum += m->find(std::make_pair(a.sin_addr.s_addr,
+					a.sin_port))->second;
+		}
+		bench::keep(sum);
+	}
+};
+
+void report(const char* impl, std::size_t peers, const bench::timing& t)
+{
+	bench::report("peer_table_lookup")
+		.tag("impl", impl)
+		.num("peers", peers)
+		.time(t)
+		.print();
+}
+
+} // namespace
+
+BENCH( peer_table_lookup )
+{
+	for (std::size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s) {
+		std::size_t n = sizes[s];
+		table t;
+		map m;
+		for (std::size_t i = 0; i < n; ++i) {
+			inet::sockaddr a = peer(i);
+			t[a] = i;
+			m[std::make_pair(a.sin_addr.s_addr, a.sin_port)] = i;
+		}
+		std::vector< inet::sockaddr > addrs;
+		uint64_t x = uint64_t(0x139408dcu) << 32 | 0xbbf7a44u;
+		for (std::size_t i = 0; i < lookups; ++i) {
+			// xorshift64
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			addrs.push_back(peer(x % n));
+		}
+		table_lookup tl = { &t, &addrs };
+		report("peer_table", n, bench::measure(tl));
+		table_batch_lookup tb = { &t, &addrs };
+		report("peer_table_prefetch", n, bench::measure(tb));
+		map_lookup ml = { &m, &addrs };
+		report("std_map", n, bench::measure(ml));
+	}
+}
+
@@ -0,0 +1,106 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "bench.hpp" // BENCH, bench::report, now, budget
+
+#include <posixx/linux/queue.hpp> // posixx::linux::queue
+
+#include <vector> // std::vector
+#include <pthread.h> // pthread_create, pthread_join
+#include <stdint.h> // uint64_t
+
+/*
+ * posixx::linux::queue benchmarks.
+ *
+ * N producers push pointers as fast as they can for the time budget and N
+ * consumers pop them, blocking when the queue is empty. The throughput is
+ * reported in elements per second, for the MPMC queue with 1, 2 and 4
+ * threads on each side and for the SPSC specialization.
+ */
+
+namespace {
+
+namespace lx = posixx::linux;
+
+const std::size_t capacity = 1024;
+
+template < typename Q >
+struct context
+{
+	Q q;
+	uint64_t end;
+	context(): q(capacity), end(0) {}
+};
+
+template < typename Q >
+void* producer(void* arg)
+{
+	context< Q >& c = *static_cast< context< Q >* >(arg);
+	uint64_t n = 0;
+	while ((n & 1023) || bench::now() < c.end) {
+		c.q.push(&c);
+		++n;
+	}
+	return reinterpret_cast< void* >(n);
+}
+
+template < typename Q >
+void* consumer(void* arg)
+{
+	context< Q >& c = *static_cast< context< Q >* >(arg);
+	uint64_t n = 0;
+	void* v;
+	while (c.q.pop(v))
+		++n;
+	return reinterpret_cast< void* >(n);
+}
+
+template < typename Q >
+void throughput(const char* kind, unsigned threads)
+{
+	context< Q > c;
+	std::vector< pthread_t > p(threads);
+	std::vector< pthread_t > q(threads);
+	uint64_t start = bench::now();
+	c.end = start + bench::budget();
+	for (unsigned i = 0; i < threads; ++i) {
+		pthread_create(&q[i], NULL, &consumer< Q >, &c);
+		pthread_create(&p[i], NULL, &producer< Q >, &c);
+	}
+	uint64_t pushed = 0;
+	for (unsigned i = 0; i < threads; ++i) {
+		void* r;
+		pthread_join(p[i], &r);
+		pushed += reinterpret_cast< uint64_t >(r);
+	}
+	c.q.close();
+	uint64_t popped = 0;
+	for (unsigned i = 0; i < threads; ++i) {
+		void* r;
+		pthread_join(q[i], &r);
+		popped += reinterpret_cast< uint64_t >(r);
+	}
+	double secs = (bench::now() - start) / 1e9;
+	bench::report("queue_throughput")
+		.tag("kind", kind)
+		.num("threads", threads)
+		.num("pushed", pushed)
+		.num("popped", popped)
+		.num("seconds", secs)
+		.num("ops_per_s", popped / secs)
+		.print();
+}
+
+} // namespace
+
+BENCH( queue_throughput )
+{
+	throughput< lx::queue< void*, lx::SPSC > >("spsc", 1);
+	for (unsigned t = 1; t <= 4; t *= 2)
+		throughput< lx::queue< void* > >("mpmc", t);
+}
+
@@ -0,0 +1,198 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "bench.hpp" // BENCH, bench::measure, report, keep
+
+#include <posixx/socket/inet.hpp> // posixx::socket::inet
+#include <posixx/socket/inet/print.hpp> // inet::sockaddr ostream output
+#include <posixx/socket/unix.hpp> // posixx::socket::unix
+#include <posixx/linux/tipc.hpp> // posixx::linux::tipc
+
+#include <string> // std::string
+#include <sstream> // std::ostringstream
+#include <cstdio> // snprintf
+#include <arpa/inet.h> // inet_ntoa, inet_addr
+#include <stdint.h> // uint64_t
+
+/*
+ * Socket address text conversion benchmarks.
+ *
+ * The allocation-free format() and parse() members of the socket addresses
+ * are compared with the previous ways to do the same: formatting an
+ * inet::sockaddr through its ostream operator into an std::ostringstream,
+ * getting the IP address with inet_ntoa(3) (or sockaddr::addr(), which
+ * returns an std::string) and parsing it with inet_addr(3) (through an
+ * std::string, as the sockaddr constructor does).
+ */
+
+namespace {
+
+namespace inet = posixx::socket::inet;
+namespace unix = posixx::socket::unix;
+namespace tipc = posixx::linux::tipc;
+
+const inet::sockaddr inet_addr_(inet::broadcast, 65535);
+
+struct inet_format
+{
+	void operator () (uint64_t n) const
+	{
+		char buf[inet::sockaddr::TEXT_SIZE];
+		for (uint64_t i = 0; i < n; ++i) {
+			bench::keep(inet_addr_.format(buf, sizeof(buf)));
+			bench::keep(buf);
+		}
+	}
+};
+
+struct inet_ostream
+{
+	void operator () (uint64_t n) const
+	{
+		for (uint64_t i = 0; i < n; ++i) {
+			std::ostringstream os;
+			os << inet_addr_;
+			bench::keep(os.str());
+		}
+	}
+};
+
+struct inet_ntoa_snprintf
+{
+	void operator () (uint64_t n) const
+	{
+		char buf[inet::sockaddr::TEXT_SIZE];
+		for (uint64_t i = 0; i < n; ++i) {
+			bench::keep(snprintf(buf, sizeof(buf), "%s:%u",
+					inet_ntoa(inet_addr_.sin_addr),
+					unsigned(inet_addr_.port())));
+			bench::keep(buf);
+		}
+	}
+};
+
+struct inet_addr_string
+{
+	void operator () (uint64_t n) const
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			bench::keep(inet_addr_.addr());
+	}
+};
+
+struct inet_parse
+{
+	void operator () (uint64_t n) const
+	{
+		inet::sockaddr sa;
+		for (uint64_t i = 0; i < n; ++i) {
+			bench::keep(sa.parse("255.255.255.255:65535"));
+			bench::keep(sa);
+		}
+	}
+};
+
+struct inet_string_ctor
+{
+	void operator () (uint64_t n) const
+	{
+		for (uint64_t i = 0; i < n; ++i) {
+			inet::sockaddr sa(std::string("255.255.255.255"),
+					65535);
+			bench::keep(sa);
+		}
+	}
+};
+
+struct inet_addr_c
+{
+	void operator () (uint64_t n) const
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			bench::keep(inet_addr("255.255.255.255"));
+	}
+};
+
+struct unix_format
+{
+	unix::sockaddr sa;
+	unix_format(): sa("/tmp/posixx_bench_sockaddr") {}
+	void operator () (uint64_t n) const
+	{
+		char buf[unix::sockaddr::TEXT_SIZE];
+		for (uint64_t i = 0; i < n; ++i) {
+			bench::keep(sa.format(buf, sizeof(buf)));
+			bench::keep(buf);
+		}
+	}
+};
+
+struct unix_path
+{
+	unix::sockaddr sa;
+	unix_path(): sa("/tmp/posixx_bench_sockaddr") {}
+	void operator () (uint64_t n) const
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			bench::keep(sa.path());
+	}
+};
+
+struct tipc_format
+{
+	tipc::sockaddr sa;
+	tipc_format(): sa(tipc::nameseq(1000, 1, 4294967295u)) {}
+	void operator () (uint64_t n) const
+	{
+		char buf[tipc::sockaddr::TEXT_SIZE];
+		for (uint64_t i = 0; i < n; ++i) {
+			bench::keep(sa.format(buf, sizeof(buf)));
+			bench::keep(buf);
+		}
+	}
+};
+
+struct tipc_parse
+{
+	void operator () (uint64_t n) const
+	{
+		tipc::sockaddr sa;
+		for (uint64_t i = 0; i < n; ++i) {
+			bench::keep(sa.parse("{1000,1,4294967295}"));
+			bench::keep(sa);
+		}
+	}
+};
+
+template < typename F >
+void run(const char* family, const char* op, const char* impl, F f)
+{
+	bench::report("sockaddr_text")
+		.tag("family", family)
+		.tag("op", op)
+		.tag("impl", impl)
+		.time(bench::measure(f))
+		.print();
+}
+
+} // namespace
+
+BENCH( sockaddr_text )
+{
+	run("inet", "format", "format", inet_format());
+	run("inet", "format", "ostream", inet_ostream());
+	run("inet", "format", "inet_ntoa", inet_ntoa_snprintf());
+	run("inet", "format_addr", "addr_string", inet_addr_string());
+	run("inet", "parse", "parse", inet_parse());
+	run("inet", "parse", "string_ctor", inet_string_ctor());
+	run("inet", "parse", "inet_addr", inet_addr_c());
+	run("unix", "format", "format", unix_format());
+	run("unix", "format", "path_string", unix_path());
+	run("tipc", "format", "format", tipc_format());
+	run("tipc", "parse", "parse", tipc_parse());
+}
+
@@ -0,0 +1,457 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "bench.hpp" // BENCH, bench::report, now, budget
+
+#include <posixx/socket/unix.hpp> // posixx::socket::unix
+#include <posixx/socket/inet.hpp> // posixx::socket::inet
+#include <posixx/socket/loopback.hpp> // posixx::socket::loopback
+#include <posixx/socket/opt.hpp> // posixx::socket::opt
+#include <posixx/linux/tipc.hpp> // posixx::linux::tipc
+#include <posixx/histogram.hpp> // posixx::histogram
+
+#include <string> // std::string
+#include <sstream> // std::ostringstream
+#include <vector> // std::vector
+#include <iostream> // std::cerr
+#include <cerrno> // EAFNOSUPPORT
+#include <pthread.h> // pthread_create, pthread_join
+#include <unistd.h> // unlink, getpid
+#include <sys/time.h> // timeval
+
+namespace sock = posixx::socket;
+namespace unix = posixx::socket::unix;
+namespace inet = posixx::socket::inet;
+namespace loopback = posixx::socket::loopback;
+namespace tipc = posixx::linux::tipc;
+
+namespace {
+
+// Message sizes, from 16 B to 1 MiB
+const size_t sizes[] = { 16, 64, 256, 1024, 4096, 16384, 65536, 262144,
+		1048576 };
+
+// Socket types
+const sock::type types[] = { sock::DGRAM, sock::STREAM, sock::SEQPACKET,
+		sock::RDM };
+
+// Time to wait for a message before giving up (in case a datagram is lost)
+const int timeout_ms = 1000;
+
+const char* type_name(sock::type t)
+{
+	switch (t) {
+	case sock::DGRAM: return "DGRAM";
+	case sock::STREAM: return "STREAM";
+	case sock::SEQPACKET: return "SEQPACKET";
+	case sock::RDM: return "RDM";
+	default: return "RAW";
+	}
+}
+
+bool connected(sock::type t)
+{
+	return t == sock::STREAM || t == sock::SEQPACKET;
+}
+
+/*
+ * Family specific stuff.
+ *
+ * Each family provides:
+ * - name(): the name to use in the reports.
+ * - supports(type): true if the socket type is supported.
+ * - max_msg(type): the maximum message size supported for the type.
+ * - server_addr() and client_addr(): addresses to bind to.
+ * - prepare(socket, addr): called before binding a socket.
+ * - cleanup(): called after the sockets are not used anymore.
+ */
+template < typename TSock >
+struct family;
+
+template <>
+struct family< unix::socket >
+{
+	static const char* name() { return "unix"; }
+	static bool supports(sock::type t) { return t != sock::RDM; }
+	static size_t max_msg(sock::type t)
+	{ return t == sock::STREAM ? ~size_t(0) : 65536; }
+	static unix::sockaddr addr(const char* role)
+	{
+		std::ostringstream os;
+		os << "/tmp/posixx_bench_" << role << "_" << getpid();
+		return unix::sockaddr(os.str());
+	}
+	static unix::sockaddr server_addr() { return addr("server"); }
+	static unix::sockaddr client_addr() { return addr("client"); }
+	static void prepare(unix::socket& s, const unix::sockaddr& a)
+	{ unlink(a.sun_path); }
+	static void cleanup()
+	{
+		unlink(server_addr().sun_path);
+		unlink(client_addr().sun_path);
+	}
+};
+
+template <>
+struct family< inet::socket >
+{
+	static const char* name() { return "inet"; }
+	static bool supports(sock::type t)
+	{ return t == sock::DGRAM || t == sock::STREAM; }
+	static size_t max_msg(sock::type t)
+	{ return t == sock::STREAM ? ~size_t(0) : 65507; }
+	static inet::sockaddr server_addr()
+	{ return inet::sockaddr("127.0.0.1", 0); }
+	static inet::sockaddr client_addr()
+	{ return inet::sockaddr("127.0.0.1", 0); }
+	static void prepare(inet::socket& s, const inet::sockaddr& a)
+	{ s.opt< sock::opt::REUSEADDR >(true); }
+	static void cleanup() {}
+};
+
+template <>
+struct family< tipc::socket >
+{
+	static const char* name() { return "tipc"; }
+	static bool supports(sock::type t)
+	{ return t != sock::RAW; }
+	static size_t max_msg(sock::type t)
+	{
+		return t == sock::STREAM ? ~size_t(0)
+				: size_t(tipc::MAX_USER_MSG_SIZE);
+	}
+	static tipc::sockaddr server_addr()
+	{ return tipc::sockaddr(tipc::name(20000, getpid()), tipc::NODE); }
+	static tipc::sockaddr client_addr()
+	{ return tipc::sockaddr(tipc::name(20001, getpid()), tipc::NODE); }
+	static void prepare(tipc::socket& s, const tipc::sockaddr& a) {}
+	static void cleanup() {}
+};
+
+// In-memory sockets, to measure the overhead outside the kernel
+template <>
+struct family< loopback::socket >
+{
+	static const char* name() { return "loopback"; }
+	static bool supports(sock::type t)
+	{ return t != sock::RDM; }
+	static size_t max_msg(sock::type t)
+	{ return t == sock::STREAM ? ~size_t(0) : 65536; }
+	static loopback::sockaddr server_addr()
+	{ return loopback::sockaddr(); }
+	static loopback::sockaddr client_addr()
+	{ return loopback::sockaddr(); }
+	static void prepare(loopback::socket& s, const loopback::sockaddr& a)
+	{}
+	static void cleanup() {}
+};
+
+template < typename TSock >
+bool available()
+{
+	try {
+		TSock s(sock::DGRAM);
+	}
+	catch (const posixx::error& e) {
+		if (e.no != EAFNOSUPPORT)
+			throw;
+		std::cerr << family< TSock >::name() << " sockets not "
+				"available, skipping" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+template < typename TSock >
+void set_timeout(TSock& s)
+{
+	timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = timeout_ms % 1000 * 1000;
+	s.template opt< sock::opt::RCVTIMEO >(tv);
+}
+
+/*
+ * A connected (or ready to talk) pair of sockets.
+ *
+ * For connection oriented types the client is connected to the server, for
+ * connectionless types both are bound and messages are sent using to (the
+ * client sends to the server and the server replies to whatever address it
+ * got the message from).
+ */
+template < typename TSock >
+struct endpoint
+{
+	typedef typename TSock::traits::sockaddr addr_type;
+	sock::type type;
+	TSock* sock;
+	addr_type peer;
+	endpoint(sock::type t): type(t), sock(0) {}
+	~endpoint() { delete sock; }
+};
+
+// Send a whole message, returns false on error.
+template < typename TSock >
+bool send_msg(endpoint< TSock >& e, const char* buf, size_t n)
+{
+	try {
+		if (!connected(e.type))
+			return e.sock->send(buf, n, e.peer, MSG_NOSIGNAL)
+					== ssize_t(n);
+		size_t sent = 0;
+		while (sent < n)
+			sent += e.sock->send(buf + sent, n - sent,
+					MSG_NOSIGNAL);
+	}
+	catch (const posixx::error& err) {
+		return false;
+	}
+	return true;
+}
+
+// Receive a whole message, returns the number of bytes received (can be less
+// than n if the peer shut down the connection or sent a shorter message).
+template < typename TSock >
+size_t recv_msg(endpoint< TSock >& e, char* buf, size_t n)
+{
+	size_t got = 0;
+	try {
+		if (!connected(e.type))
+			return e.sock->recv(buf, n, e.peer);
+		if (e.type == sock::SEQPACKET)
+			return e.sock->recv(buf, n);
+		while (got < n)
+			got += e.sock->recv(buf + got, n - got);
+	}
+	catch (const posixx::error& err) {
+	}
+	return got;
+}
+
+// Which benchmark the server should run
+enum mode { PINGPONG, THROUGHPUT };
+
+// Server thread arguments and results
+template < typename TSock >
+struct server_context
+{
+	endpoint< TSock > ep;
+	TSock* listener;
+	mode m;
+	size_t size;
+	// results (throughput)
+	uint64_t start;
+	uint64_t last;
+	uint64_t bytes;
+	uint64_t messages;
+	server_context(sock::type t): ep(t), listener(0), m(PINGPONG),
+			size(0), start(0), last(0), bytes(0), messages(0) {}
+	~server_context() { delete listener; }
+};
+
+template < typename TSock >
+void* server_main(void* arg)
+{
+	server_context< TSock >& c = *static_cast< server_context< TSock >* >(
+			arg);
+	try {
+		if (c.listener)
+			c.ep.sock = c.listener->accept();
+	}
+	catch (const posixx::error& e) {
+		std::cerr << "accept: " << e.what() << std::endl;
+		return 0;
+	}
+	set_timeout(*c.ep.sock);
+	std::vector< char > buf(c.size);
+	if (c.m == PINGPONG) {
+		// echo until we get a short message (or the peer is gone)
+		while (recv_msg(c.ep, &buf[0], c.size) == c.size)
+			if (!send_msg(c.ep, &buf[0], c.size))
+				break;
+		return 0;
+	}
+	// count until we get a short message (or the peer is gone)
+	for (;;) {
+		size_t n = recv_msg(c.ep, &buf[0], c.size);
+		if (n != c.size)
+			break;
+		c.last = bench::now();
+		c.bytes += n;
+		++c.messages;
+	}
+	return 0;
+}
+
+// Set up the client and the server (running in its own thread)
+template < typename TSock >
+bool setup(endpoint< TSock >& client, server_context< TSock >& server,
+		pthread_t& thread)
+{
+	typedef family< TSock > f;
+	typedef typename TSock::traits::sockaddr addr_type;
+	sock::type t = client.type;
+	TSock* s = new TSock(t);
+	addr_type saddr = f::server_addr();
+	f::prepare(*s, saddr);
+	s->bind(saddr);
+	addr_type target = s->name();
+	if (connected(t)) {
+		s->listen();
+		server.listener = s;
+	}
+	else
+		server.ep.sock = s;
+	client.sock = new TSock(t);
+	// connect before starting the server, so nothing has to be undone if
+	// it fails (the listener queues the connection until it's accepted)
+	if (connected(t))
+		client.sock->connect(target);
+	else {
+		addr_type caddr = f::client_addr();
+		f::prepare(*client.sock, caddr);
+		client.sock->bind(caddr);
+		client.peer = target;
+	}
+	if (pthread_create(&thread, 0, &server_main< TSock >, &server) != 0)
+		return false;
+	set_timeout(*client.sock);
+	return true;
+}
+
+// Tell the server to stop and wait for it
+template < typename TSock >
+void teardown(endpoint< TSock >& client, pthread_t thread)
+{
+	if (connected(client.type))
+		client.sock->shutdown(sock::WR);
+	else {
+		char stop = 0;
+		send_msg(client, &stop, 1);
+	}
+	pthread_join(thread, 0);
+	family< TSock >::cleanup();
+}
+
+template < typename TSock >
+void pingpong(sock::type t, size_t size)
+{
+	endpoint< TSock > client(t);
+	server_context< TSock > server(t);
+	server.m = PINGPONG;
+	server.size = size;
+	pthread_t thread;
+	if (!setup(client, server, thread))
+		return;
+	std::vector< char > buf(size, 'x');
+	posixx::histogram h;
+	uint64_t errors = 0;
+	uint64_t end = bench::now() + bench::budget();
+	for (;;) {
+		uint64_t start = bench::now();
+		if (start > end)
+			break;
+		if (!send_msg(client, &buf[0], size)
+				|| recv_msg(client, &buf[0], size) != size) {
+			++errors;
+			break;
+		}
+		h.record(bench::now() - start);
+	}
+	teardown(client, thread);
+	bench::report("socket_pingpong")
+		.tag("family", family< TSock >::name())
+		.tag("type", type_name(t))
+		.num("size", size)
+		.num("iterations", h.count())
+		.num("errors", errors)
+		.latency(h)
+		.print();
+}
+
+template < typename TSock >
+void throughput(sock::type t, size_t size)
+{
+	endpoint< TSock > client(t);
+	server_context< TSock > server(t);
+	server.m = THROUGHPUT;
+	server.size = size;
+	pthread_t thread;
+	if (!setup(client, server, thread))
+		return;
+	std::vector< char > buf(size, 'x');
+	uint64_t sent = 0;
+	server.start = bench::now();
+	uint64_t end = server.start + bench::budget();
+	while (bench::now() < end && send_msg(client, &buf[0], size))
+		++sent;
+	teardown(client, thread);
+	// nothing got through (or the clock went wrong), there is no rate to
+	// report
+	if (!server.messages || server.last <= server.start) {
+		std::cerr << "socket_throughput " << family< TSock >::name()
+			<< " " << type_name(t) << " " << size
+			<< ": no messages received (" << sent << " sent)"
+			<< std::endl;
+		return;
+	}
+	double secs = (server.last - server.start) / 1e9;
+	bench::report("socket_throughput")
+		.tag("family", family< TSock >::name())
+		.tag("type", type_name(t))
+		.num("size", size)
+		.num("sent", sent)
+		.num("received", server.messages)
+		.num("seconds", secs)
+		.num("msgs_per_s", server.messages / secs)
+		.num("mib_per_s", server.bytes / secs / 1048576)
+		.print();
+}
+
+template < typename TSock >
+void run_all(void (*bench)(sock::type, size_t))
+{
+	if (!available< TSock >())
+		return;
+	typedef family< TSock > f;
+	for (size_t i = 0; i < sizeof(types) / sizeof(*types); ++i) {
+		if (!f::supports(types[i]))
+			continue;
+		for (size_t j = 0; j < sizeof(sizes) / sizeof(*sizes); ++j) {
+			if (sizes[j] > f::max_msg(types[i]))
+				continue;
+			try {
+				bench(types[i], sizes[j]);
+			}
+			catch (const posixx::error& e) {
+				std::cerr << f::name() << " "
+					<< type_name(types[i]) << " "
+					<< sizes[j] << ": " << e.what()
+					<< std::endl;
+			}
+		}
+	}
+}
+
+} // namespace
+
+BENCH( socket_pingpong )
+{
+	run_all< unix::socket >(&pingpong< unix::socket >);
+	run_all< inet::socket >(&pingpong< inet::socket >);
+	run_all< loopback::socket >(&pingpong< loopback::socket >);
+	run_all< tipc::socket >(&pingpong< tipc::socket >);
+}
+
+BENCH( socket_throughput )
+{
+	run_all< unix::socket >(&throughput< unix::socket >);
+	run_all< inet::socket >(&throughput< inet::socket >);
+	run_all< loopback::socket >(&throughput< loopback::socket >);
+	run_all< tipc::socket >(&throughput< tipc::socket >);
+}
+
@@ -0,0 +1,122 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "bench.hpp" // BENCH, bench::measure, report, keep
+
+#include <posixx/socket/udp.hpp> // posixx::socket::udp
+#include <posixx/socket/inet.hpp> // posixx::socket::inet
+#include <posixx/socket/opt.hpp> // posixx::socket::opt
+
+#include <vector> // std::vector
+#include <algorithm> // std::min
+#include <cstddef> // std::size_t
+#include <stdint.h> // uint16_t, uint64_t
+#include <sys/time.h> // timeval
+
+/*
+ * posixx::socket::udp benchmarks.
+ *
+ * Transfer of a batch of datagrams of the same size through the loopback
+ * interface (in the same thread): one sendto() and one recv() per datagram
+ * (plain), one GSO send and one recv() per datagram (gso), and one GSO
+ * send and GRO receives (gso_gro). The reported time is per batch.
+ */
+
+namespace {
+
+namespace sock = posixx::socket;
+namespace inet = posixx::socket::inet;
+namespace udp = posixx::socket::udp;
+
+const uint16_t segments[] = { 500, 1400 };
+
+// Biggest batch that fits in a datagram
+std::size_t batch(uint16_t segment)
+{
+	return std::min< std::size_t >(65000 / segment, udp::MAX_SEGMENTS)
+			* segment;
+}
+
+struct plain
+{
+	inet::socket* tx;
+	inet::socket* rx;
+	const inet::sockaddr* to;
+	uint16_t segment;
+	std::vector< char >* buf;
+	void operator () (uint64_t n) const
+	{
+		std::size_t size = batch(segment);
+		for (uint64_t i = 0; i < n; ++i) {
+			for (std::size_t s = 0; s < size; s += segment)
+				tx->send(&(*buf)[s], segment, *to);
+			for (std::size_t s = 0; s < size; s += segment)
+				rx->recv(&(*buf)[0], buf->size());
+		}
+		bench::keep(*buf);
+	}
+};
+
+struct gso
+{
+	inet::socket* tx;
+	inet::socket* rx;
+	const inet::sockaddr* to;
+	uint16_t segment;
+	std::vector< char >* buf;
+	bool gro;
+	void operator () (uint64_t n) const
+	{
+		std::size_t size = batch(segment);
+		for (uint64_t i = 0; i < n; ++i) {
+			udp::send(*tx, &(*buf)[0], size, segment, *to);
+			uint16_t seg;
+			for (std::size_t got = 0; got < size; )
+				got += gro ? udp::recv(*rx, &(*buf)[0],
+						buf->size(), seg)
+					: rx->recv(&(*buf)[0], buf->size());
+		}
+		bench::keep(*buf);
+	}
+};
+
+void report(const char* impl, uint16_t segment, const bench::timing& t)
+{
+	bench::report("udp_transfer")
+		.tag("impl", impl)
+		.num("segment", segment)
+		.num("bytes", batch(segment))
+		.time(t)
+		.print();
+}
+
+} // namespace
+
+BENCH( udp_transfer )
+{
+	inet::sockaddr addr("127.0.0.1", 0);
+	inet::socket rx(sock::DGRAM);
+	rx.bind(addr);
+	addr = rx.name();
+	rx.opt< sock::opt::RCVBUF >(4 << 20);
+	// don't hang forever if a datagram is lost
+	timeval tv = { 1, 0 };
+	rx.opt< sock::opt::RCVTIMEO >(tv);
+	inet::socket tx(sock::DGRAM);
+	std::vector< char > buf(65536);
+	for (std::size_t s = 0; s < sizeof(segments) / sizeof(*segments); ++s) {
+		uint16_t seg = segments[s];
+		rx.opt< udp::opt::GRO >(0);
+		plain p = { &tx, &rx, &addr, seg, &buf };
+		report("plain", seg, bench::measure(p));
+		gso g = { &tx, &rx, &addr, seg, &buf, false };
+		report("gso", seg, bench::measure(g));
+		rx.opt< udp::opt::GRO >(1);
+		g.gro = true;
+		report("gso_gro", seg, bench::measure(g));
+	}
+}
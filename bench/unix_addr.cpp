@@ -0,0 +1,99 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "bench.hpp" // BENCH, bench::measure, report, keep
+
+#include <posixx/socket/unix.hpp> // posixx::socket::unix
+
+#include <string> // std::string
+#include <sstream> // std::ostringstream
+#include <stdint.h> // uint64_t
+#include <unistd.h> // unlink, getpid
+
+/*
+ * posixx::socket::unix abstract namespace benchmarks.
+ *
+ * connect(2) and sendto(2) of DGRAM sockets to a path based address
+ * (which needs a filesystem lookup each time) compared with the same
+ * operations using an abstract namespace address. sendto() is measured
+ * with the datagram being received back by the server, so the queue never
+ * fills up.
+ */
+
+namespace {
+
+namespace sock = posixx::socket;
+namespace unix = posixx::socket::unix;
+
+unix::sockaddr server_addr(bool abstract)
+{
+	std::ostringstream os;
+	if (abstract) {
+		os << "posixx_bench_unix_addr_" << getpid();
+		return unix::sockaddr::abstract(os.str());
+	}
+	os << "/tmp/posixx_bench_unix_addr_" << getpid();
+	return unix::sockaddr(os.str());
+}
+
+struct connect_op
+{
+	unix::socket* client;
+	const unix::sockaddr* addr;
+	void operator () (uint64_t n) const
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			client->connect(*addr);
+	}
+};
+
+struct sendto_op
+{
+	unix::socket* client;
+	unix::socket* server;
+	const unix::sockaddr* addr;
+	void operator () (uint64_t n) const
+	{
+		char buf[16] = "ping";
+		for (uint64_t i = 0; i < n; ++i) {
+			client->send(buf, sizeof(buf), *addr);
+			server->recv(buf, sizeof(buf));
+		}
+		bench::keep(buf);
+	}
+};
+
+void report(const char* op, bool abstract, const bench::timing& t)
+{
+	bench::report("unix_addr")
+		.tag("op", op)
+		.tag("addr", abstract ? "abstract" : "path")
+		.time(t)
+		.print();
+}
+
+} // namespace
+
+BENCH( unix_addr )
+{
+	for (int a = 0; a < 2; ++a) {
+		bool abstract = a;
+		unix::sockaddr addr = server_addr(abstract);
+		if (!abstract)
+			unlink(addr.sun_path);
+		unix::socket server(sock::DGRAM);
+		server.bind(addr);
+		unix::socket client(sock::DGRAM);
+		connect_op c = { &client, &addr };
+		report("connect", abstract, bench::measure(c));
+		unix::socket unconnected(sock::DGRAM);
+		sendto_op s = { &unconnected, &server, &addr };
+		report("sendto", abstract, bench::measure(s));
+		if (!abstract)
+			unlink(addr.sun_path);
+	}
+}
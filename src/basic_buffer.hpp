@@ -7,9 +7,13 @@
 #ifndef POSIXX_BASIC_BUFFER_HPP_
 #define POSIXX_BASIC_BUFFER_HPP_
 
+#include "simd.hpp" // posixx::simd
+#include "static_assert.hpp" // static_assert
 #include <stdexcept> // std::bad_alloc, std::out_of_range
 #include <limits> // std::numeric_limits
 #include <tr1/type_traits> // std::tr1::is_integral, true_type, false_type
+#include <tr1/functional> // std::tr1::hash
+#include <functional> // std::unary_function
 #include <cstdlib> // std::realloc()
 #include <cstring> // std::memcpy(), memset(), memcmp()
 #include <cassert> // assert()
@@ -66,6 +70,9 @@ struct basic_buffer {
 	///
 	typedef std::reverse_iterator< const_iterator > const_reverse_iterator;
 
+	/// Value returned by the find methods when there is no match.
+	static const size_type npos = static_cast< size_type >(-1);
+
 
 	// Construct/Copy/Destroy
 	//////////////////////////////////////////////////////////////////////
@@ -374,6 +381,74 @@ struct basic_buffer {
 	{ return _data; }
 
 
+	// Search Operations
+	//////////////////////////////////////////////////////////////////////
+
+	/*
+	 * The search operations are only available for buffers of bytes and
+	 * use the vectorized implementations in posixx::simd.
+	 */
+
+	/**
+	 * Returns the position of the first element equal to value, starting
+	 * at pos, or npos if there is none.
+	 */
+	size_type find(value_type value, size_type pos = 0) const
+	{
+		static_assert(sizeof(value_type) == 1, "Only for byte buffers");
+		if (pos >= size())
+			return npos;
+		return _offset(simd::find(_data + pos, size() - pos, value),
+				pos);
+	}
+
+	/**
+	 * Returns the position of the first occurrence of the n elements
+	 * pointed by s, starting at pos, or npos if there is none.
+	 *
+	 * An empty sequence is found at pos (if pos <= size()).
+	 */
+	size_type find(const value_type* s, size_type n, size_type pos = 0)
+			const
+	{
+		static_assert(sizeof(value_type) == 1, "Only for byte buffers");
+		if (pos > size())
+			return npos;
+		return _offset(simd::find(_data + pos, size() - pos, s, n),
+				pos);
+	}
+
+	/**
+	 * Returns the position of the first occurrence of x, starting at pos,
+	 * or npos if there is none.
+	 */
+	size_type find(const basic_buffer< T, Allocator >& x,
+			size_type pos = 0) const
+	{ return find(x.c_array(), x.size(), pos); }
+
+	/**
+	 * Returns the position of the first element equal to any of the n
+	 * elements pointed by set, starting at pos, or npos if there is none.
+	 */
+	size_type find_any(const value_type* set, size_type n,
+			size_type pos = 0) const
+	{
+		static_assert(sizeof(value_type) == 1, "Only for byte buffers");
+		if (pos >= size())
+			return npos;
+		return _offset(simd::find_any(_data + pos, size() - pos, set, n),
+				pos);
+	}
+
+	/**
+	 * Returns the position of the first element equal to any of the
+	 * elements in set, starting at pos, or npos if there is none.
+	 */
+	size_type find_any(const basic_buffer< T, Allocator >& set,
+			size_type pos = 0) const
+	{ return find_any(set.c_array(), set.size(), pos); }
+
+
 	// Modifiers
 	//////////////////////////////////////////////////////////////////////
 
@@ -454,6 +529,12 @@ protected:
 	}
 
 
+	// Convert a posixx::simd search result to a position
+	static size_type _offset(std::size_t r, size_type pos)
+	{
+		return r == simd::npos ? npos : r + pos;
+	}
+
 	/*
 	 * Helper assign functions to disambiguate the Iterator based and the
 	 * N-value copy assign() methods. The last arguments indicates if
@@ -485,6 +566,10 @@ protected:
 
 };
 
+template < typename T, void* (*Allocator)(void*, std::size_t) >
+const typename basic_buffer< T, Allocator >::size_type
+basic_buffer< T, Allocator >::npos;
+
 // Nonmember Operators
 //////////////////////////////////////////////////////////////////////
 
@@ -499,15 +584,10 @@ bool operator == (const basic_buffer< T, Allocator >& x,
 		return true;
 	if (x.size() != y.size())
 		return false;
-	if (x.empty() && y.empty())
+	if (x.empty())
 		return true;
-	if (x.empty() || y.empty())
-		return false;
-	int r = std::memcmp(x.c_array(), y.c_array(),
-			(x.size() < y.size()) ? x.size() : y.size());
-	if (r == 0)
-		return x.size() == y.size();
-	return r == 0;
+	return simd::equal(x.c_array(), y.c_array(),
+			x.size() * sizeof(T));
 }
 
 /**
@@ -588,6 +668,35 @@ void swap(basic_buffer< T, Allocator >& x, basic_buffer< T, Allocator >& y)
 	x.swap(y);
 }
 
+/**
+ * Returns a hash of the contents of x.
+ *
+ * This makes buffers usable as keys for boost::hash (and
+ * std::tr1::hash) based containers. The hash is fast but not cryptographic
+ * (see posixx::simd::hash()).
+ */
+template < typename T, void* (*Allocator)(void*, std::size_t) >
+std::size_t hash_value(const basic_buffer< T, Allocator >& x)
+{
+	return static_cast< std::size_t >(
+			simd::hash(x.c_array(), x.size() * sizeof(T)));
+}
+
 } // namespace posixx
 
+namespace std { namespace tr1 {
+
+/// Hash function object for posixx::basic_buffer.
+template < typename T, void* (*Allocator)(void*, std::size_t) >
+struct hash< posixx::basic_buffer< T, Allocator > >:
+		std::unary_function< posixx::basic_buffer< T, Allocator >,
+				std::size_t >
+{
+	std::size_t operator () (const posixx::basic_buffer< T, Allocator >& x)
+			const
+	{ return posixx::hash_value(x); }
+};
+
+} } // namespace std::tr1
+
 #endif // POSIXX_BASIC_BUFFER_HPP_
@@ -0,0 +1,179 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_BUFFER_POOL_HPP_
+#define POSIXX_BUFFER_POOL_HPP_
+
+#include "buffer.hpp" // posixx::buffer
+
+#include <vector> // std::vector
+#include <cstddef> // std::size_t
+
+/// @file
+
+namespace posixx {
+
+/**
+ * Pool of buffers of the same size.
+ *
+ * Released buffers are kept in a free list and reused, so after a warm up
+ * getting a buffer doesn't allocate memory. The pool is not thread-safe:
+ * it's meant to be owned by a single thread (see linux::runtime), which
+ * avoids any contention in the allocator. A buffer can be released to a
+ * pool of another thread only by sending it back to its owner.
+ *
+ * @code
+ * posixx::buffer_pool<> pool(65536);
+ * posixx::buffer* b = pool.get();
+ * ssize_t n = sock.recv(&(*b)[0], b->size());
+ * ...
+ * pool.put(b);
+ * @endcode
+ */
+template < typename TBuffer = buffer >
+struct buffer_pool
+{
+
+	/// Type of the buffers.
+	typedef TBuffer buffer_type;
+
+	/**
+	 * Create a pool.
+	 *
+	 * @param size Size of the buffers.
+	 * @param max_free Maximum number of free buffers to keep (the rest
+	 *                 are deleted when released).
+	 */
+	explicit buffer_pool(std::size_t size, std::size_t max_free = 1024);
+
+	/// Get a buffer (of size() elements).
+	TBuffer* get();
+
+	/**
+	 * Release a buffer got from this pool.
+	 *
+	 * If the buffer was resized, it's resized back to size().
+	 */
+	void put(TBuffer* b) throw ();
+
+	/// Allocate buffers until there are n free.
+	void reserve(std::size_t n);
+
+	/// Size of the buffers.
+	std::size_t size() const throw ();
+
+	/// Number of free buffers.
+	std::size_t free() const throw ();
+
+	/// Number of buffers got that were not released yet.
+	std::size_t used() const throw ();
+
+	/// Destructor (deletes the free buffers).
+	~buffer_pool() throw ();
+
+private:
+
+	// Hidden copy constructor and assign operator
+	buffer_pool(const buffer_pool& p);
+	buffer_pool& operator=(const buffer_pool& p);
+
+	std::size_t _size;
+	std::size_t _max_free;
+	std::size_t _used;
+	std::vector< TBuffer* > _free;
+
+};
+
+} // namespace posixx
+
+
+
+template < typename TBuffer >
+inline
+posixx::buffer_pool< TBuffer >::buffer_pool(std::size_t size,
+		std::size_t max_free):
+		_size(size), _max_free(max_free), _used(0)
+{
+	_free.reserve(max_free);
+}
+
+template < typename TBuffer >
+inline
+TBuffer* posixx::buffer_pool< TBuffer >::get()
+{
+	TBuffer* b;
+	if (_free.empty())
+		b = new TBuffer(_size);
+	else {
+		b = _free.back();
+		_free.pop_back();
+	}
+	++_used;
+	return b;
+}
+
+template < typename TBuffer >
+inline
+void posixx::buffer_pool< TBuffer >::put(TBuffer* b) throw ()
+{
+	--_used;
+	if (_free.size() >= _max_free) {
+		delete b;
+		return;
+	}
+	if (b->size() != _size) {
+		try {
+			b->resize(_size);
+		}
+		catch (...) {
+			delete b;
+			return;
+		}
+	}
+	// it never allocates, there is room for max_free buffers
+	_free.push_back(b);
+}
+
+template < typename TBuffer >
+inline
+void posixx::buffer_pool< TBuffer >::reserve(std::size_t n)
+{
+	if (n > _max_free)
+		n = _max_free;
+	while (_free.size() < n)
+		_free.push_back(new TBuffer(_size));
+}
+
+template < typename TBuffer >
+inline
+std::size_t posixx::buffer_pool< TBuffer >::size() const throw ()
+{
+	return _size;
+}
+
+template < typename TBuffer >
+inline
+std::size_t posixx::buffer_pool< TBuffer >::free() const throw ()
+{
+	return _free.size();
+}
+
+template < typename TBuffer >
+inline
+std::size_t posixx::buffer_pool< TBuffer >::used() const throw ()
+{
+	return _used;
+}
+
+template < typename TBuffer >
+inline
+posixx::buffer_pool< TBuffer >::~buffer_pool() throw ()
+{
+	for (std::size_t i = 0; i < _free.size(); ++i)
+		delete _free[i];
+}
+
+#endif // POSIXX_BUFFER_POOL_HPP_
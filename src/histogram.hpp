@@ -0,0 +1,247 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_HISTOGRAM_HPP_
+#define POSIXX_HISTOGRAM_HPP_
+
+#include <cstddef> // std::size_t
+#include <stdint.h> // uint64_t
+
+/// @file
+
+namespace posixx {
+
+/**
+ * A lock-free log-linear histogram.
+ *
+ * Values are unsigned 64-bit integers (usually nanoseconds). Values smaller
+ * than SUB_BUCKETS are counted exactly, bigger values are grouped in
+ * power-of-two ranges, each one split in SUB_BUCKETS linear buckets, so the
+ * relative error of any reported value is at most 1 / SUB_BUCKETS (6.25%).
+ * This is the same layout used by HdrHistogram.
+ *
+ * record() uses only a relaxed atomic increment, so it can be called
+ * concurrently from any number of threads without locking. The statistics
+ * (count(), sum(), percentile(), etc.) can be read at any time too, but
+ * they might not agree with each other while values are being recorded;
+ * snapshot() gives a copy that can be inspected consistently (or merged
+ * with other histograms) while the original is still being updated.
+ */
+struct histogram
+{
+
+	enum
+	{
+		/// log2(SUB_BUCKETS)
+		SUB_BITS = 4,
+		/// Number of linear buckets in each power-of-two range.
+		SUB_BUCKETS = 1 << SUB_BITS,
+		/// Total number of buckets (enough for any 64-bit value).
+		BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS
+	};
+
+	/// Value type.
+	typedef uint64_t value_type;
+
+	/// Create an empty histogram.
+	histogram() throw ();
+
+	/**
+	 * Record a value.
+	 *
+	 * This is lock-free and safe to call concurrently with any other
+	 * method.
+	 */
+	void record(value_type v) throw ();
+
+	/// Get a consistent (enough) copy of this histogram.
+	histogram snapshot() const throw ();
+
+	/**
+	 * Add all the values recorded by other to this histogram.
+	 *
+	 * @note This method is not atomic, other should be a snapshot (or
+	 *       not being updated concurrently) and this histogram shouldn't
+	 *       be updated concurrently either.
+	 */
+	void merge(const histogram& other) throw ();
+
+	/// Remove all the recorded values.
+	void reset() throw ();
+
+	/// Number of values recorded.
+	value_type count() const throw ();
+
+	/// Sum of all the values recorded.
+	value_type sum() const throw ();
+
+	/// Mean of all the values recorded (0 if empty).
+	double mean() const throw ();
+
+	/**
+	 * Get a percentile.
+	 *
+	 * @param p Percentile, between 0 and 100 (out of range values are
+	 *          clamped).
+	 *
+	 * @return The highest value equivalent to the value at percentile p
+	 *         (0 if empty).
+	 */
+	value_type percentile(double p) const throw ();
+
+	/// Get the number of values recorded in a bucket.
+	value_type bucket_count(std::size_t i) const throw ();
+
+	/// Get the bucket a value is counted in.
+	static std::size_t bucket(value_type v) throw ();
+
+	/// Get the lowest value counted in a bucket.
+	static value_type bucket_lower(std::size_t i) throw ();
+
+	/// Get the highest value counted in a bucket.
+	static value_type bucket_upper(std::size_t i) throw ();
+
+private:
+
+	// Number of values recorded in each bucket
+	value_type _buckets[BUCKETS];
+
+	// Sum of all the values recorded
+	value_type _sum;
+
+};
+
+} // namespace posixx
+
+
+
+inline
+posixx::histogram::histogram() throw ()
+{
+	reset();
+}
+
+inline
+std::size_t posixx::histogram::bucket(value_type v) throw ()
+{
+	if (v < SUB_BUCKETS)
+		return v;
+	unsigned e = 63 - __builtin_clzll(v); // most significant bit
+	return (e - SUB_BITS + 1) * SUB_BUCKETS
+			+ ((v >> (e - SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+inline
+posixx::histogram::value_type posixx::histogram::bucket_lower(std::size_t i)
+		throw ()
+{
+	if (i < SUB_BUCKETS)
+		return i;
+	unsigned e = i / SUB_BUCKETS + SUB_BITS - 1;
+	return static_cast< value_type >(SUB_BUCKETS + i % SUB_BUCKETS)
+			<< (e - SUB_BITS);
+}
+
+inline
+posixx::histogram::value_type posixx::histogram::bucket_upper(std::size_t i)
+		throw ()
+{
+	if (i < SUB_BUCKETS)
+		return i;
+	unsigned e = i / SUB_BUCKETS + SUB_BITS - 1;
+	return bucket_lower(i)
+			+ (static_cast< value_type >(1) << (e - SUB_BITS)) - 1;
+}
+
+inline
+void posixx::histogram::record(value_type v) throw ()
+{
+	__atomic_fetch_add(&_buckets[bucket(v)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&_sum, v, __ATOMIC_RELAXED);
+}
+
+inline
+posixx::histogram posixx::histogram::snapshot() const throw ()
+{
+	histogram h;
+	for (std::size_t i = 0; i < BUCKETS; ++i)
+		h._buckets[i] = __atomic_load_n(&_buckets[i], __ATOMIC_RELAXED);
+	h._sum = __atomic_load_n(&_sum, __ATOMIC_RELAXED);
+	return h;
+}
+
+inline
+void posixx::histogram::merge(const histogram& other) throw ()
+{
+	for (std::size_t i = 0; i < BUCKETS; ++i)
+		_buckets[i] += other._buckets[i];
+	_sum += other._sum;
+}
+
+inline
+void posixx::histogram::reset() throw ()
+{
+	for (std::size_t i = 0; i < BUCKETS; ++i)
+		__atomic_store_n(&_buckets[i], 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&_sum, 0, __ATOMIC_RELAXED);
+}
+
+inline
+posixx::histogram::value_type posixx::histogram::count() const throw ()
+{
+	value_type n = 0;
+	for (std::size_t i = 0; i < BUCKETS; ++i)
+		n += __atomic_load_n(&_buckets[i], __ATOMIC_RELAXED);
+	return n;
+}
+
+inline
+posixx::histogram::value_type posixx::histogram::sum() const throw ()
+{
+	return __atomic_load_n(&_sum, __ATOMIC_RELAXED);
+}
+
+inline
+double posixx::histogram::mean() const throw ()
+{
+	value_type n = count();
+	if (n == 0)
+		return 0.0;
+	return static_cast< double >(sum()) / n;
+}
+
+inline
+posixx::histogram::value_type posixx::histogram::percentile(double p) const
+		throw ()
+{
+	value_type n = count();
+	if (n == 0)
+		return 0;
+	// NaN is taken as 0 too
+	if (!(p >= 0.0))
+		p = 0.0;
+	else if (p > 100.0)
+		p = 100.0;
+	value_type target = static_cast< value_type >(p / 100.0 * n + 0.5);
+	if (target == 0)
+		target = 1;
+	value_type acc = 0;
+	for (std::size_t i = 0; i < BUCKETS; ++i) {
+		acc += __atomic_load_n(&_buckets[i], __ATOMIC_RELAXED);
+		if (acc >= target)
+			return bucket_upper(i);
+	}
+	return bucket_upper(BUCKETS - 1);
+}
+
+inline
+posixx::histogram::value_type posixx::histogram::bucket_count(std::size_t i)
+		const throw ()
+{
+	return __atomic_load_n(&_buckets[i], __ATOMIC_RELAXED);
+}
+
+#endif // POSIXX_HISTOGRAM_HPP_
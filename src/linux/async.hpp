@@ -0,0 +1,269 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_ASYNC_HPP_
+#define POSIXX_LINUX_ASYNC_HPP_
+
+#include "../error.hpp" // posixx::error
+#include "../socket/basic_socket.hpp" // posixx::socket::basic_socket
+#include "../socket/opt.hpp" // posixx::socket::opt::ERROR, TYPE
+#include "fiber.hpp" // posixx::linux::fiber_scheduler
+
+#include <cerrno> // errno, EAGAIN, EWOULDBLOCK, EINPROGRESS, EINVAL, EMSGSIZE
+#include <cstring> // memset
+#include <sys/epoll.h> // EPOLLIN, EPOLLOUT
+#include <sys/socket.h> // MSG_DONTWAIT, MSG_NOSIGNAL, MSG_TRUNC, msghdr
+#include <sys/uio.h> // iovec
+
+/// @file
+
+/**
+ * Socket operations that suspend the calling fiber instead of blocking.
+ *
+ * These functions must be called from a fiber (see fiber_scheduler): they
+ * try the operation without blocking and, if it would block, they wait
+ * for the socket to be ready in the scheduler reactor, letting the other
+ * fibers run in the meantime. Errors are reported as in basic_socket.
+ *
+ * send() and recv() use MSG_DONTWAIT, so any socket works, but accept()
+ * and connect() need the socket in non-blocking mode (O_NONBLOCK).
+ */
+
+namespace posixx { namespace linux {
+
+/// Accept a connection, suspending the fiber until there is one.
+template < typename TSockTraits >
+socket::basic_socket< TSockTraits >* async_accept(
+		socket::basic_socket< TSockTraits >& s) throw (error);
+
+/// Accept a connection, getting the peer address.
+template < typename TSockTraits >
+socket::basic_socket< TSockTraits >* async_accept(
+		socket::basic_socket< TSockTraits >& s,
+		typename TSockTraits::sockaddr& addr) throw (error);
+
+/// Connect, suspending the fiber until the connection is established.
+template < typename TSockTraits >
+void async_connect(socket::basic_socket< TSockTraits >& s,
+		const typename TSockTraits::sockaddr& addr) throw (error);
+
+/// Send a message, suspending the fiber until there is room for it.
+template < typename TSockTraits >
+ssize_t async_send(socket::basic_socket< TSockTraits >& s, const void* buf,
+		size_t n, int flags = 0) throw (error);
+
+/// Receive a message, suspending the fiber until there is one.
+template < typename TSockTraits >
+ssize_t async_recv(socket::basic_socket< TSockTraits >& s, void* buf,
+		size_t n, int flags = 0) throw (error);
+
+/// Receive a message (see basic_socket::recv(msghdr*, int)).
+template < typename TSockTraits >
+ssize_t async_recv(socket::basic_socket< TSockTraits >& s, msghdr* msg,
+		int flags = 0) throw (error);
+
+/// Send a struct (see basic_socket::send_struct()).
+template < typename TSockTraits, typename TPacket >
+void async_send_struct(socket::basic_socket< TSockTraits >& s,
+		const TPacket& packet, int flags = MSG_NOSIGNAL)
+		throw (error);
+
+/**
+ * Receive a struct (see basic_socket::recv_struct()).
+ *
+ * Only a STREAM socket can deliver the struct in pieces, it's received
+ * until it's complete. In other sockets each struct must come in a message
+ * by itself, otherwise error is thrown with errno EMSGSIZE (the message is
+ * discarded).
+ */
+template < typename TSockTraits, typename TPacket >
+void async_recv_struct(socket::basic_socket< TSockTraits >& s,
+		TPacket& packet, int flags = MSG_NOSIGNAL) throw (error);
+
+namespace detail {
+
+// Re-throw e unless it's a "would block" error
+void async_check(const error& e) throw (error);
+
+// Wait for fd in the current fiber
+void async_wait(int fd, uint32_t events) throw (error);
+
+} // namespace detail
+
+} } // namespace posixx::linux
+
+
+
+inline
+void posixx::linux::detail::async_check(const error& e) throw (error)
+{
+	if (e.no != EAGAIN && e.no != EWOULDBLOCK && e.no != EINTR)
+		throw e;
+}
+
+inline
+void posixx::linux::detail::async_wait(int fd, uint32_t events)
+		throw (error)
+{
+	fiber_scheduler* s = fiber_scheduler::current();
+	if (!s) {
+		errno = EINVAL;
+		throw error("async operation outside a fiber");
+	}
+	s->wait(fd, events);
+}
+
+template < typename TSockTraits >
+inline
+posixx::socket::basic_socket< TSockTraits >* posixx::linux::async_accept(
+		socket::basic_socket< TSockTraits >& s) throw (error)
+{
+	for (;;) {
+		try {
+			return s.accept();
+		}
+		catch (const error& e) {
+			// don't switch fibers while handling an exception
+			detail::async_check(e);
+		}
+		detail::async_wait(s.fd(), EPOLLIN);
+	}
+}
+
+template < typename TSockTraits >
+inline
+posixx::socket::basic_socket< TSockTraits >* posixx::linux::async_accept(
+		socket::basic_socket< TSockTraits >& s,
+		typename TSockTraits::sockaddr& addr) throw (error)
+{
+	for (;;) {
+		try {
+			return s.accept(addr);
+		}
+		catch (const error& e) {
+			// don't switch fibers while handling an exception
+			detail::async_check(e);
+		}
+		detail::async_wait(s.fd(), EPOLLIN);
+	}
+}
+
+template < typename TSockTraits >
+inline
+void posixx::linux::async_connect(socket::basic_socket< TSockTraits >& s,
+		const typename TSockTraits::sockaddr& addr) throw (error)
+{
+	try {
+		s.connect(addr);
+		return;
+	}
+	catch (const error& e) {
+		if (e.no != EINPROGRESS)
+			throw;
+	}
+	detail::async_wait(s.fd(), EPOLLOUT);
+	int r = s.template opt< socket::opt::ERROR >();
+	if (r) {
+		errno = r;
+		throw error("connect");
+	}
+}
+
+template < typename TSockTraits >
+inline
+ssize_t posixx::linux::async_send(socket::basic_socket< TSockTraits >& s,
+		const void* buf, size_t n, int flags) throw (error)
+{
+	for (;;) {
+		try {
+			return s.send(buf, n, flags | MSG_DONTWAIT);
+		}
+		catch (const error& e) {
+			// don't switch fibers while handling an exception
+			detail::async_check(e);
+		}
+		detail::async_wait(s.fd(), EPOLLOUT);
+	}
+}
+
+template < typename TSockTraits >
+inline
+ssize_t posixx::linux::async_recv(socket::basic_socket< TSockTraits >& s,
+		void* buf, size_t n, int flags) throw (error)
+{
+	for (;;) {
+		try {
+			// an orderly shutdown doesn't set errno
+			errno = 0;
+			return s.recv(buf, n, flags | MSG_DONTWAIT);
+		}
+		catch (const error& e) {
+			// don't switch fibers while handling an exception
+			detail::async_check(e);
+		}
+		detail::async_wait(s.fd(), EPOLLIN);
+	}
+}
+
+template < typename TSockTraits, typename TPacket >
+inline
+void posixx::linux::async_send_struct(
+		socket::basic_socket< TSockTraits >& s, const TPacket& packet,
+		int flags) throw (error)
+{
+	const char* p = reinterpret_cast< const char* >(&packet);
+	std::size_t sent = 0;
+	while (sent < sizeof(TPacket))
+		sent += async_send(s, p + sent, sizeof(TPacket) - sent, flags);
+}
+
+template < typename TSockTraits >
+inline
+ssize_t posixx::linux::async_recv(socket::basic_socket< TSockTraits >& s,
+		msghdr* msg, int flags) throw (error)
+{
+	for (;;) {
+		try {
+			// an orderly shutdown doesn't set errno
+			errno = 0;
+			return s.recv(msg, flags | MSG_DONTWAIT);
+		}
+		catch (const error& e) {
+			// don't switch fibers while handling an exception
+			detail::async_check(e);
+		}
+		detail::async_wait(s.fd(), EPOLLIN);
+	}
+}
+
+template < typename TSockTraits, typename TPacket >
+inline
+void posixx::linux::async_recv_struct(
+		socket::basic_socket< TSockTraits >& s, TPacket& packet,
+		int flags) throw (error)
+{
+	char* p = reinterpret_cast< char* >(&packet);
+	iovec iov = { p, sizeof(TPacket) };
+	msghdr m;
+	memset(&m, 0, sizeof(m));
+	m.msg_iov = &iov;
+	m.msg_iovlen = 1;
+	std::size_t received = async_recv(s, &m, flags);
+	if (received == sizeof(TPacket) && !(m.msg_flags & MSG_TRUNC))
+		return;
+	// a message socket would mix the rest of the struct with the next
+	// message (MSG_TRUNC is never set for streams)
+	if ((m.msg_flags & MSG_TRUNC) || s.template opt< socket::opt::TYPE >()
+			!= socket::STREAM) {
+		errno = EMSGSIZE;
+		throw error("recv_struct");
+	}
+	while (received < sizeof(TPacket))
+		received += async_recv(s, p + received,
+				sizeof(TPacket) - received, flags);
+}
+
+#endif // POSIXX_LINUX_ASYNC_HPP_
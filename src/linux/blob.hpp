@@ -0,0 +1,581 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_BLOB_HPP_
+#define POSIXX_LINUX_BLOB_HPP_
+
+#include "../error.hpp" // posixx::error
+#include "../socket/unix.hpp" // posixx::socket::unix
+
+#include <vector> // std::vector
+#include <cstring> // memcpy
+#include <cerrno> // errno, EINVAL, EMSGSIZE, EPERM
+#include <stdint.h> // uint32_t, uint64_t
+#include <fcntl.h> // fcntl, fallocate, F_ADD_SEALS, F_GET_SEALS, F_SEAL_*
+#include <sys/mman.h> // mmap, munmap, memfd_create
+#include <sys/socket.h> // msghdr, cmsghdr, SCM_RIGHTS, MSG_CMSG_CLOEXEC
+#include <sys/stat.h> // fstat
+#include <sys/uio.h> // iovec
+#include <unistd.h> // ftruncate, write, close
+
+/// @file
+
+namespace posixx { namespace linux {
+
+/**
+ * Large payload transfer over unix sockets using sealed memfds.
+ *
+ * Sending a big payload through a socket copies it twice (to the kernel
+ * and back). Here the payload is put in a memfd, which is sealed so it
+ * can't be modified nor resized anymore, and only its file descriptor and
+ * some metadata are sent (as SCM_RIGHTS ancillary data); the receiver maps
+ * it read-only, without copying. Filling a buffer in place avoids the
+ * remaining copy too.
+ *
+ * Setting up and mapping a memfd is much more expensive than copying a
+ * few KiB, so payloads up to inline_max bytes are sent inline, in the
+ * same message the metadata goes, and the receiver doesn't need to know
+ * which way a payload was sent. Each memfd payload needs freshly allocated
+ * pages, which in some environments (virtual machines, specially) cost
+ * about as much as copying them, so the best inline_max depends on the
+ * system (but an inline payload must fit in the socket send buffer).
+ *
+ * The socket should be a unix SEQPACKET (or DGRAM) socket, so each
+ * payload is a message. The receiver's inline_max only limits the inline
+ * payloads it accepts, so it must not be smaller than the sender's (a
+ * memfd payload is accepted whatever its size).
+ *
+ * @code
+ * using namespace posixx;
+ * // sender
+ * linux::blob::buffer b(16 << 20);
+ * fill(b.data(), b.size());
+ * linux::blob::send(s, b, 42);
+ * // receiver
+ * linux::blob::view v;
+ * linux::blob::recv(s, v);
+ * process(v.data(), v.size(), v.tag());
+ * @endcode
+ */
+namespace blob {
+
+/// Default maximum size of a payload sent inline.
+enum { INLINE_MAX = 65536 };
+
+/**
+ * Writable buffer backed by a memfd.
+ *
+ * The payload can be written directly to it and then sent without
+ * copying (see send(socket::unix::socket&, buffer&, uint64_t,
+ * std::size_t)).
+ */
+struct buffer
+{
+
+	/**
+	 * Create a buffer.
+	 *
+	 * @param size Size of the buffer (can't be changed).
+	 */
+	explicit buffer(std::size_t size) throw (error);
+
+	/// Buffer memory
+	char* data() throw ();
+
+	/// Buffer memory
+	const char* data() const throw ();
+
+	/// Buffer size
+	std::size_t size() const throw ();
+
+	/**
+	 * Unmap the buffer and give up its file descriptor.
+	 *
+	 * The buffer can't be used after this (it's done by send()).
+	 *
+	 * @return The memfd file descriptor (to be closed by the caller).
+	 */
+	int release() throw ();
+
+	/// Destructor (unmaps the buffer and closes the memfd)
+	~buffer() throw ();
+
+private:
+
+	// Hidden copy constructor and assign operator
+	buffer(const buffer& b);
+	buffer& operator=(const buffer& b);
+
+	int _fd;
+	char* _data;
+	std::size_t _size;
+
+};
+
+/**
+ * Received payload.
+ *
+ * A view can be reused for many recv() calls, the previous payload is
+ * released when a new one is received.
+ */
+struct view
+{
+
+	/// Create an empty view
+	view() throw ();
+
+	/// Payload data (valid until the next recv() or reset())
+	const char* data() const throw ();
+
+	/// Payload size
+	std::size_t size() const throw ();
+
+	/// Metadata sent with the payload
+	uint64_t tag() const throw ();
+
+	/// Tell if the payload is a mapped memfd (false if it was inline)
+	bool mapped() const throw ();
+
+	/// Release the payload (unmapping it if needed)
+	void reset() throw ();
+
+	/// Destructor
+	~view() throw ();
+
+private:
+
+	// Hidden copy constructor and assign operator
+	view(const view& v);
+	view& operator=(const view& v);
+
+	friend void recv(socket::unix::socket& s, view& v,
+			std::size_t inline_max) throw (error);
+
+	const char* _data;
+	std::size_t _size;
+	uint64_t _tag;
+	// mapped memfd (NULL if the payload is inline)
+	void* _map;
+	std::size_t _map_size;
+	// inline payloads storage (reused between messages)
+	std::vector< char > _inline;
+
+};
+
+/**
+ * Send a payload.
+ *
+ * If n > inline_max, the payload is copied to a new sealed memfd (only
+ * once, instead of twice as a plain send() would do), otherwise it's sent
+ * inline.
+ *
+ * @param s Unix SEQPACKET (or DGRAM) socket.
+ * @param buf Payload data.
+ * @param n Payload size.
+ * @param tag Metadata for the receiver (see view::tag()).
+ * @param inline_max Maximum size of an inline payload.
+ */
+void send(socket::unix::socket& s, const void* buf, std::size_t n,
+		uint64_t tag = 0, std::size_t inline_max = INLINE_MAX)
+		throw (error);
+
+/**
+ * Send a buffer without copying it.
+ *
+ * The buffer is sealed and released (it can't be used anymore). If it's
+ * not bigger than inline_max, it's sent inline instead.
+ *
+ * @param s Unix SEQPACKET (or DGRAM) socket.
+ * @param b Buffer to send.
+ * @param tag Metadata for the receiver (see view::tag()).
+ * @param inline_max Maximum size of an inline payload.
+ */
+void send(socket::unix::socket& s, buffer& b, uint64_t tag = 0,
+		std::size_t inline_max = INLINE_MAX) throw (error);
+
+/**
+ * Receive a payload.
+ *
+ * memfd payloads are mapped read-only. They are only accepted if they are
+ * sealed against writing and shrinking, so the sender can't change them
+ * (or make the receiver crash with a SIGBUS) after sending them. Any other
+ * descriptor passed with the message is closed, so a misbehaving peer
+ * can't make the receiver leak them.
+ *
+ * @param s Unix SEQPACKET (or DGRAM) socket.
+ * @param v Where to store the payload.
+ * @param inline_max Maximum size of an inline payload.
+ *
+ * @throw error with errno EMSGSIZE if the message is not a valid payload
+ *        (for example if it's sent inline and it's bigger than inline_max,
+ *        or has more than one descriptor), EPERM if a memfd is not
+ *        properly sealed or 0 if the peer closed the connection.
+ */
+void recv(socket::unix::socket& s, view& v,
+		std::size_t inline_max = INLINE_MAX) throw (error);
+
+namespace detail {
+
+// Metadata sent with each payload
+struct header
+{
+	uint64_t size;
+	uint64_t tag;
+	uint32_t kind;
+	uint32_t reserved;
+};
+
+// Kinds of payloads
+enum { INLINE, MEMFD };
+
+// Seals a memfd must have to be accepted (F_SEAL_GROW is just added for
+// completeness, a growing file can't hurt the receiver)
+enum { SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL };
+
+// Create a memfd of size bytes
+int create(std::size_t size) throw (error);
+
+// Seal a memfd and send it (closing it in any case)
+void send_fd(socket::unix::socket& s, int fd, std::size_t size,
+		uint64_t tag) throw (error);
+
+// Send a payload inline
+void send_inline(socket::unix::socket& s, const void* buf, std::size_t n,
+		uint64_t tag) throw (error);
+
+// Descriptors a received message has room for (the kernel closes the ones
+// that don't fit, flagging the message with MSG_CTRUNC)
+enum { MAX_FDS = 8 };
+
+// Take the first descriptor passed with a received message and close all
+// the others (fd is -1 if there is none), returns how many were passed
+std::size_t take_fd(msghdr& m, int& fd) throw ();
+
+} // namespace detail
+
+} } } // namespace posixx::linux::blob
+
+
+
+inline
+int posixx::linux::blob::detail::create(std::size_t size) throw (error)
+{
+	int fd = ::memfd_create("posixx-blob", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd == -1)
+		throw error("memfd_create");
+	if (::ftruncate(fd, size) == -1) {
+		int e = errno;
+		::close(fd);
+		errno = e;
+		throw error("blob ftruncate");
+	}
+	// allocating all the pages at once is much cheaper than doing it
+	// one by one when writing (it's just an optimization, the pages are
+	// allocated on demand if it fails)
+	if (size)
+		::fallocate(fd, 0, 0, size);
+	return fd;
+}
+
+inline
+void posixx::linux::blob::detail::send_fd(socket::unix::socket& s, int fd,
+		std::size_t size, uint64_t tag) throw (error)
+{
+	header h = { size, tag, MEMFD, 0 };
+	iovec iov = { &h, sizeof(h) };
+	union
+	{
+		cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} ctrl;
+	msghdr m;
+	memset(&m, 0, sizeof(m));
+	m.msg_iov = &iov;
+	m.msg_iovlen = 1;
+	m.msg_control = ctrl.buf;
+	m.msg_controllen = sizeof(ctrl.buf);
+	cmsghdr* c = CMSG_FIRSTHDR(&m);
+	c->cmsg_level = SOL_SOCKET;
+	c->cmsg_type = SCM_RIGHTS;
+	c->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(c), &fd, sizeof(int));
+	try {
+		if (::fcntl(fd, F_ADD_SEALS, int(SEALS)) == -1)
+			throw error("blob seal");
+		s.send(&m, MSG_NOSIGNAL);
+	}
+	catch (...) {
+		int e = errno;
+		::close(fd);
+		errno = e;
+		throw;
+	}
+	::close(fd);
+}
+
+inline
+void posixx::linux::blob::detail::send_inline(socket::unix::socket& s,
+		const void* buf, std::size_t n, uint64_t tag) throw (error)
+{
+	header h = { n, tag, INLINE, 0 };
+	iovec iov[2] = { { &h, sizeof(h) },
+			{ const_cast< void* >(buf), n } };
+	msghdr m;
+	memset(&m, 0, sizeof(m));
+	m.msg_iov = iov;
+	m.msg_iovlen = 2;
+	s.send(&m, MSG_NOSIGNAL);
+}
+
+inline
+std::size_t posixx::linux::blob::detail::take_fd(msghdr& m, int& fd)
+		throw ()
+{
+	fd = -1;
+	std::size_t count = 0;
+	for (cmsghdr* c = CMSG_FIRSTHDR(&m); c; c = CMSG_NXTHDR(&m, c)) {
+		if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+			continue;
+		std::size_t n = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		const unsigned char* p = CMSG_DATA(c);
+		for (std::size_t i = 0; i < n; ++i, ++count) {
+			int d;
+			memcpy(&d, p + i * sizeof(int), sizeof(int));
+			if (fd == -1)
+				fd = d;
+			else
+				::close(d);
+		}
+	}
+	return count;
+}
+
+inline
+posixx::linux::blob::buffer::buffer(std::size_t size) throw (error):
+		_fd(detail::create(size)), _data(NULL), _size(size)
+{
+	if (!size)
+		return;
+	void* m = ::mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, _fd, 0);
+	if (m == MAP_FAILED) {
+		int e = errno;
+		::close(_fd);
+		errno = e;
+		throw error("blob mmap");
+	}
+	_data = static_cast< char* >(m);
+}
+
+inline
+char* posixx::linux::blob::buffer::data() throw ()
+{
+	return _data;
+}
+
+inline
+const char* posixx::linux::blob::buffer::data() const throw ()
+{
+	return _data;
+}
+
+inline
+std::size_t posixx::linux::blob::buffer::size() const throw ()
+{
+	return _size;
+}
+
+inline
+int posixx::linux::blob::buffer::release() throw ()
+{
+	// no writable mapping can exist when sealing for writing
+	if (_data)
+		::munmap(_data, _size);
+	int fd = _fd;
+	_fd = -1;
+	_data = NULL;
+	_size = 0;
+	return fd;
+}
+
+inline
+posixx::linux::blob::buffer::~buffer() throw ()
+{
+	int fd = release();
+	if (fd != -1)
+		::close(fd);
+}
+
+inline
+posixx::linux::blob::view::view() throw ():
+		_data(NULL), _size(0), _tag(0), _map(NULL), _map_size(0)
+{
+}
+
+inline
+const char* posixx::linux::blob::view::data() const throw ()
+{
+	return _data;
+}
+
+inline
+std::size_t posixx::linux::blob::view::size() const throw ()
+{
+	return _size;
+}
+
+inline
+uint64_t posixx::linux::blob::view::tag() const throw ()
+{
+	return _tag;
+}
+
+inline
+bool posixx::linux::blob::view::mapped() const throw ()
+{
+	return _map;
+}
+
+inline
+void posixx::linux::blob::view::reset() throw ()
+{
+	if (_map)
+		::munmap(_map, _map_size);
+	_map = NULL;
+	_map_size = 0;
+	_data = NULL;
+	_size = 0;
+	_tag = 0;
+}
+
+inline
+posixx::linux::blob::view::~view() throw ()
+{
+	reset();
+}
+
+inline
+void posixx::linux::blob::send(socket::unix::socket& s, const void* buf,
+		std::size_t n, uint64_t tag, std::size_t inline_max)
+		throw (error)
+{
+	if (n <= inline_max) {
+		detail::send_inline(s, buf, n, tag);
+		return;
+	}
+	int fd = detail::create(n);
+	// write(2) copies straight to the page cache, without the cost of
+	// setting up (and faulting in) a mapping
+	const char* p = static_cast< const char* >(buf);
+	for (std::size_t done = 0; done < n; ) {
+		ssize_t w = ::write(fd, p + done, n - done);
+		if (w == -1) {
+			if (errno == EINTR)
+				continue;
+			int e = errno;
+			::close(fd);
+			errno = e;
+			throw error("blob write");
+		}
+		done += w;
+	}
+	detail::send_fd(s, fd, n, tag);
+}
+
+inline
+void posixx::linux::blob::send(socket::unix::socket& s, buffer& b,
+		uint64_t tag, std::size_t inline_max) throw (error)
+{
+	if (b.size() <= inline_max) {
+		detail::send_inline(s, b.data(), b.size(), tag);
+		::close(b.release());
+		return;
+	}
+	std::size_t n = b.size();
+	detail::send_fd(s, b.release(), n, tag);
+}
+
+inline
+void posixx::linux::blob::recv(socket::unix::socket& s, view& v,
+		std::size_t inline_max) throw (error)
+{
+	v.reset();
+	// one more byte, so it's never empty
+	if (v._inline.size() <= inline_max)
+		v._inline.resize(inline_max + 1);
+	detail::header h;
+	iovec iov[2] = { { &h, sizeof(h) }, { &v._inline[0], inline_max } };
+	union
+	{
+		cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int) * detail::MAX_FDS)];
+	} ctrl;
+	msghdr m;
+	memset(&m, 0, sizeof(m));
+	m.msg_iov = iov;
+	m.msg_iovlen = 2;
+	m.msg_control = ctrl.buf;
+	m.msg_controllen = sizeof(ctrl.buf);
+	ssize_t n = s.recv(&m, MSG_CMSG_CLOEXEC);
+	if (n == 0) {
+		error e("recvmsg connection shutdown");
+		e.no = 0;
+		throw e;
+	}
+	// only one descriptor is expected, any other is closed right away
+	int fd;
+	std::size_t fds = detail::take_fd(m, fd);
+	// validate the message, a stray descriptor is closed in any case
+	int err = 0;
+	if ((m.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || fds > 1
+			|| std::size_t(n) < sizeof(h))
+		err = EMSGSIZE;
+	else if (h.kind == detail::INLINE) {
+		if (fd != -1 || h.size != n - sizeof(h))
+			err = EMSGSIZE;
+	}
+	else if (h.kind != detail::MEMFD || fd == -1
+			|| std::size_t(n) != sizeof(h) || h.size == 0
+			|| h.size != std::size_t(h.size))
+		err = EMSGSIZE;
+	else {
+		int seals = ::fcntl(fd, F_GET_SEALS);
+		struct stat st;
+		if (seals == -1 || (seals & (F_SEAL_WRITE | F_SEAL_SHRINK))
+				!= (F_SEAL_WRITE | F_SEAL_SHRINK))
+			err = EPERM;
+		else if (::fstat(fd, &st) == -1)
+			err = errno;
+		else if (uint64_t(st.st_size) < h.size)
+			err = EMSGSIZE;
+	}
+	if (err) {
+		if (fd != -1)
+			::close(fd);
+		errno = err;
+		throw error("blob recv");
+	}
+	v._tag = h.tag;
+	v._size = h.size;
+	if (h.kind == detail::INLINE) {
+		v._data = &v._inline[0];
+		return;
+	}
+	void* p = ::mmap(NULL, h.size, PROT_READ, MAP_SHARED, fd, 0);
+	int e = errno;
+	// the mapping keeps the memfd alive
+	::close(fd);
+	if (p == MAP_FAILED) {
+		v.reset();
+		errno = e;
+		throw error("blob mmap");
+	}
+	v._map = p;
+	v._map_size = h.size;
+	v._data = static_cast< const char* >(p);
+}
+
+#endif // POSIXX_LINUX_BLOB_HPP_
@@ -0,0 +1,144 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_CHANNEL_HPP_
+#define POSIXX_LINUX_CHANNEL_HPP_
+
+#include "../error.hpp" // posixx::error
+#include "queue.hpp" // posixx::linux::queue
+#include "reactor.hpp" // posixx::linux::reactor
+
+#include <cerrno> // EAGAIN
+#include <stdint.h> // uint32_t, uint64_t
+#include <sys/eventfd.h> // eventfd
+#include <unistd.h> // read, write, close
+
+/// @file
+
+namespace posixx { namespace linux {
+
+/**
+ * Channel to send messages to a reactor from any thread.
+ *
+ * Messages are pushed to a lock-free queue and the reactor is notified
+ * through an eventfd, which the channel registers in it. The eventfd is
+ * only written when the receiving reactor has drained the queue since the
+ * last notification, so a burst of messages costs a single system call on
+ * each side.
+ *
+ * Messages are delivered by calling received(), in the reactor thread, so
+ * receivers should derive from this class.
+ *
+ * @see runtime
+ */
+template < typename T >
+struct channel: reactor::handler
+{
+
+	/// Type of the messages.
+	typedef T value_type;
+
+	/**
+	 * Create a channel and register it in a reactor.
+	 *
+	 * @param r Reactor where the messages are received.
+	 * @param capacity Maximum number of messages in flight.
+	 */
+	channel(reactor& r, std::size_t capacity) throw (error);
+
+	/**
+	 * Send a message (from any thread).
+	 *
+	 * @return false if the channel is full (or closed).
+	 */
+	bool send(const T& msg) throw (error);
+
+	/// Called (in the reactor thread) for each message received.
+	virtual void received(T& msg) = 0;
+
+	/// Destructor (unregisters the channel).
+	virtual ~channel() throw ();
+
+	void ready(uint32_t events);
+
+private:
+
+	// Hidden copy constructor and assign operator
+	channel(const channel& c);
+	channel& operator=(const channel& c);
+
+	reactor& _reactor;
+	queue< T > _queue;
+	int _fd;
+	// 1 if the next message must write to the eventfd
+	int _armed;
+
+};
+
+} } // namespace posixx::linux
+
+
+
+template < typename T >
+inline
+posixx::linux::channel< T >::channel(reactor& r, std::size_t capacity)
+		throw (error):
+		_reactor(r), _queue(capacity), _armed(1)
+{
+	_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (_fd == -1)
+		throw error("eventfd");
+	try {
+		r.add(_fd, this);
+	}
+	catch (...) {
+		::close(_fd);
+		throw;
+	}
+}
+
+template < typename T >
+inline
+bool posixx::linux::channel< T >::send(const T& msg) throw (error)
+{
+	if (!_queue.try_push(msg))
+		return false;
+	if (__atomic_exchange_n(&_armed, 0, __ATOMIC_SEQ_CST)) {
+		uint64_t one = 1;
+		if (::write(_fd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+			throw error("channel write");
+	}
+	return true;
+}
+
+template < typename T >
+inline
+void posixx::linux::channel< T >::ready(uint32_t events)
+{
+	uint64_t n;
+	if (::read(_fd, &n, sizeof(n)) == -1 && errno != EAGAIN)
+		throw error("channel read");
+	// re-arm before draining: anything pushed after this is either
+	// drained now or notified again
+	__atomic_store_n(&_armed, 1, __ATOMIC_SEQ_CST);
+	T msg;
+	while (_queue.try_pop(msg))
+		received(msg);
+}
+
+template < typename T >
+inline
+posixx::linux::channel< T >::~channel() throw ()
+{
+	try {
+		_reactor.remove(_fd);
+	}
+	catch (...) {
+	}
+	::close(_fd);
+}
+
+#endif // POSIXX_LINUX_CHANNEL_HPP_
@@ -0,0 +1,538 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_EXECUTOR_HPP_
+#define POSIXX_LINUX_EXECUTOR_HPP_
+
+#include "../error.hpp" // posixx::error
+#include "reactor.hpp" // posixx::linux::reactor
+#include "queue.hpp" // posixx::linux::queue
+#include "work_deque.hpp" // posixx::linux::work_deque
+#include "thread.hpp" // available_cpus, start_thread
+
+#include <vector> // std::vector
+#include <memory> // std::auto_ptr
+#include <exception> // std::exception
+#include <cerrno> // errno, EINVAL
+#include <stdint.h> // uint32_t, uint64_t
+#include <sys/epoll.h> // EPOLLIN, EPOLLONESHOT
+#include <pthread.h> // pthread_t, pthread_join
+
+/// @file
+
+namespace posixx { namespace linux {
+
+/**
+ * Work-stealing task executor.
+ *
+ * An executor runs a pool of worker threads (one per CPU by default, each
+ * pinned to it), each with its own reactor and its own Chase-Lev deque of
+ * tasks. Tasks are submitted to a particular worker, and that worker runs
+ * them unless it's busy and another worker is idle, in which case the idle
+ * one steals them. This keeps connection affinity in the common case
+ * while bursts on a worker are spread among the idle ones.
+ *
+ * File descriptors are watched with watch(), which registers an io_task
+ * in a worker reactor (in one-shot mode): when the file descriptor is
+ * ready, the io_task is scheduled in the worker it was registered on and
+ * re-armed after it runs, so only one thread at a time handles it, even
+ * if it was stolen.
+ *
+ * Tasks are not owned by the executor, a one-shot task can delete itself
+ * at the end of run().
+ *
+ * @code
+ * struct conn: posixx::linux::executor::io_task {
+ *	bool handle(uint32_t events) { ... }
+ * };
+ * posixx::linux::executor e;
+ * e.start();
+ * e.watch(sock.fd(), new conn(sock), 0);
+ * @endcode
+ */
+struct executor
+{
+
+	/// Unit of work.
+	struct task
+	{
+		/// Do the work.
+		virtual void run() = 0;
+
+		/// Destructor.
+		virtual ~task();
+	};
+
+	/// Task scheduled when a file descriptor is ready.
+	struct io_task: task, reactor::handler
+	{
+		/**
+		 * Handle the file descriptor readiness.
+		 *
+		 * @param events Combination of EPOLL* flags.
+		 *
+		 * @return true to keep watching the file descriptor, false to
+		 *         stop (in that case the task may close the file
+		 *         descriptor and delete itself before returning).
+		 */
+		virtual bool handle(uint32_t events) = 0;
+
+		/// Create an unwatched task.
+		io_task() throw ();
+
+		void run();
+
+		void ready(uint32_t events);
+
+	private:
+
+		friend struct executor;
+
+		executor* _executor;
+		unsigned _worker;
+		int _fd;
+		uint32_t _events;
+		uint32_t _ready;
+	};
+
+	/// Executor configuration.
+	struct config
+	{
+		/// Number of workers (0 means one per CPU available).
+		unsigned threads;
+		/// Pin each worker thread to a CPU.
+		bool pin;
+		/// Let idle workers steal tasks from busy ones.
+		bool steal;
+		/// Capacity of each worker deque and inbox.
+		std::size_t capacity;
+		/// Create a default configuration.
+		config() throw ();
+	};
+
+	/// Create the workers (but don't start them).
+	explicit executor(const config& c = config()) throw (error);
+
+	/// Start the worker threads.
+	void start() throw (error);
+
+	/**
+	 * Run a task in a worker (can be called from any thread).
+	 *
+	 * Tasks submitted from the worker thread itself go to its deque and
+	 * can be stolen; the rest go to the worker inbox, which can be
+	 * stolen from too.
+	 */
+	void submit(task* t, unsigned worker) throw (error);
+
+	/**
+	 * Run a task in the calling worker.
+	 *
+	 * If the caller is not a worker thread, the workers are picked in a
+	 * round-robin fashion.
+	 */
+	void submit(task* t) throw (error);
+
+	/**
+	 * Watch a file descriptor.
+	 *
+	 * @param fd File descriptor.
+	 * @param t Task to run when fd is ready (it must not be watching
+	 *          another file descriptor).
+	 * @param worker Worker that handles fd by default.
+	 * @param events Combination of EPOLL* flags to wait for.
+	 */
+	void watch(int fd, io_task* t, unsigned worker,
+			uint32_t events = EPOLLIN) throw (error);
+
+	/// Stop all the workers (can be called from any thread).
+	void stop() throw (error);
+
+	/**
+	 * Wait for all the worker threads to finish.
+	 *
+	 * If a task threw an exception, it's re-thrown here. A failing task
+	 * stops the whole executor (tasks still waiting in any worker are not
+	 * run), so this doesn't wait for the executor to be stopped by other
+	 * means.
+	 */
+	void join() throw (error);
+
+	/// Number of workers.
+	std::size_t size() const throw ();
+
+	/// Number of tasks run by a worker other than the one they were
+	/// submitted to.
+	uint64_t stolen() const throw ();
+
+	/// Index of the worker running the calling thread (-1 if none).
+	int current() const throw ();
+
+	/// Destructor (stops and joins the worker threads if running).
+	~executor() throw ();
+
+private:
+
+	friend struct io_task;
+
+	// Hidden copy constructor and assign operator
+	executor(const executor& e);
+	executor& operator=(const executor& e);
+
+	// Number of tasks to run between non-blocking reactor polls
+	enum { POLL_INTERVAL = 64 };
+
+	struct worker
+	{
+		executor& owner;
+		unsigned id;
+		int cpu;
+		reactor loop;
+		work_deque< task > deque;
+		queue< task* > inbox;
+		int sleeping;
+		uint64_t stolen;
+		pthread_t thread;
+		std::auto_ptr< error > failure;
+		worker(executor& e, unsigned id, int cpu, std::size_t capacity);
+	};
+
+	static worker*& _self() throw ();
+
+	static void* _main(void* arg);
+
+	// Stop all the workers after a failure
+	void _stop_all() throw ();
+
+	task* _next(worker& w) throw (error);
+
+	bool _pending(const worker& w) const throw ();
+
+	void _notify(worker& w) throw (error);
+
+	std::vector< worker* > _workers;
+	bool _steal;
+	bool _started;
+	unsigned _next_worker;
+	int _idle;
+
+};
+
+} } // namespace posixx::linux
+
+
+
+inline
+posixx::linux::executor::task::~task()
+{
+}
+
+inline
+posixx::linux::executor::io_task::io_task() throw ():
+		_executor(NULL), _worker(0), _fd(-1), _events(0), _ready(0)
+{
+}
+
+inline
+void posixx::linux::executor::io_task::ready(uint32_t events)
+{
+	_ready = events;
+	_executor->submit(this, _worker);
+}
+
+inline
+void posixx::linux::executor::io_task::run()
+{
+	// the task might be gone after handle() returns false
+	reactor& r = _executor->_workers[_worker]->loop;
+	int fd = _fd;
+	if (handle(_ready)) {
+		r.modify(fd, this, _events | EPOLLONESHOT);
+		return;
+	}
+	try {
+		r.remove(fd);
+	}
+	catch (const error&) {
+		// fine if the task already closed it
+	}
+}
+
+inline
+posixx::linux::executor::config::config() throw ():
+		threads(0), pin(true), steal(true), capacity(4096)
+{
+}
+
+inline
+posixx::linux::executor::worker::worker(executor& e, unsigned id, int cpu,
+		std::size_t capacity):
+		owner(e), id(id), cpu(cpu), deque(capacity), inbox(capacity),
+		sleeping(0), stolen(0)
+{
+}
+
+inline
+posixx::linux::executor::executor(const config& c) throw (error):
+		_steal(c.steal), _started(false), _next_worker(0), _idle(0)
+{
+	std::vector< int > cpus = available_cpus();
+	unsigned n = c.threads ? c.threads : cpus.size();
+	try {
+		for (unsigned i = 0; i < n; ++i)
+			_workers.push_back(new worker(*this, i,
+					c.pin ? cpus[i % cpus.size()] : -1,
+					c.capacity));
+	}
+	catch (...) {
+		for (std::size_t i = 0; i < _workers.size(); ++i)
+			delete _workers[i];
+		throw;
+	}
+}
+
+inline
+posixx::linux::executor::worker*& posixx::linux::executor::_self() throw ()
+{
+	static __thread worker* w = NULL;
+	return w;
+}
+
+inline
+void* posixx::linux::executor::_main(void* arg)
+{
+	worker& w = *static_cast< worker* >(arg);
+	executor& e = w.owner;
+	_self() = &w;
+	try {
+		unsigned ran = 0;
+		while (!w.loop.stopped()) {
+			task* t = e._next(w);
+			if (t) {
+				t->run();
+				// don't starve the file descriptors
+				if (++ran % POLL_INTERVAL == 0)
+					w.loop.poll(0);
+				continue;
+			}
+			if (w.loop.poll(0))
+				continue;
+			// nothing to do, go to sleep unless some work arrived
+			// in the meantime (see _notify())
+			__atomic_store_n(&w.sleeping, 1, __ATOMIC_SEQ_CST);
+			__atomic_add_fetch(&e._idle, 1, __ATOMIC_SEQ_CST);
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			if (!e._pending(w))
+				w.loop.poll();
+			__atomic_sub_fetch(&e._idle, 1, __ATOMIC_SEQ_CST);
+			__atomic_store_n(&w.sleeping, 0, __ATOMIC_SEQ_CST);
+		}
+	}
+	catch (const error& x) {
+		w.failure.reset(new error(x));
+		e._stop_all();
+	}
+	catch (const std::exception& x) {
+		errno = 0;
+		w.failure.reset(new error(x.what()));
+		e._stop_all();
+	}
+	return NULL;
+}
+
+inline
+void posixx::linux::executor::_stop_all() throw ()
+{
+	// the other workers would keep join() waiting for them forever
+	try {
+		stop();
+	}
+	catch (...) {
+		// the error that got us here is the one to report
+	}
+}
+
+inline
+posixx::linux::executor::task* posixx::linux::executor::_next(worker& w)
+		throw (error)
+{
+	task* t = w.deque.pop();
+	if (t || w.inbox.try_pop(t))
+		return t;
+	if (!_steal)
+		return NULL;
+	std::size_t n = _workers.size();
+	for (std::size_t i = 1; i < n; ++i) {
+		worker& v = *_workers[(w.id + i) % n];
+		t = v.deque.steal();
+		if (t || v.inbox.try_pop(t)) {
+			__atomic_add_fetch(&w.stolen, 1, __ATOMIC_RELAXED);
+			return t;
+		}
+	}
+	return NULL;
+}
+
+inline
+bool posixx::linux::executor::_pending(const worker& w) const throw ()
+{
+	if (w.deque.size() || w.inbox.size())
+		return true;
+	if (!_steal)
+		return false;
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+		if (_workers[i]->deque.size() || _workers[i]->inbox.size())
+			return true;
+	return false;
+}
+
+inline
+void posixx::linux::executor::_notify(worker& w) throw (error)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&_idle, __ATOMIC_SEQ_CST))
+		return;
+	// prefer the worker the task was submitted to, then any idle thief
+	if (__atomic_exchange_n(&w.sleeping, 0, __ATOMIC_SEQ_CST)) {
+		w.loop.wake();
+		return;
+	}
+	if (!_steal)
+		return;
+	for (std::size_t i = 0; i < _workers.size(); ++i) {
+		worker& v = *_workers[i];
+		if (__atomic_exchange_n(&v.sleeping, 0, __ATOMIC_SEQ_CST)) {
+			v.loop.wake();
+			return;
+		}
+	}
+}
+
+inline
+void posixx::linux::executor::start() throw (error)
+{
+	for (std::size_t i = 0; i < _workers.size(); ++i) {
+		worker& w = *_workers[i];
+		try {
+			start_thread(w.thread, &executor::_main, &w, w.cpu);
+		}
+		catch (...) {
+			// the started workers must not outlive the executor
+			for (std::size_t j = 0; j < i; ++j) {
+				_workers[j]->loop.stop();
+				::pthread_join(_workers[j]->thread, NULL);
+			}
+			throw;
+		}
+	}
+	_started = true;
+}
+
+inline
+void posixx::linux::executor::submit(task* t, unsigned worker_id)
+		throw (error)
+{
+	if (worker_id >= _workers.size()) {
+		errno = EINVAL;
+		throw error("executor submit");
+	}
+	worker& w = *_workers[worker_id];
+	if (_self() == &w) {
+		if (!w.deque.push(t) && !w.inbox.try_push(t)) {
+			// both full, the owner can't wait for itself
+			t->run();
+			return;
+		}
+	}
+	else
+		w.inbox.push(t);
+	_notify(w);
+}
+
+inline
+void posixx::linux::executor::submit(task* t) throw (error)
+{
+	worker* w = _self();
+	if (w && &w->owner == this)
+		submit(t, w->id);
+	else
+		submit(t, __atomic_fetch_add(&_next_worker, 1,
+				__ATOMIC_RELAXED) % _workers.size());
+}
+
+inline
+void posixx::linux::executor::watch(int fd, io_task* t, unsigned worker_id,
+		uint32_t events) throw (error)
+{
+	if (worker_id >= _workers.size()) {
+		errno = EINVAL;
+		throw error("executor watch");
+	}
+	t->_executor = this;
+	t->_worker = worker_id;
+	t->_fd = fd;
+	t->_events = events;
+	_workers[worker_id]->loop.add(fd, t, events | EPOLLONESHOT);
+}
+
+inline
+void posixx::linux::executor::stop() throw (error)
+{
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+		_workers[i]->loop.stop();
+}
+
+inline
+void posixx::linux::executor::join() throw (error)
+{
+	if (!_started)
+		return;
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+		::pthread_join(_workers[i]->thread, NULL);
+	_started = false;
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+		if (_workers[i]->failure.get())
+			throw error(*_workers[i]->failure);
+}
+
+inline
+std::size_t posixx::linux::executor::size() const throw ()
+{
+	return _workers.size();
+}
+
+inline
+uint64_t posixx::linux::executor::stolen() const throw ()
+{
+	uint64_t n = 0;
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+		n += __atomic_load_n(&_workers[i]->stolen, __ATOMIC_RELAXED);
+	return n;
+}
+
+inline
+int posixx::linux::executor::current() const throw ()
+{
+	worker* w = _self();
+	return w && &w->owner == this ? int(w->id) : -1;
+}
+
+inline
+posixx::linux::executor::~executor() throw ()
+{
+	if (_started) {
+		try {
+			stop();
+			join();
+		}
+		catch (...) {
+		}
+	}
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+		delete _workers[i];
+}
+
+#endif // POSIXX_LINUX_EXECUTOR_HPP_
@@ -0,0 +1,475 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_FIBER_HPP_
+#define POSIXX_LINUX_FIBER_HPP_
+
+#include "../error.hpp" // posixx::error
+#include "reactor.hpp" // posixx::linux::reactor
+
+#include <new> // placement new
+#include <memory> // std::auto_ptr
+#include <vector> // std::vector
+#include <exception> // std::exception
+#include <cerrno> // errno, EINVAL
+#include <stdint.h> // uint32_t
+#include <ucontext.h> // ucontext_t, getcontext, makecontext, swapcontext
+#include <sys/mman.h> // mmap, mprotect, munmap
+#include <sys/epoll.h> // EPOLLONESHOT
+#include <unistd.h> // sysconf
+
+/// @file
+
+namespace posixx { namespace linux {
+
+/**
+ * Pool of fiber stacks.
+ *
+ * Stacks are mapped with a guard page below them (so an overflow is a
+ * segmentation fault instead of a memory corruption) and recycled when
+ * released, so after a warm up spawning a fiber doesn't need any system
+ * call or heap allocation.
+ */
+struct stack_pool
+{
+
+	/**
+	 * Create a pool.
+	 *
+	 * @param size Usable size of each stack (rounded up to whole pages).
+	 * @param max_free Maximum number of free stacks to keep.
+	 */
+	explicit stack_pool(std::size_t size = 65536,
+			std::size_t max_free = 64);
+
+	/// Get a stack (its lowest address).
+	void* get() throw (error);
+
+	/// Release a stack got from this pool.
+	void put(void* stack) throw ();
+
+	/// Usable size of the stacks.
+	std::size_t size() const throw ();
+
+	/// Number of free stacks.
+	std::size_t free() const throw ();
+
+	/// Destructor (unmaps the free stacks).
+	~stack_pool() throw ();
+
+private:
+
+	// Hidden copy constructor and assign operator
+	stack_pool(const stack_pool& p);
+	stack_pool& operator=(const stack_pool& p);
+
+	void _unmap(void* stack) throw ();
+
+	std::size_t _page;
+	std::size_t _size;
+	std::size_t _max_free;
+	std::vector< void* > _free;
+
+};
+
+/**
+ * Cooperative scheduler of stackful fibers driven by a reactor.
+ *
+ * Fibers let non-blocking socket code be written sequentially: when an
+ * operation would block, the fiber registers the file descriptor in the
+ * reactor and switches back to the scheduler, which runs other fibers or
+ * waits in the reactor, and it's resumed when the file descriptor is
+ * ready. See async.hpp for the socket operations.
+ *
+ * The fiber control block lives at the top of its own stack, taken from a
+ * stack_pool, so fibers cost no heap allocations once the pool is warm,
+ * and waiting uses no allocations at all.
+ *
+ * A scheduler (and its fibers) must be used from a single thread.
+ *
+ * @code
+ * void echo(void* arg)
+ * {
+ *	inet::socket* s = static_cast< inet::socket* >(arg);
+ *	char buf[512];
+ *	for (;;) {
+ *		ssize_t n = posixx::linux::async_recv(*s, buf, sizeof(buf));
+ *		posixx::linux::async_send(*s, buf, n);
+ *	}
+ * }
+ * posixx::linux::reactor r;
+ * posixx::linux::fiber_scheduler f(r);
+ * f.spawn(&echo, sock);
+ * f.run();
+ * @endcode
+ *
+ * @see makecontext(3)
+ */
+struct fiber_scheduler
+{
+
+	/// Function run by a fiber.
+	typedef void (*entry)(void* arg);
+
+	/**
+	 * Create a scheduler.
+	 *
+	 * @param r Reactor used to wait for file descriptors.
+	 * @param stack_size Size of the fibers stacks.
+	 */
+	explicit fiber_scheduler(reactor& r, std::size_t stack_size = 65536);
+
+	/// Start a fiber (it runs the next time the scheduler runs).
+	void spawn(entry fn, void* arg) throw (error);
+
+	/**
+	 * Run the fibers until all of them are finished.
+	 *
+	 * If a fiber throws an exception, it's re-thrown here (the rest of
+	 * the fibers are kept and can be resumed by calling run() again). An
+	 * exception that is not a std::exception is re-thrown as an error
+	 * with errno 0, since an exception can't leave a fiber.
+	 */
+	void run() throw (error);
+
+	/**
+	 * Wait (from a fiber) until a file descriptor is ready.
+	 *
+	 * Only one fiber can wait for a file descriptor at a time.
+	 *
+	 * @param fd File descriptor.
+	 * @param events Combination of EPOLL* flags to wait for.
+	 *
+	 * @return The EPOLL* flags reported.
+	 */
+	uint32_t wait(int fd, uint32_t events) throw (error);
+
+	/// Let other fibers run (from a fiber).
+	void yield() throw ();
+
+	/// Number of fibers not finished yet.
+	std::size_t size() const throw ();
+
+	/// Reactor used by this scheduler.
+	reactor& loop() throw ();
+
+	/// Scheduler running in the calling thread (NULL if none).
+	static fiber_scheduler* current() throw ();
+
+	/// Destructor (fibers not finished are discarded without unwinding).
+	~fiber_scheduler() throw ();
+
+private:
+
+	struct fiber;
+	friend struct fiber;
+
+	// Hidden copy constructor and assign operator
+	fiber_scheduler(const fiber_scheduler& s);
+	fiber_scheduler& operator=(const fiber_scheduler& s);
+
+	struct fiber: reactor::handler
+	{
+		ucontext_t ctx;
+		fiber_scheduler& owner;
+		void* stack;
+		entry fn;
+		void* arg;
+		fiber* next;
+		std::size_t slot;
+		int fd;
+		uint32_t events;
+		bool done;
+		fiber(fiber_scheduler& s, void* stack, entry fn, void* arg);
+		void ready(uint32_t events);
+	};
+
+	static fiber_scheduler*& _self() throw ();
+
+	static void _trampoline();
+
+	void _schedule(fiber* f) throw ();
+
+	void _release(fiber* f) throw ();
+
+	reactor& _reactor;
+	stack_pool _stacks;
+	ucontext_t _main;
+	fiber* _running;
+	fiber* _head;
+	fiber* _tail;
+	std::vector< fiber* > _all;
+	std::auto_ptr< error > _error;
+
+};
+
+} } // namespace posixx::linux
+
+
+
+inline
+posixx::linux::stack_pool::stack_pool(std::size_t size, std::size_t max_free):
+		_page(::sysconf(_SC_PAGESIZE)), _max_free(max_free)
+{
+	_size = (size + _page - 1) / _page * _page;
+	_free.reserve(max_free);
+}
+
+inline
+void* posixx::linux::stack_pool::get() throw (error)
+{
+	if (!_free.empty()) {
+		void* s = _free.back();
+		_free.pop_back();
+		return s;
+	}
+	char* p = static_cast< char* >(::mmap(NULL, _size + _page,
+			PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0));
+	if (p == MAP_FAILED)
+		throw error("stack mmap");
+	if (::mprotect(p, _page, PROT_NONE) == -1) {
+		int e = errno;
+		::munmap(p, _size + _page);
+		errno = e;
+		throw error("stack guard mprotect");
+	}
+	return p + _page;
+}
+
+inline
+void posixx::linux::stack_pool::put(void* stack) throw ()
+{
+	if (_free.size() >= _max_free)
+		_unmap(stack);
+	else
+		_free.push_back(stack);
+}
+
+inline
+std::size_t posixx::linux::stack_pool::size() const throw ()
+{
+	return _size;
+}
+
+inline
+std::size_t posixx::linux::stack_pool::free() const throw ()
+{
+	return _free.size();
+}
+
+inline
+void posixx::linux::stack_pool::_unmap(void* stack) throw ()
+{
+	::munmap(static_cast< char* >(stack) - _page, _size + _page);
+}
+
+inline
+posixx::linux::stack_pool::~stack_pool() throw ()
+{
+	for (std::size_t i = 0; i < _free.size(); ++i)
+		_unmap(_free[i]);
+}
+
+inline
+posixx::linux::fiber_scheduler::fiber::fiber(fiber_scheduler& s,
+		void* stack, entry fn, void* arg):
+		owner(s), stack(stack), fn(fn), arg(arg), next(NULL), slot(0),
+		fd(-1), events(0), done(false)
+{
+}
+
+inline
+void posixx::linux::fiber_scheduler::fiber::ready(uint32_t events)
+{
+	this->events = events;
+	owner._schedule(this);
+}
+
+inline
+posixx::linux::fiber_scheduler::fiber_scheduler(reactor& r,
+		std::size_t stack_size):
+		_reactor(r), _stacks(stack_size), _running(NULL), _head(NULL),
+		_tail(NULL)
+{
+}
+
+inline
+posixx::linux::fiber_scheduler*& posixx::linux::fiber_scheduler::_self()
+		throw ()
+{
+	static __thread fiber_scheduler* s = NULL;
+	return s;
+}
+
+inline
+void posixx::linux::fiber_scheduler::_trampoline()
+{
+	fiber_scheduler& s = *_self();
+	fiber* f = s._running;
+	try {
+		f->fn(f->arg);
+	}
+	catch (const error& e) {
+		if (!s._error.get())
+			s._error.reset(new error(e));
+	}
+	catch (const std::exception& e) {
+		if (!s._error.get()) {
+			errno = 0;
+			s._error.reset(new error(e.what()));
+		}
+	}
+	catch (...) {
+		if (!s._error.get()) {
+			errno = 0;
+			s._error.reset(new error("fiber: unknown exception"));
+		}
+	}
+	f->done = true;
+	// returning resumes uc_link, the scheduler
+}
+
+inline
+void posixx::linux::fiber_scheduler::spawn(entry fn, void* arg)
+		throw (error)
+{
+	void* stack = _stacks.get();
+	// the control block goes at the top of the stack
+	std::size_t size = (_stacks.size() - sizeof(fiber)) & ~std::size_t(15);
+	fiber* f = new (static_cast< char* >(stack) + size)
+			fiber(*this, stack, fn, arg);
+	::getcontext(&f->ctx);
+	f->ctx.uc_stack.ss_sp = stack;
+	f->ctx.uc_stack.ss_size = size;
+	f->ctx.uc_link = &_main;
+	::makecontext(&f->ctx, &_trampoline, 0);
+	try {
+		f->slot = _all.size();
+		_all.push_back(f);
+	}
+	catch (...) {
+		f->~fiber();
+		_stacks.put(stack);
+		throw;
+	}
+	_schedule(f);
+}
+
+inline
+void posixx::linux::fiber_scheduler::_schedule(fiber* f) throw ()
+{
+	f->next = NULL;
+	if (_tail)
+		_tail->next = f;
+	else
+		_head = f;
+	_tail = f;
+}
+
+inline
+void posixx::linux::fiber_scheduler::_release(fiber* f) throw ()
+{
+	_all[f->slot] = _all.back();
+	_all[f->slot]->slot = f->slot;
+	_all.pop_back();
+	void* stack = f->stack;
+	f->~fiber();
+	_stacks.put(stack);
+}
+
+inline
+void posixx::linux::fiber_scheduler::run() throw (error)
+{
+	fiber_scheduler* prev = _self();
+	_self() = this;
+	while (!_all.empty()) {
+		while (_head) {
+			fiber* f = _head;
+			_head = f->next;
+			if (!_head)
+				_tail = NULL;
+			_running = f;
+			::swapcontext(&_main, &f->ctx);
+			_running = NULL;
+			if (f->done)
+				_release(f);
+			if (_error.get()) {
+				_self() = prev;
+				error e(*_error);
+				_error.reset();
+				throw e;
+			}
+		}
+		if (!_all.empty())
+			_reactor.poll();
+	}
+	_self() = prev;
+}
+
+inline
+uint32_t posixx::linux::fiber_scheduler::wait(int fd, uint32_t events)
+		throw (error)
+{
+	fiber* f = _running;
+	if (!f) {
+		errno = EINVAL;
+		throw error("fiber wait outside a fiber");
+	}
+	_reactor.add(fd, f, events | EPOLLONESHOT);
+	f->fd = fd;
+	::swapcontext(&f->ctx, &_main);
+	f->fd = -1;
+	_reactor.remove(fd);
+	return f->events;
+}
+
+inline
+void posixx::linux::fiber_scheduler::yield() throw ()
+{
+	fiber* f = _running;
+	if (!f)
+		return;
+	_schedule(f);
+	::swapcontext(&f->ctx, &_main);
+}
+
+inline
+std::size_t posixx::linux::fiber_scheduler::size() const throw ()
+{
+	return _all.size();
+}
+
+inline
+posixx::linux::reactor& posixx::linux::fiber_scheduler::loop() throw ()
+{
+	return _reactor;
+}
+
+inline
+posixx::linux::fiber_scheduler* posixx::linux::fiber_scheduler::current()
+		throw ()
+{
+	return _self();
+}
+
+inline
+posixx::linux::fiber_scheduler::~fiber_scheduler() throw ()
+{
+	while (!_all.empty()) {
+		fiber* f = _all.back();
+		if (f->fd != -1) {
+			try {
+				_reactor.remove(f->fd);
+			}
+			catch (const error&) {
+			}
+		}
+		_release(f);
+	}
+}
+
+#endif // POSIXX_LINUX_FIBER_HPP_
@@ -0,0 +1,91 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_FUTEX_HPP_
+#define POSIXX_LINUX_FUTEX_HPP_
+
+#include "../error.hpp" // posixx::error
+
+#include <cerrno> // EAGAIN, EINTR, ETIMEDOUT
+#include <climits> // INT_MAX
+#include <linux/futex.h> // FUTEX_*
+#include <sys/syscall.h> // SYS_futex
+#include <unistd.h> // syscall
+#include <time.h> // timespec
+
+/// @file
+
+namespace posixx { namespace linux {
+
+/**
+ * Fast user-space locking primitives.
+ *
+ * A futex is a 32-bit integer used to wait until another thread (or
+ * process, if the futex is in shared memory) changes it. The waiter
+ * passes the value it saw, and the kernel only puts it to sleep if the
+ * futex still has that value, so wake-ups can't be lost.
+ *
+ * @see futex(2)
+ */
+namespace futex {
+
+/**
+ * Wait until the futex is woken up, if it has the expected value.
+ *
+ * Spurious wake-ups are possible, so the caller should check the
+ * condition it waits for again after this returns.
+ *
+ * @param addr Futex address.
+ * @param expected Value the futex is expected to have.
+ * @param timeout Relative timeout (NULL to wait forever).
+ * @param shared false if the futex is only used inside this process (it
+ *               makes the futex a little faster).
+ *
+ * @return false if the timeout expired.
+ */
+bool wait(int* addr, int expected, const timespec* timeout = NULL,
+		bool shared = true) throw (error);
+
+/**
+ * Wake up threads waiting on the futex.
+ *
+ * @param addr Futex address.
+ * @param n Maximum number of threads to wake up.
+ * @param shared Must match the value used by wait().
+ *
+ * @return Number of threads woken up.
+ */
+int wake(int* addr, int n = INT_MAX, bool shared = true) throw (error);
+
+} } } // namespace posixx::linux::futex
+
+
+
+inline
+bool posixx::linux::futex::wait(int* addr, int expected,
+		const timespec* timeout, bool shared) throw (error)
+{
+	int op = shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE;
+	if (::syscall(SYS_futex, addr, op, expected, timeout, NULL, 0) == -1) {
+		if (errno == ETIMEDOUT)
+			return false;
+		if (errno != EAGAIN && errno != EINTR)
+			throw error("futex wait");
+	}
+	return true;
+}
+
+inline
+int posixx::linux::futex::wake(int* addr, int n, bool shared) throw (error)
+{
+	int op = shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE;
+	long r = ::syscall(SYS_futex, addr, op, n, NULL, NULL, 0);
+	if (r == -1)
+		throw error("futex wake");
+	return static_cast< int >(r);
+}
+
+#endif // POSIXX_LINUX_FUTEX_HPP_
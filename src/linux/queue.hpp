@@ -0,0 +1,640 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_QUEUE_HPP_
+#define POSIXX_LINUX_QUEUE_HPP_
+
+#include "../error.hpp" // posixx::error
+#include "futex.hpp" // posixx::linux::futex
+#include "../tsc.hpp" // posixx::tsc::monotonic
+
+#include <vector> // std::vector
+#include <climits> // INT_MAX
+#include <stdint.h> // uint64_t, intptr_t
+#include <time.h> // timespec
+#include <unistd.h> // sysconf
+
+/// @file
+
+namespace posixx { namespace linux {
+
+/// Number of producers and consumers of a queue.
+enum queue_kind
+{
+	/// Many producers and many consumers.
+	MPMC,
+	/// A single producer and a single consumer.
+	SPSC
+};
+
+/**
+ * Blocking and closing logic shared by all the queues.
+ *
+ * Waiting threads spin for a while and then sleep on a futex (private to
+ * the process). The other side only makes the futex system call if
+ * someone is actually sleeping, so the common case doesn't need any
+ * system call.
+ */
+struct queue_base
+{
+
+	/// true if the queue was closed.
+	bool closed() const throw ();
+
+	/**
+	 * Close the queue.
+	 *
+	 * Producers can't push anymore, and consumers can pop the elements
+	 * left, and then pop() returns false instead of blocking. All the
+	 * waiting threads are woken up.
+	 */
+	void close() throw (error);
+
+protected:
+
+	// Condition threads can wait for (padded to avoid false sharing)
+	struct signal
+	{
+		int seq;
+		int waiters;
+		char _pad[64 - 2 * sizeof(int)];
+	};
+
+	// Spins before sleeping on a futex (with more than one CPU)
+	enum { SPINS = 128 };
+
+	// Spins to do before sleeping (0 if there is only one CPU)
+	static unsigned _spins() throw ();
+
+	queue_base() throw ();
+
+	// Compute the deadline for a relative timeout (0 means forever)
+	static uint64_t _deadline(const timespec* timeout) throw ();
+
+	// Let the other hyper-thread run while spinning
+	static void _pause() throw ();
+
+	// Wake up threads waiting on the signal, if any
+	static void _notify(signal& s, int n = 1) throw (error);
+
+	// Register as waiter, the returned value must be passed to _sleep()
+	static int _prepare(signal& s) throw ();
+
+	// Unregister as waiter (if the condition was met after _prepare())
+	static void _cancel(signal& s) throw ();
+
+	// Sleep until notified, returns false if the deadline passed
+	static bool _sleep(signal& s, int seq, uint64_t deadline)
+			throw (error);
+
+	// Signaled when an element is pushed
+	signal _not_empty;
+	// Signaled when an element is popped
+	signal _not_full;
+	int _closed;
+
+};
+
+/**
+ * Bounded lock-free queue.
+ *
+ * The queue is a ring of slots allocated when it's created, so pushing and
+ * popping never allocates memory (or locks). The elements are copied in
+ * and out of the queue, so T should be cheap to copy, like a pointer to a
+ * buffer or a socket.
+ *
+ * try_push() and try_pop() never block, push() and pop() wait (up to a
+ * timeout, optionally) until there is space or an element available.
+ *
+ * The MPMC queue (the default) is the bounded queue by Dmitry Vyukov: each
+ * slot has a sequence number telling if it's ready to be written or read
+ * in the current lap, so producers and consumers only compete (with a CAS)
+ * for the index of their own side. The SPSC specialization doesn't need
+ * any atomic read-modify-write operation at all.
+ *
+ * @code
+ * using namespace posixx::linux;
+ * queue< posixx::buffer* > q(1024);
+ * // I/O thread
+ * q.push(buf);
+ * // worker threads
+ * posixx::buffer* b;
+ * while (q.pop(b))
+ *	process(b);
+ * @endcode
+ */
+template < typename T, queue_kind K = MPMC >
+struct queue: queue_base
+{
+
+	/// Type of the elements.
+	typedef T value_type;
+
+	/**
+	 * Create a queue.
+	 *
+	 * @param capacity Maximum number of elements (rounded up to a power
+	 *                 of 2).
+	 */
+	explicit queue(std::size_t capacity);
+
+	/**
+	 * Push an element, without blocking.
+	 *
+	 * @return false if the queue is full or closed.
+	 */
+	bool try_push(const T& v) throw (error);
+
+	/**
+	 * Pop an element, without blocking.
+	 *
+	 * @return false if the queue is empty.
+	 */
+	bool try_pop(T& v) throw (error);
+
+	/**
+	 * Push an element, waiting for space if needed.
+	 *
+	 * @param v Element to push.
+	 * @param timeout Relative timeout (NULL to wait forever).
+	 *
+	 * @return false if the timeout expired or the queue is closed.
+	 */
+	bool push(const T& v, const timespec* timeout = NULL) throw (error);
+
+	/**
+	 * Pop an element, waiting for one if needed.
+	 *
+	 * @param v Where to store the element.
+	 * @param timeout Relative timeout (NULL to wait forever).
+	 *
+	 * @return false if the timeout expired or the queue is closed and
+	 *         empty.
+	 */
+	bool pop(T& v, const timespec* timeout = NULL) throw (error);
+
+	/// Get the capacity.
+	std::size_t capacity() const throw ();
+
+	/// Get the number of elements (it can be stale when it's returned).
+	std::size_t size() const throw ();
+
+private:
+
+	struct cell
+	{
+		std::size_t seq;
+		T value;
+	};
+
+	std::vector< cell > _cells;
+	std::size_t _mask;
+	char _pad0[64];
+	// next position to push
+	std::size_t _tail;
+	char _pad1[64 - sizeof(std::size_t)];
+	// next position to pop
+	std::size_t _head;
+	char _pad2[64 - sizeof(std::size_t)];
+
+};
+
+/**
+ * Bounded lock-free single producer, single consumer queue.
+ *
+ * Only one thread can push and only one thread can pop at the same time.
+ * Each side keeps a cached copy of the other side's index, so it only
+ * touches the other side's cache line when the queue looks full (or
+ * empty).
+ *
+ * @see queue
+ */
+template < typename T >
+struct queue< T, SPSC >: queue_base
+{
+
+	/// Type of the elements.
+	typedef T value_type;
+
+	/// @see queue::queue()
+	explicit queue(std::size_t capacity);
+
+	/// @see queue::try_push()
+	bool try_push(const T& v) throw (error);
+
+	/// @see queue::try_pop()
+	bool try_pop(T& v) throw (error);
+
+	/// @see queue::push()
+	bool push(const T& v, const timespec* timeout = NULL) throw (error);
+
+	/// @see queue::pop()
+	bool pop(T& v, const timespec* timeout = NULL) throw (error);
+
+	/// @see queue::capacity()
+	std::size_t capacity() const throw ();
+
+	/// @see queue::size()
+	std::size_t size() const throw ();
+
+private:
+
+	std::vector< T > _cells;
+	std::size_t _mask;
+	char _pad0[64];
+	// producer side
+	std::size_t _tail;
+	std::size_t _head_cache;
+	char _pad1[64 - 2 * sizeof(std::size_t)];
+	// consumer side
+	std::size_t _head;
+	std::size_t _tail_cache;
+	char _pad2[64 - 2 * sizeof(std::size_t)];
+
+};
+
+} } // namespace posixx::linux
+
+
+
+inline
+posixx::linux::queue_base::queue_base() throw ():
+		_closed(0)
+{
+	_not_empty.seq = _not_empty.waiters = 0;
+	_not_full.seq = _not_full.waiters = 0;
+}
+
+inline
+bool posixx::linux::queue_base::closed() const throw ()
+{
+	return __atomic_load_n(&_closed, __ATOMIC_ACQUIRE);
+}
+
+inline
+void posixx::linux::queue_base::close() throw (error)
+{
+	__atomic_store_n(&_closed, 1, __ATOMIC_SEQ_CST);
+	_notify(_not_empty, INT_MAX);
+	_notify(_not_full, INT_MAX);
+}
+
+inline
+uint64_t posixx::linux::queue_base::_deadline(const timespec* timeout)
+		throw ()
+{
+	if (timeout == NULL)
+		return 0;
+	return tsc::monotonic() + static_cast< uint64_t >(timeout->tv_sec)
+			* 1000000000 + timeout->tv_nsec;
+}
+
+inline
+unsigned posixx::linux::queue_base::_spins() throw ()
+{
+	// spinning is useless if the other side can't run meanwhile
+	static unsigned spins = ::sysconf(_SC_NPROCESSORS_ONLN) > 1
+			? SPINS : 0;
+	return spins;
+}
+
+inline
+void posixx::linux::queue_base::_pause() throw ()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#endif
+}
+
+inline
+void posixx::linux::queue_base::_notify(signal& s, int n) throw (error)
+{
+	// pairs with the fence in _prepare(): either the waiter sees the new
+	// state or we see the waiter
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&s.waiters, __ATOMIC_RELAXED) == 0)
+		return;
+	__atomic_add_fetch(&s.seq, 1, __ATOMIC_RELEASE);
+	futex::wake(&s.seq, n, false);
+}
+
+inline
+int posixx::linux::queue_base::_prepare(signal& s) throw ()
+{
+	__atomic_add_fetch(&s.waiters, 1, __ATOMIC_SEQ_CST);
+	int seq = __atomic_load_n(&s.seq, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return seq;
+}
+
+inline
+void posixx::linux::queue_base::_cancel(signal& s) throw ()
+{
+	__atomic_sub_fetch(&s.waiters, 1, __ATOMIC_RELAXED);
+}
+
+inline
+bool posixx::linux::queue_base::_sleep(signal& s, int seq,
+		uint64_t deadline) throw (error)
+{
+	timespec ts;
+	timespec* timeout = NULL;
+	if (deadline) {
+		uint64_t now = tsc::monotonic();
+		if (now >= deadline) {
+			_cancel(s);
+			return false;
+		}
+		ts.tv_sec = (deadline - now) / 1000000000;
+		ts.tv_nsec = (deadline - now) % 1000000000;
+		timeout = &ts;
+	}
+	bool r;
+	try {
+		r = futex::wait(&s.seq, seq, timeout, false);
+	}
+	catch (...) {
+		_cancel(s);
+		throw;
+	}
+	_cancel(s);
+	return r;
+}
+
+template < typename T, posixx::linux::queue_kind K >
+inline
+posixx::linux::queue< T, K >::queue(std::size_t capacity):
+		_mask(0), _tail(0), _head(0)
+{
+	std::size_t c = 1;
+	while (c < capacity)
+		c <<= 1;
+	_cells.resize(c);
+	_mask = c - 1;
+	for (std::size_t i = 0; i < c; ++i)
+		_cells[i].seq = i;
+}
+
+template < typename T, posixx::linux::queue_kind K >
+inline
+bool posixx::linux::queue< T, K >::try_push(const T& v) throw (error)
+{
+	if (closed())
+		return false;
+	std::size_t pos = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+	cell* c;
+	for (;;) {
+		c = &_cells[pos & _mask];
+		std::size_t seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+		intptr_t dif = intptr_t(seq) - intptr_t(pos);
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&_tail, &pos, pos + 1,
+					true, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED))
+				break;
+		}
+		else if (dif < 0)
+			return false; // full
+		else
+			pos = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+	}
+	c->value = v;
+	__atomic_store_n(&c->seq, pos + 1, __ATOMIC_RELEASE);
+	_notify(_not_empty);
+	return true;
+}
+
+template < typename T, posixx::linux::queue_kind K >
+inline
+bool posixx::linux::queue< T, K >::try_pop(T& v) throw (error)
+{
+	std::size_t pos = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+	cell* c;
+	for (;;) {
+		c = &_cells[pos & _mask];
+		std::size_t seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+		intptr_t dif = intptr_t(seq) - intptr_t(pos + 1);
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&_head, &pos, pos + 1,
+					true, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED))
+				break;
+		}
+		else if (dif < 0)
+			return false; // empty
+		else
+			pos = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+	}
+	v = c->value;
+	__atomic_store_n(&c->seq, pos + _mask + 1, __ATOMIC_RELEASE);
+	_notify(_not_full);
+	return true;
+}
+
+template < typename T, posixx::linux::queue_kind K >
+inline
+bool posixx::linux::queue< T, K >::push(const T& v,
+		const timespec* timeout) throw (error)
+{
+	uint64_t deadline = _deadline(timeout);
+	unsigned max_spins = _spins();
+	for (unsigned spins = 0; ; ++spins) {
+		if (try_push(v))
+			return true;
+		if (closed())
+			return false;
+		if (spins < max_spins) {
+			_pause();
+			continue;
+		}
+		int seq = _prepare(_not_full);
+		if (try_push(v)) {
+			_cancel(_not_full);
+			return true;
+		}
+		if (closed()) {
+			_cancel(_not_full);
+			return false;
+		}
+		if (!_sleep(_not_full, seq, deadline))
+			return try_push(v);
+	}
+}
+
+template < typename T, posixx::linux::queue_kind K >
+inline
+bool posixx::linux::queue< T, K >::pop(T& v, const timespec* timeout)
+		throw (error)
+{
+	uint64_t deadline = _deadline(timeout);
+	unsigned max_spins = _spins();
+	for (unsigned spins = 0; ; ++spins) {
+		if (try_pop(v))
+			return true;
+		// elements pushed before closing can still be popped
+		if (closed())
+			return try_pop(v);
+		if (spins < max_spins) {
+			_pause();
+			continue;
+		}
+		int seq = _prepare(_not_empty);
+		if (try_pop(v)) {
+			_cancel(_not_empty);
+			return true;
+		}
+		if (closed()) {
+			_cancel(_not_empty);
+			return try_pop(v);
+		}
+		if (!_sleep(_not_empty, seq, deadline))
+			return try_pop(v);
+	}
+}
+
+template < typename T, posixx::linux::queue_kind K >
+inline
+std::size_t posixx::linux::queue< T, K >::capacity() const throw ()
+{
+	return _mask + 1;
+}
+
+template < typename T, posixx::linux::queue_kind K >
+inline
+std::size_t posixx::linux::queue< T, K >::size() const throw ()
+{
+	std::size_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+	std::size_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+	return tail > head ? tail - head : 0;
+}
+
+template < typename T >
+inline
+posixx::linux::queue< T, posixx::linux::SPSC >::queue(
+		std::size_t capacity):
+		_mask(0), _tail(0), _head_cache(0), _head(0), _tail_cache(0)
+{
+	std::size_t c = 1;
+	while (c < capacity)
+		c <<= 1;
+	_cells.resize(c);
+	_mask = c - 1;
+}
+
+template < typename T >
+inline
+bool posixx::linux::queue< T, posixx::linux::SPSC >::try_push(const T& v)
+		throw (error)
+{
+	if (closed())
+		return false;
+	if (_tail - _head_cache > _mask) {
+		_head_cache = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+		if (_tail - _head_cache > _mask)
+			return false; // full
+	}
+	_cells[_tail & _mask] = v;
+	__atomic_store_n(&_tail, _tail + 1, __ATOMIC_RELEASE);
+	_notify(_not_empty);
+	return true;
+}
+
+template < typename T >
+inline
+bool posixx::linux::queue< T, posixx::linux::SPSC >::try_pop(T& v)
+		throw (error)
+{
+	if (_head == _tail_cache) {
+		_tail_cache = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+		if (_head == _tail_cache)
+			return false; // empty
+	}
+	v = _cells[_head & _mask];
+	__atomic_store_n(&_head, _head + 1, __ATOMIC_RELEASE);
+	_notify(_not_full);
+	return true;
+}
+
+template < typename T >
+inline
+bool posixx::linux::queue< T, posixx::linux::SPSC >::push(const T& v,
+		const timespec* timeout) throw (error)
+{
+	uint64_t deadline = _deadline(timeout);
+	unsigned max_spins = _spins();
+	for (unsigned spins = 0; ; ++spins) {
+		if (try_push(v))
+			return true;
+		if (closed())
+			return false;
+		if (spins < max_spins) {
+			_pause();
+			continue;
+		}
+		int seq = _prepare(_not_full);
+		if (try_push(v)) {
+			_cancel(_not_full);
+			return true;
+		}
+		if (closed()) {
+			_cancel(_not_full);
+			return false;
+		}
+		if (!_sleep(_not_full, seq, deadline))
+			return try_push(v);
+	}
+}
+
+template < typename T >
+inline
+bool posixx::linux::queue< T, posixx::linux::SPSC >::pop(T& v,
+		const timespec* timeout) throw (error)
+{
+	uint64_t deadline = _deadline(timeout);
+	unsigned max_spins = _spins();
+	for (unsigned spins = 0; ; ++spins) {
+		if (try_pop(v))
+			return true;
+		// elements pushed before closing can still be popped
+		if (closed())
+			return try_pop(v);
+		if (spins < max_spins) {
+			_pause();
+			continue;
+		}
+		int seq = _prepare(_not_empty);
+		if (try_pop(v)) {
+			_cancel(_not_empty);
+			return true;
+		}
+		if (closed()) {
+			_cancel(_not_empty);
+			return try_pop(v);
+		}
+		if (!_sleep(_not_empty, seq, deadline))
+			return try_pop(v);
+	}
+}
+
+template < typename T >
+inline
+std::size_t posixx::linux::queue< T, posixx::linux::SPSC >::capacity() const
+		throw ()
+{
+	return _mask + 1;
+}
+
+template < typename T >
+inline
+std::size_t posixx::linux::queue< T, posixx::linux::SPSC >::size() const
+		throw ()
+{
+	std::size_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+	std::size_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+	return tail > head ? tail - head : 0;
+}
+
+#endif // POSIXX_LINUX_QUEUE_HPP_
@@ -0,0 +1,257 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_REACTOR_HPP_
+#define POSIXX_LINUX_REACTOR_HPP_
+
+#include "../error.hpp" // posixx::error
+
+#include <cerrno> // EINTR, EAGAIN
+#include <stdint.h> // uint32_t, uint64_t
+#include <sys/epoll.h> // epoll_*, EPOLL*
+#include <sys/eventfd.h> // eventfd
+#include <unistd.h> // read, write, close
+
+/// @file
+
+namespace posixx { namespace linux {
+
+/**
+ * Single-threaded event loop based on epoll.
+ *
+ * File descriptors are registered with a handler, which is called by
+ * poll() (or run()) when the file descriptor is ready. Everything except
+ * wake() and stop() should be called from the thread running the loop.
+ *
+ * @code
+ * using namespace posixx::linux;
+ * struct echo: reactor::handler {
+ *	void ready(uint32_t events) { ... }
+ * };
+ * reactor r;
+ * echo h;
+ * r.add(sock.fd(), &h);
+ * r.run();
+ * @endcode
+ *
+ * @see epoll(7)
+ */
+struct reactor
+{
+
+	/// Object notified when a file descriptor is ready.
+	struct handler
+	{
+		/**
+		 * Called when the file descriptor is ready.
+		 *
+		 * @param events Combination of EPOLL* flags.
+		 */
+		virtual void ready(uint32_t events) = 0;
+
+		/// Destructor.
+		virtual ~handler();
+	};
+
+	/// Maximum number of events dispatched in each poll() system call.
+	enum { MAX_EVENTS = 64 };
+
+	/// Create a reactor.
+	reactor() throw (error);
+
+	/**
+	 * Register a file descriptor.
+	 *
+	 * @param fd File descriptor.
+	 * @param h Handler to notify (it must outlive the registration).
+	 * @param events Combination of EPOLL* flags to wait for (use
+	 *               EPOLLEXCLUSIVE to share a listening socket among
+	 *               reactors without waking them all up).
+	 */
+	void add(int fd, handler* h, uint32_t events = EPOLLIN) throw (error);
+
+	/// Change the handler or the events of a registered file descriptor.
+	void modify(int fd, handler* h, uint32_t events) throw (error);
+
+	/// Unregister a file descriptor.
+	void remove(int fd) throw (error);
+
+	/**
+	 * Wait for events and dispatch them.
+	 *
+	 * @param timeout Maximum time to wait, in milliseconds (-1 waits
+	 *                forever, 0 doesn't wait at all).
+	 *
+	 * @return Number of events dispatched.
+	 */
+	std::size_t poll(int timeout = -1) throw (error);
+
+	/// Dispatch events until stop() is called.
+	void run() throw (error);
+
+	/// Make run() return (can be called from any thread).
+	void stop() throw (error);
+
+	/// true if stop() was called.
+	bool stopped() const throw ();
+
+	/// Interrupt a blocked poll() (can be called from any thread).
+	void wake() throw (error);
+
+	/// Get the epoll file descriptor.
+	int fd() const throw ();
+
+	/// Destructor.
+	~reactor() throw ();
+
+private:
+
+	// Hidden copy constructor and assign operator
+	reactor(const reactor& r);
+	reactor& operator=(const reactor& r);
+
+	// Consumes the wake() notifications
+	struct waker: handler
+	{
+		int fd;
+		void ready(uint32_t events);
+	};
+
+	int _epfd;
+	waker _waker;
+	int _stopped;
+
+};
+
+} } // namespace posixx::linux
+
+
+
+inline
+posixx::linux::reactor::handler::~handler()
+{
+}
+
+inline
+void posixx::linux::reactor::waker::ready(uint32_t events)
+{
+	uint64_t n;
+	if (::read(fd, &n, sizeof(n)) == -1 && errno != EAGAIN)
+		throw error("reactor wake read");
+}
+
+inline
+posixx::linux::reactor::reactor() throw (error):
+		_stopped(0)
+{
+	_epfd = ::epoll_create1(EPOLL_CLOEXEC);
+	if (_epfd == -1)
+		throw error("epoll_create1");
+	_waker.fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (_waker.fd == -1) {
+		int e = errno;
+		::close(_epfd);
+		errno = e;
+		throw error("eventfd");
+	}
+	try {
+		add(_waker.fd, &_waker);
+	}
+	catch (...) {
+		::close(_waker.fd);
+		::close(_epfd);
+		throw;
+	}
+}
+
+inline
+void posixx::linux::reactor::add(int fd, handler* h, uint32_t events)
+		throw (error)
+{
+	epoll_event ev;
+	ev.events = events;
+	ev.data.ptr = h;
+	if (::epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+		throw error("epoll_ctl add");
+}
+
+inline
+void posixx::linux::reactor::modify(int fd, handler* h, uint32_t events)
+		throw (error)
+{
+	epoll_event ev;
+	ev.events = events;
+	ev.data.ptr = h;
+	if (::epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &ev) == -1)
+		throw error("epoll_ctl mod");
+}
+
+inline
+void posixx::linux::reactor::remove(int fd) throw (error)
+{
+	epoll_event ev; // ignored, but needed by old kernels
+	if (::epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, &ev) == -1)
+		throw error("epoll_ctl del");
+}
+
+inline
+std::size_t posixx::linux::reactor::poll(int timeout) throw (error)
+{
+	epoll_event events[MAX_EVENTS];
+	int n = ::epoll_wait(_epfd, events, MAX_EVENTS, timeout);
+	if (n == -1) {
+		if (errno == EINTR)
+			return 0;
+		throw error("epoll_wait");
+	}
+	for (int i = 0; i < n; ++i)
+		static_cast< handler* >(events[i].data.ptr)->ready(
+				events[i].events);
+	return n;
+}
+
+inline
+void posixx::linux::reactor::run() throw (error)
+{
+	while (!stopped())
+		poll();
+}
+
+inline
+void posixx::linux::reactor::stop() throw (error)
+{
+	__atomic_store_n(&_stopped, 1, __ATOMIC_RELEASE);
+	wake();
+}
+
+inline
+bool posixx::linux::reactor::stopped() const throw ()
+{
+	return __atomic_load_n(&_stopped, __ATOMIC_ACQUIRE);
+}
+
+inline
+void posixx::linux::reactor::wake() throw (error)
+{
+	uint64_t one = 1;
+	if (::write(_waker.fd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+		throw error("reactor wake write");
+}
+
+inline
+int posixx::linux::reactor::fd() const throw ()
+{
+	return _epfd;
+}
+
+inline
+posixx::linux::reactor::~reactor() throw ()
+{
+	::close(_waker.fd);
+	::close(_epfd);
+}
+
+#endif // POSIXX_LINUX_REACTOR_HPP_
@@ -0,0 +1,448 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_RUNTIME_HPP_
+#define POSIXX_LINUX_RUNTIME_HPP_
+
+#include "../error.hpp" // posixx::error
+#include "../buffer_pool.hpp" // posixx::buffer_pool
+#include "../socket/basic_socket.hpp" // posixx::socket::type, STREAM
+#include "../socket/opt.hpp" // REUSEADDR, REUSEPORT
+#include "reactor.hpp" // posixx::linux::reactor
+#include "channel.hpp" // posixx::linux::channel
+#include "thread.hpp" // available_cpus, start_thread
+
+#include <vector> // std::vector
+#include <memory> // std::auto_ptr
+#include <exception> // std::exception
+#include <cerrno> // errno, EINVAL
+#include <pthread.h> // pthread_t, pthread_join
+
+/// @file
+
+namespace posixx { namespace linux {
+
+struct runtime;
+
+/**
+ * Per-thread state of a runtime.
+ *
+ * Everything in a shard is owned by its thread, so it can be used without
+ * any locking. The only way to interact with another shard is by posting
+ * a message to it (see post()).
+ */
+struct shard
+{
+
+	/// Function run in a shard thread.
+	typedef void (*task)(shard& s, void* arg);
+
+	/// Message sent between shards.
+	struct message
+	{
+		/// Function to run in the receiving shard.
+		task fn;
+		/// Argument for the function.
+		void* arg;
+	};
+
+	/// Index of this shard in the runtime.
+	unsigned id() const throw ();
+
+	/// CPU where this shard thread runs (-1 if not pinned).
+	int cpu() const throw ();
+
+	/// Runtime this shard belongs to.
+	runtime& owner() throw ();
+
+	/// Event loop of this shard.
+	reactor& loop() throw ();
+
+	/// Buffers of this shard.
+	buffer_pool<>& buffers() throw ();
+
+	/**
+	 * Run a function in another shard.
+	 *
+	 * @return false if the other shard inbox is full.
+	 *
+	 * @see runtime::post()
+	 */
+	bool post(unsigned to, task fn, void* arg) throw (error);
+
+private:
+
+	friend struct runtime;
+
+	// Runs the messages received by the shard
+	struct inbox: channel< message >
+	{
+		shard& owner;
+		inbox(shard& s, std::size_t capacity);
+		void received(message& msg);
+	};
+
+	shard(runtime& rt, unsigned id, int cpu, std::size_t inbox_size,
+			std::size_t buffer_size);
+
+	// Hidden copy constructor and assign operator
+	shard(const shard& s);
+	shard& operator=(const shard& s);
+
+	static void* _main(void* arg);
+
+	// Stop the whole runtime after a failure
+	void _stop_all() throw ();
+
+	runtime& _runtime;
+	unsigned _id;
+	int _cpu;
+	reactor _reactor;
+	buffer_pool<> _buffers;
+	inbox _inbox;
+	pthread_t _thread;
+	std::auto_ptr< error > _error;
+
+};
+
+/**
+ * Thread-per-core runtime.
+ *
+ * A runtime starts one thread per CPU, pinned to it, each with its own
+ * shard: a reactor, a buffer pool and an inbox to receive messages from
+ * the other shards. This share-nothing design avoids any cross-core
+ * contention, as long as each connection is handled entirely by one shard.
+ *
+ * To spread connections among shards, each shard should create its own
+ * listening socket with listener(), which uses SO_REUSEPORT so the kernel
+ * balances the incoming connections.
+ *
+ * @code
+ * void init(posixx::linux::shard& s, void* arg)
+ * {
+ *	inet::socket* l = posixx::linux::listener< inet::socket >(
+ *			inet::sockaddr(inet::any, 8080));
+ *	s.loop().add(l->fd(), new acceptor(s, l));
+ * }
+ * posixx::linux::runtime rt;
+ * rt.start(&init, NULL);
+ * rt.join();
+ * @endcode
+ */
+struct runtime
+{
+
+	/// Runtime configuration.
+	struct config
+	{
+		/// Number of shards (0 means one per CPU available).
+		unsigned threads;
+		/// Pin each shard thread to a CPU.
+		bool pin;
+		/// Capacity of the shards inboxes.
+		std::size_t inbox;
+		/// Size of the shards buffers.
+		std::size_t buffer_size;
+		/// Create a default configuration.
+		config() throw ();
+	};
+
+	/// Create the shards (but don't start them).
+	explicit runtime(const config& c = config()) throw (error);
+
+	/**
+	 * Start the shard threads.
+	 *
+	 * @param init Function to run first in each shard (before running its
+	 *             reactor), usually to create its listener.
+	 * @param arg Argument for init.
+	 */
+	void start(shard::task init, void* arg) throw (error);
+
+	/**
+	 * Run a function in a shard (can be called from any thread).
+	 *
+	 * @return false if the shard inbox is full.
+	 */
+	bool post(unsigned to, shard::task fn, void* arg) throw (error);
+
+	/// Stop all the shards (can be called from any thread).
+	void stop() throw (error);
+
+	/**
+	 * Wait for all the shard threads to finish.
+	 *
+	 * If a shard thread failed with an exception, it's re-thrown here
+	 * (if more than one failed, only the first one is thrown). A failing
+	 * shard stops the whole runtime, so this doesn't wait for the rest
+	 * of the shards to be stopped by other means.
+	 */
+	void join() throw (error);
+
+	/// Number of shards.
+	std::size_t size() const throw ();
+
+	/// Get a shard.
+	shard& operator[](std::size_t i) throw ();
+
+	/// Destructor (stops and joins the shard threads if running).
+	~runtime() throw ();
+
+private:
+
+	friend struct shard;
+
+	// Hidden copy constructor and assign operator
+	runtime(const runtime& r);
+	runtime& operator=(const runtime& r);
+
+	std::vector< shard* > _shards;
+	shard::task _init;
+	void* _arg;
+	bool _started;
+
+};
+
+/**
+ * Create a listening socket that can be shared among shards.
+ *
+ * SO_REUSEPORT is set, so each shard can bind its own listener to the
+ * same address and the kernel balances the connections among them.
+ *
+ * @note Unix sockets can't bind the same path more than once. To share a
+ *       unix listener, create it only once and add it to the reactor of
+ *       each shard with EPOLLIN | EPOLLEXCLUSIVE, so only one shard is
+ *       woken up for each connection.
+ *
+ * @param addr Address to listen on.
+ * @param type Type of the socket.
+ * @param backlog Maximum length of the queue of pending connections.
+ *
+ * @return A new socket (the caller owns it).
+ */
+template < typename TSock >
+TSock* listener(const typename TSock::traits::sockaddr& addr,
+		socket::type type = socket::STREAM, int backlog = 128)
+		throw (error);
+
+} } // namespace posixx::linux
+
+
+
+inline
+posixx::linux::shard::inbox::inbox(shard& s, std::size_t capacity):
+		channel< message >(s._reactor, capacity), owner(s)
+{
+}
+
+inline
+void posixx::linux::shard::inbox::received(message& msg)
+{
+	msg.fn(owner, msg.arg);
+}
+
+inline
+posixx::linux::shard::shard(runtime& rt, unsigned id, int cpu,
+		std::size_t inbox_size, std::size_t buffer_size):
+		_runtime(rt), _id(id), _cpu(cpu), _buffers(buffer_size),
+		_inbox(*this, inbox_size)
+{
+}
+
+inline
+unsigned posixx::linux::shard::id() const throw ()
+{
+	return _id;
+}
+
+inline
+int posixx::linux::shard::cpu() const throw ()
+{
+	return _cpu;
+}
+
+inline
+posixx::linux::runtime& posixx::linux::shard::owner() throw ()
+{
+	return _runtime;
+}
+
+inline
+posixx::linux::reactor& posixx::linux::shard::loop() throw ()
+{
+	return _reactor;
+}
+
+inline
+posixx::buffer_pool<>& posixx::linux::shard::buffers() throw ()
+{
+	return _buffers;
+}
+
+inline
+bool posixx::linux::shard::post(unsigned to, task fn, void* arg)
+		throw (error)
+{
+	return _runtime.post(to, fn, arg);
+}
+
+inline
+void* posixx::linux::shard::_main(void* arg)
+{
+	shard& s = *static_cast< shard* >(arg);
+	try {
+		if (s._runtime._init)
+			s._runtime._init(s, s._runtime._arg);
+		s._reactor.run();
+	}
+	catch (const error& e) {
+		s._error.reset(new error(e));
+		s._stop_all();
+	}
+	catch (const std::exception& e) {
+		errno = 0;
+		s._error.reset(new error(e.what()));
+		s._stop_all();
+	}
+	return NULL;
+}
+
+inline
+void posixx::linux::shard::_stop_all() throw ()
+{
+	// the other shards would keep join() waiting for them forever
+	try {
+		_runtime.stop();
+	}
+	catch (...) {
+		// the error that got us here is the one to report
+	}
+}
+
+inline
+posixx::linux::runtime::config::config() throw ():
+		threads(0), pin(true), inbox(1024), buffer_size(65536)
+{
+}
+
+inline
+posixx::linux::runtime::runtime(const config& c) throw (error):
+		_init(NULL), _arg(NULL), _started(false)
+{
+	std::vector< int > cpus = available_cpus();
+	unsigned n = c.threads ? c.threads : cpus.size();
+	try {
+		for (unsigned i = 0; i < n; ++i)
+			_shards.push_back(new shard(*this, i,
+					c.pin ? cpus[i % cpus.size()] : -1,
+					c.inbox, c.buffer_size));
+	}
+	catch (...) {
+		for (std::size_t i = 0; i < _shards.size(); ++i)
+			delete _shards[i];
+		throw;
+	}
+}
+
+inline
+void posixx::linux::runtime::start(shard::task init, void* arg)
+		throw (error)
+{
+	_init = init;
+	_arg = arg;
+	for (std::size_t i = 0; i < _shards.size(); ++i) {
+		shard& s = *_shards[i];
+		try {
+			start_thread(s._thread, &shard::_main, &s, s._cpu);
+		}
+		catch (...) {
+			// the started shards must not outlive the runtime
+			for (std::size_t j = 0; j < i; ++j) {
+				_shards[j]->_reactor.stop();
+				::pthread_join(_shards[j]->_thread, NULL);
+			}
+			throw;
+		}
+	}
+	_started = true;
+}
+
+inline
+bool posixx::linux::runtime::post(unsigned to, shard::task fn, void* arg)
+		throw (error)
+{
+	if (to >= _shards.size()) {
+		errno = EINVAL;
+		throw error("runtime post");
+	}
+	shard::message msg;
+	msg.fn = fn;
+	msg.arg = arg;
+	return _shards[to]->_inbox.send(msg);
+}
+
+inline
+void posixx::linux::runtime::stop() throw (error)
+{
+	for (std::size_t i = 0; i < _shards.size(); ++i)
+		_shards[i]->_reactor.stop();
+}
+
+inline
+void posixx::linux::runtime::join() throw (error)
+{
+	if (!_started)
+		return;
+	for (std::size_t i = 0; i < _shards.size(); ++i)
+		::pthread_join(_shards[i]->_thread, NULL);
+	_started = false;
+	for (std::size_t i = 0; i < _shards.size(); ++i)
+		if (_shards[i]->_error.get())
+			throw error(*_shards[i]->_error);
+}
+
+inline
+std::size_t posixx::linux::runtime::size() const throw ()
+{
+	return _shards.size();
+}
+
+inline
+posixx::linux::shard& posixx::linux::runtime::operator[](std::size_t i)
+		throw ()
+{
+	return *_shards[i];
+}
+
+inline
+posixx::linux::runtime::~runtime() throw ()
+{
+	if (_started) {
+		try {
+			stop();
+			join();
+		}
+		catch (...) {
+		}
+	}
+	for (std::size_t i = 0; i < _shards.size(); ++i)
+		delete _shards[i];
+}
+
+template < typename TSock >
+inline
+TSock* posixx::linux::listener(const typename TSock::traits::sockaddr& addr,
+		socket::type type, int backlog) throw (error)
+{
+	std::auto_ptr< TSock > s(new TSock(type));
+	s->template opt< socket::opt::REUSEADDR >(1);
+	s->template opt< socket::opt::REUSEPORT >(1);
+	s->bind(addr);
+	s->listen(backlog);
+	return s.release();
+}
+
+#endif // POSIXX_LINUX_RUNTIME_HPP_
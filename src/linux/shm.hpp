@@ -0,0 +1,453 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_SHM_HPP_
+#define POSIXX_LINUX_SHM_HPP_
+
+#include "../error.hpp" // posixx::error
+#include "shm/ring.hpp" // posixx::linux::shm::ring
+
+#include <string> // std::string
+#include <utility> // std::pair
+#include <cerrno> // EAGAIN, EINVAL, EMSGSIZE
+#include <fcntl.h> // O_* constants
+#include <sys/mman.h> // mmap, munmap, memfd_create, shm_open, shm_unlink
+#include <sys/stat.h> // fstat
+#include <sys/socket.h> // MSG_DONTWAIT, MSG_NOSIGNAL, MSG_WAITALL
+#include <unistd.h> // ftruncate, close
+
+/// @file
+
+namespace posixx { namespace linux { namespace shm {
+
+/// Side of a shared memory socket.
+enum side_t
+{
+	/// The side that created the shared memory.
+	SIDE_A,
+	/// The side that attached to it.
+	SIDE_B
+};
+
+/**
+ * Message socket over shared memory.
+ *
+ * A socket is a pair of rings (one for each direction) in a shared memory
+ * region, backed by a memfd (anonymous, its file descriptor can be passed
+ * to another process) or a POSIX shared memory object (named). Messages
+ * are transferred without system calls unless the receiver is sleeping.
+ *
+ * The API mirrors posixx::socket::basic_socket (send(), recv(),
+ * send_struct() and recv_struct() with the same signatures and error
+ * reporting), so code templated on the socket type can use either.
+ * Messages are never split, like in a SEQPACKET socket. The only flag
+ * honored is MSG_DONTWAIT, which makes send() and recv() throw an error
+ * with errno EAGAIN instead of blocking. When the peer closes the socket,
+ * recv() throws an error with errno 0 once all the messages are read
+ * (just like basic_socket::recv() does on an orderly shutdown) and send()
+ * throws an error with errno EPIPE.
+ *
+ * With MULTI_PRODUCER, the ring from SIDE_B to SIDE_A accepts many
+ * producers, so many processes can attach as SIDE_B and send messages to
+ * a single SIDE_A. Only one of them can receive, though, and closing a
+ * SIDE_B socket doesn't close the socket for the others.
+ *
+ * @code
+ * using namespace posixx::linux;
+ * shm::socket a(1 << 20);
+ * // pass a.fd() to another process, which does:
+ * shm::socket b(fd, shm::SIDE_B);
+ * b.send("hello", 5);
+ * // back in the first process
+ * ssize_t n = a.recv(buf, sizeof(buf));
+ * @endcode
+ */
+struct socket
+{
+
+	/// Default capacity of each ring.
+	enum { DEFAULT_CAPACITY = 65536 };
+
+	/**
+	 * Create an anonymous (memfd backed) socket, as SIDE_A.
+	 *
+	 * @param capacity Capacity of each ring (see ring::round()).
+	 * @param producers Producers of the SIDE_B to SIDE_A ring.
+	 */
+	explicit socket(std::size_t capacity = DEFAULT_CAPACITY,
+			producers_t producers = SINGLE_PRODUCER) throw (error);
+
+	/**
+	 * Create a named (POSIX shared memory backed) socket, as SIDE_A.
+	 *
+	 * The name should start with a slash (see shm_open(3)). It's an
+	 * error if the name already exists, use unlink() to remove it.
+	 *
+	 * @param name Shared memory object name.
+	 * @param capacity Capacity of each ring (see ring::round()).
+	 * @param producers Producers of the SIDE_B to SIDE_A ring.
+	 */
+	socket(const std::string& name, std::size_t capacity,
+			producers_t producers = SINGLE_PRODUCER) throw (error);
+
+	/// Attach to a named socket created by another process, as SIDE_B.
+	explicit socket(const std::string& name) throw (error);
+
+	/**
+	 * Attach to a socket using a file descriptor.
+	 *
+	 * This takes "ownership" of the file descriptor (it's closed by the
+	 * destructor).
+	 *
+	 * @param fd File descriptor of the shared memory (see fd()).
+	 * @param side Side to attach as.
+	 */
+	socket(int fd, side_t side) throw (error);
+
+	/// Remove a named socket (attached sockets are not affected).
+	static void unlink(const std::string& name) throw (error);
+
+	/**
+	 * Send a message.
+	 *
+	 * @param buf Message buffer.
+	 * @param n Message length.
+	 * @param flags Sending options (only MSG_DONTWAIT is used).
+	 *
+	 * @return The number of characters sent (always n).
+	 */
+	ssize_t send(const void* buf, size_t n, int flags = 0) throw (error);
+
+	/**
+	 * Receive a message.
+	 *
+	 * If the message is bigger than n, it's truncated.
+	 *
+	 * @param buf Message buffer.
+	 * @param n Maximum message length.
+	 * @param flags Receiving options (only MSG_DONTWAIT is used).
+	 *
+	 * @return The number of characters received.
+	 */
+	ssize_t recv(void* buf, size_t n, int flags = 0) throw (error);
+
+	/**
+	 * Send a struct as a message.
+	 *
+	 * @see basic_socket::send_struct()
+	 */
+	template< typename TPacket >
+	void send_struct(const TPacket& packet, int flags = MSG_NOSIGNAL)
+			throw (error);
+
+	/**
+	 * Receive a message in a struct.
+	 *
+	 * @throw error with errno EMSGSIZE if the message size is not
+	 *        sizeof(TPacket).
+	 *
+	 * @see basic_socket::recv_struct()
+	 */
+	template< typename TPacket >
+	void recv_struct(TPacket& packet,
+			int flags = MSG_NOSIGNAL | MSG_WAITALL) throw (error);
+
+	/**
+	 * Close the socket.
+	 *
+	 * The peer can still read the messages already sent.
+	 */
+	void close() throw (error);
+
+	/// Get the shared memory file descriptor.
+	int fd() const throw ();
+
+	/// Get the side of the socket.
+	side_t side() const throw ();
+
+	/// Get the maximum message size.
+	std::size_t max_message() const throw ();
+
+	/// Destructor (closes the socket).
+	~socket() throw ();
+
+private:
+
+	// Hidden copy constructor and assign operator
+	socket(const socket& s);
+	socket& operator=(const socket& s);
+
+	// Initialize a new shared memory region
+	void _create(std::size_t capacity, producers_t producers)
+			throw (error);
+
+	// Map the shared memory region and attach to the rings
+	void _attach() throw (error);
+
+	int _fd;
+	side_t _side;
+	void* _mem;
+	std::size_t _size;
+	// rings are attached lazily, after the memory is mapped
+	ring* _tx;
+	ring* _rx;
+
+};
+
+/**
+ * Create a pair of connected shared memory sockets.
+ *
+ * @param capacity Capacity of each ring (see ring::round()).
+ *
+ * @return The new connected pair of sockets.
+ */
+std::pair< socket*, socket* > pair(
+		std::size_t capacity = socket::DEFAULT_CAPACITY) throw (error);
+
+} } } // namespace posixx::linux::shm
+
+
+
+inline
+void posixx::linux::shm::socket::_create(std::size_t capacity,
+		producers_t producers) throw (error)
+{
+	capacity = ring::round(capacity);
+	std::size_t rs = ring::size(capacity);
+	if (::ftruncate(_fd, 2 * rs) == -1) {
+		int e = errno;
+		::close(_fd);
+		errno = e;
+		throw error("shm ftruncate");
+	}
+	void* m = ::mmap(NULL, 2 * rs, PROT_READ | PROT_WRITE, MAP_SHARED,
+			_fd, 0);
+	if (m == MAP_FAILED) {
+		int e = errno;
+		::close(_fd);
+		errno = e;
+		throw error("shm mmap");
+	}
+	// the first ring goes from A to B, the second from B to A
+	ring::init(m, capacity, SINGLE_PRODUCER);
+	ring::init(static_cast< char* >(m) + rs, capacity, producers);
+	::munmap(m, 2 * rs);
+	_attach();
+}
+
+inline
+void posixx::linux::shm::socket::_attach() throw (error)
+{
+	struct stat st;
+	if (::fstat(_fd, &st) == -1) {
+		int e = errno;
+		::close(_fd);
+		errno = e;
+		throw error("shm fstat");
+	}
+	_size = st.st_size;
+	_mem = ::mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd,
+			0);
+	if (_mem == MAP_FAILED) {
+		int e = errno;
+		::close(_fd);
+		errno = e;
+		throw error("shm mmap");
+	}
+	try {
+		ring a(_mem);
+		if (_size != 2 * ring::size(a.capacity())) {
+			errno = EINVAL;
+			throw error("shm size");
+		}
+		ring b(static_cast< char* >(_mem) + _size / 2);
+		_tx = new ring(_side == SIDE_A ? a : b);
+		_rx = new ring(_side == SIDE_A ? b : a);
+	}
+	catch (...) {
+		int e = errno;
+		::munmap(_mem, _size);
+		::close(_fd);
+		errno = e;
+		throw;
+	}
+}
+
+inline
+posixx::linux::shm::socket::socket(std::size_t capacity,
+		producers_t producers) throw (error):
+		_fd(::memfd_create("posixx-shm", MFD_CLOEXEC)),
+		_side(SIDE_A), _mem(NULL), _size(0), _tx(NULL), _rx(NULL)
+{
+	if (_fd == -1)
+		throw error("memfd_create");
+	_create(capacity, producers);
+}
+
+inline
+posixx::linux::shm::socket::socket(const std::string& name,
+		std::size_t capacity, producers_t producers) throw (error):
+		_fd(::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600)),
+		_side(SIDE_A), _mem(NULL), _size(0), _tx(NULL), _rx(NULL)
+{
+	if (_fd == -1)
+		throw error("shm_open " + name);
+	_create(capacity, producers);
+}
+
+inline
+posixx::linux::shm::socket::socket(const std::string& name) throw (error):
+		_fd(::shm_open(name.c_str(), O_RDWR, 0)),
+		_side(SIDE_B), _mem(NULL), _size(0), _tx(NULL), _rx(NULL)
+{
+	if (_fd == -1)
+		throw error("shm_open " + name);
+	_attach();
+}
+
+inline
+posixx::linux::shm::socket::socket(int fd, side_t side) throw (error):
+		_fd(fd), _side(side), _mem(NULL), _size(0), _tx(NULL),
+		_rx(NULL)
+{
+	_attach();
+}
+
+inline
+void posixx::linux::shm::socket::unlink(const std::string& name)
+		throw (error)
+{
+	if (::shm_unlink(name.c_str()) == -1)
+		throw error("shm_unlink " + name);
+}
+
+inline
+ssize_t posixx::linux::shm::socket::send(const void* buf, size_t n,
+		int flags) throw (error)
+{
+	if (flags & MSG_DONTWAIT) {
+		if (!_tx->try_write(buf, n)) {
+			errno = EAGAIN;
+			throw error("shm send");
+		}
+	}
+	else
+		_tx->write(buf, n);
+	return n;
+}
+
+inline
+ssize_t posixx::linux::shm::socket::recv(void* buf, size_t n, int flags)
+		throw (error)
+{
+	ssize_t s;
+	try {
+		s = (flags & MSG_DONTWAIT) ? _rx->try_read(buf, n)
+				: _rx->read(buf, n);
+	}
+	catch (const error& e) {
+		if (e.no != EPIPE)
+			throw;
+		error e2("shm recv peer closed");
+		e2.no = 0;
+		throw e2;
+	}
+	if (s == -1) {
+		errno = EAGAIN;
+		throw error("shm recv");
+	}
+	return s;
+}
+
+template< typename TPacket >
+inline
+void posixx::linux::shm::socket::send_struct(const TPacket& packet,
+		int flags) throw (error)
+{
+	send(&packet, sizeof(TPacket), flags);
+}
+
+template< typename TPacket >
+inline
+void posixx::linux::shm::socket::recv_struct(TPacket& packet, int flags)
+		throw (error)
+{
+	if (static_cast< std::size_t >(recv(&packet, sizeof(TPacket), flags))
+			!= sizeof(TPacket)) {
+		errno = EMSGSIZE;
+		throw error("recv size not match");
+	}
+}
+
+inline
+void posixx::linux::shm::socket::close() throw (error)
+{
+	if (_fd == -1)
+		return;
+	// one of many producers leaving doesn't close the socket
+	if (_side == SIDE_A || _tx->producers() == SINGLE_PRODUCER) {
+		_tx->close();
+		_rx->close();
+	}
+	delete _tx;
+	delete _rx;
+	_tx = _rx = NULL;
+	::munmap(_mem, _size);
+	int fd = _fd;
+	_fd = -1;
+	if (::close(fd) == -1)
+		throw error("close");
+}
+
+inline
+int posixx::linux::shm::socket::fd() const throw ()
+{
+	return _fd;
+}
+
+inline
+posixx::linux::shm::side_t posixx::linux::shm::socket::side() const
+		throw ()
+{
+	return _side;
+}
+
+inline
+std::size_t posixx::linux::shm::socket::max_message() const throw ()
+{
+	return _tx->max_message();
+}
+
+inline
+posixx::linux::shm::socket::~socket() throw ()
+{
+	try {
+		close();
+	}
+	catch (...) {
+	}
+}
+
+inline
+std::pair< posixx::linux::shm::socket*, posixx::linux::shm::socket* >
+posixx::linux::shm::pair(std::size_t capacity) throw (error)
+{
+	socket* a = new socket(capacity);
+	int fd = ::dup(a->fd());
+	if (fd == -1) {
+		delete a;
+		throw error("dup");
+	}
+	try {
+		return std::make_pair(a, new socket(fd, SIDE_B));
+	}
+	catch (...) {
+		delete a;
+		throw;
+	}
+}
+
+#endif // POSIXX_LINUX_SHM_HPP_
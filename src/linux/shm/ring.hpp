@@ -0,0 +1,515 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_SHM_RING_HPP_
+#define POSIXX_LINUX_SHM_RING_HPP_
+
+#include "../../error.hpp" // posixx::error
+#include "../futex.hpp" // posixx::linux::futex
+
+#include <cstring> // std::memcpy
+#include <cerrno> // EINVAL, EMSGSIZE, EAGAIN, EPIPE, ETIMEDOUT
+#include <stdint.h> // uint32_t, uint64_t
+#include <sys/types.h> // ssize_t
+#include <time.h> // timespec
+
+/// @file
+
+namespace posixx { namespace linux {
+
+/// Shared memory transport.
+namespace shm {
+
+/// Number of processes (or threads) that can write to a ring.
+enum producers_t
+{
+	/// Only one producer (lock-free).
+	SINGLE_PRODUCER,
+	/// Many producers (serialized with a futex based lock).
+	MULTI_PRODUCER
+};
+
+/**
+ * Message ring in shared memory.
+ *
+ * The ring is a circular buffer of variable size messages, laid out in a
+ * memory region that can be shared between processes (see init()). The
+ * ring object itself only keeps process-local caches, so every process
+ * (or thread) using the ring should have its own ring object attached to
+ * the same memory.
+ *
+ * There can be only one consumer. With SINGLE_PRODUCER there can be only
+ * one producer too, and the ring is completely lock-free (writes and
+ * reads only need an atomic store to publish the new positions). With
+ * MULTI_PRODUCER, producers are serialized with a lock in the shared
+ * memory, held only while the message is copied. A producer dying while
+ * holding the lock blocks the other producers.
+ *
+ * When the ring is empty (or full), blocking reads (or writes) spin for a
+ * while and then sleep on a futex. The other side only makes the futex
+ * system call if someone is actually sleeping, so in the common case a
+ * message is transferred without any system call.
+ *
+ * Each message is stored with an 8 bytes header and padded to 8 bytes, so
+ * the maximum message size is the capacity minus 8 bytes.
+ */
+struct ring
+{
+
+	/// Shared state (it's followed by the data in the shared memory).
+	struct header
+	{
+		uint32_t magic;
+		uint32_t producers;
+		uint64_t capacity;
+		uint32_t closed;
+		char _pad0[64 - 20];
+		// written by the producers
+		uint64_t head;
+		int data_seq;
+		int consumer_waiting;
+		char _pad1[64 - 16];
+		// written by the consumer
+		uint64_t tail;
+		int space_seq;
+		int producers_waiting;
+		char _pad2[64 - 16];
+		// producers lock (0 free, 1 locked, 2 locked with waiters)
+		int lock;
+		char _pad3[64 - 4];
+	};
+
+	/// Minimum capacity.
+	enum { MIN_CAPACITY = 4096 };
+
+	/**
+	 * Round a capacity up to a valid one (a power of 2 and at least
+	 * MIN_CAPACITY).
+	 */
+	static std::size_t round(std::size_t capacity) throw ();
+
+	/// Bytes of memory needed for a ring of the given (valid) capacity.
+	static std::size_t size(std::size_t capacity) throw ();
+
+	/**
+	 * Initialize a ring in a memory region.
+	 *
+	 * @param mem Memory region (at least size(capacity) bytes, aligned to
+	 *            64 bytes).
+	 * @param capacity Data capacity (see round()).
+	 * @param producers Number of producers.
+	 */
+	static void init(void* mem, std::size_t capacity,
+			producers_t producers = SINGLE_PRODUCER) throw ();
+
+	/**
+	 * Attach to a ring initialized with init().
+	 *
+	 * @throw error with errno EINVAL if the memory doesn't have a ring.
+	 */
+	explicit ring(void* mem) throw (error);
+
+	/**
+	 * Write a message, without blocking.
+	 *
+	 * @return false if there is no space left.
+	 *
+	 * @throw error with errno EMSGSIZE if the message is too big, or
+	 *        EPIPE if the ring was closed.
+	 */
+	bool try_write(const void* buf, std::size_t n) throw (error);
+
+	/**
+	 * Write a message, waiting for space if needed.
+	 *
+	 * @param buf Message buffer.
+	 * @param n Message length.
+	 * @param timeout Relative timeout (NULL to wait forever).
+	 *
+	 * @return false if the timeout expired.
+	 */
+	bool write(const void* buf, std::size_t n,
+			const timespec* timeout = NULL) throw (error);
+
+	/**
+	 * Read a message, without blocking.
+	 *
+	 * If the message is bigger than n, it's truncated.
+	 *
+	 * @return The number of characters copied to buf, or -1 if the ring
+	 *         is empty.
+	 *
+	 * @throw error with errno EPIPE if the ring is empty and was
+	 *        closed.
+	 */
+	ssize_t try_read(void* buf, std::size_t n) throw (error);
+
+	/**
+	 * Read a message, waiting for one if needed.
+	 *
+	 * @return The number of characters copied to buf, or -1 if the
+	 *         timeout expired.
+	 */
+	ssize_t read(void* buf, std::size_t n, const timespec* timeout = NULL)
+			throw (error);
+
+	/// Close the ring (readers get EPIPE once it's empty, writers always).
+	void close() throw (error);
+
+	/// true if the ring was closed.
+	bool closed() const throw ();
+
+	/// Get the number of producers.
+	producers_t producers() const throw ();
+
+	/// Get the data capacity.
+	std::size_t capacity() const throw ();
+
+	/// Get the maximum message size.
+	std::size_t max_message() const throw ();
+
+	/// Number of bytes used (messages, headers and padding).
+	std::size_t used() const throw ();
+
+private:
+
+	// Magic number to recognize initialized rings ("PXRG")
+	enum { MAGIC = 0x50585247 };
+
+	// Header of a message in the ring
+	enum { MSG_HEADER = 8 };
+
+	// Length of the wrap marker (the rest of the ring is padding)
+	enum { WRAP = 0xffffffff };
+
+	// Spins before sleeping on a futex
+	enum { SPINS = 256 };
+
+	static std::size_t _align(std::size_t n) throw ();
+	void _lock() throw (error);
+	void _unlock() throw (error);
+	bool _write(const void* buf, std::size_t n) throw (error);
+	void _notify(int* seq, int* waiting) throw (error);
+	static void _pause() throw ();
+
+	header* _hdr;
+	unsigned char* _data;
+	uint64_t _mask;
+	// cached positions of the other side (always behind the real ones)
+	uint64_t _head;
+	uint64_t _tail;
+
+};
+
+} } } // namespace posixx::linux::shm
+
+
+
+inline
+std::size_t posixx::linux::shm::ring::round(std::size_t capacity) throw ()
+{
+	std::size_t c = MIN_CAPACITY;
+	while (c < capacity)
+		c <<= 1;
+	return c;
+}
+
+inline
+std::size_t posixx::linux::shm::ring::size(std::size_t capacity) throw ()
+{
+	return sizeof(header) + capacity;
+}
+
+inline
+void posixx::linux::shm::ring::init(void* mem, std::size_t capacity,
+		producers_t producers) throw ()
+{
+	header* h = static_cast< header* >(mem);
+	std::memset(h, 0, sizeof(header));
+	h->producers = producers;
+	h->capacity = capacity;
+	__atomic_store_n(&h->magic, uint32_t(MAGIC), __ATOMIC_RELEASE);
+}
+
+inline
+posixx::linux::shm::ring::ring(void* mem) throw (error):
+		_hdr(static_cast< header* >(mem)),
+		_data(static_cast< unsigned char* >(mem) + sizeof(header)),
+		_mask(0), _head(0), _tail(0)
+{
+	if (__atomic_load_n(&_hdr->magic, __ATOMIC_ACQUIRE) != MAGIC) {
+		errno = EINVAL;
+		throw error("shm ring");
+	}
+	_mask = _hdr->capacity - 1;
+	_head = __atomic_load_n(&_hdr->head, __ATOMIC_ACQUIRE);
+	_tail = __atomic_load_n(&_hdr->tail, __ATOMIC_ACQUIRE);
+}
+
+inline
+std::size_t posixx::linux::shm::ring::_align(std::size_t n) throw ()
+{
+	return (n + 7) & ~std::size_t(7);
+}
+
+inline
+void posixx::linux::shm::ring::_pause() throw ()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#endif
+}
+
+inline
+void posixx::linux::shm::ring::_lock() throw (error)
+{
+	int c = 0;
+	for (int i = 0; i < SPINS; ++i) {
+		c = 0;
+		if (__atomic_compare_exchange_n(&_hdr->lock, &c, 1, false,
+				__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return;
+		_pause();
+	}
+	if (c != 2)
+		c = __atomic_exchange_n(&_hdr->lock, 2, __ATOMIC_ACQUIRE);
+	while (c != 0) {
+		futex::wait(&_hdr->lock, 2);
+		c = __atomic_exchange_n(&_hdr->lock, 2, __ATOMIC_ACQUIRE);
+	}
+}
+
+inline
+void posixx::linux::shm::ring::_unlock() throw (error)
+{
+	if (__atomic_fetch_sub(&_hdr->lock, 1, __ATOMIC_RELEASE) != 1) {
+		__atomic_store_n(&_hdr->lock, 0, __ATOMIC_RELEASE);
+		futex::wake(&_hdr->lock, 1);
+	}
+}
+
+inline
+void posixx::linux::shm::ring::_notify(int* seq, int* waiting) throw (error)
+{
+	// pairs with the fence in the waiting side: either it sees the new
+	// position or we see it waiting
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(waiting, __ATOMIC_RELAXED)) {
+		__atomic_fetch_add(seq, 1, __ATOMIC_RELEASE);
+		futex::wake(seq);
+	}
+}
+
+inline
+bool posixx::linux::shm::ring::_write(const void* buf, std::size_t n)
+		throw (error)
+{
+	const uint64_t cap = _mask + 1;
+	const std::size_t need = _align(MSG_HEADER + n);
+	uint64_t pos = __atomic_load_n(&_hdr->head, __ATOMIC_RELAXED);
+	std::size_t off = pos & _mask;
+	std::size_t contig = cap - off;
+	std::size_t total = need > contig ? contig + need : need;
+	if (pos + total - _tail > cap) {
+		_tail = __atomic_load_n(&_hdr->tail, __ATOMIC_ACQUIRE);
+		if (pos + total - _tail > cap) {
+			// the message doesn't fit after the end but the marker
+			// does, wrap now so it fits once the ring is drained
+			if (need > contig && pos + contig - _tail <= cap) {
+				*reinterpret_cast< uint32_t* >(_data + off) =
+						WRAP;
+				__atomic_store_n(&_hdr->head, pos + contig,
+						__ATOMIC_RELEASE);
+			}
+			return false;
+		}
+	}
+	if (need > contig) {
+		*reinterpret_cast< uint32_t* >(_data + off) = WRAP;
+		pos += contig;
+		off = 0;
+	}
+	*reinterpret_cast< uint32_t* >(_data + off) = n;
+	std::memcpy(_data + off + MSG_HEADER, buf, n);
+	__atomic_store_n(&_hdr->head, pos + need, __ATOMIC_RELEASE);
+	return true;
+}
+
+inline
+bool posixx::linux::shm::ring::try_write(const void* buf, std::size_t n)
+		throw (error)
+{
+	if (n > max_message()) {
+		errno = EMSGSIZE;
+		throw error("shm ring write");
+	}
+	if (closed()) {
+		errno = EPIPE;
+		throw error("shm ring write");
+	}
+	bool multi = producers() == MULTI_PRODUCER;
+	if (multi)
+		_lock();
+	uint64_t head = __atomic_load_n(&_hdr->head, __ATOMIC_RELAXED);
+	bool ok = _write(buf, n);
+	// a wrap marker alone moves the head too, and the consumer must
+	// consume it to make room for the message
+	bool moved = __atomic_load_n(&_hdr->head, __ATOMIC_RELAXED) != head;
+	if (multi)
+		_unlock();
+	if (moved)
+		_notify(&_hdr->data_seq, &_hdr->consumer_waiting);
+	return ok;
+}
+
+inline
+bool posixx::linux::shm::ring::write(const void* buf, std::size_t n,
+		const timespec* timeout) throw (error)
+{
+	for (int i = 0; i < SPINS; ++i) {
+		if (try_write(buf, n))
+			return true;
+		_pause();
+	}
+	for (;;) {
+		int seq = __atomic_load_n(&_hdr->space_seq, __ATOMIC_ACQUIRE);
+		__atomic_fetch_add(&_hdr->producers_waiting, 1,
+				__ATOMIC_SEQ_CST);
+		bool ok;
+		try {
+			ok = try_write(buf, n);
+			if (!ok && !futex::wait(&_hdr->space_seq, seq,
+					timeout)) {
+				__atomic_fetch_sub(&_hdr->producers_waiting,
+						1, __ATOMIC_RELAXED);
+				return false;
+			}
+		}
+		catch (...) {
+			__atomic_fetch_sub(&_hdr->producers_waiting, 1,
+					__ATOMIC_RELAXED);
+			throw;
+		}
+		__atomic_fetch_sub(&_hdr->producers_waiting, 1,
+				__ATOMIC_RELAXED);
+		if (ok)
+			return true;
+	}
+}
+
+inline
+ssize_t posixx::linux::shm::ring::try_read(void* buf, std::size_t n)
+		throw (error)
+{
+	uint64_t pos = __atomic_load_n(&_hdr->tail, __ATOMIC_RELAXED);
+	if (pos == _head) {
+		_head = __atomic_load_n(&_hdr->head, __ATOMIC_ACQUIRE);
+		if (pos == _head) {
+			if (closed()) {
+				errno = EPIPE;
+				throw error("shm ring read");
+			}
+			return -1;
+		}
+	}
+	std::size_t off = pos & _mask;
+	uint32_t len = *reinterpret_cast< const uint32_t* >(_data + off);
+	if (len == WRAP) {
+		pos += _mask + 1 - off;
+		if (pos == _head) {
+			// only the marker was published
+			__atomic_store_n(&_hdr->tail, pos, __ATOMIC_RELEASE);
+			_notify(&_hdr->space_seq, &_hdr->producers_waiting);
+			return try_read(buf, n);
+		}
+		off = 0;
+		len = *reinterpret_cast< const uint32_t* >(_data);
+	}
+	std::size_t s = len < n ? len : n;
+	std::memcpy(buf, _data + off + MSG_HEADER, s);
+	__atomic_store_n(&_hdr->tail, pos + _align(MSG_HEADER + len),
+			__ATOMIC_RELEASE);
+	_notify(&_hdr->space_seq, &_hdr->producers_waiting);
+	return s;
+}
+
+inline
+ssize_t posixx::linux::shm::ring::read(void* buf, std::size_t n,
+		const timespec* timeout) throw (error)
+{
+	ssize_t s;
+	for (int i = 0; i < SPINS; ++i) {
+		if ((s = try_read(buf, n)) != -1)
+			return s;
+		_pause();
+	}
+	for (;;) {
+		int seq = __atomic_load_n(&_hdr->data_seq, __ATOMIC_ACQUIRE);
+		__atomic_store_n(&_hdr->consumer_waiting, 1,
+				__ATOMIC_SEQ_CST);
+		try {
+			s = try_read(buf, n);
+			if (s == -1 && !futex::wait(&_hdr->data_seq, seq,
+					timeout)) {
+				__atomic_store_n(&_hdr->consumer_waiting, 0,
+						__ATOMIC_RELAXED);
+				return -1;
+			}
+		}
+		catch (...) {
+			__atomic_store_n(&_hdr->consumer_waiting, 0,
+					__ATOMIC_RELAXED);
+			throw;
+		}
+		__atomic_store_n(&_hdr->consumer_waiting, 0, __ATOMIC_RELAXED);
+		if (s != -1)
+			return s;
+	}
+}
+
+inline
+void posixx::linux::shm::ring::close() throw (error)
+{
+	__atomic_store_n(&_hdr->closed, 1u, __ATOMIC_SEQ_CST);
+	__atomic_fetch_add(&_hdr->data_seq, 1, __ATOMIC_RELEASE);
+	__atomic_fetch_add(&_hdr->space_seq, 1, __ATOMIC_RELEASE);
+	futex::wake(&_hdr->data_seq);
+	futex::wake(&_hdr->space_seq);
+}
+
+inline
+bool posixx::linux::shm::ring::closed() const throw ()
+{
+	return __atomic_load_n(&_hdr->closed, __ATOMIC_ACQUIRE);
+}
+
+inline
+posixx::linux::shm::producers_t posixx::linux::shm::ring::producers() const
+		throw ()
+{
+	return static_cast< producers_t >(_hdr->producers);
+}
+
+inline
+std::size_t posixx::linux::shm::ring::capacity() const throw ()
+{
+	return _mask + 1;
+}
+
+inline
+std::size_t posixx::linux::shm::ring::max_message() const throw ()
+{
+	return _mask + 1 - MSG_HEADER;
+}
+
+inline
+std::size_t posixx::linux::shm::ring::used() const throw ()
+{
+	return __atomic_load_n(&_hdr->head, __ATOMIC_ACQUIRE)
+			- __atomic_load_n(&_hdr->tail, __ATOMIC_ACQUIRE);
+}
+
+#endif // POSIXX_LINUX_SHM_RING_HPP_
@@ -0,0 +1,79 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_THREAD_HPP_
+#define POSIXX_LINUX_THREAD_HPP_
+
+#include "../error.hpp" // posixx::error
+
+#include <vector> // std::vector
+#include <cerrno> // errno
+#include <sched.h> // cpu_set_t, CPU_*, sched_getaffinity
+#include <pthread.h> // pthread_*
+
+/// @file
+
+namespace posixx { namespace linux {
+
+/**
+ * Get the CPUs the calling thread is allowed to run on.
+ *
+ * @see sched_getaffinity(2)
+ */
+std::vector< int > available_cpus() throw (error);
+
+/**
+ * Start a thread, optionally pinned to a CPU.
+ *
+ * @param t Where to store the thread ID.
+ * @param fn Function run by the thread.
+ * @param arg Argument for fn.
+ * @param cpu CPU to pin the thread to (-1 to let it run anywhere).
+ *
+ * @see pthread_create(3), pthread_attr_setaffinity_np(3)
+ */
+void start_thread(pthread_t& t, void* (*fn)(void*), void* arg, int cpu = -1)
+		throw (error);
+
+} } // namespace posixx::linux
+
+
+
+inline
+std::vector< int > posixx::linux::available_cpus() throw (error)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (::sched_getaffinity(0, sizeof(set), &set) == -1)
+		throw error("sched_getaffinity");
+	std::vector< int > cpus;
+	for (int i = 0; i < CPU_SETSIZE; ++i)
+		if (CPU_ISSET(i, &set))
+			cpus.push_back(i);
+	return cpus;
+}
+
+inline
+void posixx::linux::start_thread(pthread_t& t, void* (*fn)(void*),
+		void* arg, int cpu) throw (error)
+{
+	pthread_attr_t attr;
+	::pthread_attr_init(&attr);
+	if (cpu != -1) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		::pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+	}
+	int r = ::pthread_create(&t, &attr, fn, arg);
+	::pthread_attr_destroy(&attr);
+	if (r) {
+		errno = r;
+		throw error("pthread_create");
+	}
+}
+
+#endif // POSIXX_LINUX_THREAD_HPP_
@@ -8,9 +8,12 @@
 #define POSIXX_LINUX_TIPC_HPP_
 
 #include "../socket/basic_socket.hpp" // posixx::socket
+#include "../text.hpp" // posixx::text
+#include "../simd.hpp" // posixx::simd::mix
 
 #include <linux/tipc.h> // all tipc stuff
 #include <cstring> // memcpy
+#include <cerrno> // errno, EINVAL
 
 /// @file
 
@@ -355,6 +358,9 @@ enum scope_t
 struct sockaddr: sockaddr_tipc
 {
 
+	/// Buffer size (including the terminating NUL) for format().
+	enum { TEXT_SIZE = sizeof("{4294967295,4294967295}@255.4095.4095") };
+
 	/// Constructor.
 	sockaddr() throw ();
 
@@ -396,6 +402,14 @@ struct sockaddr: sockaddr_tipc
 	/// Compare two TIPC socket addresses
 	bool operator == (const sockaddr& other) const throw ();
 
+	/**
+	 * Hash of the address (consistent with operator==).
+	 *
+	 * Useful to use the address as a key in hash tables (see
+	 * posixx::socket::peer_table).
+	 */
+	uint64_t hash() const throw ();
+
 	/// Access to the port ID (only valid if addrtype == ID)
 	portid& port_id() throw ();
 
@@ -420,6 +434,43 @@ struct sockaddr: sockaddr_tipc
 	/// Access to the port name sequence (only valid if addrtype == NAMESEQ)
 	const nameseq& name_seq() const throw ();
 
+	/**
+	 * Format the address into a buffer.
+	 *
+	 * The usual TIPC notation is used: "<Z.C.N:ref>" for port IDs,
+	 * "{type,instance}" for port names (followed by "@Z.C.N" if the
+	 * lookup domain is not 0) and "{type,lower,upper}" for port name
+	 * sequences. The scope is not included.
+	 *
+	 * @param buf Buffer to write to (always NUL terminated if size > 0).
+	 * @param size Size of the buffer (TEXT_SIZE is always enough).
+	 *
+	 * @return Length of the text, like snprintf(3) (if it's equal or
+	 *         bigger than size, the text was truncated).
+	 */
+	std::size_t format(char* buf, std::size_t size) const throw ();
+
+	/**
+	 * Parse an address in the format used by format().
+	 *
+	 * The scope is set to ZONE, like the constructors do by default.
+	 *
+	 * @param s NUL terminated string to parse.
+	 *
+	 * @return true on success, false (with errno set to EINVAL) if s is
+	 *         not a valid address, in which case the address is left
+	 *         untouched.
+	 */
+	bool parse(const char* s) throw ();
+
+private:
+
+	static void _put_addr(text::writer& w, const tipc::addr& a) throw ();
+
+	static bool _parse_addr(const char*& s, tipc::addr& a) throw ();
+
+	static bool _parse(const char* s, sockaddr& sa) throw ();
+
 };
 
 /// TIPC socket traits.
@@ -713,6 +764,24 @@ bool posixx::linux::tipc::sockaddr::operator == (const sockaddr& other) const
 	return memcmp(this, &other, sizeof(*this)) == 0;
 }
 
+inline
+uint64_t posixx::linux::tipc::sockaddr::hash() const throw ()
+{
+	uint64_t h = simd::mix(uint64_t(family) << 16 | addrtype << 8 | scope);
+	if (addrtype == ID)
+		return simd::mix(h ^ (uint64_t(addr.id.ref) << 32
+				| addr.id.node));
+	if (addrtype == NAME)
+		return simd::mix(simd::mix(h ^ (uint64_t(addr.name.name.type)
+				<< 32 | addr.name.name.instance))
+				^ addr.name.domain);
+	if (addrtype == NAMESEQ)
+		return simd::mix(simd::mix(h ^ (uint64_t(addr.nameseq.type)
+				<< 32 | addr.nameseq.lower))
+				^ addr.nameseq.upper);
+	return simd::hash(this, sizeof(*this), h);
+}
+
 inline
 posixx::linux::tipc::portid& posixx::linux::tipc::sockaddr::port_id() throw ()
 {
@@ -767,4 +836,107 @@ const posixx::linux::tipc::nameseq& posixx::linux::tipc::sockaddr::name_seq()
 	return *reinterpret_cast<const nameseq*>(&addr.nameseq);
 }
 
+inline
+void posixx::linux::tipc::sockaddr::_put_addr(text::writer& w,
+		const tipc::addr& a) throw ()
+{
+	w.put(static_cast< unsigned long >(a.zone())).put('.')
+		.put(static_cast< unsigned long >(a.cluster())).put('.')
+		.put(static_cast< unsigned long >(a.node()));
+}
+
+inline
+std::size_t posixx::linux::tipc::sockaddr::format(char* buf,
+		std::size_t size) const throw ()
+{
+	text::writer w(buf, size);
+	if (addrtype == ID) {
+		w.put('<');
+		_put_addr(w, port_id().node_addr());
+		w.put(':').put(static_cast< unsigned long >(port_id().ref))
+			.put('>');
+	}
+	else if (addrtype == NAME) {
+		w.put('{').put(static_cast< unsigned long >(port_name().type))
+			.put(',')
+			.put(static_cast< unsigned long >(port_name().instance))
+			.put('}');
+		if (name_domain().address) {
+			w.put('@');
+			_put_addr(w, name_domain());
+		}
+	}
+	else if (addrtype == NAMESEQ) {
+		const nameseq& ns = name_seq();
+		w.put('{').put(static_cast< unsigned long >(ns.type))
+			.put(',').put(static_cast< unsigned long >(ns.lower))
+			.put(',').put(static_cast< unsigned long >(ns.upper))
+			.put('}');
+	}
+	return w.finish();
+}
+
+inline
+bool posixx::linux::tipc::sockaddr::_parse_addr(const char*& s,
+		tipc::addr& a) throw ()
+{
+	unsigned long z, c, n;
+	if (!text::parse_uint(s, 255, z) || !text::expect(s, '.')
+			|| !text::parse_uint(s, 4095, c)
+			|| !text::expect(s, '.')
+			|| !text::parse_uint(s, 4095, n))
+		return false;
+	a = tipc::addr(z, c, n);
+	return true;
+}
+
+inline
+bool posixx::linux::tipc::sockaddr::_parse(const char* s, sockaddr& sa)
+		throw ()
+{
+	const unsigned long max = 0xffffffffu;
+	unsigned long v1, v2, v3;
+	sa.scope = ZONE;
+	if (text::expect(s, '<')) {
+		tipc::addr a;
+		if (!_parse_addr(s, a) || !text::expect(s, ':')
+				|| !text::parse_uint(s, max, v1)
+				|| !text::expect(s, '>'))
+			return false;
+		sa.addrtype = ID;
+		sa.port_id() = portid(v1, a);
+		return !*s;
+	}
+	if (!text::expect(s, '{') || !text::parse_uint(s, max, v1)
+			|| !text::expect(s, ',')
+			|| !text::parse_uint(s, max, v2))
+		return false;
+	if (text::expect(s, ',')) {
+		if (!text::parse_uint(s, max, v3) || !text::expect(s, '}'))
+			return false;
+		sa.addrtype = NAMESEQ;
+		sa.name_seq() = nameseq(v1, v2, v3);
+		return !*s;
+	}
+	if (!text::expect(s, '}'))
+		return false;
+	sa.addrtype = NAME;
+	sa.port_name() = name(v1, v2);
+	if (text::expect(s, '@') && !_parse_addr(s, sa.name_domain()))
+		return false;
+	return !*s;
+}
+
+inline
+bool posixx::linux::tipc::sockaddr::parse(const char* s) throw ()
+{
+	sockaddr sa;
+	if (!_parse(s, sa)) {
+		errno = EINVAL;
+		return false;
+	}
+	*this = sa;
+	return true;
+}
+
 #endif // POSIXX_LINUX_TIPC_HPP_
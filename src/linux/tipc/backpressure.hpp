@@ -0,0 +1,258 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_TIPC_BACKPRESSURE_HPP_
+#define POSIXX_LINUX_TIPC_BACKPRESSURE_HPP_
+
+#include "../tipc.hpp" // posixx::linux::tipc::reason_t
+#include "returned.hpp" // posixx::linux::tipc::msg_info
+#include "../../tsc.hpp" // posixx::tsc::monotonic
+
+#include <stdint.h> // uint64_t
+
+/// @file
+
+namespace posixx { namespace linux { namespace tipc {
+
+/**
+ * Adaptive send rate controller.
+ *
+ * Limits the send rate using a token bucket whose rate adapts to the
+ * congestion of the receivers (AIMD): every ERR_OVERLOAD returned message
+ * reported with returned() cuts the rate by a factor (and empties the
+ * bucket, so sending pauses until the next token), and every interval
+ * without overloads increases it by a fixed amount.
+ *
+ * A burst of overloads usually comes from the same congestion episode (all
+ * the messages in flight when the receiver queue filled up are returned),
+ * so only the first overload in a hold period cuts the rate.
+ *
+ * Returned messages with other reasons (like ERR_NO_PORT) don't mean
+ * congestion, so they don't affect the rate.
+ *
+ * The controller doesn't do any I/O, all the methods take the current
+ * time (in nanoseconds, see tsc::monotonic()) so it can be used with any
+ * event loop.
+ *
+ * @code
+ * using namespace posixx::linux::tipc;
+ * rate_controller rc;
+ * receiver r;
+ * msg_info info;
+ * // when poll() reports sock is readable
+ * r.recv(sock, buf, sizeof(buf), info);
+ * if (info.returned())
+ *	rc.returned(info);
+ * // when there is a message to send
+ * if (rc.acquire())
+ *	sock.send(msg, n, to);
+ * else
+ *	timeout = rc.wait_time(); // poll() again with this timeout
+ * @endcode
+ */
+struct rate_controller
+{
+
+	/// Configuration (rates in messages per second, times in ns).
+	struct config
+	{
+		/// Initial rate.
+		double initial_rate;
+		/// Minimum rate (the rate is never cut below it).
+		double min_rate;
+		/// Maximum rate (the rate never grows beyond it).
+		double max_rate;
+		/// Rate added every interval without overloads.
+		double increase;
+		/// Factor applied to the rate on overload (between 0 and 1).
+		double decrease;
+		/// Interval for the rate increase.
+		uint64_t interval;
+		/// Time after an overload in which other overloads are ignored.
+		uint64_t hold;
+		/// Maximum messages that can be sent in a burst.
+		double burst;
+		/// Default configuration.
+		config() throw ();
+	};
+
+	/**
+	 * Constructor.
+	 *
+	 * @param cfg Configuration.
+	 * @param t Current time.
+	 */
+	explicit rate_controller(const config& cfg = config(),
+			uint64_t t = tsc::monotonic()) throw ();
+
+	/**
+	 * Try to get permission to send a message.
+	 *
+	 * @return true if the message can be sent (a token was consumed).
+	 */
+	bool acquire(uint64_t t = tsc::monotonic()) throw ();
+
+	/// Time to wait until a message can be sent (0 if it can be sent now).
+	uint64_t wait_time(uint64_t t = tsc::monotonic()) throw ();
+
+	/**
+	 * Report an overload (cuts the rate, unless it's in the hold period).
+	 *
+	 * @return true if the rate was cut.
+	 */
+	bool overload(uint64_t t = tsc::monotonic()) throw ();
+
+	/**
+	 * Report a returned message (only ERR_OVERLOAD affects the rate).
+	 *
+	 * @return true if the rate was cut.
+	 */
+	bool returned(reason_t reason, uint64_t t = tsc::monotonic()) throw ();
+
+	/// Report a message received with receiver (see returned(reason_t)).
+	bool returned(const msg_info& info, uint64_t t = tsc::monotonic())
+			throw ();
+
+	/// Current rate.
+	double rate() const throw ();
+
+	/// Total overloads reported (including the ones in hold periods).
+	unsigned long overloads() const throw ();
+
+	/// Get the configuration.
+	const config& conf() const throw ();
+
+private:
+
+	// Update the rate and refill the bucket up to time t
+	void _update(uint64_t t) throw ();
+
+	config _cfg;
+	double _rate;
+	double _tokens;
+	unsigned long _overloads;
+	// Last time the bucket was refilled
+	uint64_t _refilled;
+	// Last time the rate was increased (or cut)
+	uint64_t _increased;
+	// End of the hold period
+	uint64_t _hold_until;
+
+};
+
+} } } // namespace posixx::linux::tipc
+
+
+
+inline
+posixx::linux::tipc::rate_controller::config::config() throw ():
+		initial_rate(10000), min_rate(100), max_rate(1000000),
+		increase(1000), decrease(0.5), interval(10000000),
+		hold(10000000), burst(32)
+{
+}
+
+inline
+posixx::linux::tipc::rate_controller::rate_controller(const config& cfg,
+		uint64_t t) throw ():
+		_cfg(cfg), _rate(cfg.initial_rate), _tokens(cfg.burst),
+		_overloads(0), _refilled(t), _increased(t), _hold_until(0)
+{
+}
+
+inline
+void posixx::linux::tipc::rate_controller::_update(uint64_t t) throw ()
+{
+	if (t > _refilled) {
+		_tokens += _rate * (t - _refilled) / 1e9;
+		if (_tokens > _cfg.burst)
+			_tokens = _cfg.burst;
+		_refilled = t;
+	}
+	if (_cfg.interval && t >= _increased + _cfg.interval) {
+		uint64_t n = (t - _increased) / _cfg.interval;
+		_rate += n * _cfg.increase;
+		if (_rate > _cfg.max_rate)
+			_rate = _cfg.max_rate;
+		_increased += n * _cfg.interval;
+	}
+}
+
+inline
+bool posixx::linux::tipc::rate_controller::acquire(uint64_t t) throw ()
+{
+	_update(t);
+	if (_tokens < 1)
+		return false;
+	_tokens -= 1;
+	return true;
+}
+
+inline
+uint64_t posixx::linux::tipc::rate_controller::wait_time(uint64_t t)
+		throw ()
+{
+	_update(t);
+	if (_tokens >= 1)
+		return 0;
+	// round up, so waiting that long is always enough
+	return static_cast< uint64_t >((1 - _tokens) * 1e9 / _rate) + 1;
+}
+
+inline
+bool posixx::linux::tipc::rate_controller::overload(uint64_t t) throw ()
+{
+	++_overloads;
+	_update(t);
+	if (t < _hold_until)
+		return false;
+	_rate *= _cfg.decrease;
+	if (_rate < _cfg.min_rate)
+		_rate = _cfg.min_rate;
+	if (_tokens > 0)
+		_tokens = 0;
+	_increased = t;
+	_hold_until = t + _cfg.hold;
+	return true;
+}
+
+inline
+bool posixx::linux::tipc::rate_controller::returned(reason_t reason,
+		uint64_t t) throw ()
+{
+	if (reason != ERR_OVERLOAD)
+		return false;
+	return overload(t);
+}
+
+inline
+bool posixx::linux::tipc::rate_controller::returned(const msg_info& info,
+		uint64_t t) throw ()
+{
+	return returned(info.reason, t);
+}
+
+inline
+double posixx::linux::tipc::rate_controller::rate() const throw ()
+{
+	return _rate;
+}
+
+inline
+unsigned long posixx::linux::tipc::rate_controller::overloads() const
+		throw ()
+{
+	return _overloads;
+}
+
+inline
+const posixx::linux::tipc::rate_controller::config&
+posixx::linux::tipc::rate_controller::conf() const throw ()
+{
+	return _cfg;
+}
+
+#endif // POSIXX_LINUX_TIPC_BACKPRESSURE_HPP_
@@ -0,0 +1,484 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_TIPC_BALANCER_HPP_
+#define POSIXX_LINUX_TIPC_BALANCER_HPP_
+
+#include "../tipc.hpp" // posixx::linux::tipc
+#include "topology.hpp" // posixx::linux::tipc::name_table
+#include "../../simd.hpp" // posixx::simd::hash
+#include "../../tsc.hpp" // posixx::tsc::monotonic
+
+#include <vector> // std::vector
+#include <utility> // std::pair
+#include <algorithm> // std::sort, std::lower_bound
+#include <cerrno> // EAGAIN, EHOSTUNREACH, ECONNREFUSED
+#include <stdint.h> // uint64_t
+
+/// @file
+
+namespace posixx { namespace linux { namespace tipc {
+
+/// Port selection policy.
+enum policy_t
+{
+	/// Use each port in turn.
+	ROUND_ROBIN,
+	/// Use the port with less outstanding messages.
+	LEAST_LOADED,
+	/**
+	 * Use a consistent hash of a key (so the same key always goes to the
+	 * same port while it's available, and only the keys of a port that
+	 * goes away are moved to other ports).
+	 */
+	CONSISTENT_HASH
+};
+
+/**
+ * Select a port among the ones that published a name sequence.
+ *
+ * The candidates are all the ports with publications overlapping the name
+ * sequence, taken from a name_table (usually kept updated by a topology
+ * client). The candidates are refreshed automatically when the table
+ * changes.
+ *
+ * Ports can be penalized (temporarily excluded from the selection) by
+ * reporting errors using report(): ERR_NO_PORT (and ERR_NO_NAME and
+ * ERR_NO_NODE) penalize the port for no_port_penalty, ERR_OVERLOAD for
+ * overload_penalty, which is doubled for each consecutive overload up to
+ * max_overload_penalty. A successful complete() resets the overload
+ * penalty.
+ *
+ * The load used by LEAST_LOADED is the number of outstanding messages:
+ * sent() increments it and complete() decrements it, so the user should
+ * call complete() when a response (or any other kind of acknowledgement)
+ * is received.
+ *
+ * This class doesn't do any I/O, see balancer for a sender.
+ */
+struct port_selector
+{
+
+	/// Penalties configuration (all times in nanoseconds).
+	struct config
+	{
+		/// Penalty for a port that doesn't exist anymore.
+		uint64_t no_port_penalty;
+		/// Initial penalty for an overloaded port.
+		uint64_t overload_penalty;
+		/// Maximum penalty for an overloaded port.
+		uint64_t max_overload_penalty;
+		/// Virtual nodes of each port in the consistent hash ring.
+		unsigned replicas;
+		/// Default configuration.
+		config() throw ();
+	};
+
+	/// State of a candidate port.
+	struct port_state
+	{
+		/// Port ID.
+		portid id;
+		/// Outstanding messages (sent but not completed).
+		unsigned long outstanding;
+		/// Total messages sent.
+		unsigned long sent;
+		/// Total errors reported.
+		unsigned long errors;
+		/// Time until the port is penalized (0 if it isn't).
+		uint64_t penalized_until;
+		/// Current overload penalty.
+		uint64_t overload_penalty;
+	};
+
+	/// Candidate ports.
+	typedef std::vector< port_state > ports;
+
+	/**
+	 * Constructor.
+	 *
+	 * @param table Name table to take the candidates from (it must
+	 *              outlive the selector).
+	 * @param seq Name sequence to send to.
+	 * @param policy Selection policy.
+	 * @param cfg Penalties configuration.
+	 */
+	port_selector(const name_table& table, const nameseq& seq,
+			policy_t policy = ROUND_ROBIN,
+			const config& cfg = config());
+
+	/**
+	 * Select a port.
+	 *
+	 * @param key Key for CONSISTENT_HASH (ignored by other policies).
+	 *
+	 * @return The selected port, or NULL if there are no candidates or
+	 *         all of them are penalized.
+	 */
+	port_state* select(uint64_t key = 0);
+
+	/// Record a message sent to a port.
+	void sent(port_state& p) throw ();
+
+	/// Record a message completed by a port (see LEAST_LOADED).
+	void complete(const portid& id);
+
+	/// Report an error for a port (see reason_t).
+	void report(const portid& id, reason_t reason);
+
+	/// Get the candidate ports (refreshed if the table changed).
+	const ports& candidates();
+
+	/// Get the name sequence.
+	const nameseq& name_seq() const throw ();
+
+	/// Get the selection policy.
+	policy_t policy() const throw ();
+
+protected:
+
+	// Penalize a port (see report())
+	void _penalize(port_state& p, reason_t reason) throw ();
+
+private:
+
+	// Refresh the candidates if the table changed
+	void _refresh();
+
+	// Find a candidate port
+	port_state* _find(const portid& id) throw ();
+
+	// Check if a port can be used at time t
+	static bool _usable(const port_state& p, uint64_t t) throw ();
+
+	const name_table& _table;
+	nameseq _seq;
+	policy_t _policy;
+	config _cfg;
+
+	// Version of the table the candidates were taken from
+	unsigned long _version;
+	bool _fresh;
+
+	ports _ports;
+
+	// Next port to try for ROUND_ROBIN (and ties in LEAST_LOADED)
+	std::size_t _next;
+
+	// Consistent hash ring: (hash, port index), sorted by hash
+	typedef std::vector< std::pair< uint64_t, std::size_t > > ring;
+	ring _ring;
+
+};
+
+/**
+ * Load-balancing TIPC sender.
+ *
+ * Sends messages (usually using a socket::RDM socket) to the ports that
+ * published a name sequence, selected by a port_selector, failing over to
+ * the next selected port if the send fails because the port is gone
+ * (EHOSTUNREACH, ECONNREFUSED) or congested (EAGAIN).
+ *
+ * Messages returned asynchronously by TIPC (see TIPC_DEST_DROPPABLE) should
+ * be reported using report() so the port is penalized.
+ *
+ * @code
+ * using namespace posixx::linux::tipc;
+ * topology top;
+ * top.subscribe(nameseq(1000, 0, 99));
+ * socket sock(posixx::socket::RDM);
+ * balancer b(sock, top.table(), nameseq(1000, 0, 99), LEAST_LOADED);
+ * // ...
+ * top.process_all();
+ * b.send(buf, n);
+ * @endcode
+ */
+struct balancer: port_selector
+{
+
+	/**
+	 * Constructor.
+	 *
+	 * @param sock Socket to send the messages (it must outlive the
+	 *             balancer).
+	 * @param table Name table to take the candidates from (it must
+	 *              outlive the balancer).
+	 * @param seq Name sequence to send to.
+	 * @param policy Selection policy.
+	 * @param cfg Penalties configuration.
+	 */
+	balancer(tipc::socket& sock, const name_table& table,
+			const nameseq& seq, policy_t policy = ROUND_ROBIN,
+			const port_selector::config& cfg = port_selector::config());
+
+	/**
+	 * Send a message to a selected port.
+	 *
+	 * Each candidate is tried at most once.
+	 *
+	 * @param buf Message to send.
+	 * @param n Size of the message.
+	 * @param key Key for CONSISTENT_HASH (ignored by other policies).
+	 * @param to Where to store the port the message was sent to (if not
+	 *           NULL).
+	 * @param flags Send flags.
+	 *
+	 * @throw error With EHOSTUNREACH if there are no candidates, EAGAIN
+	 *        if all of them are penalized, or the error of the last send
+	 *        otherwise.
+	 */
+	ssize_t send(const void* buf, size_t n, uint64_t key = 0,
+			portid* to = NULL, int flags = 0) throw (error);
+
+private:
+
+	tipc::socket& _sock;
+
+};
+
+} } } // namespace posixx::linux::tipc
+
+
+
+inline
+posixx::linux::tipc::port_selector::config::config() throw ():
+		no_port_penalty(1000000000), overload_penalty(1000000),
+		max_overload_penalty(100000000), replicas(64)
+{
+}
+
+inline
+posixx::linux::tipc::port_selector::port_selector(const name_table& table,
+		const nameseq& seq, policy_t policy, const config& cfg):
+		_table(table), _seq(seq), _policy(policy), _cfg(cfg),
+		_version(0), _fresh(false), _next(0)
+{
+}
+
+inline
+bool posixx::linux::tipc::port_selector::_usable(const port_state& p,
+		uint64_t t) throw ()
+{
+	return p.penalized_until <= t;
+}
+
+inline
+void posixx::linux::tipc::port_selector::_refresh()
+{
+	if (_fresh && _version == _table.version())
+		return;
+	ports old;
+	old.swap(_ports);
+	const name_table::publications& pubs = _table.published(_seq.type);
+	for (name_table::publications::const_iterator i = pubs.begin();
+			i != pubs.end(); ++i) {
+		if (i->seq.upper < _seq.lower || i->seq.lower > _seq.upper)
+			continue;
+		if (_find(i->port))
+			continue; // port with more than one publication
+		port_state p = { i->port, 0, 0, 0, 0, _cfg.overload_penalty };
+		// keep the state of the ports we already knew
+		for (ports::const_iterator j = old.begin(); j != old.end(); ++j)
+			if (j->id == i->port) {
+				p = *j;
+				break;
+			}
+		_ports.push_back(p);
+	}
+	_ring.clear();
+	if (_policy == CONSISTENT_HASH) {
+		for (std::size_t i = 0; i < _ports.size(); ++i)
+			for (unsigned r = 0; r < _cfg.replicas; ++r) {
+				__u32 v[3] = { _ports[i].id.ref, _ports[i].id.node,
+						r };
+				_ring.push_back(std::make_pair(
+						simd::hash(v, sizeof(v)), i));
+			}
+		std::sort(_ring.begin(), _ring.end());
+	}
+	if (_next >= _ports.size())
+		_next = 0;
+	_version = _table.version();
+	_fresh = true;
+}
+
+inline
+posixx::linux::tipc::port_selector::port_state*
+posixx::linux::tipc::port_selector::_find(const portid& id) throw ()
+{
+	for (ports::iterator i = _ports.begin(); i != _ports.end(); ++i)
+		if (i->id == id)
+			return &*i;
+	return NULL;
+}
+
+inline
+posixx::linux::tipc::port_selector::port_state*
+posixx::linux::tipc::port_selector::select(uint64_t key)
+{
+	_refresh();
+	std::size_t n = _ports.size();
+	if (n == 0)
+		return NULL;
+	uint64_t t = tsc::monotonic();
+	switch (_policy) {
+	case ROUND_ROBIN:
+		for (std::size_t i = 0; i < n; ++i) {
+			port_state& p = _ports[(_next + i) % n];
+			if (_usable(p, t)) {
+				_next = (_next + i + 1) % n;
+				return &p;
+			}
+		}
+		return NULL;
+	case LEAST_LOADED: {
+		port_state* best = NULL;
+		for (std::size_t i = 0; i < n; ++i) {
+			port_state& p = _ports[(_next + i) % n];
+			if (_usable(p, t) && (best == NULL
+					|| p.outstanding < best->outstanding))
+				best = &p;
+		}
+		_next = (_next + 1) % n;
+		return best;
+	}
+	case CONSISTENT_HASH: {
+		uint64_t h = simd::hash(&key, sizeof(key));
+		ring::const_iterator i = std::lower_bound(_ring.begin(),
+				_ring.end(), std::make_pair(h, std::size_t(0)));
+		for (std::size_t j = 0; j < _ring.size(); ++j, ++i) {
+			if (i == _ring.end())
+				i = _ring.begin();
+			port_state& p = _ports[i->second];
+			if (_usable(p, t))
+				return &p;
+		}
+		return NULL;
+	}
+	}
+	return NULL;
+}
+
+inline
+void posixx::linux::tipc::port_selector::sent(port_state& p) throw ()
+{
+	++p.outstanding;
+	++p.sent;
+}
+
+inline
+void posixx::linux::tipc::port_selector::complete(const portid& id)
+{
+	_refresh();
+	port_state* p = _find(id);
+	if (p == NULL)
+		return;
+	if (p->outstanding)
+		--p->outstanding;
+	p->overload_penalty = _cfg.overload_penalty;
+}
+
+inline
+void posixx::linux::tipc::port_selector::_penalize(port_state& p,
+		reason_t reason) throw ()
+{
+	switch (reason) {
+	case OK:
+		return;
+	case ERR_OVERLOAD:
+		p.penalized_until = tsc::monotonic() + p.overload_penalty;
+		p.overload_penalty *= 2;
+		if (p.overload_penalty > _cfg.max_overload_penalty)
+			p.overload_penalty = _cfg.max_overload_penalty;
+		break;
+	default:
+		p.penalized_until = tsc::monotonic() + _cfg.no_port_penalty;
+		break;
+	}
+	++p.errors;
+}
+
+inline
+void posixx::linux::tipc::port_selector::report(const portid& id,
+		reason_t reason)
+{
+	_refresh();
+	port_state* p = _find(id);
+	if (p == NULL || reason == OK)
+		return;
+	_penalize(*p, reason);
+	// the returned message is not outstanding anymore
+	if (p->outstanding)
+		--p->outstanding;
+}
+
+inline
+const posixx::linux::tipc::port_selector::ports&
+posixx::linux::tipc::port_selector::candidates()
+{
+	_refresh();
+	return _ports;
+}
+
+inline
+const posixx::linux::tipc::nameseq&
+posixx::linux::tipc::port_selector::name_seq() const throw ()
+{
+	return _seq;
+}
+
+inline
+posixx::linux::tipc::policy_t posixx::linux::tipc::port_selector::policy()
+		const throw ()
+{
+	return _policy;
+}
+
+
+inline
+posixx::linux::tipc::balancer::balancer(tipc::socket& sock,
+		const name_table& table, const nameseq& seq, policy_t policy,
+		const port_selector::config& cfg):
+		port_selector(table, seq, policy, cfg), _sock(sock)
+{
+}
+
+inline
+ssize_t posixx::linux::tipc::balancer::send(const void* buf, size_t n,
+		uint64_t key, portid* to, int flags) throw (error)
+{
+	std::size_t tries = candidates().size();
+	if (tries == 0) {
+		errno = EHOSTUNREACH;
+		throw error("balancer: no ports");
+	}
+	for (std::size_t i = 0; ; ++i) {
+		port_state* p = select(key);
+		if (p == NULL) {
+			errno = EAGAIN;
+			throw error("balancer: all ports penalized");
+		}
+		try {
+			ssize_t r = _sock.send(buf, n, sockaddr(p->id), flags);
+			sent(*p);
+			if (to)
+				*to = p->id;
+			return r;
+		}
+		catch (const error& e) {
+			if (e.no == EAGAIN)
+				_penalize(*p, ERR_OVERLOAD);
+			else if (e.no == EHOSTUNREACH || e.no == ECONNREFUSED)
+				_penalize(*p, ERR_NO_PORT);
+			else
+				throw;
+			if (i + 1 >= tries)
+				throw;
+		}
+	}
+}
+
+#endif // POSIXX_LINUX_TIPC_BALANCER_HPP_
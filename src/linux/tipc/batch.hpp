@@ -0,0 +1,520 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_TIPC_BATCH_HPP_
+#define POSIXX_LINUX_TIPC_BATCH_HPP_
+
+#include "../tipc.hpp" // posixx::linux::tipc
+#include "../../tsc.hpp" // posixx::tsc::monotonic
+
+#include <vector> // std::vector
+#include <cstring> // std::memset, std::memcpy
+#include <cstddef> // std::ptrdiff_t
+#include <cerrno> // EMSGSIZE, EPROTO, EAGAIN, EWOULDBLOCK
+#include <sys/socket.h> // mmsghdr, MSG_WAITFORONE, MSG_DONTWAIT
+#include <sys/uio.h> // iovec
+#include <stdint.h> // uint64_t
+
+/// @file
+
+namespace posixx { namespace linux { namespace tipc {
+
+/**
+ * Read the records of a batched datagram.
+ *
+ * A batch is a sequence of records, each one being a 2 bytes length (in
+ * network byte order) followed by the record data.
+ *
+ * @see batch_sender, batch_receiver
+ */
+struct batch_reader
+{
+
+	/// Size of the record header.
+	static const std::size_t HEADER = 2;
+
+	/// Maximum size of a record.
+	static const std::size_t MAX_RECORD = 0xffff;
+
+	/**
+	 * Constructor.
+	 *
+	 * @param buf Batch (it must outlive the reader).
+	 * @param n Batch size.
+	 */
+	batch_reader(const void* buf, std::size_t n) throw ();
+
+	/**
+	 * Get the next record.
+	 *
+	 * @param data Where to store a pointer to the record data (it points
+	 *             into the batch).
+	 * @param n Where to store the record size.
+	 *
+	 * @return false if there are no more records.
+	 *
+	 * @throw error with errno EPROTO if the batch is malformed (the
+	 *        rest of the batch is skipped).
+	 */
+	bool next(const void*& data, std::size_t& n) throw (error);
+
+	/**
+	 * Append a record to a batch.
+	 *
+	 * @throw error with errno EMSGSIZE if the record is bigger than
+	 *        MAX_RECORD.
+	 */
+	static void append(std::vector< char >& batch, const void* buf,
+			std::size_t n) throw (error);
+
+private:
+
+	const unsigned char* _pos;
+	const unsigned char* _end;
+
+};
+
+/**
+ * Multicast sender that batches small messages.
+ *
+ * Messages sent to the same name sequence are coalesced into a single
+ * datagram (see batch_reader for the format) until the batch reaches
+ * max_size bytes or its oldest message is max_delay nanoseconds old.
+ *
+ * The sender doesn't start any thread or timer: expired batches are sent
+ * when a new message is sent to the same name sequence or when
+ * flush_expired() is called (deadline() tells when that should be). When
+ * batches for more than one name sequence are ready, they are sent with a
+ * single sendmmsg() call.
+ *
+ * A message bigger than max_size is sent alone (it's never fragmented).
+ *
+ * @code
+ * using namespace posixx::linux::tipc;
+ * socket sock(posixx::socket::RDM);
+ * batch_sender bs(sock);
+ * bs.send(nameseq(1000, 0, 99), update, n);
+ * // ...
+ * bs.flush_expired(); // when poll() times out at bs.deadline()
+ * @endcode
+ */
+struct batch_sender
+{
+
+	/// Batching configuration.
+	struct config
+	{
+		/**
+		 * Maximum batch size (the default fits, with the TIPC
+		 * header, in a single Ethernet frame).
+		 */
+		std::size_t max_size;
+		/// Maximum time a message can be delayed (in nanoseconds).
+		uint64_t max_delay;
+		/// Scope of the name sequences.
+		scope_t scope;
+		/// Default configuration.
+		config() throw ();
+	};
+
+	/**
+	 * Constructor.
+	 *
+	 * @param sock Socket to send the batches (it must outlive the
+	 *             sender).
+	 * @param cfg Batching configuration.
+	 */
+	explicit batch_sender(tipc::socket& sock,
+			const config& cfg = config());
+
+	/**
+	 * Send a message to a name sequence.
+	 *
+	 * The message is added to the batch of the name sequence, which is
+	 * sent if it's full or expired.
+	 *
+	 * @param to Name sequence to send the message to.
+	 * @param buf Message buffer.
+	 * @param n Message length.
+	 * @param t Current time (see tsc::monotonic()).
+	 *
+	 * @throw error with errno EMSGSIZE if the message is too big
+	 *        (see batch_reader::MAX_RECORD).
+	 */
+	void send(const nameseq& to, const void* buf, std::size_t n,
+			uint64_t t = tsc::monotonic()) throw (error);
+
+	/**
+	 * Send the batches whose oldest message is too old.
+	 *
+	 * @return Number of batches sent.
+	 */
+	std::size_t flush_expired(uint64_t t = tsc::monotonic()) throw (error);
+
+	/**
+	 * Send all the pending batches.
+	 *
+	 * @return Number of batches sent.
+	 */
+	std::size_t flush() throw (error);
+
+	/**
+	 * Time when the oldest pending batch expires.
+	 *
+	 * @return 0 if there are no pending batches.
+	 */
+	uint64_t deadline() const throw ();
+
+	/// Number of messages waiting in pending batches.
+	std::size_t pending() const throw ();
+
+	/// Get the configuration.
+	const config& conf() const throw ();
+
+private:
+
+	// Batch for a name sequence
+	struct batch
+	{
+		sockaddr to;
+		std::vector< char > data;
+		std::size_t messages;
+		uint64_t started;
+	};
+
+	// Get (or create) the batch of a name sequence
+	batch& _batch(const nameseq& to);
+
+	// Send the batches for which _ready[i] is true
+	std::size_t _flush() throw (error);
+
+	tipc::socket& _sock;
+	config _cfg;
+
+	// Batches are never removed, there are usually just a few
+	// destinations and this avoids allocating memory in the steady state
+	std::vector< batch > _batches;
+
+	// Reused buffers for sendmmsg()
+	std::vector< bool > _ready;
+	std::vector< mmsghdr > _msgs;
+	std::vector< iovec > _iovs;
+	std::vector< std::size_t > _index;
+
+};
+
+/**
+ * Receive batches sent by a batch_sender and split them in messages.
+ *
+ * Several datagrams are received with a single recvmmsg() call.
+ *
+ * @code
+ * using namespace posixx::linux::tipc;
+ * socket sock(posixx::socket::RDM);
+ * sock.bind(sockaddr(nameseq(1000, 0, 99)));
+ * batch_receiver br(sock);
+ * const void* msg;
+ * std::size_t n;
+ * while (br.next(msg, n))
+ *	handle(msg, n);
+ * @endcode
+ */
+struct batch_receiver
+{
+
+	/**
+	 * Constructor.
+	 *
+	 * @param sock Socket to receive the batches (it must outlive the
+	 *             receiver).
+	 * @param depth Maximum datagrams received by each system call.
+	 * @param max_size Maximum datagram size (depth * max_size bytes
+	 *                 are allocated for the datagrams).
+	 */
+	explicit batch_receiver(tipc::socket& sock, unsigned depth = 16,
+			std::size_t max_size = TIPC_MAX_USER_MSG_SIZE);
+
+	/**
+	 * Get the next message.
+	 *
+	 * @param data Where to store a pointer to the message (valid until
+	 *             the next call).
+	 * @param n Where to store the message size.
+	 * @param from Where to store the sender address (if not NULL).
+	 * @param block Wait for a datagram if there is none pending.
+	 *
+	 * @return false if block is false and there was no message pending.
+	 */
+	bool next(const void*& data, std::size_t& n, sockaddr* from = NULL,
+			bool block = true) throw (error);
+
+private:
+
+	tipc::socket& _sock;
+	std::vector< char > _bufs;
+	std::vector< sockaddr > _from;
+	std::vector< iovec > _iovs;
+	std::vector< mmsghdr > _msgs;
+
+	// Datagrams received and current one
+	unsigned _received;
+	unsigned _current;
+	batch_reader _reader;
+
+};
+
+} } } // namespace posixx::linux::tipc
+
+
+
+inline
+posixx::linux::tipc::batch_reader::batch_reader(const void* buf,
+		std::size_t n) throw ():
+		_pos(static_cast< const unsigned char* >(buf)),
+		_end(static_cast< const unsigned char* >(buf) + n)
+{
+}
+
+inline
+bool posixx::linux::tipc::batch_reader::next(const void*& data,
+		std::size_t& n) throw (error)
+{
+	if (_pos == _end)
+		return false;
+	// skip the rest of the batch on errors
+	if (_end - _pos < static_cast< std::ptrdiff_t >(HEADER)) {
+		_pos = _end;
+		errno = EPROTO;
+		throw error("tipc batch header");
+	}
+	n = (std::size_t(_pos[0]) << 8) | _pos[1];
+	if (static_cast< std::size_t >(_end - _pos) - HEADER < n) {
+		_pos = _end;
+		errno = EPROTO;
+		throw error("tipc batch record");
+	}
+	data = _pos + HEADER;
+	_pos += HEADER + n;
+	return true;
+}
+
+inline
+void posixx::linux::tipc::batch_reader::append(std::vector< char >& batch,
+		const void* buf, std::size_t n) throw (error)
+{
+	if (n > MAX_RECORD) {
+		errno = EMSGSIZE;
+		throw error("tipc batch record");
+	}
+	std::size_t pos = batch.size();
+	batch.resize(pos + HEADER + n);
+	batch[pos] = static_cast< char >(n >> 8);
+	batch[pos + 1] = static_cast< char >(n & 0xff);
+	if (n)
+		std::memcpy(&batch[pos + HEADER], buf, n);
+}
+
+
+inline
+posixx::linux::tipc::batch_sender::config::config() throw ():
+		max_size(1400), max_delay(1000000), scope(ZONE)
+{
+}
+
+inline
+posixx::linux::tipc::batch_sender::batch_sender(tipc::socket& sock,
+		const config& cfg):
+		_sock(sock), _cfg(cfg)
+{
+}
+
+inline
+posixx::linux::tipc::batch_sender::batch&
+posixx::linux::tipc::batch_sender::_batch(const nameseq& to)
+{
+	for (std::size_t i = 0; i < _batches.size(); ++i)
+		if (_batches[i].to.name_seq() == to)
+			return _batches[i];
+	batch b;
+	b.to = sockaddr(to, _cfg.scope);
+	b.messages = 0;
+	b.started = 0;
+	_batches.push_back(b);
+	_batches.back().data.reserve(_cfg.max_size);
+	_ready.push_back(false);
+	return _batches.back();
+}
+
+inline
+void posixx::linux::tipc::batch_sender::send(const nameseq& to,
+		const void* buf, std::size_t n, uint64_t t) throw (error)
+{
+	if (n > batch_reader::MAX_RECORD) {
+		errno = EMSGSIZE;
+		throw error("tipc batch record");
+	}
+	batch& b = _batch(to);
+	std::size_t i = &b - &_batches[0];
+	// doesn't fit, send what we have first
+	if (b.messages && b.data.size() + batch_reader::HEADER + n
+			> _cfg.max_size) {
+		_ready[i] = true;
+		_flush();
+	}
+	if (!b.messages)
+		b.started = t;
+	batch_reader::append(b.data, buf, n);
+	++b.messages;
+	if (b.data.size() >= _cfg.max_size
+			|| t - b.started >= _cfg.max_delay) {
+		_ready[i] = true;
+		_flush();
+	}
+}
+
+inline
+std::size_t posixx::linux::tipc::batch_sender::flush_expired(uint64_t t)
+		throw (error)
+{
+	for (std::size_t i = 0; i < _batches.size(); ++i)
+		_ready[i] = _batches[i].messages
+				&& t - _batches[i].started >= _cfg.max_delay;
+	return _flush();
+}
+
+inline
+std::size_t posixx::linux::tipc::batch_sender::flush() throw (error)
+{
+	for (std::size_t i = 0; i < _batches.size(); ++i)
+		_ready[i] = _batches[i].messages;
+	return _flush();
+}
+
+inline
+std::size_t posixx::linux::tipc::batch_sender::_flush() throw (error)
+{
+	_msgs.clear();
+	_iovs.clear();
+	_index.clear();
+	for (std::size_t i = 0; i < _batches.size(); ++i) {
+		if (!_ready[i])
+			continue;
+		_ready[i] = false;
+		iovec iov;
+		iov.iov_base = &_batches[i].data[0];
+		iov.iov_len = _batches[i].data.size();
+		_iovs.push_back(iov);
+		_index.push_back(i);
+	}
+	if (_index.empty())
+		return 0;
+	_msgs.resize(_index.size());
+	for (std::size_t i = 0; i < _index.size(); ++i) {
+		msghdr& m = _msgs[i].msg_hdr;
+		std::memset(&m, 0, sizeof(m));
+		m.msg_name = &_batches[_index[i]].to;
+		m.msg_namelen = _batches[_index[i]].to.length();
+		m.msg_iov = &_iovs[i];
+		m.msg_iovlen = 1;
+		_msgs[i].msg_len = 0;
+	}
+	// sendmmsg() can send less messages than requested, the batches
+	// that were not sent (if it fails) are kept for the next flush
+	std::size_t sent = 0;
+	while (sent < _msgs.size()) {
+		std::size_t n = 1;
+		if (_msgs.size() - sent == 1)
+			_sock.send(&_msgs[sent].msg_hdr);
+		else
+			n = _sock.send(&_msgs[sent], _msgs.size() - sent);
+		for (std::size_t i = sent; i < sent + n; ++i) {
+			batch& b = _batches[_index[i]];
+			b.data.clear();
+			b.messages = 0;
+		}
+		sent += n;
+	}
+	return sent;
+}
+
+inline
+uint64_t posixx::linux::tipc::batch_sender::deadline() const throw ()
+{
+	uint64_t d = 0;
+	for (std::size_t i = 0; i < _batches.size(); ++i) {
+		const batch& b = _batches[i];
+		if (b.messages && (d == 0 || b.started + _cfg.max_delay < d))
+			d = b.started + _cfg.max_delay;
+	}
+	return d;
+}
+
+inline
+std::size_t posixx::linux::tipc::batch_sender::pending() const throw ()
+{
+	std::size_t n = 0;
+	for (std::size_t i = 0; i < _batches.size(); ++i)
+		n += _batches[i].messages;
+	return n;
+}
+
+inline
+const posixx::linux::tipc::batch_sender::config&
+posixx::linux::tipc::batch_sender::conf() const throw ()
+{
+	return _cfg;
+}
+
+
+inline
+posixx::linux::tipc::batch_receiver::batch_receiver(tipc::socket& sock,
+		unsigned depth, std::size_t max_size):
+		_sock(sock), _bufs(depth * max_size),
+		_from(depth), _iovs(depth), _msgs(depth), _received(0),
+		_current(0), _reader(NULL, 0)
+{
+	for (unsigned i = 0; i < depth; ++i) {
+		_iovs[i].iov_base = &_bufs[i * max_size];
+		_iovs[i].iov_len = max_size;
+	}
+}
+
+inline
+bool posixx::linux::tipc::batch_receiver::next(const void*& data,
+		std::size_t& n, sockaddr* from, bool block) throw (error)
+{
+	while (!_reader.next(data, n)) {
+		if (++_current >= _received) {
+			for (std::size_t i = 0; i < _msgs.size(); ++i) {
+				msghdr& m = _msgs[i].msg_hdr;
+				std::memset(&m, 0, sizeof(m));
+				m.msg_name = &_from[i];
+				m.msg_namelen = sizeof(_from[i]);
+				m.msg_iov = &_iovs[i];
+				m.msg_iovlen = 1;
+			}
+			try {
+				_received = _sock.recv(&_msgs[0], _msgs.size(),
+						block ? MSG_WAITFORONE
+						: MSG_DONTWAIT);
+			}
+			catch (const error& e) {
+				if (!block && (e.no == EAGAIN
+						|| e.no == EWOULDBLOCK))
+					return false;
+				throw;
+			}
+			_current = 0;
+		}
+		_reader = batch_reader(_iovs[_current].iov_base,
+				_msgs[_current].msg_len);
+	}
+	if (from)
+		*from = _from[_current];
+	return true;
+}
+
+#endif // POSIXX_LINUX_TIPC_BATCH_HPP_
@@ -0,0 +1,239 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_TIPC_GROUP_HPP_
+#define POSIXX_LINUX_TIPC_GROUP_HPP_
+
+#include "../tipc.hpp" // posixx::linux::tipc
+#include "opt.hpp" // posixx::linux::tipc::opt::GROUP_JOIN, group_req
+
+#include <cstring> // std::memset
+#include <sys/socket.h> // msghdr, MSG_OOB, MSG_EOR
+#include <sys/uio.h> // iovec
+
+/// @file
+
+namespace posixx { namespace linux { namespace tipc {
+
+/// Kind of message received by a group_socket.
+enum group_event_t
+{
+	/// A regular message sent by a member.
+	GROUP_MESSAGE,
+	/// A member joined the group.
+	MEMBER_UP,
+	/// A member left the group (or its node went down).
+	MEMBER_DOWN
+};
+
+/// Information about a message received by group_socket::recv().
+struct group_msg
+{
+	/// Kind of message.
+	group_event_t event;
+	/// Socket of the member that sent the message (or joined or left).
+	portid from;
+	/// Member identity (the instance it used to join the group).
+	__u32 member;
+	/// Message size (0 for membership events).
+	std::size_t size;
+};
+
+/**
+ * Socket member of a TIPC communication group.
+ *
+ * Communication groups (available since Linux 4.14) provide
+ * flow-controlled, reliable messaging among the members of a group, which
+ * scales much better than sending unicast messages to every other member.
+ * Each member is identified by the group type and its own instance, and
+ * messages can be sent using any of the group send modes:
+ *
+ * - broadcast(): to all the members.
+ * - anycast(): to one of the members with a given instance (selected
+ *   round robin by TIPC).
+ * - multicast(): to all the members with instances in a range.
+ * - unicast(): to a specific member socket.
+ *
+ * If the GROUP_MEMBER_EVTS flag is used when joining, recv() reports
+ * when members join and leave the group too.
+ *
+ * @code
+ * using namespace posixx::linux::tipc;
+ * group_socket g(name(4711, 1));
+ * g.broadcast("hello", 5);
+ * group_msg m;
+ * g.recv(buf, sizeof(buf), m);
+ * if (m.event == MEMBER_UP)
+ *	g.unicast("welcome", 7, m.from);
+ * @endcode
+ */
+struct group_socket: tipc::socket
+{
+
+	/// Create a socket that is not member of any group.
+	group_socket() throw (error);
+
+	/**
+	 * Create a socket and join a group.
+	 *
+	 * @see join()
+	 */
+	explicit group_socket(const tipc::name& member,
+			scope_t scope = CLUSTER,
+			int flags = tipc::opt::GROUP_MEMBER_EVTS) throw (error);
+
+	/**
+	 * Join a group.
+	 *
+	 * @param member Group type and member instance.
+	 * @param scope Visibility of the membership (NODE or CLUSTER).
+	 * @param flags Combination of tipc::opt::group_flags.
+	 */
+	void join(const tipc::name& member, scope_t scope = CLUSTER,
+			int flags = tipc::opt::GROUP_MEMBER_EVTS) throw (error);
+
+	/// Leave the group.
+	void leave() throw (error);
+
+	/// Get the type of the group (0 if not member of a group).
+	__u32 group() const throw ();
+
+	/// Send a message to all the members.
+	ssize_t broadcast(const void* buf, size_t n, int flags = 0)
+			throw (error);
+
+	/// Send a message to one of the members with a given instance.
+	ssize_t anycast(const void* buf, size_t n, __u32 instance,
+			int flags = 0) throw (error);
+
+	/// Send a message to all the members with instances in a range.
+	ssize_t multicast(const void* buf, size_t n, __u32 lower,
+			__u32 upper, int flags = 0) throw (error);
+
+	/// Send a message to a specific member socket.
+	ssize_t unicast(const void* buf, size_t n, const portid& to,
+			int flags = 0) throw (error);
+
+	/**
+	 * Receive a message or a membership event.
+	 *
+	 * @param buf Message buffer.
+	 * @param n Maximum message length.
+	 * @param msg Where to store information about the message.
+	 * @param flags Receiving options.
+	 *
+	 * @return The number of characters received (0 for membership
+	 *         events).
+	 */
+	ssize_t recv(void* buf, size_t n, group_msg& msg, int flags = 0)
+			throw (error);
+
+	using tipc::socket::send;
+	using tipc::socket::recv;
+
+private:
+
+	// Type of the group joined (0 if none)
+	__u32 _group;
+
+};
+
+} } } // namespace posixx::linux::tipc
+
+
+
+inline
+posixx::linux::tipc::group_socket::group_socket() throw (error):
+		tipc::socket(posixx::socket::RDM), _group(0)
+{
+}
+
+inline
+posixx::linux::tipc::group_socket::group_socket(const tipc::name& member,
+		scope_t scope, int flags) throw (error):
+		tipc::socket(posixx::socket::RDM), _group(0)
+{
+	join(member, scope, flags);
+}
+
+inline
+void posixx::linux::tipc::group_socket::join(const tipc::name& member,
+		scope_t scope, int flags) throw (error)
+{
+	opt< tipc::opt::GROUP_JOIN >(tipc::opt::group_req(member.type,
+			member.instance, scope, flags));
+	_group = member.type;
+}
+
+inline
+void posixx::linux::tipc::group_socket::leave() throw (error)
+{
+	set_opt< tipc::opt::GROUP_LEAVE >();
+	_group = 0;
+}
+
+inline
+__u32 posixx::linux::tipc::group_socket::group() const throw ()
+{
+	return _group;
+}
+
+inline
+ssize_t posixx::linux::tipc::group_socket::broadcast(const void* buf,
+		size_t n, int flags) throw (error)
+{
+	return send(buf, n, flags);
+}
+
+inline
+ssize_t posixx::linux::tipc::group_socket::anycast(const void* buf,
+		size_t n, __u32 instance, int flags) throw (error)
+{
+	return send(buf, n, sockaddr(tipc::name(_group, instance)), flags);
+}
+
+inline
+ssize_t posixx::linux::tipc::group_socket::multicast(const void* buf,
+		size_t n, __u32 lower, __u32 upper, int flags) throw (error)
+{
+	return send(buf, n, sockaddr(nameseq(_group, lower, upper)), flags);
+}
+
+inline
+ssize_t posixx::linux::tipc::group_socket::unicast(const void* buf,
+		size_t n, const portid& to, int flags) throw (error)
+{
+	return send(buf, n, sockaddr(to), flags);
+}
+
+inline
+ssize_t posixx::linux::tipc::group_socket::recv(void* buf, size_t n,
+		group_msg& msg, int flags) throw (error)
+{
+	// the member identity comes as a second address
+	sockaddr from[2];
+	iovec iov;
+	iov.iov_base = buf;
+	iov.iov_len = n;
+	msghdr m;
+	std::memset(&m, 0, sizeof(m));
+	m.msg_name = from;
+	m.msg_namelen = sizeof(from);
+	m.msg_iov = &iov;
+	m.msg_iovlen = 1;
+	ssize_t s = tipc::socket::recv(&m, flags);
+	msg.event = GROUP_MESSAGE;
+	if (m.msg_flags & MSG_OOB)
+		msg.event = (m.msg_flags & MSG_EOR) ? MEMBER_DOWN : MEMBER_UP;
+	msg.from = from[0].port_id();
+	msg.member = 0;
+	if (m.msg_namelen >= sizeof(from))
+		msg.member = from[1].port_name().instance;
+	msg.size = s;
+	return s;
+}
+
+#endif // POSIXX_LINUX_TIPC_GROUP_HPP_
@@ -21,14 +21,17 @@ namespace posixx { namespace linux { namespace tipc {
  */
 namespace opt {
 
-#define MKSOLOPT(O, T) \
+#define MKSOLOPT_RW(O, T, R, W) \
 	struct O { \
 		enum { \
 			level   = SOL_TIPC, \
 			optname = TIPC_ ## O, \
-			read    = true, \
-			write   = true }; \
+			read    = R, \
+			write   = W }; \
 		typedef T type; }
+#define MKSOLOPT(O, T) MKSOLOPT_RW(O, T, true, true)
+#define MKSOLOPT_R(O, T) MKSOLOPT_RW(O, T, true, false)
+#define MKSOLOPT_W(O, T) MKSOLOPT_RW(O, T, false, true)
 
 /**
  * How to handle messages sent by the socket if link congestion occurs.
@@ -70,7 +73,89 @@ MKSOLOPT(DEST_DROPPABLE, int);
  */
 MKSOLOPT(CONN_TIMEOUT, int);
 
+/// @see GROUP_JOIN
+enum group_flags
+{
+	/// Receive a copy of the messages sent by the socket to the group.
+	GROUP_LOOPBACK = TIPC_GROUP_LOOPBACK,
+	/// Receive membership events (see group_socket::recv()).
+	GROUP_MEMBER_EVTS = TIPC_GROUP_MEMBER_EVTS
+};
+
+/// Group membership request (see GROUP_JOIN).
+struct group_req: tipc_group_req
+{
+
+	/// Constructor (all fields are 0).
+	group_req() throw ();
+
+	/**
+	 * Constructor.
+	 *
+	 * @param type Group identity (port name type).
+	 * @param instance Member identity inside the group.
+	 * @param scope Visibility of the membership (TIPC_*_SCOPE).
+	 * @param flags Combination of group_flags.
+	 */
+	group_req(__u32 type, __u32 instance,
+			__u32 scope = TIPC_CLUSTER_SCOPE, __u32 flags = 0)
+			throw ();
+
+};
+
+/**
+ * Join a communication group (only for socket::RDM sockets).
+ *
+ * The socket becomes a member of the group identified by the type, with
+ * the given instance as member identity. Messages sent after joining are
+ * delivered only to (and flow-controlled by) the other members.
+ *
+ * A socket can be member of only one group at a time.
+ *
+ * The option is write-only here because reading it gives just the group
+ * type (a __u32), not a group_req (see group_socket::group()).
+ *
+ * @see group_socket
+ */
+MKSOLOPT_W(GROUP_JOIN, group_req);
+
+/**
+ * Leave the communication group.
+ *
+ * It takes no argument, use tipc::socket::set_opt().
+ */
+MKSOLOPT_W(GROUP_LEAVE, void);
+
+/**
+ * Always use broadcast to send multicast messages.
+ *
+ * By default TIPC selects between broadcast and replicast (a unicast to
+ * each destination) depending on the number of destinations. It takes no
+ * argument, use tipc::socket::set_opt().
+ */
+MKSOLOPT_W(MCAST_BROADCAST, void);
+
+/// Always use replicast to send multicast messages (see MCAST_BROADCAST).
+MKSOLOPT_W(MCAST_REPLICAST, void);
+
+/// Number of messages in the socket receive queue.
+MKSOLOPT_R(SOCK_RECVQ_DEPTH, __u32);
+
+/// Bytes used by the socket receive queue (since Linux 4.16).
+MKSOLOPT_R(SOCK_RECVQ_USED, __u32);
+
+/**
+ * Number of messages in the node receive queue.
+ *
+ * Obsolete since TIPC doesn't have a node queue anymore (newer kernels
+ * always return 0), use SOCK_RECVQ_DEPTH instead.
+ */
+MKSOLOPT_R(NODE_RECVQ_DEPTH, __u32);
+
+#undef MKSOLOPT_W
+#undef MKSOLOPT_R
 #undef MKSOLOPT
+#undef MKSOLOPT_RW
 
 /// @see IMPORTANCE
 enum importance
@@ -105,4 +190,25 @@ struct IMPORTANCE
 
 } } } } // namespace posixx::linux::tipc::opt
 
+
+
+inline
+posixx::linux::tipc::opt::group_req::group_req() throw ()
+{
+	type = 0;
+	instance = 0;
+	scope = 0;
+	flags = 0;
+}
+
+inline
+posixx::linux::tipc::opt::group_req::group_req(__u32 type, __u32 instance,
+		__u32 scope, __u32 flags) throw ()
+{
+	this->type = type;
+	this->instance = instance;
+	this->scope = scope;
+	this->flags = flags;
+}
+
 #endif // POSIXX_LINUX_TIPC_OPT_HPP_
@@ -0,0 +1,268 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_TIPC_QUEUE_SAMPLER_HPP_
+#define POSIXX_LINUX_TIPC_QUEUE_SAMPLER_HPP_
+
+#include "../tipc.hpp" // posixx::linux::tipc
+#include "opt.hpp" // SOCK_RECVQ_DEPTH, SOCK_RECVQ_USED
+#include "../../histogram.hpp" // posixx::histogram
+
+#include <vector> // std::vector
+#include <sys/socket.h> // getsockopt
+
+/// @file
+
+namespace posixx { namespace linux { namespace tipc {
+
+/**
+ * Sample the receive queue depth of a set of TIPC sockets.
+ *
+ * Each call to sample() reads the receive queue depth (in messages) and,
+ * optionally, the bytes used by the queue of every socket, using one
+ * getsockopt() per value and without allocating memory, so it's cheap
+ * enough to be called every millisecond.
+ *
+ * For every socket the sampler keeps the last values, the maximum depth
+ * and an exponentially weighted moving average of the depth. It also keeps
+ * the total and maximum depth of the last sample and a histogram of the
+ * total depth.
+ *
+ * sample() and queues() must be used from the same thread, but total(),
+ * max() and depths() can be read from any thread, so load shedding
+ * decisions can be taken without locking.
+ *
+ * @code
+ * using namespace posixx::linux::tipc;
+ * queue_sampler qs;
+ * qs.add(sock1);
+ * qs.add(sock2);
+ * // every millisecond
+ * qs.sample();
+ * // in any thread
+ * if (qs.max() > 1000)
+ *	shed_load();
+ * @endcode
+ */
+struct queue_sampler
+{
+
+	/// Receive queue statistics of a socket.
+	struct queue
+	{
+		/// Socket file descriptor.
+		int fd;
+		/// Messages in the queue (last sample).
+		__u32 depth;
+		/// Bytes used by the queue (last sample, if sampled).
+		__u32 used;
+		/// Maximum depth seen (since the last reset()).
+		__u32 max_depth;
+		/// Moving average of the depth.
+		double avg_depth;
+	};
+
+	/// Sampled sockets.
+	typedef std::vector< queue > queues_type;
+
+	/**
+	 * Constructor.
+	 *
+	 * @param alpha Weight of each sample in the moving average (between
+	 *              0 and 1).
+	 * @param bytes Sample the bytes used by the queues too (it needs an
+	 *              extra system call per socket and Linux 4.16).
+	 */
+	explicit queue_sampler(double alpha = 0.1, bool bytes = false);
+
+	/// Add a socket (it must be kept open while it's being sampled).
+	void add(const tipc::socket& sock);
+
+	/// Add a socket by file descriptor.
+	void add(int fd);
+
+	/**
+	 * Remove a socket.
+	 *
+	 * @return false if the socket was not being sampled.
+	 */
+	bool remove(int fd) throw ();
+
+	/// Sample all the sockets.
+	void sample() throw (error);
+
+	/**
+	 * Record a sample of a queue obtained by other means.
+	 *
+	 * Only that queue is updated, call commit() after recording all of
+	 * them to update the totals.
+	 *
+	 * @param i Index of the queue (in the order they were added).
+	 * @param depth Messages in the queue.
+	 * @param used Bytes used by the queue.
+	 */
+	void record(std::size_t i, __u32 depth, __u32 used = 0) throw ();
+
+	/// Update the totals with the values recorded for each queue.
+	void commit() throw ();
+
+	/// Get the sampled queues.
+	const queues_type& queues() const throw ();
+
+	/// Total depth of all the queues in the last sample.
+	unsigned long total() const throw ();
+
+	/// Maximum depth of any queue in the last sample.
+	unsigned long max() const throw ();
+
+	/// Number of samples taken.
+	unsigned long samples() const throw ();
+
+	/// Histogram of the total depth (safe to snapshot from any thread).
+	const histogram& depths() const throw ();
+
+	/// Reset the maximums and the histogram.
+	void reset() throw ();
+
+private:
+
+	double _alpha;
+	bool _bytes;
+	queues_type _queues;
+	unsigned long _total;
+	unsigned long _max;
+	unsigned long _samples;
+	histogram _depths;
+
+};
+
+} } } // namespace posixx::linux::tipc
+
+
+
+inline
+posixx::linux::tipc::queue_sampler::queue_sampler(double alpha, bool bytes):
+		_alpha(alpha), _bytes(bytes), _total(0), _max(0), _samples(0)
+{
+}
+
+inline
+void posixx::linux::tipc::queue_sampler::add(const tipc::socket& sock)
+{
+	add(sock.fd());
+}
+
+inline
+void posixx::linux::tipc::queue_sampler::add(int fd)
+{
+	queue q = { fd, 0, 0, 0, 0.0 };
+	_queues.push_back(q);
+}
+
+inline
+bool posixx::linux::tipc::queue_sampler::remove(int fd) throw ()
+{
+	for (queues_type::iterator i = _queues.begin(); i != _queues.end();
+			++i)
+		if (i->fd == fd) {
+			_queues.erase(i);
+			return true;
+		}
+	return false;
+}
+
+inline
+void posixx::linux::tipc::queue_sampler::record(std::size_t i, __u32 depth,
+		__u32 used) throw ()
+{
+	queue& q = _queues[i];
+	q.depth = depth;
+	q.used = used;
+	if (depth > q.max_depth)
+		q.max_depth = depth;
+	q.avg_depth += _alpha * (depth - q.avg_depth);
+}
+
+inline
+void posixx::linux::tipc::queue_sampler::commit() throw ()
+{
+	unsigned long total = 0;
+	unsigned long max = 0;
+	for (queues_type::const_iterator i = _queues.begin();
+			i != _queues.end(); ++i) {
+		total += i->depth;
+		if (i->depth > max)
+			max = i->depth;
+	}
+	__atomic_store_n(&_total, total, __ATOMIC_RELAXED);
+	__atomic_store_n(&_max, max, __ATOMIC_RELAXED);
+	__atomic_store_n(&_samples, _samples + 1, __ATOMIC_RELAXED);
+	_depths.record(total);
+}
+
+inline
+void posixx::linux::tipc::queue_sampler::sample() throw (error)
+{
+	for (std::size_t i = 0; i < _queues.size(); ++i) {
+		__u32 depth = 0;
+		__u32 used = 0;
+		socklen_t len = sizeof(depth);
+		if (::getsockopt(_queues[i].fd, SOL_TIPC,
+				opt::SOCK_RECVQ_DEPTH::optname, &depth,
+				&len) == -1)
+			throw error("getsockopt SOCK_RECVQ_DEPTH");
+		len = sizeof(used);
+		if (_bytes && ::getsockopt(_queues[i].fd, SOL_TIPC,
+				opt::SOCK_RECVQ_USED::optname, &used,
+				&len) == -1)
+			throw error("getsockopt SOCK_RECVQ_USED");
+		record(i, depth, used);
+	}
+	commit();
+}
+
+inline
+const posixx::linux::tipc::queue_sampler::queues_type&
+posixx::linux::tipc::queue_sampler::queues() const throw ()
+{
+	return _queues;
+}
+
+inline
+unsigned long posixx::linux::tipc::queue_sampler::total() const throw ()
+{
+	return __atomic_load_n(&_total, __ATOMIC_RELAXED);
+}
+
+inline
+unsigned long posixx::linux::tipc::queue_sampler::max() const throw ()
+{
+	return __atomic_load_n(&_max, __ATOMIC_RELAXED);
+}
+
+inline
+unsigned long posixx::linux::tipc::queue_sampler::samples() const throw ()
+{
+	return __atomic_load_n(&_samples, __ATOMIC_RELAXED);
+}
+
+inline
+const posixx::histogram& posixx::linux::tipc::queue_sampler::depths() const
+		throw ()
+{
+	return _depths;
+}
+
+inline
+void posixx::linux::tipc::queue_sampler::reset() throw ()
+{
+	for (queues_type::iterator i = _queues.begin(); i != _queues.end();
+			++i)
+		i->max_depth = i->depth;
+	_depths.reset();
+}
+
+#endif // POSIXX_LINUX_TIPC_QUEUE_SAMPLER_HPP_
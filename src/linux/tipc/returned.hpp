@@ -0,0 +1,190 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_TIPC_RETURNED_HPP_
+#define POSIXX_LINUX_TIPC_RETURNED_HPP_
+
+#include "../tipc.hpp" // posixx::linux::tipc
+
+#include <vector> // std::vector
+#include <cstring> // std::memset, std::memcpy
+#include <sys/socket.h> // msghdr, cmsghdr, CMSG_*
+#include <sys/uio.h> // iovec
+
+/// @file
+
+namespace posixx { namespace linux { namespace tipc {
+
+/**
+ * Information about a message received by receiver::recv().
+ */
+struct msg_info
+{
+
+	/**
+	 * Port the message came from.
+	 *
+	 * For returned messages this is the port that returned the message
+	 * (the original destination), so it can be reported to a
+	 * port_selector.
+	 */
+	sockaddr from;
+
+	/// Why the message was returned (OK if it's a regular message).
+	reason_t reason;
+
+	/**
+	 * Size of the message data.
+	 *
+	 * For returned messages this is the size of the original message,
+	 * which can be bigger than what was copied to the user buffer.
+	 */
+	std::size_t size;
+
+	/**
+	 * Name sequence the message was sent to.
+	 *
+	 * Only available for messages sent to a name or a name sequence
+	 * (multicast), otherwise the type is 0.
+	 */
+	nameseq dest;
+
+	/// Flags returned by recvmsg() (MSG_TRUNC, MSG_CTRUNC, etc.).
+	int flags;
+
+	/// Constructor.
+	msg_info() throw ();
+
+	/// true if the message is a returned message.
+	bool returned() const throw ();
+
+};
+
+/**
+ * Receive messages from a TIPC socket, including returned messages.
+ *
+ * When a message can't be delivered (and the sender didn't ask to discard
+ * it with the DEST_DROPPABLE option), TIPC returns it to the sender. The
+ * returned message carries the reason (see reason_t) and the original
+ * data as ancillary data, which is only available through recvmsg().
+ *
+ * The receiver keeps the buffer for the ancillary data, so it can be
+ * reused for every message without allocating memory.
+ *
+ * @code
+ * using namespace posixx::linux::tipc;
+ * receiver r;
+ * msg_info info;
+ * ssize_t n = r.recv(sock, buf, sizeof(buf), info);
+ * if (info.returned())
+ *	selector.report(info.from.port_id(), info.reason);
+ * @endcode
+ */
+struct receiver
+{
+
+	/**
+	 * Constructor.
+	 *
+	 * @param max_returned Maximum size of the returned data to receive
+	 *                     (the rest is truncated and MSG_CTRUNC is set
+	 *                     in msg_info::flags).
+	 */
+	explicit receiver(std::size_t max_returned = TIPC_MAX_USER_MSG_SIZE);
+
+	/**
+	 * Receive a message.
+	 *
+	 * If the message is a returned message, the original data is copied
+	 * to buf and info.reason is set to the reason it was returned.
+	 *
+	 * @param sock Socket to receive from.
+	 * @param buf Message buffer.
+	 * @param n Maximum message length.
+	 * @param info Where to store information about the message.
+	 * @param flags Receiving options.
+	 *
+	 * @return The number of characters copied to buf (which can be 0).
+	 */
+	ssize_t recv(tipc::socket& sock, void* buf, std::size_t n,
+			msg_info& info, int flags = 0) throw (error);
+
+private:
+
+	// Ancillary data buffer
+	std::vector< char > _control;
+
+};
+
+} } } // namespace posixx::linux::tipc
+
+
+
+inline
+posixx::linux::tipc::msg_info::msg_info() throw ():
+		reason(OK), size(0), dest(0, 0, 0), flags(0)
+{
+}
+
+inline
+bool posixx::linux::tipc::msg_info::returned() const throw ()
+{
+	return reason != OK;
+}
+
+
+inline
+posixx::linux::tipc::receiver::receiver(std::size_t max_returned):
+		_control(CMSG_SPACE(2 * sizeof(__u32))
+				+ CMSG_SPACE(3 * sizeof(__u32))
+				+ CMSG_SPACE(max_returned))
+{
+}
+
+inline
+ssize_t posixx::linux::tipc::receiver::recv(tipc::socket& sock, void* buf,
+		std::size_t n, msg_info& info, int flags) throw (error)
+{
+	iovec iov;
+	iov.iov_base = buf;
+	iov.iov_len = n;
+	msghdr m;
+	std::memset(&m, 0, sizeof(m));
+	m.msg_name = &info.from;
+	m.msg_namelen = sizeof(info.from);
+	m.msg_iov = &iov;
+	m.msg_iovlen = 1;
+	m.msg_control = &_control[0];
+	m.msg_controllen = _control.size();
+	ssize_t s = sock.recv(&m, flags);
+	info.reason = OK;
+	info.size = s;
+	info.dest = nameseq(0, 0, 0);
+	info.flags = m.msg_flags;
+	for (cmsghdr* c = CMSG_FIRSTHDR(&m); c; c = CMSG_NXTHDR(&m, c)) {
+		if (c->cmsg_level != SOL_TIPC)
+			continue;
+		const __u32* d = reinterpret_cast< const __u32* >(CMSG_DATA(c));
+		switch (c->cmsg_type) {
+		case TIPC_ERRINFO:
+			info.reason = static_cast< reason_t >(d[0]);
+			info.size = d[1];
+			break;
+		case TIPC_RETDATA:
+			s = c->cmsg_len - CMSG_LEN(0);
+			if (static_cast< std::size_t >(s) > n)
+				s = n;
+			std::memcpy(buf, CMSG_DATA(c), s);
+			break;
+		case TIPC_DESTNAME:
+			info.dest = nameseq(d[0], d[1], d[2]);
+			break;
+		}
+	}
+	return s;
+}
+
+#endif // POSIXX_LINUX_TIPC_RETURNED_HPP_
@@ -0,0 +1,440 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_TIPC_TOPOLOGY_HPP_
+#define POSIXX_LINUX_TIPC_TOPOLOGY_HPP_
+
+#include "../tipc.hpp" // posixx::linux::tipc
+
+#include <vector> // std::vector
+#include <algorithm> // std::find
+#include <tr1/unordered_map> // std::tr1::unordered_map
+#include <cerrno> // EAGAIN, EWOULDBLOCK, EPROTO
+#include <stdint.h> // uint64_t
+
+/// @file
+
+namespace posixx { namespace linux { namespace tipc {
+
+/**
+ * Local copy of the TIPC name table, built from topology events.
+ *
+ * The table keeps all the publications reported by PUBLISHED events and
+ * removes them on WITHDRAWN events. Lookups by (type, instance) return the
+ * ports that published that name (each port once).
+ *
+ * Overlapping subscriptions report the same publication once each, so
+ * publications are counted and only removed by the last matching
+ * WITHDRAWN event.
+ *
+ * The first lookup of a name scans the publications of its type and caches
+ * the result. After that, lookups of the same name are O(1), and the cached
+ * results are updated in place when new events arrive, so a sender can
+ * resolve destinations on every message without asking the name service.
+ * Names that are not published are not cached, so looking up arbitrary
+ * names doesn't make the table grow (they are scanned on every lookup
+ * instead, until they are published).
+ *
+ * The table doesn't do any I/O. Use topology to feed it from the topology
+ * service, or apply() events obtained by other means.
+ */
+struct name_table
+{
+
+	/// Ports that published a name.
+	typedef std::vector< portid > ports;
+
+	/// Create an empty table.
+	name_table() throw ();
+
+	/// A published name sequence.
+	struct publication
+	{
+		/// Published name sequence.
+		nameseq seq;
+		/// Port that published it.
+		portid port;
+		/// Number of PUBLISHED events not withdrawn yet.
+		unsigned refs;
+	};
+
+	/// Publications of a name type.
+	typedef std::vector< publication > publications;
+
+	/**
+	 * Update the table with a topology event.
+	 *
+	 * @return true if the table changed (TIMEOUT events are ignored).
+	 */
+	bool apply(const subscr_event& ev);
+
+	/**
+	 * Get the ports that published a name.
+	 *
+	 * If the name is published, the returned reference is valid (and
+	 * updated) until the next call to clear(). Otherwise it's a reference
+	 * to an empty list that is never updated, so the name has to be looked
+	 * up again to see new publications.
+	 */
+	const ports& lookup(const name& n) const;
+
+	/// Get all the publications of a name type.
+	const publications& published(__u32 type) const;
+
+	/// Remove all the publications (and cached lookups).
+	void clear() throw ();
+
+	/**
+	 * Get the version of the table.
+	 *
+	 * The version changes every time the table changes, so it can be used
+	 * to know when to refresh data derived from the table.
+	 */
+	unsigned long version() const throw ();
+
+private:
+
+	// Version, incremented on every change
+	unsigned long _version;
+
+	// Cache key for a name
+	static uint64_t _key(__u32 type, __u32 instance) throw ();
+
+	// Tell if a port publishes an instance
+	static bool _covers(const publications& pubs, __u32 instance,
+			const portid& port) throw ();
+
+	// Publications, by type
+	typedef std::tr1::unordered_map< __u32, publications > pub_map;
+	pub_map _pubs;
+
+	// Cached lookups, by name
+	typedef std::tr1::unordered_map< uint64_t, ports > cache_map;
+	mutable cache_map _cache;
+
+	// Cached instances, by type (to update the cache on events)
+	typedef std::tr1::unordered_map< __u32, std::vector< __u32 > >
+			cached_map;
+	mutable cached_map _cached;
+
+};
+
+/**
+ * TIPC topology service client.
+ *
+ * Connects to the topology service (TOP_SRV), subscribes to name
+ * sequences and keeps a name_table updated with the events received.
+ *
+ * The client doesn't start any thread, events are processed when process()
+ * or process_all() are called. The socket file descriptor (fd()) can be
+ * polled to know when there are events to process.
+ *
+ * @code
+ * using namespace posixx::linux::tipc;
+ * topology top;
+ * top.subscribe(nameseq(1000, 0, 99));
+ * // ...
+ * top.process_all();
+ * const name_table::ports& p = top.lookup(name(1000, 7));
+ * if (!p.empty())
+ *	sock.send(buf, n, sockaddr(p[0]));
+ * @endcode
+ */
+struct topology
+{
+
+	/**
+	 * Connect to the topology service.
+	 *
+	 * @param domain Node (or cluster or zone) whose topology service to
+	 *               use (the default 0 means the local node).
+	 */
+	explicit topology(tipc::addr domain = tipc::addr(0u)) throw (error);
+
+	/**
+	 * Subscribe to a name sequence.
+	 *
+	 * @param seq The port name sequence of interest.
+	 * @param filter Event filter (see subscr_t).
+	 * @param timeout Subscription timeout in ms (or WAIT_FOREVER).
+	 */
+	void subscribe(const nameseq& seq, __u32 filter = SUB_PORTS,
+			__u32 timeout = WAIT_FOREVER) throw (error);
+
+	/**
+	 * Cancel a subscription to a name sequence.
+	 *
+	 * The publications already in the table are not removed.
+	 *
+	 * @return false if there was no subscription to seq.
+	 */
+	bool unsubscribe(const nameseq& seq) throw (error);
+
+	/**
+	 * Process one event.
+	 *
+	 * @param ev Where to store the event (if not NULL).
+	 * @param block Wait for an event if there is none pending.
+	 *
+	 * @return false if block is false and there was no event pending.
+	 */
+	bool process(subscr_event* ev = NULL, bool block = true) throw (error);
+
+	/**
+	 * Process all the pending events, without blocking.
+	 *
+	 * @return Number of events processed.
+	 */
+	std::size_t process_all() throw (error);
+
+	/// Get the ports that published a name (see name_table::lookup()).
+	const name_table::ports& lookup(const name& n) const;
+
+	/// Get the name table.
+	const name_table& table() const throw ();
+
+	/// Get the subscriptions in effect.
+	const std::vector< subscr >& subscriptions() const throw ();
+
+	/// Get the topology service connection file descriptor.
+	int fd() const throw ();
+
+private:
+
+	// Connection to the topology service
+	tipc::socket _sock;
+
+	// Subscriptions in effect (needed to cancel them)
+	std::vector< subscr > _subs;
+
+	// The name table
+	name_table _table;
+
+};
+
+} } } // namespace posixx::linux::tipc
+
+
+
+inline
+posixx::linux::tipc::name_table::name_table() throw (): _version(0)
+{
+}
+
+inline
+uint64_t posixx::linux::tipc::name_table::_key(__u32 type, __u32 instance)
+		throw ()
+{
+	return static_cast< uint64_t >(type) << 32 | instance;
+}
+
+inline
+bool posixx::linux::tipc::name_table::apply(const subscr_event& ev)
+{
+	if (ev.event != PUBLISHED && ev.event != WITHDRAWN)
+		return false;
+	__u32 type = ev.subscription().name_seq().type;
+	publication p = { nameseq(type, ev.found_lower, ev.found_upper),
+			ev.port_id(), 1 };
+	publications& pubs = _pubs[type];
+	publications::iterator i = pubs.begin();
+	for (; i != pubs.end(); ++i)
+		if (i->seq == p.seq && i->port == p.port)
+			break;
+	if (ev.event == PUBLISHED) {
+		// already reported by another subscription
+		if (i != pubs.end()) {
+			++i->refs;
+			return false;
+		}
+		pubs.push_back(p);
+	}
+	else {
+		if (i == pubs.end() || --i->refs)
+			return false;
+		*i = pubs.back();
+		pubs.pop_back();
+	}
+	++_version;
+	// update the cached lookups affected by the publication
+	cached_map::const_iterator c = _cached.find(type);
+	if (c == _cached.end())
+		return true;
+	for (std::vector< __u32 >::const_iterator i = c->second.begin();
+			i != c->second.end(); ++i) {
+		if (*i < p.seq.lower || *i > p.seq.upper)
+			continue;
+		ports& ps = _cache[_key(type, *i)];
+		ports::iterator j = std::find(ps.begin(), ps.end(), p.port);
+		if (ev.event == PUBLISHED) {
+			if (j == ps.end())
+				ps.push_back(p.port);
+		}
+		// the port might still publish it in another sequence
+		else if (j != ps.end() && !_covers(pubs, *i, p.port))
+			ps.erase(j);
+	}
+	return true;
+}
+
+inline
+bool posixx::linux::tipc::name_table::_covers(const publications& pubs,
+		__u32 instance, const portid& port) throw ()
+{
+	for (publications::const_iterator i = pubs.begin(); i != pubs.end();
+			++i)
+		if (i->port == port && instance >= i->seq.lower
+				&& instance <= i->seq.upper)
+			return true;
+	return false;
+}
+
+inline
+const posixx::linux::tipc::name_table::ports&
+posixx::linux::tipc::name_table::lookup(const name& n) const
+{
+	static const ports none;
+	uint64_t k = _key(n.type, n.instance);
+	cache_map::iterator c = _cache.find(k);
+	if (c != _cache.end())
+		return c->second;
+	ports found;
+	const publications& pubs = published(n.type);
+	for (publications::const_iterator i = pubs.begin(); i != pubs.end();
+			++i)
+		if (n.instance >= i->seq.lower && n.instance <= i->seq.upper
+				&& std::find(found.begin(), found.end(),
+				i->port) == found.end())
+			found.push_back(i->port);
+	// misses are not cached, anybody can look up any name
+	if (found.empty())
+		return none;
+	ports& ps = _cache[k];
+	ps.swap(found);
+	_cached[n.type].push_back(n.instance);
+	return ps;
+}
+
+inline
+const posixx::linux::tipc::name_table::publications&
+posixx::linux::tipc::name_table::published(__u32 type) const
+{
+	static const publications none;
+	pub_map::const_iterator i = _pubs.find(type);
+	if (i == _pubs.end())
+		return none;
+	return i->second;
+}
+
+inline
+void posixx::linux::tipc::name_table::clear() throw ()
+{
+	_pubs.clear();
+	_cache.clear();
+	_cached.clear();
+	++_version;
+}
+
+inline
+unsigned long posixx::linux::tipc::name_table::version() const throw ()
+{
+	return _version;
+}
+
+
+inline
+posixx::linux::tipc::topology::topology(tipc::addr domain) throw (error):
+		_sock(posixx::socket::SEQPACKET)
+{
+	_sock.connect(sockaddr(name(TOP_SRV, TOP_SRV), ZONE, domain));
+}
+
+inline
+void posixx::linux::tipc::topology::subscribe(const nameseq& seq,
+		__u32 filter, __u32 timeout) throw (error)
+{
+	subscr s(seq, timeout, filter);
+	_sock.send(&s, sizeof(s));
+	_subs.push_back(s);
+}
+
+inline
+bool posixx::linux::tipc::topology::unsubscribe(const nameseq& seq)
+		throw (error)
+{
+	for (std::vector< subscr >::iterator i = _subs.begin();
+			i != _subs.end(); ++i) {
+		if (!(i->name_seq() == seq))
+			continue;
+		subscr s = *i;
+		s.filter |= SUB_CANCEL;
+		_sock.send(&s, sizeof(s));
+		_subs.erase(i);
+		return true;
+	}
+	return false;
+}
+
+inline
+bool posixx::linux::tipc::topology::process(subscr_event* ev, bool block)
+		throw (error)
+{
+	subscr_event e;
+	try {
+		ssize_t n = _sock.recv(&e, sizeof(e), block ? 0 : MSG_DONTWAIT);
+		if (n != sizeof(e)) {
+			errno = EPROTO;
+			throw error("topology event");
+		}
+	}
+	catch (const error& err) {
+		if (!block && (err.no == EAGAIN || err.no == EWOULDBLOCK))
+			return false;
+		throw;
+	}
+	_table.apply(e);
+	if (ev)
+		*ev = e;
+	return true;
+}
+
+inline
+std::size_t posixx::linux::tipc::topology::process_all() throw (error)
+{
+	std::size_t n = 0;
+	while (process(NULL, false))
+		++n;
+	return n;
+}
+
+inline
+const posixx::linux::tipc::name_table::ports&
+posixx::linux::tipc::topology::lookup(const name& n) const
+{
+	return _table.lookup(n);
+}
+
+inline
+const posixx::linux::tipc::name_table& posixx::linux::tipc::topology::table()
+		const throw ()
+{
+	return _table;
+}
+
+inline
+const std::vector< posixx::linux::tipc::subscr >&
+posixx::linux::tipc::topology::subscriptions() const throw ()
+{
+	return _subs;
+}
+
+inline
+int posixx::linux::tipc::topology::fd() const throw ()
+{
+	return _sock.fd();
+}
+
+#endif // POSIXX_LINUX_TIPC_TOPOLOGY_HPP_
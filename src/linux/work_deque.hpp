@@ -0,0 +1,161 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_LINUX_WORK_DEQUE_HPP_
+#define POSIXX_LINUX_WORK_DEQUE_HPP_
+
+#include <vector> // std::vector
+#include <cstddef> // std::size_t, ptrdiff_t
+
+/// @file
+
+namespace posixx { namespace linux {
+
+/**
+ * Chase-Lev work-stealing deque of pointers.
+ *
+ * The owner thread pushes and pops elements at the bottom (LIFO, which
+ * keeps the most recently produced, and cache-hot, work local) while any
+ * other thread can steal elements from the top (FIFO) without locking.
+ *
+ * The capacity is fixed (rounded up to a power of two); push() fails when
+ * the deque is full so the caller can fall back to another queue.
+ *
+ * @see "Dynamic Circular Work-Stealing Deque" (Chase and Lev, 2005) and
+ *      "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê
+ *      et al., 2013), which this implementation follows.
+ */
+template < typename T >
+struct work_deque
+{
+
+	/// Create a deque with room for at least capacity elements.
+	explicit work_deque(std::size_t capacity);
+
+	/// Push an element at the bottom (owner only).
+	bool push(T* v) throw ();
+
+	/// Pop an element from the bottom (owner only, NULL if empty).
+	T* pop() throw ();
+
+	/**
+	 * Steal an element from the top (any thread).
+	 *
+	 * NULL is returned if the deque is empty or if another thread won
+	 * the race for the top element.
+	 */
+	T* steal() throw ();
+
+	/// Approximate number of elements.
+	std::size_t size() const throw ();
+
+	/// Maximum number of elements.
+	std::size_t capacity() const throw ();
+
+private:
+
+	// Hidden copy constructor and assign operator
+	work_deque(const work_deque& d);
+	work_deque& operator=(const work_deque& d);
+
+	std::vector< T* > _buffer;
+	std::ptrdiff_t _mask;
+	// padding to avoid false sharing between owner and thieves
+	char _pad0[64];
+	std::ptrdiff_t _top;
+	char _pad1[64];
+	std::ptrdiff_t _bottom;
+	char _pad2[64];
+
+};
+
+} } // namespace posixx::linux
+
+
+
+template < typename T >
+inline
+posixx::linux::work_deque< T >::work_deque(std::size_t capacity):
+		_top(0), _bottom(0)
+{
+	std::size_t c = 1;
+	while (c < capacity)
+		c <<= 1;
+	_buffer.resize(c);
+	_mask = c - 1;
+}
+
+template < typename T >
+inline
+bool posixx::linux::work_deque< T >::push(T* v) throw ()
+{
+	std::ptrdiff_t b = __atomic_load_n(&_bottom, __ATOMIC_RELAXED);
+	std::ptrdiff_t t = __atomic_load_n(&_top, __ATOMIC_ACQUIRE);
+	if (b - t > _mask)
+		return false;
+	__atomic_store_n(&_buffer[b & _mask], v, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&_bottom, b + 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+template < typename T >
+inline
+T* posixx::linux::work_deque< T >::pop() throw ()
+{
+	std::ptrdiff_t b = __atomic_load_n(&_bottom, __ATOMIC_RELAXED) - 1;
+	__atomic_store_n(&_bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	std::ptrdiff_t t = __atomic_load_n(&_top, __ATOMIC_RELAXED);
+	if (t > b) {
+		// empty
+		__atomic_store_n(&_bottom, b + 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	T* v = __atomic_load_n(&_buffer[b & _mask], __ATOMIC_RELAXED);
+	if (t == b) {
+		// last element, race against thieves for it
+		if (!__atomic_compare_exchange_n(&_top, &t, t + 1, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+			v = NULL;
+		__atomic_store_n(&_bottom, b + 1, __ATOMIC_RELAXED);
+	}
+	return v;
+}
+
+template < typename T >
+inline
+T* posixx::linux::work_deque< T >::steal() throw ()
+{
+	std::ptrdiff_t t = __atomic_load_n(&_top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	std::ptrdiff_t b = __atomic_load_n(&_bottom, __ATOMIC_ACQUIRE);
+	if (t >= b)
+		return NULL;
+	T* v = __atomic_load_n(&_buffer[t & _mask], __ATOMIC_RELAXED);
+	if (!__atomic_compare_exchange_n(&_top, &t, t + 1, false,
+			__ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return NULL;
+	return v;
+}
+
+template < typename T >
+inline
+std::size_t posixx::linux::work_deque< T >::size() const throw ()
+{
+	std::ptrdiff_t b = __atomic_load_n(&_bottom, __ATOMIC_RELAXED);
+	std::ptrdiff_t t = __atomic_load_n(&_top, __ATOMIC_RELAXED);
+	return b > t ? b - t : 0;
+}
+
+template < typename T >
+inline
+std::size_t posixx::linux::work_deque< T >::capacity() const throw ()
+{
+	return _buffer.size();
+}
+
+#endif // POSIXX_LINUX_WORK_DEQUE_HPP_
@@ -0,0 +1,611 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SIMD_HPP_
+#define POSIXX_SIMD_HPP_
+
+#include <cstddef> // std::size_t
+#include <cstring> // std::memchr(), memcmp(), memcpy()
+#include <stdint.h> // uint32_t, uint64_t
+
+// SSE2 is always available on x86-64, AVX2 is detected at runtime. Define
+// POSIXX_NO_SIMD to use only the scalar versions.
+#if !defined(POSIXX_NO_SIMD) && \
+		(defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#	define POSIXX_SIMD_X86 1
+#	include <immintrin.h> // SSE2 and AVX2 intrinsics
+#	define POSIXX_SIMD_AVX2 __attribute__ ((target ("avx2")))
+#else
+#	define POSIXX_SIMD_X86 0
+#endif
+
+/// @file
+
+namespace posixx {
+
+/**
+ * Vectorized byte search, comparison and hashing primitives.
+ *
+ * All the functions work on raw memory (bytes). The functions in this
+ * namespace dispatch, at runtime, to the best implementation supported by
+ * the CPU (see active()): avx2, sse2 or scalar. Each implementation can be
+ * used directly too (only the scalar one is always available), which is
+ * mostly useful for testing and benchmarking.
+ *
+ * Search functions return the offset of the match, or npos if there is no
+ * match.
+ */
+namespace simd {
+
+/// Returned by the search functions when there is no match.
+const std::size_t npos = static_cast< std::size_t >(-1);
+
+/// Implementation level.
+enum level
+{
+	/// Plain C++ (and the C library).
+	SCALAR,
+	/// 16 bytes at a time using SSE2.
+	SSE2,
+	/// 32 bytes at a time using AVX2.
+	AVX2
+};
+
+/// Best implementation level supported by the CPU.
+level supported() throw ();
+
+/// Implementation level used by the dispatching functions.
+level active() throw ();
+
+/**
+ * Change the implementation level used by the dispatching functions.
+ *
+ * If l is not supported, supported() is used instead.
+ *
+ * @return The previously active level.
+ */
+level use(level l) throw ();
+
+/**
+ * Find the first byte equal to c in [p, p + n).
+ *
+ * This is always memchr(3), which the C library already vectorizes.
+ */
+std::size_t find(const void* p, std::size_t n, unsigned char c) throw ();
+
+/// Find the first byte in [p, p + n) that is equal to any byte in the set.
+std::size_t find_any(const void* p, std::size_t n, const void* set,
+		std::size_t set_n) throw ();
+
+/**
+ * Find the first occurrence of the substring [s, s + m) in [p, p + n).
+ *
+ * An empty substring is found at offset 0.
+ */
+std::size_t find(const void* p, std::size_t n, const void* s, std::size_t m)
+		throw ();
+
+/// Compare [p, p + n) and [q, q + n) for equality.
+bool equal(const void* p, const void* q, std::size_t n) throw ();
+
+/**
+ * Fast non-cryptographic hash (XXH64) of [p, p + n).
+ *
+ * This is not vectorized: it uses 4 independent 64-bit multiply lanes, which
+ * is faster than what SSE2 or AVX2 can do (they lack a 64-bit multiply).
+ * The result depends on the CPU endianness.
+ */
+uint64_t hash(const void* p, std::size_t n, uint64_t seed = 0) throw ();
+
+/**
+ * Fast hash of a 64-bit value (the XXH64 avalanche).
+ *
+ * It's a bijection, so it's well suited for hashing small fixed-size keys
+ * (packed in a 64-bit integer) much faster than hash() can.
+ */
+uint64_t mix(uint64_t v) throw ();
+
+/// Portable implementation (using the C library when possible).
+namespace scalar {
+	std::size_t find(const void* p, std::size_t n, unsigned char c)
+			throw ();
+	std::size_t find_any(const void* p, std::size_t n, const void* set,
+			std::size_t set_n) throw ();
+	std::size_t find(const void* p, std::size_t n, const void* s,
+			std::size_t m) throw ();
+	bool equal(const void* p, const void* q, std::size_t n) throw ();
+}
+
+#if POSIXX_SIMD_X86
+
+/// SSE2 implementation.
+namespace sse2 {
+	std::size_t find_any(const void* p, std::size_t n, const void* set,
+			std::size_t set_n) throw ();
+	std::size_t find(const void* p, std::size_t n, const void* s,
+			std::size_t m) throw ();
+	bool equal(const void* p, const void* q, std::size_t n) throw ();
+}
+
+/// AVX2 implementation (only usable if supported() is AVX2).
+namespace avx2 {
+	POSIXX_SIMD_AVX2
+	std::size_t find_any(const void* p, std::size_t n, const void* set,
+			std::size_t set_n) throw ();
+	POSIXX_SIMD_AVX2
+	std::size_t find(const void* p, std::size_t n, const void* s,
+			std::size_t m) throw ();
+	POSIXX_SIMD_AVX2
+	bool equal(const void* p, const void* q, std::size_t n) throw ();
+}
+
+#endif // POSIXX_SIMD_X86
+
+// Storage for the active level
+int& active_level_() throw ();
+
+// Biggest set find_any() handles with vector compares (bigger sets use a
+// lookup table)
+const std::size_t MAX_VECTOR_SET = 16;
+
+} } // namespace posixx::simd
+
+
+
+inline
+posixx::simd::level posixx::simd::supported() throw ()
+{
+#if POSIXX_SIMD_X86
+	static const level l = (__builtin_cpu_init(),
+			__builtin_cpu_supports("avx2")) ? AVX2 : SSE2;
+	return l;
+#else
+	return SCALAR;
+#endif
+}
+
+inline
+int& posixx::simd::active_level_() throw ()
+{
+	static int l = supported();
+	return l;
+}
+
+inline
+posixx::simd::level posixx::simd::active() throw ()
+{
+	return static_cast< level >(
+			__atomic_load_n(&active_level_(), __ATOMIC_RELAXED));
+}
+
+inline
+posixx::simd::level posixx::simd::use(level l) throw ()
+{
+	if (l > supported())
+		l = supported();
+	return static_cast< level >(__atomic_exchange_n(&active_level_(),
+			static_cast< int >(l), __ATOMIC_RELAXED));
+}
+
+
+// Scalar implementation
+//////////////////////////////////////////////////////////////////////
+
+inline
+std::size_t posixx::simd::scalar::find(const void* p, std::size_t n,
+		unsigned char c) throw ()
+{
+	const void* r = std::memchr(p, c, n);
+	if (r == NULL)
+		return npos;
+	return static_cast< const unsigned char* >(r)
+			- static_cast< const unsigned char* >(p);
+}
+
+inline
+std::size_t posixx::simd::scalar::find_any(const void* p, std::size_t n,
+		const void* set, std::size_t set_n) throw ()
+{
+	const unsigned char* s = static_cast< const unsigned char* >(p);
+	const unsigned char* b = static_cast< const unsigned char* >(set);
+	uint32_t table[256 / 32] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	for (std::size_t i = 0; i < set_n; ++i)
+		table[b[i] / 32] |= uint32_t(1) << (b[i] % 32);
+	for (std::size_t i = 0; i < n; ++i)
+		if (table[s[i] / 32] & (uint32_t(1) << (s[i] % 32)))
+			return i;
+	return npos;
+}
+
+inline
+std::size_t posixx::simd::scalar::find(const void* p, std::size_t n,
+		const void* s, std::size_t m) throw ()
+{
+	const unsigned char* h = static_cast< const unsigned char* >(p);
+	const unsigned char* nd = static_cast< const unsigned char* >(s);
+	if (m == 0)
+		return 0;
+	if (m > n)
+		return npos;
+	std::size_t i = 0;
+	while (i + m <= n) {
+		std::size_t f = find(h + i, n - m + 1 - i, nd[0]);
+		if (f == npos)
+			return npos;
+		i += f;
+		if (std::memcmp(h + i + 1, nd + 1, m - 1) == 0)
+			return i;
+		++i;
+	}
+	return npos;
+}
+
+inline
+bool posixx::simd::scalar::equal(const void* p, const void* q, std::size_t n)
+		throw ()
+{
+	return std::memcmp(p, q, n) == 0;
+}
+
+
+#if POSIXX_SIMD_X86
+
+// SSE2 implementation
+//////////////////////////////////////////////////////////////////////
+
+inline
+std::size_t posixx::simd::sse2::find_any(const void* p, std::size_t n,
+		const void* set, std::size_t set_n) throw ()
+{
+	if (set_n == 0)
+		return npos;
+	if (set_n == 1)
+		return scalar::find(p, n,
+				*static_cast< const unsigned char* >(set));
+	if (set_n > MAX_VECTOR_SET)
+		return scalar::find_any(p, n, set, set_n);
+	const unsigned char* s = static_cast< const unsigned char* >(p);
+	const unsigned char* b = static_cast< const unsigned char* >(set);
+	__m128i v[MAX_VECTOR_SET];
+	for (std::size_t k = 0; k < set_n; ++k)
+		v[k] = _mm_set1_epi8(static_cast< char >(b[k]));
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128(
+				reinterpret_cast< const __m128i* >(s + i));
+		__m128i r = _mm_cmpeq_epi8(x, v[0]);
+		for (std::size_t k = 1; k < set_n; ++k)
+			r = _mm_or_si128(r, _mm_cmpeq_epi8(x, v[k]));
+		int m = _mm_movemask_epi8(r);
+		if (m)
+			return i + __builtin_ctz(m);
+	}
+	std::size_t r = scalar::find_any(s + i, n - i, set, set_n);
+	return r == npos ? npos : i + r;
+}
+
+inline
+std::size_t posixx::simd::sse2::find(const void* p, std::size_t n,
+		const void* s, std::size_t m) throw ()
+{
+	const unsigned char* h = static_cast< const unsigned char* >(p);
+	const unsigned char* nd = static_cast< const unsigned char* >(s);
+	if (m == 0)
+		return 0;
+	if (m > n)
+		return npos;
+	if (m == 1)
+		return scalar::find(p, n, nd[0]);
+	// compare the first and last bytes of 16 candidates at a time, and
+	// only check the rest of the candidates matching both
+	const __m128i first = _mm_set1_epi8(static_cast< char >(nd[0]));
+	const __m128i last = _mm_set1_epi8(static_cast< char >(nd[m - 1]));
+	std::size_t i = 0;
+	for (; i + m - 1 + 16 <= n; i += 16) {
+		__m128i a = _mm_loadu_si128(
+				reinterpret_cast< const __m128i* >(h + i));
+		__m128i b = _mm_loadu_si128(
+				reinterpret_cast< const __m128i* >(h + i + m - 1));
+		unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+				_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		while (mask) {
+			unsigned bit = __builtin_ctz(mask);
+			if (std::memcmp(h + i + bit + 1, nd + 1, m - 2) == 0)
+				return i + bit;
+			mask &= mask - 1;
+		}
+	}
+	std::size_t r = scalar::find(h + i, n - i, nd, m);
+	return r == npos ? npos : i + r;
+}
+
+inline
+bool posixx::simd::sse2::equal(const void* p, const void* q, std::size_t n)
+		throw ()
+{
+	const unsigned char* a = static_cast< const unsigned char* >(p);
+	const unsigned char* b = static_cast< const unsigned char* >(q);
+	std::size_t i = 0;
+	// 64 bytes per iteration, to keep several loads in flight
+	for (; i + 64 <= n; i += 64) {
+		const __m128i* x = reinterpret_cast< const __m128i* >(a + i);
+		const __m128i* y = reinterpret_cast< const __m128i* >(b + i);
+		__m128i r0 = _mm_cmpeq_epi8(_mm_loadu_si128(x),
+				_mm_loadu_si128(y));
+		__m128i r1 = _mm_cmpeq_epi8(_mm_loadu_si128(x + 1),
+				_mm_loadu_si128(y + 1));
+		__m128i r2 = _mm_cmpeq_epi8(_mm_loadu_si128(x + 2),
+				_mm_loadu_si128(y + 2));
+		__m128i r3 = _mm_cmpeq_epi8(_mm_loadu_si128(x + 3),
+				_mm_loadu_si128(y + 3));
+		if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(r0, r1),
+				_mm_and_si128(r2, r3))) != 0xffff)
+			return false;
+	}
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128(
+				reinterpret_cast< const __m128i* >(a + i));
+		__m128i y = _mm_loadu_si128(
+				reinterpret_cast< const __m128i* >(b + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff)
+			return false;
+	}
+	return std::memcmp(a + i, b + i, n - i) == 0;
+}
+
+
+// AVX2 implementation
+//////////////////////////////////////////////////////////////////////
+
+POSIXX_SIMD_AVX2
+inline
+std::size_t posixx::simd::avx2::find_any(const void* p, std::size_t n,
+		const void* set, std::size_t set_n) throw ()
+{
+	if (set_n == 0)
+		return npos;
+	if (set_n == 1)
+		return scalar::find(p, n,
+				*static_cast< const unsigned char* >(set));
+	if (set_n > MAX_VECTOR_SET)
+		return scalar::find_any(p, n, set, set_n);
+	const unsigned char* s = static_cast< const unsigned char* >(p);
+	const unsigned char* b = static_cast< const unsigned char* >(set);
+	__m256i v[MAX_VECTOR_SET];
+	for (std::size_t k = 0; k < set_n; ++k)
+		v[k] = _mm256_set1_epi8(static_cast< char >(b[k]));
+	std::size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256(
+				reinterpret_cast< const __m256i* >(s + i));
+		__m256i r = _mm256_cmpeq_epi8(x, v[0]);
+		for (std::size_t k = 1; k < set_n; ++k)
+			r = _mm256_or_si256(r, _mm256_cmpeq_epi8(x, v[k]));
+		unsigned m = _mm256_movemask_epi8(r);
+		if (m)
+			return i + __builtin_ctz(m);
+	}
+	std::size_t r = sse2::find_any(s + i, n - i, set, set_n);
+	return r == npos ? npos : i + r;
+}
+
+POSIXX_SIMD_AVX2
+inline
+std::size_t posixx::simd::avx2::find(const void* p, std::size_t n,
+		const void* s, std::size_t m) throw ()
+{
+	const unsigned char* h = static_cast< const unsigned char* >(p);
+	const unsigned char* nd = static_cast< const unsigned char* >(s);
+	if (m == 0)
+		return 0;
+	if (m > n)
+		return npos;
+	if (m == 1)
+		return scalar::find(p, n, nd[0]);
+	// same as sse2::find(), but with 32 candidates at a time
+	const __m256i first = _mm256_set1_epi8(static_cast< char >(nd[0]));
+	const __m256i last = _mm256_set1_epi8(static_cast< char >(nd[m - 1]));
+	std::size_t i = 0;
+	for (; i + m - 1 + 32 <= n; i += 32) {
+		__m256i a = _mm256_loadu_si256(
+				reinterpret_cast< const __m256i* >(h + i));
+		__m256i b = _mm256_loadu_si256(
+				reinterpret_cast< const __m256i* >(h + i + m - 1));
+		unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(
+				_mm256_cmpeq_epi8(a, first),
+				_mm256_cmpeq_epi8(b, last)));
+		while (mask) {
+			unsigned bit = __builtin_ctz(mask);
+			if (std::memcmp(h + i + bit + 1, nd + 1, m - 2) == 0)
+				return i + bit;
+			mask &= mask - 1;
+		}
+	}
+	std::size_t r = sse2::find(h + i, n - i, nd, m);
+	return r == npos ? npos : i + r;
+}
+
+POSIXX_SIMD_AVX2
+inline
+bool posixx::simd::avx2::equal(const void* p, const void* q, std::size_t n)
+		throw ()
+{
+	const unsigned char* a = static_cast< const unsigned char* >(p);
+	const unsigned char* b = static_cast< const unsigned char* >(q);
+	std::size_t i = 0;
+	// 128 bytes per iteration, to keep several loads in flight
+	for (; i + 128 <= n; i += 128) {
+		const __m256i* x = reinterpret_cast< const __m256i* >(a + i);
+		const __m256i* y = reinterpret_cast< const __m256i* >(b + i);
+		__m256i r0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(x),
+				_mm256_loadu_si256(y));
+		__m256i r1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(x + 1),
+				_mm256_loadu_si256(y + 1));
+		__m256i r2 = _mm256_cmpeq_epi8(_mm256_loadu_si256(x + 2),
+				_mm256_loadu_si256(y + 2));
+		__m256i r3 = _mm256_cmpeq_epi8(_mm256_loadu_si256(x + 3),
+				_mm256_loadu_si256(y + 3));
+		if (~_mm256_movemask_epi8(_mm256_and_si256(
+				_mm256_and_si256(r0, r1),
+				_mm256_and_si256(r2, r3))))
+			return false;
+	}
+	for (; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256(
+				reinterpret_cast< const __m256i* >(a + i));
+		__m256i y = _mm256_loadu_si256(
+				reinterpret_cast< const __m256i* >(b + i));
+		if (~_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)))
+			return false;
+	}
+	return sse2::equal(a + i, b + i, n - i);
+}
+
+#endif // POSIXX_SIMD_X86
+
+
+// Dispatching functions
+//////////////////////////////////////////////////////////////////////
+
+inline
+std::size_t posixx::simd::find(const void* p, std::size_t n, unsigned char c)
+		throw ()
+{
+	// memchr(3) is already vectorized (with its own runtime dispatch) by
+	// any decent C library, and it is faster than a plain SSE2/AVX2 loop
+	return scalar::find(p, n, c);
+}
+
+inline
+std::size_t posixx::simd::find_any(const void* p, std::size_t n,
+		const void* set, std::size_t set_n) throw ()
+{
+#if POSIXX_SIMD_X86
+	switch (active()) {
+	case AVX2:
+		return avx2::find_any(p, n, set, set_n);
+	case SSE2:
+		return sse2::find_any(p, n, set, set_n);
+	default:
+		break;
+	}
+#endif
+	return scalar::find_any(p, n, set, set_n);
+}
+
+inline
+std::size_t posixx::simd::find(const void* p, std::size_t n, const void* s,
+		std::size_t m) throw ()
+{
+#if POSIXX_SIMD_X86
+	switch (active()) {
+	case AVX2:
+		return avx2::find(p, n, s, m);
+	case SSE2:
+		return sse2::find(p, n, s, m);
+	default:
+		break;
+	}
+#endif
+	return scalar::find(p, n, s, m);
+}
+
+inline
+bool posixx::simd::equal(const void* p, const void* q, std::size_t n) throw ()
+{
+#if POSIXX_SIMD_X86
+	switch (active()) {
+	case AVX2:
+		return avx2::equal(p, q, n);
+	case SSE2:
+		return sse2::equal(p, q, n);
+	default:
+		break;
+	}
+#endif
+	return scalar::equal(p, q, n);
+}
+
+inline
+uint64_t posixx::simd::hash(const void* p, std::size_t n, uint64_t seed)
+		throw ()
+{
+	// XXH64, see https://github.com/Cyan4973/xxHash
+	const uint64_t p1 = (uint64_t(0x9e3779b1u) << 32) | 0x85ebca87u;
+	const uint64_t p2 = (uint64_t(0xc2b2ae3du) << 32) | 0x27d4eb4fu;
+	const uint64_t p3 = (uint64_t(0x165667b1u) << 32) | 0x9e3779f9u;
+	const uint64_t p4 = (uint64_t(0x85ebca77u) << 32) | 0xc2b2ae63u;
+	const uint64_t p5 = (uint64_t(0x27d4eb2fu) << 32) | 0x165667c5u;
+	const unsigned char* s = static_cast< const unsigned char* >(p);
+	const unsigned char* end = s + n;
+	uint64_t h;
+	uint64_t k;
+#define POSIXX_SIMD_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+#define POSIXX_SIMD_ROUND(acc, in) \
+		acc += (in) * p2; acc = POSIXX_SIMD_ROTL(acc, 31); acc *= p1
+	if (n >= 32) {
+		uint64_t v[4] = { seed + p1 + p2, seed + p2, seed, seed - p1 };
+		do {
+			std::memcpy(&k, s, 8);
+			POSIXX_SIMD_ROUND(v[0], k);
+			std::memcpy(&k, s + 8, 8);
+			POSIXX_SIMD_ROUND(v[1], k);
+			std::memcpy(&k, s + 16, 8);
+			POSIXX_SIMD_ROUND(v[2], k);
+			std::memcpy(&k, s + 24, 8);
+			POSIXX_SIMD_ROUND(v[3], k);
+			s += 32;
+		} while (s + 32 <= end);
+		h = POSIXX_SIMD_ROTL(v[0], 1) + POSIXX_SIMD_ROTL(v[1], 7)
+				+ POSIXX_SIMD_ROTL(v[2], 12)
+				+ POSIXX_SIMD_ROTL(v[3], 18);
+		for (int j = 0; j < 4; ++j) {
+			uint64_t a = 0;
+			POSIXX_SIMD_ROUND(a, v[j]);
+			h ^= a;
+			h = h * p1 + p4;
+		}
+	}
+	else
+		h = seed + p5;
+	h += n;
+	for (; s + 8 <= end; s += 8) {
+		std::memcpy(&k, s, 8);
+		uint64_t a = 0;
+		POSIXX_SIMD_ROUND(a, k);
+		h ^= a;
+		h = POSIXX_SIMD_ROTL(h, 27) * p1 + p4;
+	}
+	if (s + 4 <= end) {
+		uint32_t w;
+		std::memcpy(&w, s, 4);
+		h ^= uint64_t(w) * p1;
+		h = POSIXX_SIMD_ROTL(h, 23) * p2 + p3;
+		s += 4;
+	}
+	for (; s < end; ++s) {
+		h ^= *s * p5;
+		h = POSIXX_SIMD_ROTL(h, 11) * p1;
+	}
+#undef POSIXX_SIMD_ROUND
+#undef POSIXX_SIMD_ROTL
+	return mix(h);
+}
+
+inline
+uint64_t posixx::simd::mix(uint64_t v) throw ()
+{
+	const uint64_t p2 = (uint64_t(0xc2b2ae3du) << 32) | 0x27d4eb4fu;
+	const uint64_t p3 = (uint64_t(0x165667b1u) << 32) | 0x9e3779f9u;
+	v ^= v >> 33;
+	v *= p2;
+	v ^= v >> 29;
+	v *= p3;
+	v ^= v >> 32;
+	return v;
+}
+
+#endif // POSIXX_SIMD_HPP_
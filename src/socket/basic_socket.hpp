@@ -9,10 +9,13 @@
 
 #include "../error.hpp" // posixx::error
 #include "../static_assert.hpp" // static_assert
+#include "stats.hpp" // posixx::socket::stats_of, op
 
 #include <string> // std::string
 #include <utility> // std::pair
 #include <sys/socket.h> // socket, send, recv, etc.
+#include <unistd.h> // close
+#include <time.h> // timespec
 
 /// @file
 
@@ -77,17 +80,24 @@ enum shutdown_mode
 /**
  * Generic socket interface.
  *
- * This class is thread-safe as it just stores a file descriptor for the socket.
+ * This class is thread-safe as it just stores a file descriptor for the socket
+ * (and the statistics, if enabled, are updated atomically).
+ *
+ * If TSockTraits defines a stats type, it's used as the statistics policy
+ * (see stats_traits), otherwise no statistics are kept at all (see no_stats).
  *
  * @see socket(7)
  */
 template < typename TSockTraits >
-struct basic_socket
+struct basic_socket: private stats_of< TSockTraits >::type
 {
 
 	/// Traits used by this socket
 	typedef TSockTraits traits;
 
+	/// Statistics policy used by this socket
+	typedef typename stats_of< TSockTraits >::type stats_type;
+
 	/**
 	 * Create an endpoint for communication.
 	 *
@@ -212,6 +222,75 @@ struct basic_socket
 	ssize_t recv(void* buf, size_t n, typename TSockTraits::sockaddr& from,
 			int flags = 0) throw (error);
 
+	/**
+	 * Send a message (with optional ancillary data) on the socket.
+	 *
+	 * Unlike the other send() variants, sending 0 characters is not an
+	 * error (the message can carry only ancillary data).
+	 *
+	 * @param msg Message to send.
+	 * @param flags Sending options.
+	 *
+	 * @return The number of characters sent.
+	 *
+	 * @see sendmsg(2)
+	 */
+	ssize_t send(const msghdr* msg, int flags = 0) throw (error);
+
+	/**
+	 * Receive a message (with optional ancillary data) on the socket.
+	 *
+	 * Unlike the other recv() variants, receiving 0 characters is not an
+	 * error, because some protocols report events that way (a returned
+	 * TIPC message, for example, carries its data in the ancillary data).
+	 * The caller should look at msg->msg_flags and the ancillary data to
+	 * interpret the result.
+	 *
+	 * @param msg Where to store the message.
+	 * @param flags Receiving options.
+	 *
+	 * @return The number of characters received.
+	 *
+	 * @see recvmsg(2)
+	 */
+	ssize_t recv(msghdr* msg, int flags = 0) throw (error);
+
+	/**
+	 * Send multiple messages on the socket with a single system call.
+	 *
+	 * The number of characters sent for each message is stored in its
+	 * msg_len field.
+	 *
+	 * @param msgs Messages to send.
+	 * @param n Number of messages.
+	 * @param flags Sending options.
+	 *
+	 * @return The number of messages sent (which can be less than n).
+	 *
+	 * @see sendmmsg(2)
+	 */
+	std::size_t send(mmsghdr* msgs, std::size_t n, int flags = 0)
+			throw (error);
+
+	/**
+	 * Receive multiple messages on the socket with a single system call.
+	 *
+	 * The number of characters received for each message is stored in
+	 * its msg_len field.
+	 *
+	 * @param msgs Where to store the messages.
+	 * @param n Maximum number of messages.
+	 * @param flags Receiving options (MSG_WAITFORONE is useful to
+	 *              return as soon as one message is received).
+	 * @param timeout Timeout (NULL means no timeout).
+	 *
+	 * @return The number of messages received.
+	 *
+	 * @see recvmmsg(2)
+	 */
+	std::size_t recv(mmsghdr* msgs, std::size_t n, int flags = 0,
+			timespec* timeout = NULL) throw (error);
+
 	/**
 	 * Get options on the socket.
 	 *
@@ -238,6 +317,16 @@ struct basic_socket
 	void setsockopt(int level, int optname, const TSockOpt& opt)
 			throw (error);
 
+	/**
+	 * Set an option that takes no argument on the socket.
+	 *
+	 * @param level Level at which the option reside.
+	 * @param optname Name of the option.
+	 *
+	 * @see setsockopt(2)
+	 */
+	void setsockopt(int level, int optname) throw (error);
+
 	/**
 	 * Get option on the socket (type-safe).
 	 *
@@ -269,6 +358,18 @@ struct basic_socket
 	template< typename TSockOpt >
 	void opt(const typename TSockOpt::type& opt) throw (error);
 
+	/**
+	 * Set an option that takes no argument on the socket (type-safe).
+	 *
+	 * Some options are just actions (like leaving a group) and the kernel
+	 * rejects them if any value is passed, so they are set with a NULL
+	 * value of length 0. The type of those options is void.
+	 *
+	 * @see opt(const typename TSockOpt::type&), setsockopt(int, int)
+	 */
+	template< typename TSockOpt >
+	void set_opt() throw (error);
+
 	/**
 	 * Listen for connections on the socket.
 	 *
@@ -433,6 +534,15 @@ struct basic_socket
 	 */
 	operator int () const throw ();
 
+	/**
+	 * Get the socket statistics.
+	 *
+	 * @return The statistics policy instance of this socket.
+	 *
+	 * @see stats_traits
+	 */
+	const stats_type& io_stats() const throw ();
+
 private:
 
 	/// Hidden copy constructor (it has non-copiable behavior).
@@ -460,6 +570,16 @@ template < typename TSock >
 inline
 std::pair< TSock*, TSock* > pair(type type, int protocol = 0) throw (error);
 
+/**
+ * Tell a socket address the length the kernel reported for it.
+ *
+ * Called after an address is filled by the kernel (accept(), recvfrom(),
+ * etc.). It does nothing by default; address types whose length is not
+ * fixed (like unix::sockaddr) specialize it to update their length.
+ */
+template < typename TSockaddr >
+void set_length(TSockaddr& addr, socklen_t len) throw ();
+
 } } // namespace posixx::socket
 
 
@@ -475,6 +595,12 @@ std::pair< TSock*, TSock* > posixx::socket::pair(type type, int protocol)
 	return std::make_pair(new TSock(fds[0]), new TSock(fds[1]));
 }
 
+template < typename TSockaddr >
+inline
+void posixx::socket::set_length(TSockaddr& addr, socklen_t len) throw ()
+{
+}
+
 
 template< typename TSockTraits >
 inline
@@ -510,8 +636,11 @@ void posixx::socket::basic_socket< TSockTraits >::connect(
 		const typename TSockTraits::sockaddr& addr)
 		throw (posixx::error)
 {
-	if (::connect(_fd, reinterpret_cast< const ::sockaddr* >(&addr),
-				addr.length()) == -1)
+	typename stats_type::stamp st = stats_type::start(CONNECT);
+	int r = ::connect(_fd, reinterpret_cast< const ::sockaddr* >(&addr),
+				addr.length());
+	stats_type::record(CONNECT, st, r);
+	if (r == -1)
 		throw error("connect");
 }
 
@@ -525,6 +654,7 @@ typename TSockTraits::sockaddr posixx::socket::basic_socket< TSockTraits >::name
 	// TODO assert len == sizeof(typename TSockTraits::sockaddr)
 	if (::getsockname(_fd, reinterpret_cast< ::sockaddr* >(&addr), &len) == -1)
 		throw error("getsockname");
+	set_length(addr, len);
 	return addr;
 }
 
@@ -538,6 +668,7 @@ posixx::socket::basic_socket< TSockTraits >::peer_name() const throw (posixx::er
 	// TODO assert len == sizeof(typename TSockTraits::sockaddr)
 	if (::getpeername(_fd, reinterpret_cast< ::sockaddr* >(&addr), &len) == -1)
 		throw error("getpeername");
+	set_length(addr, len);
 	return addr;
 }
 
@@ -546,7 +677,9 @@ inline
 ssize_t posixx::socket::basic_socket< TSockTraits >::send(const void* buf,
 		size_t n, int flags) throw (posixx::error)
 {
+	typename stats_type::stamp st = stats_type::start(SEND);
 	ssize_t s = ::send(_fd, buf, n, flags);
+	stats_type::record(SEND, st, s);
 	if (s == -1)
 		throw error("send");
 	if (s == 0)
@@ -559,7 +692,9 @@ inline
 ssize_t posixx::socket::basic_socket< TSockTraits >::recv(void* buf, size_t n, int flags)
 		throw (posixx::error)
 {
+	typename stats_type::stamp st = stats_type::start(RECV);
 	ssize_t s = ::recv(_fd, buf, n, flags);
+	stats_type::record(RECV, st, s);
 	if (s == -1)
 		throw error("recv");
 	if (s == 0)
@@ -573,9 +708,11 @@ ssize_t posixx::socket::basic_socket< TSockTraits >::send(const void* buf,
 		size_t n, const typename TSockTraits::sockaddr& to, int flags)
 		throw (posixx::error)
 {
+	typename stats_type::stamp st = stats_type::start(SEND);
 	ssize_t s = ::sendto(_fd, buf, n, flags,
 			reinterpret_cast< const ::sockaddr* >(&to),
 			to.length());
+	stats_type::record(SEND, st, s);
 	if (s == -1)
 		throw error("sendto");
 	if (s == 0) {
@@ -593,8 +730,10 @@ ssize_t posixx::socket::basic_socket< TSockTraits >::recv(void* buf, size_t n,
 		throw (posixx::error)
 {
 	socklen_t len = sizeof(typename TSockTraits::sockaddr);
+	typename stats_type::stamp st = stats_type::start(RECV);
 	ssize_t s = ::recvfrom(_fd, buf, n, flags,
 			reinterpret_cast< ::sockaddr* >(&from), &len);
+	stats_type::record(RECV, st, s);
 	if (s == -1)
 		throw error("recvfrom");
 	if (s == 0) {
@@ -602,34 +741,74 @@ ssize_t posixx::socket::basic_socket< TSockTraits >::recv(void* buf, size_t n,
 		e.no = 0;
 		throw e;
 	}
+	set_length(from, len);
 	return s;
 }
 
-/*
 template< typename TSockTraits >
 inline
-ssize_t posixx::socket::basic_socket< TSockTraits >::send(const msghdr* msg, int flags)
+ssize_t posixx::socket::basic_socket< TSockTraits >::send(const msghdr* msg,
+		int flags) throw (posixx::error)
 {
+	typename stats_type::stamp st = stats_type::start(SEND);
 	ssize_t s = ::sendmsg(_fd, msg, flags);
+	stats_type::record(SEND, st, s);
 	if (s == -1)
 		throw error("sendmsg");
-	if (s == 0)
-		throw error("send");
 	return s;
 }
 
 template< typename TSockTraits >
 inline
-ssize_t posixx::socket::basic_socket< TSockTraits >::recv(struct msghdr* msg, int flags)
+ssize_t posixx::socket::basic_socket< TSockTraits >::recv(msghdr* msg,
+		int flags) throw (posixx::error)
 {
+	typename stats_type::stamp st = stats_type::start(RECV);
 	ssize_t s = ::recvmsg(_fd, msg, flags);
+	stats_type::record(RECV, st, s);
 	if (s == -1)
 		throw error("recvmsg");
-	if (s == 0)
-		throw error("send");
 	return s;
 }
-*/
+
+template< typename TSockTraits >
+inline
+std::size_t posixx::socket::basic_socket< TSockTraits >::send(mmsghdr* msgs,
+		std::size_t n, int flags) throw (posixx::error)
+{
+	typename stats_type::stamp st = stats_type::start(SEND);
+	int s = ::sendmmsg(_fd, msgs, static_cast< unsigned >(n), flags);
+	ssize_t bytes = -1;
+	if (s != -1) {
+		bytes = 0;
+		for (int i = 0; i < s; ++i)
+			bytes += msgs[i].msg_len;
+	}
+	stats_type::record(SEND, st, bytes);
+	if (s == -1)
+		throw error("sendmmsg");
+	return s;
+}
+
+template< typename TSockTraits >
+inline
+std::size_t posixx::socket::basic_socket< TSockTraits >::recv(mmsghdr* msgs,
+		std::size_t n, int flags, timespec* timeout) throw (posixx::error)
+{
+	typename stats_type::stamp st = stats_type::start(RECV);
+	int s = ::recvmmsg(_fd, msgs, static_cast< unsigned >(n), flags,
+			timeout);
+	ssize_t bytes = -1;
+	if (s != -1) {
+		bytes = 0;
+		for (int i = 0; i < s; ++i)
+			bytes += msgs[i].msg_len;
+	}
+	stats_type::record(RECV, st, bytes);
+	if (s == -1)
+		throw error("recvmmsg");
+	return s;
+}
 
 template< typename TSockTraits >
 template< typename TSockOpt >
@@ -652,6 +831,15 @@ void posixx::socket::basic_socket< TSockTraits >::setsockopt(int level, int optn
 		throw error("setsockopt");
 }
 
+template< typename TSockTraits >
+inline
+void posixx::socket::basic_socket< TSockTraits >::setsockopt(int level,
+		int optname) throw (posixx::error)
+{
+	if (::setsockopt(_fd, level, optname, NULL, 0) == -1)
+		throw error("setsockopt");
+}
+
 template< typename TSockTraits >
 template< typename TSockOpt >
 inline
@@ -679,6 +867,16 @@ void posixx::socket::basic_socket< TSockTraits >::opt(
 		throw error("setsockopt");
 }
 
+template< typename TSockTraits >
+template< typename TSockOpt >
+inline
+void posixx::socket::basic_socket< TSockTraits >::set_opt()
+		throw (posixx::error)
+{
+	static_assert(TSockOpt::write, "Option is not writable");
+	setsockopt(TSockOpt::level, TSockOpt::optname);
+}
+
 template< typename TSockTraits >
 inline
 void posixx::socket::basic_socket< TSockTraits >::listen(int backlog) throw (posixx::error)
@@ -692,7 +890,9 @@ inline
 posixx::socket::basic_socket< TSockTraits >* posixx::socket::basic_socket< TSockTraits >::accept()
 		throw (posixx::error)
 {
+	typename stats_type::stamp st = stats_type::start(ACCEPT);
 	int fd = ::accept(_fd, 0, 0);
+	stats_type::record(ACCEPT, st, fd);
 	if (fd == -1)
 		throw error("accept");
 	return new basic_socket(fd);
@@ -706,9 +906,12 @@ posixx::socket::basic_socket< TSockTraits >::accept(typename TSockTraits::sockad
 {
 	socklen_t len = sizeof(typename TSockTraits::sockaddr);
 	// TODO assert len = sizeof(typename TSockTraits::sockaddr)
+	typename stats_type::stamp st = stats_type::start(ACCEPT);
 	int fd = ::accept(_fd, reinterpret_cast< ::sockaddr* >(&addr), &len);
+	stats_type::record(ACCEPT, st, fd);
 	if (fd == -1)
 		throw error("accept");
+	set_length(addr, len);
 	return new basic_socket(fd);
 }
 
@@ -846,6 +1049,14 @@ posixx::socket::basic_socket< TSockTraits >::operator int () const throw ()
 	return _fd;
 }
 
+template< typename TSockTraits >
+inline
+const typename posixx::socket::basic_socket< TSockTraits >::stats_type&
+posixx::socket::basic_socket< TSockTraits >::io_stats() const throw ()
+{
+	return *this;
+}
+
 #if 0
 
 template< typename TSockTraits >
@@ -0,0 +1,173 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_CMSG_HPP_
+#define POSIXX_SOCKET_CMSG_HPP_
+
+#include <cstring> // memcpy, memset
+#include <sys/socket.h> // msghdr, cmsghdr, CMSG_*
+
+/// @file
+
+namespace posixx { namespace socket {
+
+/**
+ * Ancillary data (control messages) helpers.
+ *
+ * Control messages are passed to basic_socket::send(const msghdr*, int)
+ * and got from basic_socket::recv(msghdr*, int). A writer appends them to
+ * a user provided buffer (so no memory is allocated), and find() looks
+ * for one in a received message.
+ *
+ * @code
+ * msghdr m = ...;
+ * cmsg::buffer< sizeof(uint16_t) > ctrl;
+ * cmsg::writer w(m, ctrl);
+ * w.put(SOL_UDP, UDP_SEGMENT, uint16_t(1400));
+ * s.send(&m);
+ * @endcode
+ *
+ * @see cmsg(3)
+ */
+namespace cmsg {
+
+/**
+ * Buffer for one control message, properly aligned.
+ *
+ * For more messages use the writer(msghdr&, void*, std::size_t)
+ * constructor with a buffer of the sum of their CMSG_SPACE().
+ *
+ * @param N Size of the control message data.
+ */
+template < std::size_t N >
+union buffer
+{
+	/// Buffer size
+	enum { SIZE = CMSG_SPACE(N) };
+	/// Buffer data
+	char data[SIZE];
+	/// Just to align the data
+	cmsghdr align;
+};
+
+/**
+ * Control messages writer.
+ *
+ * Sets the control messages of a msghdr, using a user provided buffer.
+ */
+struct writer
+{
+
+	/**
+	 * Start writing control messages.
+	 *
+	 * The msghdr control messages are reset.
+	 *
+	 * @param m Message to add the control messages to.
+	 * @param buf Buffer where to store the control messages (it must be
+	 *            suitably aligned for a cmsghdr).
+	 * @param size Size of the buffer.
+	 */
+	writer(msghdr& m, void* buf, std::size_t size) throw ();
+
+	/// Start writing control messages using a cmsg::buffer.
+	template < std::size_t N >
+	writer(msghdr& m, buffer< N >& buf) throw ();
+
+	/**
+	 * Add a control message.
+	 *
+	 * @param level Originating protocol (SOL_SOCKET, SOL_UDP, etc.).
+	 * @param type Protocol-specific type.
+	 * @param data Message data.
+	 *
+	 * @return false (without adding anything) if there is no room in the
+	 *         buffer.
+	 */
+	template < typename T >
+	bool put(int level, int type, const T& data) throw ();
+
+private:
+
+	msghdr& _msg;
+	char* _buf;
+	std::size_t _size;
+
+};
+
+/**
+ * Find a control message in a received message.
+ *
+ * @param m Received message.
+ * @param level Originating protocol.
+ * @param type Protocol-specific type.
+ * @param data Where to store the message data.
+ *
+ * @return false if there is no such a message (or if it's smaller than a
+ *         T), in which case data is left untouched.
+ */
+template < typename T >
+bool find(const msghdr& m, int level, int type, T& data) throw ();
+
+} } } // namespace posixx::socket::cmsg
+
+
+
+inline
+posixx::socket::cmsg::writer::writer(msghdr& m, void* buf,
+		std::size_t size) throw ():
+		_msg(m), _buf(static_cast< char* >(buf)), _size(size)
+{
+	_msg.msg_control = buf;
+	_msg.msg_controllen = 0;
+}
+
+template < std::size_t N >
+inline
+posixx::socket::cmsg::writer::writer(msghdr& m, buffer< N >& buf)
+		throw ():
+		_msg(m), _buf(buf.data), _size(sizeof(buf.data))
+{
+	_msg.msg_control = buf.data;
+	_msg.msg_controllen = 0;
+}
+
+template < typename T >
+inline
+bool posixx::socket::cmsg::writer::put(int level, int type, const T& data)
+		throw ()
+{
+	std::size_t len = _msg.msg_controllen;
+	if (len + CMSG_SPACE(sizeof(T)) > _size)
+		return false;
+	// zero the padding, the kernel could complain about garbage there
+	memset(_buf + len, 0, CMSG_SPACE(sizeof(T)));
+	cmsghdr* c = reinterpret_cast< cmsghdr* >(_buf + len);
+	c->cmsg_level = level;
+	c->cmsg_type = type;
+	c->cmsg_len = CMSG_LEN(sizeof(T));
+	memcpy(CMSG_DATA(c), &data, sizeof(T));
+	_msg.msg_controllen = len + CMSG_SPACE(sizeof(T));
+	return true;
+}
+
+template < typename T >
+inline
+bool posixx::socket::cmsg::find(const msghdr& m, int level, int type,
+		T& data) throw ()
+{
+	msghdr& mm = const_cast< msghdr& >(m); // CMSG_NXTHDR is not const
+	for (cmsghdr* c = CMSG_FIRSTHDR(&mm); c; c = CMSG_NXTHDR(&mm, c)) {
+		if (c->cmsg_level == level && c->cmsg_type == type
+				&& c->cmsg_len >= CMSG_LEN(sizeof(T))) {
+			memcpy(&data, CMSG_DATA(c), sizeof(T));
+			return true;
+		}
+	}
+	return false;
+}
+
+#endif // POSIXX_SOCKET_CMSG_HPP_
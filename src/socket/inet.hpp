@@ -8,10 +8,13 @@
 #define POSIXX_SOCKET_INET_HPP_
 
 #include "basic_socket.hpp" // posixx::socket
+#include "../text.hpp" // posixx::text
+#include "../simd.hpp" // posixx::simd::mix
 
 #include <netinet/in.h> // sockaddr_in, htonl, htons, {PF,AF}_INET, INADDR_ANY
 #include <arpa/inet.h> // inet_addr
 #include <cstring> // memset
+#include <cerrno> // errno, EINVAL
 #include <string> // std::string
 
 /// @file
@@ -33,6 +36,13 @@ const uint32_t broadcast = INADDR_BROADCAST;
 struct sockaddr: sockaddr_in
 {
 
+	/// Buffer sizes (including the terminating NUL) for format*().
+	enum
+	{
+		TEXT_SIZE = sizeof("255.255.255.255:65535"), ///< format()
+		ADDR_TEXT_SIZE = sizeof("255.255.255.255") ///< format_addr()
+	};
+
 	/**
 	 * Create an IP socket address.
 	 *
@@ -76,7 +86,7 @@ struct sockaddr: sockaddr_in
 	 */
 	void set(const std::string& addr, uint16_t port) throw();
 
-	/// Get the IP address as a string
+	/// Get the IP address as a string (a.b.c.d)
 	std::string addr() const throw ();
 
 	/// Set the IP address (in network byte order)
@@ -97,6 +107,73 @@ struct sockaddr: sockaddr_in
 	/// Compare two IP socket addresses
 	bool operator == (const sockaddr& other) const throw ();
 
+	/**
+	 * Hash of the address (consistent with operator==).
+	 *
+	 * Useful to use the address as a key in hash tables (see
+	 * posixx::socket::peer_table).
+	 */
+	uint64_t hash() const throw ();
+
+	/**
+	 * Format the address as "a.b.c.d:port" into a buffer.
+	 *
+	 * It doesn't allocate memory nor use static storage (unlike
+	 * inet_ntoa(3)), so it's safe to use from any thread.
+	 *
+	 * @param buf Buffer to write to (always NUL terminated if size > 0).
+	 * @param size Size of the buffer (TEXT_SIZE is always enough).
+	 *
+	 * @return Length of the text, like snprintf(3) (if it's equal or
+	 *         bigger than size, the text was truncated).
+	 */
+	std::size_t format(char* buf, std::size_t size) const throw ();
+
+	/**
+	 * Format the IP address as "a.b.c.d" into a buffer.
+	 *
+	 * @param buf Buffer to write to (always NUL terminated if size > 0).
+	 * @param size Size of the buffer (ADDR_TEXT_SIZE is always enough).
+	 *
+	 * @return Length of the text, like snprintf(3).
+	 *
+	 * @see format()
+	 */
+	std::size_t format_addr(char* buf, std::size_t size) const throw ();
+
+	/**
+	 * Parse an address in the "a.b.c.d:port" format.
+	 *
+	 * Only the dotted quad notation in decimal is accepted (like
+	 * inet_pton(3), the short and octal/hexadecimal forms accepted by
+	 * inet_addr(3) are not).
+	 *
+	 * @param s NUL terminated string to parse.
+	 *
+	 * @return true on success, false (with errno set to EINVAL) if s is
+	 *         not a valid address, in which case the address is left
+	 *         untouched.
+	 */
+	bool parse(const char* s) throw ();
+
+	/**
+	 * Parse an IP address in the "a.b.c.d" format (the port is kept).
+	 *
+	 * @param s NUL terminated string to parse.
+	 *
+	 * @return true on success, false (with errno set to EINVAL) if s is
+	 *         not a valid IP address.
+	 *
+	 * @see parse()
+	 */
+	bool parse_addr(const char* s) throw ();
+
+private:
+
+	void _put_addr(text::writer& w) const throw ();
+
+	static bool _parse_addr(const char*& s, uint32_t& addr) throw ();
+
 }; // struct sockaddr
 
 /// IP socket traits
@@ -153,7 +230,8 @@ void posixx::socket::inet::sockaddr::set(const std::string& addr, uint16_t port)
 inline
 std::string posixx::socket::inet::sockaddr::addr() const throw ()
 {
-	return inet_ntoa(sin_addr);
+	char buf[ADDR_TEXT_SIZE];
+	return std::string(buf, format_addr(buf, sizeof(buf)));
 }
 
 inline
@@ -193,4 +271,86 @@ bool posixx::socket::inet::sockaddr::operator == (const sockaddr& other) const
 	return !memcmp(this, &other, sizeof(*this));
 }
 
+inline
+uint64_t posixx::socket::inet::sockaddr::hash() const throw ()
+{
+	return simd::mix(uint64_t(sin_addr.s_addr) << 16 | sin_port);
+}
+
+inline
+void posixx::socket::inet::sockaddr::_put_addr(text::writer& w) const
+		throw ()
+{
+	const unsigned char* a = reinterpret_cast< const unsigned char* >(
+			&sin_addr.s_addr);
+	for (int i = 0; i < 4; ++i) {
+		if (i)
+			w.put('.');
+		w.put(static_cast< unsigned long >(a[i]));
+	}
+}
+
+inline
+std::size_t posixx::socket::inet::sockaddr::format(char* buf,
+		std::size_t size) const throw ()
+{
+	text::writer w(buf, size);
+	_put_addr(w);
+	return w.put(':').put(static_cast< unsigned long >(port())).finish();
+}
+
+inline
+std::size_t posixx::socket::inet::sockaddr::format_addr(char* buf,
+		std::size_t size) const throw ()
+{
+	text::writer w(buf, size);
+	_put_addr(w);
+	return w.finish();
+}
+
+inline
+bool posixx::socket::inet::sockaddr::_parse_addr(const char*& s,
+		uint32_t& addr) throw ()
+{
+	// the address is stored in network byte order, so the bytes are
+	// written in the order they appear in the text
+	unsigned char* a = reinterpret_cast< unsigned char* >(&addr);
+	for (int i = 0; i < 4; ++i) {
+		unsigned long n;
+		if (i && !text::expect(s, '.'))
+			return false;
+		if (!text::parse_uint(s, 255, n))
+			return false;
+		a[i] = n;
+	}
+	return true;
+}
+
+inline
+bool posixx::socket::inet::sockaddr::parse(const char* s) throw ()
+{
+	uint32_t a;
+	unsigned long p;
+	if (!_parse_addr(s, a) || !text::expect(s, ':')
+			|| !text::parse_uint(s, 65535, p) || *s) {
+		errno = EINVAL;
+		return false;
+	}
+	sin_family = AF_INET;
+	set(a, p);
+	return true;
+}
+
+inline
+bool posixx::socket::inet::sockaddr::parse_addr(const char* s) throw ()
+{
+	uint32_t a;
+	if (!_parse_addr(s, a) || *s) {
+		errno = EINVAL;
+		return false;
+	}
+	sin_addr.s_addr = a;
+	return true;
+}
+
 #endif // POSIXX_SOCKET_INET_HPP_
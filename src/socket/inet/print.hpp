@@ -14,7 +14,9 @@ inline
 std::ostream& operator << (std::ostream& os,
 		const posixx::socket::inet::sockaddr& sa) throw()
 {
-	return os << "inet::sockaddr(addr=" << sa.addr()
+	char addr[posixx::socket::inet::sockaddr::ADDR_TEXT_SIZE];
+	sa.format_addr(addr, sizeof(addr));
+	return os << "inet::sockaddr(addr=" << addr
 			<< ", port=" << sa.port() << ")";
 }
 
@@ -0,0 +1,408 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_INET6_HPP_
+#define POSIXX_SOCKET_INET6_HPP_
+
+#include "basic_socket.hpp" // posixx::socket
+#include "inet.hpp" // posixx::socket::inet::sockaddr
+#include "../text.hpp" // posixx::text
+#include "../simd.hpp" // posixx::simd::mix
+
+#include <netinet/in.h> // sockaddr_in6, in6_addr, IPV6_V6ONLY
+#include <arpa/inet.h> // inet_ntop, inet_pton
+#include <cstring> // memset, memcpy, memcmp, strchr
+#include <cerrno> // errno, EINVAL
+#include <string> // std::string
+
+/// @file
+
+namespace posixx { namespace socket {
+
+/// Internet Protocol version 6 sockets
+namespace inet6 {
+
+
+/// Address to accept any incoming messages
+const in6_addr any = IN6ADDR_ANY_INIT;
+
+/// Loopback address (::1)
+const in6_addr loopback = IN6ADDR_LOOPBACK_INIT;
+
+
+/**
+ * IPv6 socket address.
+ *
+ * It has the same interface as inet::sockaddr, plus some helpers to deal
+ * with IPv4-mapped addresses (::ffff:a.b.c.d), which is how a dual-stack
+ * socket (see opt::V6ONLY) reports IPv4 peers.
+ */
+struct sockaddr: sockaddr_in6
+{
+
+	/// Buffer sizes (including the terminating NUL) for format*().
+	enum
+	{
+		/// format_addr()
+		ADDR_TEXT_SIZE = INET6_ADDRSTRLEN,
+		/// format()
+		TEXT_SIZE = ADDR_TEXT_SIZE + sizeof("[]:65535") - 1
+	};
+
+	/**
+	 * Create an IPv6 socket address.
+	 *
+	 * @param addr IPv6 address
+	 * @param port IP port in host byte order
+	 *
+	 * @see any, loopback constants
+	 */
+	explicit sockaddr(const in6_addr& addr = any, uint16_t port = 0)
+			throw ();
+
+	/**
+	 * Create an IPv6 socket address.
+	 *
+	 * @param addr String representation of the IPv6 address (if it's not
+	 *             valid, the address is set to any)
+	 * @param port IP port in host byte order
+	 */
+	explicit sockaddr(const std::string& addr, uint16_t port) throw ();
+
+	/**
+	 * Create an IPv4-mapped IPv6 socket address.
+	 *
+	 * @param v4 IPv4 socket address to map.
+	 */
+	explicit sockaddr(const inet::sockaddr& v4) throw ();
+
+	/**
+	 * Set the IPv6 address and port.
+	 *
+	 * @param addr IPv6 address
+	 * @param port IP port in host byte order
+	 */
+	void set(const in6_addr& addr, uint16_t port) throw();
+
+	/**
+	 * Set the IPv6 address and port.
+	 *
+	 * @param addr String representation of the IPv6 address
+	 * @param port IP port in host byte order
+	 */
+	void set(const std::string& addr, uint16_t port) throw();
+
+	/// Get the IPv6 address as a string
+	std::string addr() const throw ();
+
+	/// Set the IPv6 address
+	void addr(const in6_addr& addr) throw ();
+
+	/// Set the IPv6 address from a string (any if it's not valid)
+	void addr(const std::string& addr) throw ();
+
+	/// Get the port number
+	uint16_t port() const throw ();
+
+	/// Set the port number (port is expected to be in host byte order)
+	void port(uint16_t port) throw ();
+
+	/// Length of this IPv6 socket address
+	socklen_t length() const throw ();
+
+	/// Compare two IPv6 socket addresses
+	bool operator == (const sockaddr& other) const throw ();
+
+	/**
+	 * Hash of the address (consistent with operator==).
+	 *
+	 * Useful to use the address as a key in hash tables (see
+	 * posixx::socket::peer_table).
+	 */
+	uint64_t hash() const throw ();
+
+	/// Tell if the address is an IPv4-mapped address (::ffff:a.b.c.d)
+	bool v4_mapped() const throw ();
+
+	/**
+	 * Get the IPv4 socket address mapped in this address.
+	 *
+	 * Only meaningful if v4_mapped() is true.
+	 */
+	inet::sockaddr v4() const throw ();
+
+	/**
+	 * Format the address as "[addr]:port" into a buffer.
+	 *
+	 * The address is formatted by inet_ntop(3) (so it's in the RFC 5952
+	 * canonical form), which doesn't allocate memory nor use static
+	 * storage.
+	 *
+	 * @param buf Buffer to write to (always NUL terminated if size > 0).
+	 * @param size Size of the buffer (TEXT_SIZE is always enough).
+	 *
+	 * @return Length of the text, like snprintf(3) (if it's equal or
+	 *         bigger than size, the text was truncated).
+	 */
+	std::size_t format(char* buf, std::size_t size) const throw ();
+
+	/**
+	 * Format the IPv6 address (without brackets) into a buffer.
+	 *
+	 * @param buf Buffer to write to (always NUL terminated if size > 0).
+	 * @param size Size of the buffer (ADDR_TEXT_SIZE is always enough).
+	 *
+	 * @return Length of the text, like snprintf(3).
+	 *
+	 * @see format()
+	 */
+	std::size_t format_addr(char* buf, std::size_t size) const throw ();
+
+	/**
+	 * Parse an address in the "[addr]:port" format.
+	 *
+	 * The address is parsed by inet_pton(3) (scope IDs are not
+	 * supported).
+	 *
+	 * @param s NUL terminated string to parse.
+	 *
+	 * @return true on success, false (with errno set to EINVAL) if s is
+	 *         not a valid address, in which case the address is left
+	 *         untouched.
+	 */
+	bool parse(const char* s) throw ();
+
+	/**
+	 * Parse an IPv6 address (without brackets, the port is kept).
+	 *
+	 * @param s NUL terminated string to parse.
+	 *
+	 * @return true on success, false (with errno set to EINVAL) if s is
+	 *         not a valid IPv6 address.
+	 *
+	 * @see parse()
+	 */
+	bool parse_addr(const char* s) throw ();
+
+}; // struct sockaddr
+
+/// IPv6 socket traits
+struct traits
+{
+	/// Socket address type.
+	typedef inet6::sockaddr sockaddr;
+	/// Protocol family.
+	enum { PF = PF_INET6 };
+};
+
+/// IPv6 socket
+typedef posixx::socket::basic_socket< traits > socket;
+
+/**
+ * IPv6 socket options
+ *
+ * @see ipv6(7)
+ */
+namespace opt {
+
+/**
+ * Restrict the socket to IPv6 communication only.
+ *
+ * When disabled (the default, unless changed by the
+ * net.ipv6.bindv6only sysctl), a socket bound to the any address also
+ * accepts IPv4 connections and datagrams, reporting the peers as
+ * IPv4-mapped addresses (see sockaddr::v4_mapped()). It must be set
+ * before binding.
+ */
+struct V6ONLY
+{
+	enum
+	{
+		level   = IPPROTO_IPV6,
+		optname = IPV6_V6ONLY,
+		read    = true,
+		write   = true
+	};
+	typedef int type;
+};
+
+} // namespace opt
+
+} } } // namespace posixx::socket::inet6
+
+
+
+
+inline
+posixx::socket::inet6::sockaddr::sockaddr(const in6_addr& addr,
+		uint16_t port) throw ()
+{
+	memset(this, 0, sizeof(struct sockaddr_in6));
+	sin6_family = AF_INET6;
+	set(addr, port);
+}
+
+inline
+posixx::socket::inet6::sockaddr::sockaddr(const std::string& addr,
+		uint16_t port) throw ()
+{
+	memset(this, 0, sizeof(struct sockaddr_in6));
+	sin6_family = AF_INET6;
+	set(addr, port);
+}
+
+inline
+posixx::socket::inet6::sockaddr::sockaddr(const inet::sockaddr& v4) throw ()
+{
+	memset(this, 0, sizeof(struct sockaddr_in6));
+	sin6_family = AF_INET6;
+	sin6_addr.s6_addr[10] = 0xff;
+	sin6_addr.s6_addr[11] = 0xff;
+	memcpy(sin6_addr.s6_addr + 12, &v4.sin_addr.s_addr, 4);
+	sin6_port = v4.sin_port;
+}
+
+inline
+void posixx::socket::inet6::sockaddr::set(const in6_addr& addr,
+		uint16_t port) throw ()
+{
+	sin6_addr = addr;
+	this->port(port);
+}
+
+inline
+void posixx::socket::inet6::sockaddr::set(const std::string& addr,
+		uint16_t port) throw ()
+{
+	this->addr(addr);
+	this->port(port);
+}
+
+inline
+std::string posixx::socket::inet6::sockaddr::addr() const throw ()
+{
+	char buf[ADDR_TEXT_SIZE];
+	return std::string(buf, format_addr(buf, sizeof(buf)));
+}
+
+inline
+void posixx::socket::inet6::sockaddr::addr(const in6_addr& addr) throw ()
+{
+	sin6_addr = addr;
+}
+
+inline
+void posixx::socket::inet6::sockaddr::addr(const std::string& addr)
+		throw ()
+{
+	if (::inet_pton(AF_INET6, addr.c_str(), &sin6_addr) != 1)
+		sin6_addr = any;
+}
+
+inline
+uint16_t posixx::socket::inet6::sockaddr::port() const throw ()
+{
+	return ntohs(sin6_port);
+}
+
+inline
+void posixx::socket::inet6::sockaddr::port(uint16_t port) throw ()
+{
+	sin6_port = htons(port);
+}
+
+inline
+socklen_t posixx::socket::inet6::sockaddr::length() const throw ()
+{
+	return sizeof(sockaddr_in6);
+}
+
+inline
+bool posixx::socket::inet6::sockaddr::operator == (const sockaddr& other)
+		const throw ()
+{
+	return !memcmp(this, &other, sizeof(*this));
+}
+
+inline
+uint64_t posixx::socket::inet6::sockaddr::hash() const throw ()
+{
+	uint64_t a[2];
+	memcpy(a, &sin6_addr, sizeof(a));
+	return simd::mix(a[0] + simd::mix(a[1] ^ sin6_port));
+}
+
+inline
+bool posixx::socket::inet6::sockaddr::v4_mapped() const throw ()
+{
+	return IN6_IS_ADDR_V4MAPPED(&sin6_addr);
+}
+
+inline
+posixx::socket::inet::sockaddr posixx::socket::inet6::sockaddr::v4() const
+		throw ()
+{
+	inet::sockaddr sa;
+	memcpy(&sa.sin_addr.s_addr, sin6_addr.s6_addr + 12, 4);
+	sa.sin_port = sin6_port;
+	return sa;
+}
+
+inline
+std::size_t posixx::socket::inet6::sockaddr::format(char* buf,
+		std::size_t size) const throw ()
+{
+	char addr[ADDR_TEXT_SIZE];
+	::inet_ntop(AF_INET6, &sin6_addr, addr, sizeof(addr));
+	return text::writer(buf, size).put('[').put(addr).put(']').put(':')
+			.put(static_cast< unsigned long >(port())).finish();
+}
+
+inline
+std::size_t posixx::socket::inet6::sockaddr::format_addr(char* buf,
+		std::size_t size) const throw ()
+{
+	char addr[ADDR_TEXT_SIZE];
+	::inet_ntop(AF_INET6, &sin6_addr, addr, sizeof(addr));
+	return text::writer(buf, size).put(addr).finish();
+}
+
+inline
+bool posixx::socket::inet6::sockaddr::parse(const char* s) throw ()
+{
+	char addr[ADDR_TEXT_SIZE];
+	const char* end = text::expect(s, '[') ? strchr(s, ']') : NULL;
+	in6_addr a;
+	unsigned long p;
+	if (end && std::size_t(end - s) < sizeof(addr)) {
+		memcpy(addr, s, end - s);
+		addr[end - s] = '\0';
+		s = end + 1;
+		if (::inet_pton(AF_INET6, addr, &a) == 1
+				&& text::expect(s, ':')
+				&& text::parse_uint(s, 65535, p) && !*s) {
+			sin6_family = AF_INET6;
+			set(a, p);
+			return true;
+		}
+	}
+	errno = EINVAL;
+	return false;
+}
+
+inline
+bool posixx::socket::inet6::sockaddr::parse_addr(const char* s) throw ()
+{
+	in6_addr a;
+	if (::inet_pton(AF_INET6, s, &a) != 1) {
+		errno = EINVAL;
+		return false;
+	}
+	sin6_addr = a;
+	return true;
+}
+
+#endif // POSIXX_SOCKET_INET6_HPP_
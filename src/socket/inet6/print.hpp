@@ -0,0 +1,23 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_INET6_PRINT_HPP_
+#define POSIXX_SOCKET_INET6_PRINT_HPP_
+
+#include "../inet6.hpp" // posixx::socket::inet6::sockaddr
+#include <ostream> // std::ostream
+
+inline
+std::ostream& operator << (std::ostream& os,
+		const posixx::socket::inet6::sockaddr& sa) throw()
+{
+	char addr[posixx::socket::inet6::sockaddr::ADDR_TEXT_SIZE];
+	sa.format_addr(addr, sizeof(addr));
+	return os << "inet6::sockaddr(addr=" << addr
+			<< ", port=" << sa.port() << ")";
+}
+
+#endif // POSIXX_SOCKET_INET6_PRINT_HPP_
@@ -0,0 +1,368 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_IP_HPP_
+#define POSIXX_SOCKET_IP_HPP_
+
+#include "inet.hpp" // posixx::socket::inet
+#include "inet6.hpp" // posixx::socket::inet6
+#include "opt.hpp" // posixx::socket::opt::REUSEADDR
+
+#include <memory> // std::auto_ptr
+#include <cstring> // memcmp
+
+/// @file
+
+namespace posixx { namespace socket {
+
+/**
+ * IP version independent addresses and dual-stack sockets.
+ *
+ * A dual-stack socket is an IPv6 socket (inet6::socket) with the
+ * inet6::opt::V6ONLY option disabled, which serves both IPv4 and IPv6
+ * peers, so a single accept() (or recv()) loop can handle both families.
+ * The kernel reports IPv4 peers as IPv4-mapped IPv6 addresses; the
+ * functions in this namespace convert them to plain IPv4 addresses (and
+ * back when sending), so the application can take a per-family path based
+ * on sockaddr::family() without parsing or comparing IPv6 addresses.
+ *
+ * @code
+ * std::auto_ptr< inet6::socket > l(ip::dual_stack(
+ *		inet6::sockaddr(inet6::any, 8080)));
+ * for (;;) {
+ *	ip::sockaddr peer;
+ *	inet6::socket* s = ip::accept(*l, peer);
+ *	if (peer.family() == AF_INET)
+ *		handle_v4(s, peer.v4());
+ *	else
+ *		handle_v6(s, peer.v6());
+ * }
+ * @endcode
+ */
+namespace ip {
+
+/**
+ * IPv4 or IPv6 socket address.
+ *
+ * It's stored in place (no heap allocations), so it's as cheap to copy as
+ * an inet6::sockaddr.
+ */
+struct sockaddr
+{
+
+	/// Buffer size (including the terminating NUL) for format().
+	enum { TEXT_SIZE = inet6::sockaddr::TEXT_SIZE };
+
+	/// Create an IPv6 any address (with port 0).
+	sockaddr() throw ();
+
+	/// Create an IPv4 socket address.
+	sockaddr(const inet::sockaddr& addr) throw ();
+
+	/**
+	 * Create an IPv6 socket address.
+	 *
+	 * IPv4-mapped addresses are stored as IPv4 addresses.
+	 */
+	sockaddr(const inet6::sockaddr& addr) throw ();
+
+	/// Address family (AF_INET or AF_INET6).
+	sa_family_t family() const throw ();
+
+	/// Access to the IPv4 address (only valid if family() == AF_INET)
+	inet::sockaddr& v4() throw ();
+
+	/// Access to the IPv4 address (only valid if family() == AF_INET)
+	const inet::sockaddr& v4() const throw ();
+
+	/// Access to the IPv6 address (only valid if family() == AF_INET6)
+	inet6::sockaddr& v6() throw ();
+
+	/// Access to the IPv6 address (only valid if family() == AF_INET6)
+	const inet6::sockaddr& v6() const throw ();
+
+	/**
+	 * Get the address as an IPv6 address.
+	 *
+	 * IPv4 addresses are mapped, so the result can be used with a
+	 * dual-stack socket.
+	 */
+	inet6::sockaddr mapped() const throw ();
+
+	/// Get the port number
+	uint16_t port() const throw ();
+
+	/// Set the port number (port is expected to be in host byte order)
+	void port(uint16_t port) throw ();
+
+	/// Length of the socket address (depends on the family)
+	socklen_t length() const throw ();
+
+	/// Compare two IP socket addresses
+	bool operator == (const sockaddr& other) const throw ();
+
+	/// Hash of the address (consistent with operator==).
+	uint64_t hash() const throw ();
+
+	/**
+	 * Format the address into a buffer.
+	 *
+	 * @see inet::sockaddr::format(), inet6::sockaddr::format()
+	 */
+	std::size_t format(char* buf, std::size_t size) const throw ();
+
+	/**
+	 * Parse an IPv4 ("a.b.c.d:port") or IPv6 ("[addr]:port") address.
+	 *
+	 * IPv4-mapped IPv6 addresses are stored as IPv4 addresses.
+	 *
+	 * @return true on success, false (with errno set to EINVAL) if s is
+	 *         not a valid address, in which case the address is left
+	 *         untouched.
+	 *
+	 * @see inet::sockaddr::parse(), inet6::sockaddr::parse()
+	 */
+	bool parse(const char* s) throw ();
+
+private:
+
+	union
+	{
+		sockaddr_in _in;
+		sockaddr_in6 _in6;
+	};
+
+}; // struct sockaddr
+
+/**
+ * Create a dual-stack socket.
+ *
+ * The socket has inet6::opt::V6ONLY disabled and socket::opt::REUSEADDR
+ * enabled, it's bound to addr and, if it's a connection oriented socket,
+ * put to listen.
+ *
+ * @param addr Address to bind to (it should be inet6::any to accept
+ *             IPv4 peers too).
+ * @param type Type of the socket.
+ * @param backlog Maximum length of the pending connections queue.
+ */
+inet6::socket* dual_stack(const inet6::sockaddr& addr,
+		socket::type type = STREAM, int backlog = 128) throw (error);
+
+/**
+ * Accept a connection on a dual-stack socket.
+ *
+ * @param listener Listening dual-stack socket.
+ * @param peer Where to store the peer address (IPv4 peers are stored as
+ *             IPv4 addresses).
+ *
+ * @return The connected socket (to be deleted by the caller).
+ */
+inet6::socket* accept(inet6::socket& listener, sockaddr& peer)
+		throw (error);
+
+/**
+ * Receive a datagram from a dual-stack socket.
+ *
+ * @param s Dual-stack socket.
+ * @param buf Buffer to store the data.
+ * @param n Size of the buffer.
+ * @param from Where to store the sender address (IPv4 senders are stored
+ *             as IPv4 addresses).
+ * @param flags Flags for recvfrom(2).
+ *
+ * @return The number of bytes received.
+ */
+ssize_t recv(inet6::socket& s, void* buf, size_t n, sockaddr& from,
+		int flags = 0) throw (error);
+
+/**
+ * Send a datagram through a dual-stack socket.
+ *
+ * @param s Dual-stack socket.
+ * @param buf Data to send.
+ * @param n Size of the data.
+ * @param to Destination (IPv4 destinations are mapped).
+ * @param flags Flags for sendto(2).
+ *
+ * @return The number of bytes sent.
+ */
+ssize_t send(inet6::socket& s, const void* buf, size_t n,
+		const sockaddr& to, int flags = 0) throw (error);
+
+} } } // namespace posixx::socket::ip
+
+
+
+inline
+posixx::socket::ip::sockaddr::sockaddr() throw ()
+{
+	_in6 = inet6::sockaddr();
+}
+
+inline
+posixx::socket::ip::sockaddr::sockaddr(const inet::sockaddr& addr) throw ()
+{
+	_in = addr;
+}
+
+inline
+posixx::socket::ip::sockaddr::sockaddr(const inet6::sockaddr& addr)
+		throw ()
+{
+	if (addr.v4_mapped())
+		_in = addr.v4();
+	else
+		_in6 = addr;
+}
+
+inline
+sa_family_t posixx::socket::ip::sockaddr::family() const throw ()
+{
+	// sin_family and sin6_family are at the same offset
+	return _in.sin_family;
+}
+
+inline
+posixx::socket::inet::sockaddr& posixx::socket::ip::sockaddr::v4() throw ()
+{
+	return *reinterpret_cast< inet::sockaddr* >(&_in);
+}
+
+inline
+const posixx::socket::inet::sockaddr& posixx::socket::ip::sockaddr::v4()
+		const throw ()
+{
+	return *reinterpret_cast< const inet::sockaddr* >(&_in);
+}
+
+inline
+posixx::socket::inet6::sockaddr& posixx::socket::ip::sockaddr::v6() throw ()
+{
+	return *reinterpret_cast< inet6::sockaddr* >(&_in6);
+}
+
+inline
+const posixx::socket::inet6::sockaddr& posixx::socket::ip::sockaddr::v6()
+		const throw ()
+{
+	return *reinterpret_cast< const inet6::sockaddr* >(&_in6);
+}
+
+inline
+posixx::socket::inet6::sockaddr posixx::socket::ip::sockaddr::mapped()
+		const throw ()
+{
+	if (family() == AF_INET)
+		return inet6::sockaddr(v4());
+	return v6();
+}
+
+inline
+uint16_t posixx::socket::ip::sockaddr::port() const throw ()
+{
+	// sin_port and sin6_port are at the same offset
+	return ntohs(_in.sin_port);
+}
+
+inline
+void posixx::socket::ip::sockaddr::port(uint16_t port) throw ()
+{
+	_in.sin_port = htons(port);
+}
+
+inline
+socklen_t posixx::socket::ip::sockaddr::length() const throw ()
+{
+	return family() == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+}
+
+inline
+bool posixx::socket::ip::sockaddr::operator == (const sockaddr& other) const
+		throw ()
+{
+	return family() == other.family()
+			&& !memcmp(&_in6, &other._in6, length());
+}
+
+inline
+uint64_t posixx::socket::ip::sockaddr::hash() const throw ()
+{
+	if (family() == AF_INET)
+		return v4().hash();
+	return v6().hash();
+}
+
+inline
+std::size_t posixx::socket::ip::sockaddr::format(char* buf,
+		std::size_t size) const throw ()
+{
+	if (family() == AF_INET)
+		return v4().format(buf, size);
+	return v6().format(buf, size);
+}
+
+inline
+bool posixx::socket::ip::sockaddr::parse(const char* s) throw ()
+{
+	if (*s == '[') {
+		inet6::sockaddr a;
+		if (!a.parse(s))
+			return false;
+		*this = a;
+		return true;
+	}
+	inet::sockaddr a;
+	if (!a.parse(s))
+		return false;
+	*this = a;
+	return true;
+}
+
+inline
+posixx::socket::inet6::socket* posixx::socket::ip::dual_stack(
+		const inet6::sockaddr& addr, socket::type type, int backlog)
+		throw (error)
+{
+	std::auto_ptr< inet6::socket > s(new inet6::socket(type));
+	s->opt< inet6::opt::V6ONLY >(0);
+	s->opt< socket::opt::REUSEADDR >(1);
+	s->bind(addr);
+	if (type == STREAM || type == SEQPACKET)
+		s->listen(backlog);
+	return s.release();
+}
+
+inline
+posixx::socket::inet6::socket* posixx::socket::ip::accept(
+		inet6::socket& listener, sockaddr& peer) throw (error)
+{
+	inet6::sockaddr a;
+	inet6::socket* s = listener.accept(a);
+	peer = a;
+	return s;
+}
+
+inline
+ssize_t posixx::socket::ip::recv(inet6::socket& s, void* buf, size_t n,
+		sockaddr& from, int flags) throw (error)
+{
+	inet6::sockaddr a;
+	ssize_t r = s.recv(buf, n, a, flags);
+	from = a;
+	return r;
+}
+
+inline
+ssize_t posixx::socket::ip::send(inet6::socket& s, const void* buf, size_t n,
+		const sockaddr& to, int flags) throw (error)
+{
+	if (to.family() == AF_INET6)
+		return s.send(buf, n, to.v6(), flags);
+	return s.send(buf, n, inet6::sockaddr(to.v4()), flags);
+}
+
+#endif // POSIXX_SOCKET_IP_HPP_
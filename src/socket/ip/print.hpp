@@ -0,0 +1,29 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_IP_PRINT_HPP_
+#define POSIXX_SOCKET_IP_PRINT_HPP_
+
+#include "../ip.hpp" // posixx::socket::ip::sockaddr
+#include "../inet/print.hpp" // inet::sockaddr output
+#include "../inet6/print.hpp" // inet6::sockaddr output
+#include <ostream> // std::ostream
+
+// ip::sockaddr has no base in the global namespace (unlike the other
+// addresses), so the operator has to be in its namespace to be found by ADL
+namespace posixx { namespace socket { namespace ip {
+
+inline
+std::ostream& operator << (std::ostream& os, const sockaddr& sa) throw()
+{
+	if (sa.family() == AF_INET)
+		return ::operator << (os, sa.v4());
+	return ::operator << (os, sa.v6());
+}
+
+} } } // namespace posixx::socket::ip
+
+#endif // POSIXX_SOCKET_IP_PRINT_HPP_
@@ -0,0 +1,143 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_LATENCY_HPP_
+#define POSIXX_SOCKET_LATENCY_HPP_
+
+#include "stats.hpp" // posixx::socket::op, no_stats
+#include "../histogram.hpp" // posixx::histogram
+#include "../tsc.hpp" // posixx::tsc
+
+/// @file
+
+namespace posixx { namespace socket {
+
+/**
+ * Statistics policy recording system calls latency.
+ *
+ * The time spent in each system call (successful or not) is recorded, in
+ * nanoseconds, in a histogram per operation and per family. TFamily is just a
+ * tag used to separate the histograms of each family (usually the original
+ * socket traits). The histograms are shared by all the sockets of the family
+ * and are updated without locking.
+ *
+ * This policy can be stacked on top of another statistics policy, TStats,
+ * which is called too. For example, to get both counters and latencies:
+ * @code
+ * using namespace posixx::socket;
+ * typedef latency_stats< inet::traits, atomic_stats< inet::traits > > stats;
+ * typedef basic_socket< stats_traits< inet::traits, stats > > socket;
+ * @endcode
+ *
+ * The clock used is posixx::tsc, a single rdtsc instruction on x86 with an
+ * invariant TSC (CLOCK_MONOTONIC otherwise), so the overhead per call is
+ * two clock reads, a multiplication and two relaxed atomic increments. The
+ * atomic increments are locked instructions, so they cost as much as the
+ * clock reads; see the latency_overhead benchmark for the actual figures.
+ *
+ * @see stats_traits, histogram
+ */
+template < typename TFamily, typename TStats = no_stats >
+struct latency_stats: TStats
+{
+
+	/// Start time of the system call (and the stamp of TStats).
+	struct stamp
+	{
+		/// Start time in posixx::tsc ticks.
+		tsc::ticks_type ticks;
+		/// Stamp of the stacked statistics policy.
+		typename TStats::stamp base;
+	};
+
+	/// Get the start time of a system call.
+	stamp start(op o) throw ();
+
+	/// Record the latency of a system call.
+	void record(op o, const stamp& st, ssize_t r) throw ();
+
+	/// Get the histogram of an operation for this family.
+	static const histogram& latency(op o) throw ();
+
+	/// Get a snapshot of the histogram of an operation for this family.
+	static histogram latency_snapshot(op o) throw ();
+
+	/// Remove all the values recorded in this family.
+	static void reset_latency() throw ();
+
+	/// Get the current time in nanoseconds, as used by this policy.
+	static histogram::value_type now() throw ();
+
+private:
+
+	// Histograms for this family
+	static histogram _latency[OPS];
+
+};
+
+} } // namespace posixx::socket
+
+
+
+template < typename TFamily, typename TStats >
+posixx::histogram posixx::socket::latency_stats< TFamily, TStats >::_latency[
+		posixx::socket::OPS];
+
+template < typename TFamily, typename TStats >
+inline
+posixx::histogram::value_type
+posixx::socket::latency_stats< TFamily, TStats >::now() throw ()
+{
+	return tsc::ns(tsc::ticks());
+}
+
+template < typename TFamily, typename TStats >
+inline
+typename posixx::socket::latency_stats< TFamily, TStats >::stamp
+posixx::socket::latency_stats< TFamily, TStats >::start(op o) throw ()
+{
+	stamp st;
+	st.base = TStats::start(o);
+	st.ticks = tsc::ticks();
+	return st;
+}
+
+template < typename TFamily, typename TStats >
+inline
+void posixx::socket::latency_stats< TFamily, TStats >::record(op o,
+		const stamp& st, ssize_t r) throw ()
+{
+	tsc::ticks_type end = tsc::ticks();
+	_latency[o].record(tsc::ns(end - st.ticks));
+	TStats::record(o, st.base, r);
+}
+
+template < typename TFamily, typename TStats >
+inline
+const posixx::histogram&
+posixx::socket::latency_stats< TFamily, TStats >::latency(op o) throw ()
+{
+	return _latency[o];
+}
+
+template < typename TFamily, typename TStats >
+inline
+posixx::histogram
+posixx::socket::latency_stats< TFamily, TStats >::latency_snapshot(op o)
+		throw ()
+{
+	return _latency[o].snapshot();
+}
+
+template < typename TFamily, typename TStats >
+inline
+void posixx::socket::latency_stats< TFamily, TStats >::reset_latency() throw ()
+{
+	for (int i = 0; i < OPS; ++i)
+		_latency[i].reset();
+}
+
+#endif // POSIXX_SOCKET_LATENCY_HPP_
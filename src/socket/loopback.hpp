@@ -0,0 +1,1064 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_LOOPBACK_HPP_
+#define POSIXX_SOCKET_LOOPBACK_HPP_
+
+#include "basic_socket.hpp" // posixx::socket::type, shutdown_mode
+#include "../tsc.hpp" // posixx::tsc::monotonic
+
+#include <string> // std::string
+#include <deque> // std::deque
+#include <map> // std::map
+#include <utility> // std::pair
+#include <algorithm> // std::min
+#include <cstring> // std::memcpy, std::memset
+#include <cerrno> // E* constants
+#include <stdint.h> // uint32_t, uint64_t
+#include <pthread.h> // pthread_mutex_t, pthread_cond_t
+#include <sys/eventfd.h> // eventfd
+#include <time.h> // timespec
+#include <sys/time.h> // timeval
+
+/// @file
+
+namespace posixx { namespace socket {
+
+/**
+ * In-memory (loopback) sockets.
+ *
+ * These sockets never leave the process: messages are just copied to the
+ * receive queue of the destination socket, which makes them useful to test
+ * code templated on the socket type without any kernel support (TIPC, for
+ * example, needs a kernel module) and to measure how much of a benchmark is
+ * spent in user space.
+ *
+ * Links can be configured (see config) to delay the messages (latency and
+ * jitter) and to lose datagrams, so load tests can simulate a real network.
+ */
+namespace loopback {
+
+/// Loopback socket address (just a port number)
+struct sockaddr
+{
+
+	/// Port number (0 means any, when binding).
+	uint32_t port;
+
+	/// Create a loopback socket address.
+	explicit sockaddr(uint32_t port = 0) throw ();
+
+	/// Length of this loopback socket address
+	socklen_t length() const throw ();
+
+	/// Compare two loopback socket addresses
+	bool operator == (const sockaddr& other) const throw ();
+
+	/// Compare two loopback socket addresses
+	bool operator != (const sockaddr& other) const throw ();
+
+}; // struct sockaddr
+
+/**
+ * Link conditions.
+ *
+ * The conditions of the socket sending a message are applied to it.
+ */
+struct config
+{
+	/// Time each message takes to arrive (in nanoseconds).
+	uint64_t latency;
+	/// Maximum random extra latency (in nanoseconds).
+	uint64_t jitter;
+	/**
+	 * Probability of losing a datagram (between 0 and 1).
+	 *
+	 * Only DGRAM messages are lost, STREAM and SEQPACKET are reliable.
+	 */
+	double loss;
+	/**
+	 * Receive queue size (in bytes).
+	 *
+	 * When the queue is full, datagrams are dropped and STREAM and
+	 * SEQPACKET senders block.
+	 */
+	std::size_t rcvbuf;
+	/// Default conditions (no latency, no loss, 208KiB queues).
+	config() throw ();
+};
+
+/// Set the link conditions for the sockets created from now on.
+void default_conf(const config& conf) throw ();
+
+/// Get the link conditions used for new sockets.
+config default_conf() throw ();
+
+/// Loopback socket traits
+struct traits
+{
+	/// Socket address type.
+	typedef posixx::socket::loopback::sockaddr sockaddr;
+	/// Protocol family (there is no real one).
+	enum { PF = PF_UNSPEC };
+};
+
+struct socket;
+
+/// Pair of loopback sockets
+typedef std::pair< socket*, socket* > pair_type;
+
+/**
+ * Loopback socket.
+ *
+ * This mirrors the basic_socket interface (except for the msghdr and
+ * mmsghdr variants of send() and recv()) with DGRAM, STREAM and SEQPACKET
+ * semantics, including orderly shutdown reporting (recv() throws an error
+ * with errno 0). There are no statistics, though.
+ *
+ * Each socket has a real file descriptor (an eventfd), so it can be used
+ * with fcntl() and friends, but it's never readable: the only flag used
+ * to avoid blocking is MSG_DONTWAIT. Socket options are just stored, so
+ * they can be read back, but only SO_RCVTIMEO has any effect.
+ *
+ * All the sockets share a single lock, so this is thread-safe, but it
+ * doesn't scale to many threads. As with a file descriptor, a socket
+ * shouldn't be closed while other threads are using it.
+ */
+struct socket
+{
+
+	/// Traits used by this socket
+	typedef loopback::traits traits;
+
+	/**
+	 * Create an endpoint for communication.
+	 *
+	 * @param type Type of socket (DGRAM, STREAM or SEQPACKET).
+	 * @param protocol Protocol number (must be 0).
+	 */
+	socket(type type, int protocol = 0) throw (error);
+
+	/**
+	 * Bind a name to the socket.
+	 *
+	 * If the port is 0, a free one is picked.
+	 */
+	void bind(const sockaddr& addr) throw (error);
+
+	/**
+	 * Initiate a connection on the socket.
+	 *
+	 * The connection is established immediately (if the listening socket
+	 * backlog is full, it's refused).
+	 */
+	void connect(const sockaddr& addr) throw (error);
+
+	/// Get the socket name.
+	sockaddr name() const throw (error);
+
+	/// Get the name of connected peer socket.
+	sockaddr peer_name() const throw (error);
+
+	/// Send a message on the socket.
+	ssize_t send(const void* buf, size_t n, int flags = 0) throw (error);
+
+	/// Receive a message on the socket.
+	ssize_t recv(void* buf, size_t n, int flags = 0) throw (error);
+
+	/// Send a message on the socket to a specific name.
+	ssize_t send(const void* buf, size_t n, const sockaddr& to,
+			int flags = 0) throw (error);
+
+	/// Receive a message on the socket from a specific name.
+	ssize_t recv(void* buf, size_t n, sockaddr& from, int flags = 0)
+			throw (error);
+
+	/// Get options on the socket.
+	template< typename TSockOpt >
+	void getsockopt(int level, int optname, TSockOpt& opt) const
+			throw (error);
+
+	/// Set options on the socket.
+	template< typename TSockOpt >
+	void setsockopt(int level, int optname, const TSockOpt& opt)
+			throw (error);
+
+	/// Get option on the socket (type-safe).
+	template< typename TSockOpt >
+	typename TSockOpt::type opt() const throw (error);
+
+	/// Set option on the socket (type-safe).
+	template< typename TSockOpt >
+	void opt(const typename TSockOpt::type& opt) throw (error);
+
+	/// Listen for connections on the socket.
+	void listen(int backlog = 5) throw (error);
+
+	/// Accept a connection on the socket.
+	socket* accept() throw (error);
+
+	/// Accept a connection on the socket.
+	socket* accept(sockaddr& addr) throw (error);
+
+	/// Shut down part of a full-duplex connection.
+	void shutdown(shutdown_mode how = RDWR) throw (error);
+
+	/// Close the socket.
+	void close() throw (error);
+
+	/// Destructor (closes the socket).
+	~socket() throw ();
+
+	/// Send a struct as a message.
+	template< typename TPacket >
+	void send_struct(const TPacket& packet, int flags = MSG_NOSIGNAL)
+			throw (error);
+
+	/// Receive a message in a struct.
+	template< typename TPacket >
+	void recv_struct(TPacket& packet,
+			int flags = MSG_NOSIGNAL | MSG_WAITALL) throw (error);
+
+	/// Send a struct as a message to a specific name.
+	template< typename TPacket >
+	void send_struct(const TPacket& packet, const sockaddr& to,
+			int flags = MSG_NOSIGNAL) throw (error);
+
+	/// Receive a message in a struct from a specific name.
+	template< typename TPacket >
+	void recv_struct(TPacket& packet, sockaddr& from,
+			int flags = MSG_NOSIGNAL | MSG_WAITALL) throw (error);
+
+	/// Get the socket file descriptor.
+	int fd() const throw ();
+
+	/// Convert the socket to a file descriptor.
+	operator int () const throw ();
+
+	/// Get the link conditions of the socket.
+	config conf() const throw ();
+
+	/// Set the link conditions of the socket.
+	void conf(const config& conf) throw ();
+
+	friend void default_conf(const config& conf) throw ();
+	friend config default_conf() throw ();
+	friend pair_type pair(type type, int protocol) throw (error);
+
+private:
+
+	// Message in a receive queue
+	struct message
+	{
+		std::string data;
+		sockaddr from;
+		// delivery time (0 means now)
+		uint64_t at;
+	};
+
+	// Shared state of a socket (the sockets are just handles to it)
+	struct endpoint
+	{
+		typedef std::map< std::pair< int, int >, std::string > opts_type;
+		int type;
+		sockaddr name;
+		sockaddr peer_name;
+		// peer endpoint (STREAM and SEQPACKET)
+		endpoint* peer;
+		bool connected;
+		bool listening;
+		std::size_t max_backlog;
+		std::deque< endpoint* > backlog;
+		std::deque< message > queue;
+		// bytes in the queue
+		std::size_t queued;
+		// bytes already read from the first message (STREAM)
+		std::size_t offset;
+		// delivery time of the last message queued
+		uint64_t last_at;
+		// no more messages will arrive
+		bool eof;
+		// no more messages can be sent
+		bool shut_wr;
+		// SO_RCVTIMEO (in nanoseconds, 0 means no timeout)
+		uint64_t rcvtimeo;
+		config conf;
+		opts_type opts;
+		pthread_cond_t cond;
+		endpoint(int type, const config& conf) throw ();
+		~endpoint() throw ();
+	};
+
+	// State shared by all the sockets
+	struct network
+	{
+		pthread_mutex_t mutex;
+		std::map< uint32_t, endpoint* > ports;
+		uint32_t next_port;
+		uint64_t seed;
+		config defaults;
+		network() throw ();
+		static network& instance() throw ();
+	};
+
+	// Lock the network while in scope
+	struct lock
+	{
+		lock() throw ();
+		~lock() throw ();
+	};
+
+	// First port used when binding to any port
+	enum { EPHEMERAL_PORT = 32768 };
+
+	// Create a socket for an accepted connection
+	explicit socket(endpoint* ep) throw (error);
+
+	// Hidden copy constructor and assign operator
+	socket(const socket& s);
+	socket& operator=(const socket& s);
+
+	static double _random() throw ();
+	static int _open() throw (error);
+	static void _fail(int no, const char* where) throw (error);
+	static void _reset(endpoint* ep) throw ();
+	void _check() const throw (error);
+	void _bind(const sockaddr& addr) throw (error);
+	void _push(endpoint* dst, const void* buf, std::size_t n) throw ();
+	ssize_t _send(const void* buf, std::size_t n, const sockaddr* to,
+			int flags) throw (error);
+	ssize_t _recv(void* buf, std::size_t n, sockaddr* from, int flags)
+			throw (error);
+	socket* _accept(sockaddr* addr) throw (error);
+	void _wait(endpoint* ep, uint64_t until = 0) throw ();
+	void _getsockopt(int level, int optname, void* opt, std::size_t n)
+			const throw (error);
+	void _setsockopt(int level, int optname, const void* opt,
+			std::size_t n) throw (error);
+
+	int _fd;
+	endpoint* _ep;
+
+};
+
+/// Create a pair of connected loopback sockets
+pair_type pair(type type, int protocol = 0) throw (error);
+
+} } } // namespace posixx::socket::loopback
+
+
+
+inline
+posixx::socket::loopback::sockaddr::sockaddr(uint32_t port) throw ():
+		port(port)
+{
+}
+
+inline
+socklen_t posixx::socket::loopback::sockaddr::length() const throw ()
+{
+	return sizeof(sockaddr);
+}
+
+inline
+bool posixx::socket::loopback::sockaddr::operator == (const sockaddr& other)
+		const throw ()
+{
+	return port == other.port;
+}
+
+inline
+bool posixx::socket::loopback::sockaddr::operator != (const sockaddr& other)
+		const throw ()
+{
+	return port != other.port;
+}
+
+inline
+posixx::socket::loopback::config::config() throw ():
+		latency(0), jitter(0), loss(0.0), rcvbuf(212992)
+{
+}
+
+inline
+void posixx::socket::loopback::default_conf(const config& conf) throw ()
+{
+	socket::lock l;
+	socket::network::instance().defaults = conf;
+}
+
+inline
+posixx::socket::loopback::config posixx::socket::loopback::default_conf()
+		throw ()
+{
+	socket::lock l;
+	return socket::network::instance().defaults;
+}
+
+inline
+posixx::socket::loopback::socket::endpoint::endpoint(int type,
+		const config& conf) throw ():
+		type(type), peer(NULL), connected(false), listening(false),
+		max_backlog(0), queued(0), offset(0), last_at(0), eof(false),
+		shut_wr(false), rcvtimeo(0), conf(conf)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+inline
+posixx::socket::loopback::socket::endpoint::~endpoint() throw ()
+{
+	pthread_cond_destroy(&cond);
+}
+
+inline
+posixx::socket::loopback::socket::network::network() throw ():
+		next_port(EPHEMERAL_PORT), seed(uint64_t(0x9e3779b9) << 32 | 0x7f4a7c15)
+{
+	pthread_mutex_init(&mutex, NULL);
+}
+
+inline
+posixx::socket::loopback::socket::network&
+posixx::socket::loopback::socket::network::instance() throw ()
+{
+	static network n;
+	return n;
+}
+
+inline
+posixx::socket::loopback::socket::lock::lock() throw ()
+{
+	pthread_mutex_lock(&network::instance().mutex);
+}
+
+inline
+posixx::socket::loopback::socket::lock::~lock() throw ()
+{
+	pthread_mutex_unlock(&network::instance().mutex);
+}
+
+inline
+double posixx::socket::loopback::socket::_random() throw ()
+{
+	// xorshift64*, the network must be locked
+	uint64_t& x = network::instance().seed;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	x *= uint64_t(0x2545f491) << 32 | 0x4f6cdd1d;
+	return (x >> 11) / 9007199254740992.0;
+}
+
+inline
+int posixx::socket::loopback::socket::_open() throw (error)
+{
+	int fd = ::eventfd(0, EFD_CLOEXEC);
+	if (fd == -1)
+		throw error("eventfd");
+	return fd;
+}
+
+inline
+void posixx::socket::loopback::socket::_fail(int no, const char* where)
+		throw (error)
+{
+	errno = no;
+	throw error(where);
+}
+
+inline
+void posixx::socket::loopback::socket::_reset(endpoint* ep) throw ()
+{
+	// the network must be locked
+	if (ep->peer != NULL) {
+		ep->peer->peer = NULL;
+		ep->peer->eof = true;
+		pthread_cond_broadcast(&ep->peer->cond);
+	}
+	delete ep;
+}
+
+inline
+posixx::socket::loopback::socket::socket(type type, int protocol)
+		throw (error):
+		_fd(-1), _ep(NULL)
+{
+	if (type != DGRAM && type != STREAM && type != SEQPACKET)
+		_fail(ESOCKTNOSUPPORT, "socket");
+	if (protocol != 0)
+		_fail(EPROTONOSUPPORT, "socket");
+	_fd = _open();
+	_ep = new endpoint(type, default_conf());
+}
+
+inline
+posixx::socket::loopback::socket::socket(endpoint* ep) throw (error):
+		_fd(-1), _ep(ep)
+{
+	_fd = _open();
+}
+
+inline
+void posixx::socket::loopback::socket::_check() const throw (error)
+{
+	if (_ep == NULL)
+		_fail(EBADF, "loopback");
+}
+
+inline
+void posixx::socket::loopback::socket::_bind(const sockaddr& addr)
+		throw (error)
+{
+	network& net = network::instance();
+	if (_ep->name.port != 0)
+		_fail(EINVAL, "bind");
+	uint32_t port = addr.port;
+	if (port == 0) {
+		// the ports in use are not too many, so just look for a hole
+		while (net.ports.count(net.next_port) || net.next_port == 0)
+			++net.next_port;
+		port = net.next_port++;
+	}
+	else if (net.ports.count(port))
+		_fail(EADDRINUSE, "bind");
+	net.ports[port] = _ep;
+	_ep->name = sockaddr(port);
+}
+
+inline
+void posixx::socket::loopback::socket::bind(const sockaddr& addr)
+		throw (error)
+{
+	lock l;
+	_check();
+	_bind(addr);
+}
+
+inline
+void posixx::socket::loopback::socket::connect(const sockaddr& addr)
+		throw (error)
+{
+	lock l;
+	_check();
+	network& net = network::instance();
+	std::map< uint32_t, endpoint* >::iterator i = net.ports.find(
+			addr.port);
+	if (i == net.ports.end())
+		_fail(ECONNREFUSED, "connect");
+	endpoint* dst = i->second;
+	if (dst->type != _ep->type)
+		_fail(EPROTOTYPE, "connect");
+	if (_ep->name.port == 0)
+		_bind(sockaddr());
+	if (_ep->type == DGRAM) {
+		_ep->peer_name = addr;
+		_ep->connected = true;
+		return;
+	}
+	if (_ep->connected)
+		_fail(EISCONN, "connect");
+	if (!dst->listening || dst->backlog.size() >= dst->max_backlog)
+		_fail(ECONNREFUSED, "connect");
+	// the accepted endpoint has the name of the listening one
+	endpoint* ep = new endpoint(_ep->type, dst->conf);
+	ep->name = addr;
+	ep->peer_name = _ep->name;
+	ep->peer = _ep;
+	ep->connected = true;
+	_ep->peer_name = addr;
+	_ep->peer = ep;
+	_ep->connected = true;
+	dst->backlog.push_back(ep);
+	pthread_cond_broadcast(&dst->cond);
+}
+
+inline
+posixx::socket::loopback::sockaddr posixx::socket::loopback::socket::name()
+		const throw (error)
+{
+	lock l;
+	_check();
+	return _ep->name;
+}
+
+inline
+posixx::socket::loopback::sockaddr
+posixx::socket::loopback::socket::peer_name() const throw (error)
+{
+	lock l;
+	_check();
+	if (!_ep->connected)
+		_fail(ENOTCONN, "getpeername");
+	return _ep->peer_name;
+}
+
+inline
+void posixx::socket::loopback::socket::_wait(endpoint* ep, uint64_t until)
+		throw ()
+{
+	pthread_mutex_t* m = &network::instance().mutex;
+	if (until == 0) {
+		pthread_cond_wait(&ep->cond, m);
+		return;
+	}
+	timespec ts;
+	ts.tv_sec = until / 1000000000;
+	ts.tv_nsec = until % 1000000000;
+	pthread_cond_timedwait(&ep->cond, m, &ts);
+}
+
+inline
+void posixx::socket::loopback::socket::_push(endpoint* dst, const void* buf,
+		std::size_t n) throw ()
+{
+	message m;
+	m.data.assign(static_cast< const char* >(buf), n);
+	m.from = _ep->name;
+	m.at = 0;
+	const config& c = _ep->conf;
+	if (c.latency || c.jitter)
+		m.at = tsc::monotonic() + c.latency
+				+ static_cast< uint64_t >(_random() * c.jitter);
+	// messages are never reordered
+	if (m.at < dst->last_at)
+		m.at = dst->last_at;
+	dst->last_at = m.at;
+	dst->queue.push_back(m);
+	dst->queued += n;
+	pthread_cond_broadcast(&dst->cond);
+}
+
+inline
+ssize_t posixx::socket::loopback::socket::_send(const void* buf,
+		std::size_t n, const sockaddr* to, int flags) throw (error)
+{
+	lock l;
+	_check();
+	if (_ep->shut_wr)
+		_fail(EPIPE, "send");
+	if (_ep->type == DGRAM) {
+		if (to == NULL) {
+			if (!_ep->connected)
+				_fail(ENOTCONN, "send");
+			to = &_ep->peer_name;
+		}
+		network& net = network::instance();
+		std::map< uint32_t, endpoint* >::iterator i = net.ports.find(
+				to->port);
+		if (i == net.ports.end())
+			_fail(ECONNREFUSED, "sendto");
+		endpoint* dst = i->second;
+		if (dst->type != DGRAM)
+			_fail(EPROTOTYPE, "sendto");
+		if (_ep->name.port == 0)
+			_bind(sockaddr());
+		// datagrams are silently dropped, like in a real network
+		if (_ep->conf.loss > 0.0 && _random() < _ep->conf.loss)
+			return n;
+		if (dst->eof || dst->queued + n > dst->conf.rcvbuf)
+			return n;
+		_push(dst, buf, n);
+		return n;
+	}
+	// STREAM and SEQPACKET (the destination address is ignored)
+	if (!_ep->connected)
+		_fail(ENOTCONN, "send");
+	while (true) {
+		endpoint* dst = _ep->peer;
+		if (dst == NULL || dst->eof)
+			_fail(EPIPE, "send");
+		// a message bigger than the queue is accepted if it's empty
+		if (dst->queued == 0 || dst->queued + n <= dst->conf.rcvbuf)
+			break;
+		if (flags & MSG_DONTWAIT)
+			_fail(EAGAIN, "send");
+		// the peer wakes us up when it reads
+		_wait(_ep);
+		_check();
+	}
+	_push(_ep->peer, buf, n);
+	return n;
+}
+
+inline
+ssize_t posixx::socket::loopback::socket::_recv(void* buf, std::size_t n,
+		sockaddr* from, int flags) throw (error)
+{
+	lock l;
+	_check();
+	if (_ep->type != DGRAM && !_ep->connected)
+		_fail(ENOTCONN, "recv");
+	// SO_RCVTIMEO deadline (0 means no timeout)
+	uint64_t deadline = 0;
+	while (true) {
+		uint64_t until = 0;
+		if (!_ep->queue.empty()) {
+			message& m = _ep->queue.front();
+			uint64_t now = m.at ? tsc::monotonic() : 0;
+			if (m.at <= now)
+				break;
+			until = m.at;
+		}
+		else if (_ep->eof) {
+			error e("recv connection shutdown");
+			e.no = 0;
+			throw e;
+		}
+		if (flags & MSG_DONTWAIT)
+			_fail(EAGAIN, "recv");
+		if (_ep->rcvtimeo) {
+			uint64_t now = tsc::monotonic();
+			if (deadline == 0)
+				deadline = now + _ep->rcvtimeo;
+			else if (now >= deadline)
+				_fail(EAGAIN, "recv");
+			if (until == 0 || deadline < until)
+				until = deadline;
+		}
+		_wait(_ep, until);
+		_check();
+	}
+	message& m = _ep->queue.front();
+	std::size_t c;
+	if (_ep->type == STREAM) {
+		c = std::min(n, m.data.size() - _ep->offset);
+		std::memcpy(buf, m.data.data() + _ep->offset, c);
+		_ep->offset += c;
+		_ep->queued -= c;
+	}
+	else {
+		c = std::min(n, m.data.size());
+		std::memcpy(buf, m.data.data(), c);
+		_ep->offset = m.data.size();
+		_ep->queued -= m.data.size();
+	}
+	if (from != NULL)
+		*from = m.from;
+	if (_ep->offset == m.data.size()) {
+		_ep->queue.pop_front();
+		_ep->offset = 0;
+	}
+	// wake up a sender waiting for space
+	if (_ep->peer != NULL)
+		pthread_cond_broadcast(&_ep->peer->cond);
+	return c;
+}
+
+inline
+ssize_t posixx::socket::loopback::socket::send(const void* buf, size_t n,
+		int flags) throw (error)
+{
+	return _send(buf, n, NULL, flags);
+}
+
+inline
+ssize_t posixx::socket::loopback::socket::recv(void* buf, size_t n,
+		int flags) throw (error)
+{
+	return _recv(buf, n, NULL, flags);
+}
+
+inline
+ssize_t posixx::socket::loopback::socket::send(const void* buf, size_t n,
+		const sockaddr& to, int flags) throw (error)
+{
+	return _send(buf, n, &to, flags);
+}
+
+inline
+ssize_t posixx::socket::loopback::socket::recv(void* buf, size_t n,
+		sockaddr& from, int flags) throw (error)
+{
+	return _recv(buf, n, &from, flags);
+}
+
+inline
+void posixx::socket::loopback::socket::_getsockopt(int level, int optname,
+		void* opt, std::size_t n) const throw (error)
+{
+	lock l;
+	_check();
+	std::memset(opt, 0, n);
+	if (level == SOL_SOCKET && optname == SO_TYPE) {
+		std::memcpy(opt, &_ep->type, std::min(n, sizeof(int)));
+		return;
+	}
+	endpoint::opts_type::const_iterator i = _ep->opts.find(
+			std::make_pair(level, optname));
+	if (i != _ep->opts.end())
+		std::memcpy(opt, i->second.data(),
+				std::min(n, i->second.size()));
+}
+
+inline
+void posixx::socket::loopback::socket::_setsockopt(int level, int optname,
+		const void* opt, std::size_t n) throw (error)
+{
+	lock l;
+	_check();
+	_ep->opts[std::make_pair(level, optname)].assign(
+			static_cast< const char* >(opt), n);
+	if (level == SOL_SOCKET && optname == SO_RCVTIMEO
+			&& n >= sizeof(timeval)) {
+		const timeval* tv = static_cast< const timeval* >(opt);
+		_ep->rcvtimeo = static_cast< uint64_t >(tv->tv_sec)
+				* 1000000000 + tv->tv_usec * 1000;
+	}
+}
+
+template< typename TSockOpt >
+inline
+void posixx::socket::loopback::socket::getsockopt(int level, int optname,
+		TSockOpt& opt) const throw (error)
+{
+	_getsockopt(level, optname, &opt, sizeof(TSockOpt));
+}
+
+template< typename TSockOpt >
+inline
+void posixx::socket::loopback::socket::setsockopt(int level, int optname,
+		const TSockOpt& opt) throw (error)
+{
+	_setsockopt(level, optname, &opt, sizeof(TSockOpt));
+}
+
+template< typename TSockOpt >
+inline
+typename TSockOpt::type posixx::socket::loopback::socket::opt() const
+		throw (error)
+{
+	static_assert(TSockOpt::read, "Option is not readable");
+	typename TSockOpt::type opt;
+	_getsockopt(TSockOpt::level, TSockOpt::optname, &opt, sizeof(opt));
+	return opt;
+}
+
+template< typename TSockOpt >
+inline
+void posixx::socket::loopback::socket::opt(
+		const typename TSockOpt::type& opt) throw (error)
+{
+	static_assert(TSockOpt::write, "Option is not writable");
+	_setsockopt(TSockOpt::level, TSockOpt::optname, &opt,
+			sizeof(typename TSockOpt::type));
+}
+
+inline
+void posixx::socket::loopback::socket::listen(int backlog) throw (error)
+{
+	lock l;
+	_check();
+	if (_ep->type == DGRAM)
+		_fail(EOPNOTSUPP, "listen");
+	if (_ep->connected)
+		_fail(EINVAL, "listen");
+	if (_ep->name.port == 0)
+		_bind(sockaddr());
+	_ep->listening = true;
+	_ep->max_backlog = backlog > 0 ? backlog : 1;
+}
+
+inline
+posixx::socket::loopback::socket* posixx::socket::loopback::socket::_accept(
+		sockaddr* addr) throw (error)
+{
+	endpoint* ep;
+	{
+		lock l;
+		_check();
+		if (!_ep->listening)
+			_fail(EINVAL, "accept");
+		while (_ep->backlog.empty()) {
+			_wait(_ep);
+			_check();
+		}
+		ep = _ep->backlog.front();
+		_ep->backlog.pop_front();
+		if (addr != NULL)
+			*addr = ep->peer_name;
+	}
+	try {
+		return new socket(ep);
+	}
+	catch (...) {
+		lock l;
+		_reset(ep);
+		throw;
+	}
+}
+
+inline
+posixx::socket::loopback::socket* posixx::socket::loopback::socket::accept()
+		throw (error)
+{
+	return _accept(NULL);
+}
+
+inline
+posixx::socket::loopback::socket* posixx::socket::loopback::socket::accept(
+		sockaddr& addr) throw (error)
+{
+	return _accept(&addr);
+}
+
+inline
+void posixx::socket::loopback::socket::shutdown(shutdown_mode how)
+		throw (error)
+{
+	lock l;
+	_check();
+	if (_ep->type != DGRAM && !_ep->connected)
+		_fail(ENOTCONN, "shutdown");
+	if (how == RD || how == RDWR) {
+		_ep->eof = true;
+		pthread_cond_broadcast(&_ep->cond);
+	}
+	if (how == WR || how == RDWR) {
+		_ep->shut_wr = true;
+		if (_ep->peer != NULL) {
+			_ep->peer->eof = true;
+			pthread_cond_broadcast(&_ep->peer->cond);
+		}
+	}
+}
+
+inline
+void posixx::socket::loopback::socket::close() throw (error)
+{
+	{
+		lock l;
+		_check();
+		network& net = network::instance();
+		std::map< uint32_t, endpoint* >::iterator i = net.ports.find(
+				_ep->name.port);
+		if (i != net.ports.end() && i->second == _ep)
+			net.ports.erase(i);
+		// connections not accepted yet are reset
+		for (std::size_t j = 0; j < _ep->backlog.size(); ++j)
+			_reset(_ep->backlog[j]);
+		_reset(_ep);
+		_ep = NULL;
+	}
+	if (_fd == -1)
+		return;
+	int fd = _fd;
+	_fd = -1;
+	if (::close(fd) == -1)
+		throw error("close");
+}
+
+inline
+posixx::socket::loopback::socket::~socket() throw ()
+{
+	if (_ep != NULL)
+		close();
+}
+
+template< typename TPacket >
+inline
+void posixx::socket::loopback::socket::send_struct(const TPacket& packet,
+		int flags) throw (error)
+{
+	send(&packet, sizeof(TPacket), flags);
+}
+
+template< typename TPacket >
+inline
+void posixx::socket::loopback::socket::recv_struct(TPacket& packet,
+		int flags) throw (error)
+{
+	// STREAM messages can arrive in pieces
+	char* p = reinterpret_cast< char* >(&packet);
+	std::size_t s = 0;
+	do
+		s += recv(p + s, sizeof(TPacket) - s, flags);
+	while (_ep->type == STREAM && s < sizeof(TPacket));
+	if (s != sizeof(TPacket))
+		_fail(EMSGSIZE, "recv size not match");
+}
+
+template< typename TPacket >
+inline
+void posixx::socket::loopback::socket::send_struct(const TPacket& packet,
+		const sockaddr& to, int flags) throw (error)
+{
+	send(&packet, sizeof(TPacket), to, flags);
+}
+
+template< typename TPacket >
+inline
+void posixx::socket::loopback::socket::recv_struct(TPacket& packet,
+		sockaddr& from, int flags) throw (error)
+{
+	char* p = reinterpret_cast< char* >(&packet);
+	std::size_t s = 0;
+	do
+		s += recv(p + s, sizeof(TPacket) - s, from, flags);
+	while (_ep->type == STREAM && s < sizeof(TPacket));
+	if (s != sizeof(TPacket))
+		_fail(EMSGSIZE, "recv size not match");
+}
+
+inline
+int posixx::socket::loopback::socket::fd() const throw ()
+{
+	return _fd;
+}
+
+inline
+posixx::socket::loopback::socket::operator int () const throw ()
+{
+	return _fd;
+}
+
+inline
+posixx::socket::loopback::config posixx::socket::loopback::socket::conf()
+		const throw ()
+{
+	lock l;
+	return _ep ? _ep->conf : config();
+}
+
+inline
+void posixx::socket::loopback::socket::conf(const config& conf) throw ()
+{
+	lock l;
+	if (_ep)
+		_ep->conf = conf;
+}
+
+inline
+posixx::socket::loopback::pair_type posixx::socket::loopback::pair(
+		type type, int protocol) throw (error)
+{
+	socket* a = new socket(type, protocol);
+	socket* b;
+	try {
+		b = new socket(type, protocol);
+	}
+	catch (...) {
+		delete a;
+		throw;
+	}
+	socket::lock l;
+	a->_bind(sockaddr());
+	b->_bind(sockaddr());
+	a->_ep->peer_name = b->_ep->name;
+	b->_ep->peer_name = a->_ep->name;
+	a->_ep->connected = b->_ep->connected = true;
+	if (type != DGRAM) {
+		a->_ep->peer = b->_ep;
+		b->_ep->peer = a->_ep;
+	}
+	return std::make_pair(a, b);
+}
+
+#endif // POSIXX_SOCKET_LOOPBACK_HPP_
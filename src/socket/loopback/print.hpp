@@ -0,0 +1,24 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_LOOPBACK_PRINT_HPP_
+#define POSIXX_SOCKET_LOOPBACK_PRINT_HPP_
+
+#include "../loopback.hpp" // posixx::socket::loopback::sockaddr
+#include <ostream> // std::ostream
+
+namespace posixx { namespace socket { namespace loopback {
+
+// it's not a C struct, so it has to be here to be found by ADL
+inline
+std::ostream& operator << (std::ostream& os, const sockaddr& sa) throw()
+{
+	return os << "loopback::sockaddr(port=" << sa.port << ")";
+}
+
+} } } // namespace posixx::socket::loopback
+
+#endif // POSIXX_SOCKET_LOOPBACK_PRINT_HPP_
@@ -53,6 +53,7 @@ MKSOLOPT_R(SNDLOWAT, size_t);
 MKSOLOPT_RW(RCVTIMEO, timeval);
 MKSOLOPT_RW(SNDTIMEO, timeval);
 MKSOLOPT_RW(REUSEADDR, int);
+MKSOLOPT_RW(REUSEPORT, int);
 MKSOLOPT_RW(SNDBUF, size_t);
 MKSOLOPT_RW(SNDBUFFORCE, size_t);
 MKSOLOPT_RW(TIMESTAMP, int);
@@ -0,0 +1,501 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_PEER_TABLE_HPP_
+#define POSIXX_SOCKET_PEER_TABLE_HPP_
+
+#include "../simd.hpp" // POSIXX_SIMD_X86, SSE2 intrinsics
+
+#include <new> // placement new, operator new
+#include <utility> // std::pair
+#include <algorithm> // std::swap
+#include <cstring> // memset
+#include <cstddef> // std::size_t
+#include <stdint.h> // uint64_t
+
+/// @file
+
+namespace posixx { namespace socket {
+
+/**
+ * Hash table of per-peer state, keyed by socket address.
+ *
+ * It's meant to keep the state of the peers of a datagram server, looked
+ * up for each received packet using the address returned by
+ * basic_socket::recv(), so it's designed to keep lookups in cache even
+ * with millions of peers:
+ *
+ * - Open addressing: the entries (address and value) are stored in a
+ *   single flat array, there is no allocation per peer.
+ * - Each slot has a control byte with 7 bits of the hash of its address
+ *   (or a mark if it's empty or deleted). The control bytes are kept in a
+ *   separate, compact array and probed 16 at a time (using SSE2 when
+ *   available), so a lookup usually touches just one cache line of control
+ *   bytes and the one of the matching entry, and a miss usually doesn't
+ *   touch any entry at all.
+ * - The load factor is at most 7/8, so little memory is wasted.
+ *
+ * TSockaddr must provide a hash() member (consistent with operator==), like
+ * all the posixx socket addresses do.
+ *
+ * Pointers to the values are invalidated by insertions (which can grow the
+ * table) and erasures. The table is not thread-safe.
+ *
+ * @code
+ * posixx::socket::peer_table< inet::sockaddr, session > peers;
+ * inet::sockaddr from;
+ * ssize_t n = sock.recv(buf, sizeof(buf), from);
+ * session& s = peers[from];
+ * @endcode
+ */
+template < typename TSockaddr, typename TValue >
+struct peer_table
+{
+
+	/// Type of the keys.
+	typedef TSockaddr key_type;
+
+	/// Type of the values.
+	typedef TValue value_type;
+
+	/// Number of slots probed at a time.
+	enum { GROUP = 16 };
+
+	/**
+	 * Create a table.
+	 *
+	 * @param n Number of peers to make room for.
+	 */
+	explicit peer_table(std::size_t n = 0);
+
+	/// Find the value of a peer (NULL if not present).
+	TValue* find(const TSockaddr& addr) throw ();
+
+	/// Find the value of a peer (NULL if not present).
+	const TValue* find(const TSockaddr& addr) const throw ();
+
+	/**
+	 * Insert a peer (if not present).
+	 *
+	 * @return The value of the peer and true if it was inserted (false if
+	 *         it was already present, in which case the value is not
+	 *         changed).
+	 */
+	std::pair< TValue*, bool > insert(const TSockaddr& addr,
+			const TValue& value = TValue());
+
+	/// Get the value of a peer (inserting a default one if not present).
+	TValue& operator [] (const TSockaddr& addr);
+
+	/**
+	 * Remove a peer.
+	 *
+	 * @return true if it was present.
+	 */
+	bool erase(const TSockaddr& addr) throw ();
+
+	/**
+	 * Remove the peers for which pred(addr, value) is true.
+	 *
+	 * Useful to expire idle peers.
+	 *
+	 * @return The number of peers removed.
+	 */
+	template < typename F >
+	std::size_t erase_if(F pred);
+
+	/// Call f(addr, value) for each peer.
+	template < typename F >
+	void for_each(F f);
+
+	/**
+	 * Prefetch the memory a lookup of addr will touch.
+	 *
+	 * When processing a batch of packets (see recvmmsg(2)), prefetching
+	 * all the addresses first overlaps the cache misses of the lookups.
+	 */
+	void prefetch(const TSockaddr& addr) const throw ();
+
+	/// Remove all the peers (the capacity is kept).
+	void clear() throw ();
+
+	/// Make room for n peers.
+	void reserve(std::size_t n);
+
+	/// Number of peers.
+	std::size_t size() const throw ();
+
+	/// Tell if there are no peers.
+	bool empty() const throw ();
+
+	/// Number of slots.
+	std::size_t capacity() const throw ();
+
+	/// Destructor.
+	~peer_table() throw ();
+
+private:
+
+	// Hidden copy constructor and assign operator
+	peer_table(const peer_table& t);
+	peer_table& operator=(const peer_table& t);
+
+	enum { EMPTY = 0x80, DELETED = 0xfe, NPOS = -1 };
+
+	struct entry
+	{
+		TSockaddr addr;
+		TValue value;
+		entry(const TSockaddr& a, const TValue& v): addr(a), value(v) {}
+	};
+
+	static unsigned _match(const unsigned char* g, unsigned char c)
+			throw ();
+
+	static unsigned _match_free(const unsigned char* g) throw ();
+
+	static std::size_t _groups_for(std::size_t n) throw ();
+
+	std::size_t _find(const TSockaddr& addr, uint64_t h) const throw ();
+
+	std::size_t _free_slot(uint64_t h) const throw ();
+
+	void _erase_slot(std::size_t i) throw ();
+
+	void _rehash(std::size_t groups);
+
+	unsigned char* _ctrl;
+	entry* _slots;
+	std::size_t _mask;
+	std::size_t _size;
+	std::size_t _growth_left;
+
+};
+
+} } // namespace posixx::socket
+
+
+
+template < typename TSockaddr, typename TValue >
+inline
+posixx::socket::peer_table< TSockaddr, TValue >::peer_table(std::size_t n):
+		_ctrl(NULL), _slots(NULL), _mask(0), _size(0), _growth_left(0)
+{
+	_rehash(_groups_for(n));
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+unsigned posixx::socket::peer_table< TSockaddr, TValue >::_match(
+		const unsigned char* g, unsigned char c) throw ()
+{
+#if POSIXX_SIMD_X86
+	__m128i v = _mm_loadu_si128(reinterpret_cast< const __m128i* >(g));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+#else
+	unsigned m = 0;
+	for (unsigned i = 0; i < GROUP; ++i)
+		m |= unsigned(g[i] == c) << i;
+	return m;
+#endif
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+unsigned posixx::socket::peer_table< TSockaddr, TValue >::_match_free(
+		const unsigned char* g) throw ()
+{
+	// only EMPTY and DELETED have the high bit set
+#if POSIXX_SIMD_X86
+	return _mm_movemask_epi8(_mm_loadu_si128(
+			reinterpret_cast< const __m128i* >(g)));
+#else
+	unsigned m = 0;
+	for (unsigned i = 0; i < GROUP; ++i)
+		m |= unsigned(g[i] >> 7) << i;
+	return m;
+#endif
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+std::size_t posixx::socket::peer_table< TSockaddr, TValue >::_groups_for(
+		std::size_t n) throw ()
+{
+	// the load factor is kept at most at 7/8
+	std::size_t groups = 1;
+	while (groups * GROUP / 8 * 7 < n)
+		groups *= 2;
+	return groups;
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+std::size_t posixx::socket::peer_table< TSockaddr, TValue >::_find(
+		const TSockaddr& addr, uint64_t h) const throw ()
+{
+	// groups are probed in triangular steps, which visits all of them
+	// when their number is a power of 2
+	std::size_t g = (h >> 7) & _mask;
+	unsigned char h2 = h & 0x7f;
+	for (std::size_t step = 1; ; ++step) {
+		const unsigned char* c = _ctrl + g * GROUP;
+		for (unsigned m = _match(c, h2); m; m &= m - 1) {
+			std::size_t i = g * GROUP + __builtin_ctz(m);
+			if (_slots[i].addr == addr)
+				return i;
+		}
+		if (_match(c, EMPTY))
+			return NPOS;
+		g = (g + step) & _mask;
+	}
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+std::size_t posixx::socket::peer_table< TSockaddr, TValue >::_free_slot(
+		uint64_t h) const throw ()
+{
+	std::size_t g = (h >> 7) & _mask;
+	for (std::size_t step = 1; ; ++step) {
+		unsigned m = _match_free(_ctrl + g * GROUP);
+		if (m)
+			return g * GROUP + __builtin_ctz(m);
+		g = (g + step) & _mask;
+	}
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+TValue* posixx::socket::peer_table< TSockaddr, TValue >::find(
+		const TSockaddr& addr) throw ()
+{
+	std::size_t i = _find(addr, addr.hash());
+	return i == std::size_t(NPOS) ? NULL : &_slots[i].value;
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+const TValue* posixx::socket::peer_table< TSockaddr, TValue >::find(
+		const TSockaddr& addr) const throw ()
+{
+	std::size_t i = _find(addr, addr.hash());
+	return i == std::size_t(NPOS) ? NULL : &_slots[i].value;
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+std::pair< TValue*, bool >
+posixx::socket::peer_table< TSockaddr, TValue >::insert(
+		const TSockaddr& addr, const TValue& value)
+{
+	uint64_t h = addr.hash();
+	std::size_t i = _find(addr, h);
+	if (i != std::size_t(NPOS))
+		return std::make_pair(&_slots[i].value, false);
+	if (!_growth_left) {
+		// grow if at least half of the used slots are live peers,
+		// otherwise just get rid of the deleted slots
+		std::size_t groups = _mask + 1;
+		if (_size * 2 >= capacity() / 8 * 7)
+			groups *= 2;
+		_rehash(groups);
+	}
+	i = _free_slot(h);
+	new (&_slots[i]) entry(addr, value);
+	if (_ctrl[i] == EMPTY)
+		--_growth_left;
+	_ctrl[i] = h & 0x7f;
+	++_size;
+	return std::make_pair(&_slots[i].value, true);
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+TValue& posixx::socket::peer_table< TSockaddr, TValue >::operator [] (
+		const TSockaddr& addr)
+{
+	return *insert(addr).first;
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+void posixx::socket::peer_table< TSockaddr, TValue >::_erase_slot(
+		std::size_t i) throw ()
+{
+	_slots[i].~entry();
+	// if the group has an empty slot, it was never full, so no probe
+	// sequence goes through it and the slot can be just emptied
+	if (_match(_ctrl + i / GROUP * GROUP, EMPTY)) {
+		_ctrl[i] = EMPTY;
+		++_growth_left;
+	}
+	else
+		_ctrl[i] = DELETED;
+	--_size;
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+bool posixx::socket::peer_table< TSockaddr, TValue >::erase(
+		const TSockaddr& addr) throw ()
+{
+	std::size_t i = _find(addr, addr.hash());
+	if (i == std::size_t(NPOS))
+		return false;
+	_erase_slot(i);
+	return true;
+}
+
+template < typename TSockaddr, typename TValue >
+template < typename F >
+inline
+std::size_t posixx::socket::peer_table< TSockaddr, TValue >::erase_if(
+		F pred)
+{
+	std::size_t n = 0;
+	for (std::size_t i = 0; i < capacity(); ++i) {
+		if (_ctrl[i] & 0x80)
+			continue;
+		if (pred(const_cast< const TSockaddr& >(_slots[i].addr),
+				_slots[i].value)) {
+			_erase_slot(i);
+			++n;
+		}
+	}
+	return n;
+}
+
+template < typename TSockaddr, typename TValue >
+template < typename F >
+inline
+void posixx::socket::peer_table< TSockaddr, TValue >::for_each(F f)
+{
+	for (std::size_t i = 0; i < capacity(); ++i)
+		if (!(_ctrl[i] & 0x80))
+			f(const_cast< const TSockaddr& >(_slots[i].addr),
+					_slots[i].value);
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+void posixx::socket::peer_table< TSockaddr, TValue >::prefetch(
+		const TSockaddr& addr) const throw ()
+{
+	std::size_t g = (addr.hash() >> 7) & _mask;
+	__builtin_prefetch(_ctrl + g * GROUP);
+	__builtin_prefetch(_slots + g * GROUP);
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+void posixx::socket::peer_table< TSockaddr, TValue >::clear() throw ()
+{
+	for (std::size_t i = 0; i < capacity(); ++i)
+		if (!(_ctrl[i] & 0x80))
+			_slots[i].~entry();
+	memset(_ctrl, EMPTY, capacity());
+	_size = 0;
+	_growth_left = capacity() / 8 * 7;
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+void posixx::socket::peer_table< TSockaddr, TValue >::reserve(
+		std::size_t n)
+{
+	std::size_t groups = _groups_for(n);
+	if (groups > _mask + 1)
+		_rehash(groups);
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+void posixx::socket::peer_table< TSockaddr, TValue >::_rehash(
+		std::size_t groups)
+{
+	std::size_t cap = groups * GROUP;
+	unsigned char* ctrl = new unsigned char[cap];
+	entry* slots;
+	try {
+		slots = static_cast< entry* >(::operator new(
+				cap * sizeof(entry)));
+	}
+	catch (...) {
+		delete [] ctrl;
+		throw;
+	}
+	memset(ctrl, EMPTY, cap);
+	// copy the peers to the new arrays (if a copy fails, the table is
+	// left untouched)
+	std::size_t old_cap = _ctrl ? capacity() : 0;
+	std::swap(ctrl, _ctrl);
+	std::swap(slots, _slots);
+	std::size_t old_mask = _mask;
+	_mask = groups - 1;
+	try {
+		for (std::size_t i = 0; i < old_cap; ++i) {
+			if (ctrl[i] & 0x80)
+				continue;
+			uint64_t h = slots[i].addr.hash();
+			std::size_t j = _free_slot(h);
+			new (&_slots[j]) entry(slots[i]);
+			_ctrl[j] = h & 0x7f;
+		}
+	}
+	catch (...) {
+		for (std::size_t j = 0; j < cap; ++j)
+			if (!(_ctrl[j] & 0x80))
+				_slots[j].~entry();
+		std::swap(ctrl, _ctrl);
+		std::swap(slots, _slots);
+		_mask = old_mask;
+		delete [] ctrl;
+		::operator delete(slots);
+		throw;
+	}
+	for (std::size_t i = 0; i < old_cap; ++i)
+		if (!(ctrl[i] & 0x80))
+			slots[i].~entry();
+	delete [] ctrl;
+	::operator delete(slots);
+	_growth_left = cap / 8 * 7 - _size;
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+std::size_t posixx::socket::peer_table< TSockaddr, TValue >::size() const
+		throw ()
+{
+	return _size;
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+bool posixx::socket::peer_table< TSockaddr, TValue >::empty() const
+		throw ()
+{
+	return !_size;
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+std::size_t posixx::socket::peer_table< TSockaddr, TValue >::capacity()
+		const throw ()
+{
+	return (_mask + 1) * GROUP;
+}
+
+template < typename TSockaddr, typename TValue >
+inline
+posixx::socket::peer_table< TSockaddr, TValue >::~peer_table() throw ()
+{
+	clear();
+	delete [] _ctrl;
+	::operator delete(_slots);
+}
+
+#endif // POSIXX_SOCKET_PEER_TABLE_HPP_
@@ -0,0 +1,599 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_PIPELINE_HPP_
+#define POSIXX_SOCKET_PIPELINE_HPP_
+
+#include "../error.hpp" // posixx::error
+#include "../buffer.hpp" // posixx::buffer
+#include "basic_socket.hpp" // posixx::socket::basic_socket
+#include "opt.hpp" // posixx::socket::opt::TYPE
+
+#include <vector> // std::vector
+#include <algorithm> // std::min
+#include <cstring> // std::memcpy, std::memmove
+#include <cerrno> // errno, EAGAIN, EWOULDBLOCK, EMSGSIZE, EINVAL
+#include <stdint.h> // uint32_t
+#include <sys/socket.h> // msghdr, mmsghdr, MSG_*
+#include <sys/uio.h> // iovec
+#include <arpa/inet.h> // htonl, ntohl
+
+/// @file
+
+namespace posixx { namespace socket {
+
+/**
+ * Pipelined request/response client.
+ *
+ * Instead of waiting for each response before sending the next request, a
+ * pipeline keeps up to window() requests in flight and matches responses
+ * to requests by a correlation ID, so responses can arrive in any order.
+ * Requests submitted while the window is full are queued and sent as
+ * responses arrive. All the requests that can be sent are batched in a
+ * single system call: a gathering sendmsg() (like writev()) for STREAM
+ * sockets, and sendmmsg() for message oriented sockets (SEQPACKET, DGRAM),
+ * where each request must be a separate message.
+ *
+ * Each request and response is framed by a header, with the correlation
+ * ID and the payload size (both 32 bits, in network byte order). A
+ * server must send back the ID of the request in the response header.
+ *
+ * Requests are owned by the caller, they work as futures: done() tells if
+ * the response arrived and response() gets it. To use a callback instead,
+ * override request::completed() (which is called for both responses and
+ * errors). Nothing is allocated per request, except for the response
+ * copy made by the default completed().
+ *
+ * A pipeline is not thread-safe, and the socket should not be used by
+ * anybody else while the pipeline is in use.
+ *
+ * @code
+ * pipeline< inet::traits > p(sock, 32);
+ * pipeline< inet::traits >::request r[3];
+ * for (int i = 0; i < 3; ++i)
+ *	p.submit(r[i], req[i], len[i]);
+ * p.wait(r[2]); // r[0] and r[1] might be done too
+ * @endcode
+ */
+template < typename TSockTraits >
+struct pipeline
+{
+
+	/// Type of the socket.
+	typedef basic_socket< TSockTraits > socket_type;
+
+	/// Maximum window size (the low 16 bits of the IDs are the slot).
+	enum { MAX_WINDOW = 65536 };
+
+	/// Request and response header.
+	struct header
+	{
+		/// Correlation ID (network byte order).
+		uint32_t id;
+		/// Size of the payload that follows (network byte order).
+		uint32_t size;
+	};
+
+	/// A request (and its response).
+	struct request
+	{
+
+		/// State of a request.
+		enum state_type
+		{
+			/// Not submitted (or completed and reset).
+			IDLE,
+			/// Waiting for room in the window.
+			QUEUED,
+			/// Sent, waiting for the response.
+			SENT,
+			/// Response received.
+			DONE,
+			/// The connection failed before getting the response.
+			FAILED
+		};
+
+		/// Create an idle request.
+		request() throw ();
+
+		/// Current state.
+		state_type state() const throw ();
+
+		/// true if the request is completed (DONE or FAILED).
+		bool done() const throw ();
+
+		/// Response payload (filled by the default completed()).
+		const buffer& response() const throw ();
+
+		/// Error number if it FAILED (0 if the peer shut down).
+		int error_no() const throw ();
+
+		/**
+		 * Called when the request is completed.
+		 *
+		 * The default implementation copies the response payload to
+		 * response(). data is only valid during the call.
+		 *
+		 * @param data Response payload (NULL if the request failed).
+		 * @param n Response payload size.
+		 */
+		virtual void completed(const char* data, std::size_t n);
+
+		/// Destructor.
+		virtual ~request();
+
+	private:
+
+		friend struct pipeline;
+
+		state_type _state;
+		uint32_t _id;
+		header _header;
+		const void* _data;
+		request* _next;
+		int _errno;
+		buffer _response;
+
+	};
+
+	/**
+	 * Create a pipeline.
+	 *
+	 * @param s Connected socket.
+	 * @param window Maximum number of requests in flight (up to
+	 *               MAX_WINDOW).
+	 * @param max_response Maximum response payload size.
+	 */
+	pipeline(socket_type& s, std::size_t window = 64,
+			std::size_t max_response = 65536) throw (error);
+
+	/**
+	 * Submit a request (it's sent by the next flush()).
+	 *
+	 * @param r Request (it must be idle or completed, and it must live
+	 *          until it's completed).
+	 * @param data Request payload (it must live until it's sent).
+	 * @param n Request payload size.
+	 */
+	void submit(request& r, const void* data, std::size_t n) throw (error);
+
+	/**
+	 * Send the queued requests that fit in the window.
+	 *
+	 * @return Number of requests sent.
+	 */
+	std::size_t flush() throw (error);
+
+	/**
+	 * Receive responses and complete their requests.
+	 *
+	 * The queued requests are flushed after the responses are processed.
+	 * If the connection fails, all the pending requests fail and the
+	 * error is thrown. On message oriented sockets each response must
+	 * be a single message holding exactly one frame, otherwise the
+	 * connection fails with EMSGSIZE.
+	 *
+	 * @param block Wait for at least some data if there is none.
+	 *
+	 * @return Number of requests completed.
+	 */
+	std::size_t poll(bool block = true) throw (error);
+
+	/// Flush and poll until a request is completed.
+	void wait(request& r) throw (error);
+
+	/// Number of requests in flight.
+	std::size_t inflight() const throw ();
+
+	/// Number of requests waiting for room in the window.
+	std::size_t queued() const throw ();
+
+	/// Maximum number of requests in flight.
+	std::size_t window() const throw ();
+
+private:
+
+	// Hidden copy constructor and assign operator
+	pipeline(const pipeline& p);
+	pipeline& operator=(const pipeline& p);
+
+	void _complete(request& r, const char* data, std::size_t n) throw ();
+
+	void _fail(const error& e) throw ();
+
+	// Maximum requests per sendmsg() (Linux IOV_MAX is 1024)
+	enum { MAX_BATCH = 512 };
+
+	void _send_stream(std::size_t n) throw (error);
+
+	void _send_messages(std::size_t n) throw (error);
+
+	socket_type& _sock;
+	bool _stream;
+	std::size_t _max_response;
+	// in-flight requests, indexed by the low 16 bits of their IDs
+	std::vector< request* > _slots;
+	std::vector< uint32_t > _free;
+	uint16_t _generation;
+	std::size_t _inflight;
+	request* _head;
+	request* _tail;
+	std::size_t _queued;
+	// requests being sent and their iovecs / messages
+	std::vector< request* > _batch;
+	std::vector< iovec > _iov;
+	std::vector< mmsghdr > _msgs;
+	buffer _rbuf;
+	std::size_t _filled;
+
+};
+
+} } // namespace posixx::socket
+
+
+
+template < typename TSockTraits >
+inline
+posixx::socket::pipeline< TSockTraits >::request::request() throw ():
+		_state(IDLE), _id(0), _data(NULL), _next(NULL), _errno(0)
+{
+}
+
+template < typename TSockTraits >
+inline
+typename posixx::socket::pipeline< TSockTraits >::request::state_type
+posixx::socket::pipeline< TSockTraits >::request::state() const throw ()
+{
+	return _state;
+}
+
+template < typename TSockTraits >
+inline
+bool posixx::socket::pipeline< TSockTraits >::request::done() const
+		throw ()
+{
+	return _state == DONE || _state == FAILED;
+}
+
+template < typename TSockTraits >
+inline
+const posixx::buffer&
+posixx::socket::pipeline< TSockTraits >::request::response() const
+		throw ()
+{
+	return _response;
+}
+
+template < typename TSockTraits >
+inline
+int posixx::socket::pipeline< TSockTraits >::request::error_no() const
+		throw ()
+{
+	return _errno;
+}
+
+template < typename TSockTraits >
+inline
+void posixx::socket::pipeline< TSockTraits >::request::completed(
+		const char* data, std::size_t n)
+{
+	if (data) {
+		_response.resize(n);
+		if (n)
+			std::memcpy(_response.c_array(), data, n);
+	}
+}
+
+template < typename TSockTraits >
+inline
+posixx::socket::pipeline< TSockTraits >::request::~request()
+{
+}
+
+template < typename TSockTraits >
+inline
+posixx::socket::pipeline< TSockTraits >::pipeline(socket_type& s,
+		std::size_t window, std::size_t max_response) throw (error):
+		_sock(s), _max_response(max_response), _slots(window, NULL),
+		_generation(0), _inflight(0), _head(NULL), _tail(NULL),
+		_queued(0), _filled(0)
+{
+	if (!window || window > MAX_WINDOW) {
+		errno = EINVAL;
+		throw error("pipeline window");
+	}
+	_stream = s.template opt< opt::TYPE >() == SOCK_STREAM;
+	_free.reserve(window);
+	for (std::size_t i = window; i; --i)
+		_free.push_back(i - 1);
+	_batch.reserve(window);
+	_iov.resize(window * 2);
+	if (!_stream)
+		_msgs.resize(window);
+	// room for a few responses per recv() on streams
+	std::size_t frame = sizeof(header) + max_response;
+	_rbuf.resize(_stream && frame < 65536 ? 65536 : frame);
+}
+
+template < typename TSockTraits >
+inline
+void posixx::socket::pipeline< TSockTraits >::submit(request& r,
+		const void* data, std::size_t n) throw (error)
+{
+	if (r._state == request::QUEUED || r._state == request::SENT) {
+		errno = EINVAL;
+		throw error("pipeline submit");
+	}
+	r._state = request::QUEUED;
+	r._data = data;
+	r._header.size = htonl(n);
+	r._errno = 0;
+	r._next = NULL;
+	if (_tail)
+		_tail->_next = &r;
+	else
+		_head = &r;
+	_tail = &r;
+	++_queued;
+}
+
+template < typename TSockTraits >
+inline
+std::size_t posixx::socket::pipeline< TSockTraits >::flush() throw (error)
+{
+	std::size_t n = 0;
+	_batch.clear();
+	while (_head && !_free.empty()) {
+		request& r = *_head;
+		_head = r._next;
+		if (!_head)
+			_tail = NULL;
+		--_queued;
+		uint32_t slot = _free.back();
+		_free.pop_back();
+		// the generation makes stale IDs from a previous use of the
+		// slot not match
+		r._id = uint32_t(_generation++) << 16 | slot;
+		r._header.id = htonl(r._id);
+		r._state = request::SENT;
+		_slots[slot] = &r;
+		++_inflight;
+		_batch.push_back(&r);
+		++n;
+	}
+	if (!n)
+		return 0;
+	try {
+		if (_stream)
+			_send_stream(n);
+		else
+			_send_messages(n);
+	}
+	catch (const error& e) {
+		_fail(e);
+		throw;
+	}
+	return n;
+}
+
+template < typename TSockTraits >
+inline
+void posixx::socket::pipeline< TSockTraits >::_send_stream(std::size_t n)
+		throw (error)
+{
+	for (std::size_t i = 0; i < n; ++i) {
+		request& r = *_batch[i];
+		_iov[2 * i].iov_base = &r._header;
+		_iov[2 * i].iov_len = sizeof(header);
+		_iov[2 * i + 1].iov_base = const_cast< void* >(r._data);
+		_iov[2 * i + 1].iov_len = ntohl(r._header.size);
+	}
+	for (std::size_t first = 0; first < n; first += MAX_BATCH) {
+		msghdr msg;
+		std::memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &_iov[2 * first];
+		msg.msg_iovlen = 2 * std::min< std::size_t >(n - first,
+				MAX_BATCH);
+		while (msg.msg_iovlen) {
+			ssize_t sent = _sock.send(&msg, MSG_NOSIGNAL);
+			// skip what was sent (a partial send is unusual)
+			while (msg.msg_iovlen && std::size_t(sent) >=
+					msg.msg_iov->iov_len) {
+				sent -= msg.msg_iov->iov_len;
+				++msg.msg_iov;
+				--msg.msg_iovlen;
+			}
+			if (msg.msg_iovlen) {
+				msg.msg_iov->iov_base = static_cast< char* >(
+						msg.msg_iov->iov_base) + sent;
+				msg.msg_iov->iov_len -= sent;
+			}
+		}
+	}
+}
+
+template < typename TSockTraits >
+inline
+void posixx::socket::pipeline< TSockTraits >::_send_messages(std::size_t n)
+		throw (error)
+{
+	for (std::size_t i = 0; i < n; ++i) {
+		request& r = *_batch[i];
+		_iov[2 * i].iov_base = &r._header;
+		_iov[2 * i].iov_len = sizeof(header);
+		_iov[2 * i + 1].iov_base = const_cast< void* >(r._data);
+		_iov[2 * i + 1].iov_len = ntohl(r._header.size);
+		std::memset(&_msgs[i], 0, sizeof(mmsghdr));
+		_msgs[i].msg_hdr.msg_iov = &_iov[2 * i];
+		_msgs[i].msg_hdr.msg_iovlen = 2;
+	}
+	std::size_t sent = 0;
+	while (sent < n)
+		sent += _sock.send(&_msgs[sent], n - sent, MSG_NOSIGNAL);
+}
+
+template < typename TSockTraits >
+inline
+void posixx::socket::pipeline< TSockTraits >::_complete(request& r,
+		const char* data, std::size_t n) throw ()
+{
+	r._state = data ? request::DONE : request::FAILED;
+	try {
+		r.completed(data, n);
+	}
+	catch (...) {
+		// a callback can't break the pipeline
+	}
+}
+
+template < typename TSockTraits >
+inline
+void posixx::socket::pipeline< TSockTraits >::_fail(const error& e)
+		throw ()
+{
+	for (std::size_t i = 0; i < _slots.size(); ++i) {
+		request* r = _slots[i];
+		if (!r)
+			continue;
+		_slots[i] = NULL;
+		_free.push_back(i);
+		r->_errno = e.no;
+		_complete(*r, NULL, 0);
+	}
+	_inflight = 0;
+	while (_head) {
+		request* r = _head;
+		_head = r->_next;
+		r->_errno = e.no;
+		_complete(*r, NULL, 0);
+	}
+	_tail = NULL;
+	_queued = 0;
+	_filled = 0;
+}
+
+template < typename TSockTraits >
+inline
+std::size_t posixx::socket::pipeline< TSockTraits >::poll(bool block)
+		throw (error)
+{
+	if (_filled == _rbuf.size()) {
+		errno = EMSGSIZE;
+		error e("pipeline response too big");
+		_fail(e);
+		throw e;
+	}
+	ssize_t got;
+	bool truncated = false;
+	try {
+		// an orderly shutdown doesn't set errno
+		errno = 0;
+		if (_stream)
+			got = _sock.recv(_rbuf.c_array() + _filled,
+					_rbuf.size() - _filled,
+					block ? 0 : MSG_DONTWAIT);
+		else {
+			iovec iov;
+			iov.iov_base = _rbuf.c_array();
+			iov.iov_len = _rbuf.size();
+			msghdr m;
+			std::memset(&m, 0, sizeof(m));
+			m.msg_iov = &iov;
+			m.msg_iovlen = 1;
+			got = _sock.recv(&m, block ? 0 : MSG_DONTWAIT);
+			if (!got)
+				throw error("recv connection shutdown");
+			truncated = m.msg_flags & MSG_TRUNC;
+		}
+	}
+	catch (const error& e) {
+		if (!block && (e.no == EAGAIN || e.no == EWOULDBLOCK))
+			return 0;
+		_fail(e);
+		throw;
+	}
+	const char* data = reinterpret_cast< const char* >(_rbuf.c_array());
+	// each message must be exactly one frame, so nothing is left for the
+	// next one
+	if (!_stream && (truncated || std::size_t(got) < sizeof(header)
+			|| std::size_t(got) != sizeof(header) + ntohl(
+			reinterpret_cast< const header* >(data)->size))) {
+		errno = EMSGSIZE;
+		error e("pipeline malformed response");
+		_fail(e);
+		throw e;
+	}
+	_filled += got;
+	std::size_t n = 0;
+	std::size_t off = 0;
+	while (_filled - off >= sizeof(header)) {
+		header h;
+		std::memcpy(&h, data + off, sizeof(h));
+		std::size_t size = ntohl(h.size);
+		if (size > _max_response) {
+			errno = EMSGSIZE;
+			error e("pipeline response too big");
+			_fail(e);
+			throw e;
+		}
+		if (_filled - off < sizeof(header) + size)
+			break;
+		uint32_t id = ntohl(h.id);
+		std::size_t slot = id & 0xffff;
+		request* r = slot < _slots.size() ? _slots[slot] : NULL;
+		// responses with unknown IDs are ignored
+		if (r && r->_id == id) {
+			_slots[slot] = NULL;
+			_free.push_back(slot);
+			--_inflight;
+			_complete(*r, data + off + sizeof(header), size);
+			++n;
+		}
+		off += sizeof(header) + size;
+	}
+	if (off) {
+		std::memmove(_rbuf.c_array(), data + off, _filled - off);
+		_filled -= off;
+	}
+	flush();
+	return n;
+}
+
+template < typename TSockTraits >
+inline
+void posixx::socket::pipeline< TSockTraits >::wait(request& r)
+		throw (error)
+{
+	flush();
+	while (!r.done())
+		poll();
+}
+
+template < typename TSockTraits >
+inline
+std::size_t posixx::socket::pipeline< TSockTraits >::inflight() const
+		throw ()
+{
+	return _inflight;
+}
+
+template < typename TSockTraits >
+inline
+std::size_t posixx::socket::pipeline< TSockTraits >::queued() const
+		throw ()
+{
+	return _queued;
+}
+
+template < typename TSockTraits >
+inline
+std::size_t posixx::socket::pipeline< TSockTraits >::window() const
+		throw ()
+{
+	return _slots.size();
+}
+
+#endif // POSIXX_SOCKET_PIPELINE_HPP_
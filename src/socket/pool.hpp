@@ -0,0 +1,509 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_POOL_HPP_
+#define POSIXX_SOCKET_POOL_HPP_
+
+#include "../error.hpp" // posixx::error
+#include "basic_socket.hpp" // posixx::socket::basic_socket, type
+#include "opt.hpp" // posixx::socket::opt::ERROR
+#include "../linux/queue.hpp" // posixx::linux::queue
+#include "../linux/futex.hpp" // posixx::linux::futex
+#include "../tsc.hpp" // posixx::tsc::monotonic
+
+#include <vector> // std::vector
+#include <cstring> // std::memcmp
+#include <cerrno> // errno, EAGAIN, EWOULDBLOCK
+#include <stdint.h> // uint64_t
+#include <time.h> // timespec
+#include <pthread.h> // pthread_mutex_t
+
+/// @file
+
+namespace posixx { namespace socket {
+
+/**
+ * Pool of connected client sockets.
+ *
+ * Connections are kept per destination address and reused, which takes
+ * the connection handshake out of the request latency. Each destination
+ * has a limit of open connections; when it's reached, checkout() waits
+ * (up to config::wait) for a connection to be checked in.
+ *
+ * Idle connections are checked before being reused (a pending socket
+ * error, reported by SO_ERROR, or a connection closed by the peer, or
+ * unexpected data pending discard them) and the ones idle for more than
+ * config::max_idle are closed, either when found by checkout() or by
+ * evict(), which should be called periodically.
+ *
+ * Looking up a destination takes a lock, but it's done only once per
+ * destination: checking connections out and in using the destination
+ * handle is lock-free (unless the limit is reached) and thread-safe.
+ *
+ * @code
+ * posixx::socket::pool< inet::traits > p;
+ * pool< inet::traits >::destination& d = p.at(inet::sockaddr(ip, port));
+ * {
+ *	pool< inet::traits >::lease c(p, d);
+ *	c->send(req, sizeof(req));
+ *	c->recv(resp, sizeof(resp));
+ * } // back to the pool
+ * @endcode
+ */
+template < typename TSockTraits >
+struct pool
+{
+
+	/// Type of the pooled sockets.
+	typedef basic_socket< TSockTraits > socket_type;
+
+	/// Type of the destination addresses.
+	typedef typename TSockTraits::sockaddr sockaddr_type;
+
+	/// Pool configuration.
+	struct config
+	{
+		/// Maximum connections open to each destination.
+		std::size_t max_per_destination;
+		/// Maximum time a connection can be idle (in nanoseconds).
+		uint64_t max_idle;
+		/// Maximum time to wait for a connection when the limit is
+		/// reached (in nanoseconds).
+		uint64_t wait;
+		/// Check the idle connections before reusing them.
+		bool check;
+		/// Type of the sockets.
+		socket::type type;
+		/// Protocol of the sockets.
+		int protocol;
+		/// Create a default configuration.
+		config() throw ();
+	};
+
+	/// Connections to a destination (see at()).
+	struct destination
+	{
+		/// Address of the destination.
+		const sockaddr_type addr;
+		/// Number of open connections (in use or idle).
+		std::size_t open() const throw ();
+		/// Number of idle connections.
+		std::size_t idle() const throw ();
+	private:
+		friend struct pool;
+		struct entry
+		{
+			socket_type* sock;
+			uint64_t since;
+		};
+		destination(const sockaddr_type& addr, std::size_t max);
+		linux::queue< entry > _idle;
+		int _open;
+		// changed on each check in, close or put back by evict(),
+		// to wake up waiters
+		int _version;
+		int _waiters;
+	};
+
+	/// A connection checked out (and checked in when destroyed).
+	struct lease
+	{
+		/// Check a connection out.
+		lease(pool& p, destination& d) throw (error);
+		/// Get the socket.
+		socket_type& operator*() const throw ();
+		/// Get the socket.
+		socket_type* operator->() const throw ();
+		/// Close the connection instead of reusing it.
+		void discard() throw ();
+		/// Check the connection in.
+		~lease() throw ();
+	private:
+		lease(const lease& l);
+		lease& operator=(const lease& l);
+		pool& _pool;
+		destination& _dest;
+		socket_type* _sock;
+		bool _reuse;
+	};
+
+	/// Create an empty pool.
+	explicit pool(const config& c = config()) throw ();
+
+	/**
+	 * Get a destination (creating it if it's the first time).
+	 *
+	 * This takes a lock, so the result should be kept and reused.
+	 */
+	destination& at(const sockaddr_type& addr) throw (error);
+
+	/**
+	 * Check a connection out.
+	 *
+	 * An idle connection is reused if there is a healthy one, otherwise
+	 * a new one is connected if the limit allows it, otherwise it waits
+	 * for a connection to be checked in (an error with EAGAIN is thrown
+	 * if config::wait expires).
+	 */
+	socket_type* checkout(destination& d) throw (error);
+
+	/// Check a connection out (see at() and checkout(destination&)).
+	socket_type* checkout(const sockaddr_type& addr) throw (error);
+
+	/**
+	 * Check a connection in.
+	 *
+	 * @param d Destination the connection was checked out from.
+	 * @param s Connection.
+	 * @param reuse false to close the connection (after an error, for
+	 *              example).
+	 */
+	void checkin(destination& d, socket_type* s, bool reuse = true)
+			throw ();
+
+	/**
+	 * Close the connections idle for too long.
+	 *
+	 * @return Number of connections closed.
+	 */
+	std::size_t evict() throw ();
+
+	/// Total number of connections established.
+	uint64_t connects() const throw ();
+
+	/// Get the configuration.
+	const config& conf() const throw ();
+
+	/// Destructor (closes the idle connections, leases must be gone).
+	~pool() throw ();
+
+private:
+
+	// Hidden copy constructor and assign operator
+	pool(const pool& p);
+	pool& operator=(const pool& p);
+
+	typedef typename destination::entry entry;
+
+	bool _usable(const entry& e, uint64_t t) const throw ();
+
+	void _close(destination& d, socket_type* s) throw ();
+
+	// Tell the waiters for a connection to d to try again
+	void _wake(destination& d) throw ();
+
+	config _cfg;
+	pthread_mutex_t _mutex;
+	std::vector< destination* > _dests;
+	uint64_t _connects;
+
+};
+
+} } // namespace posixx::socket
+
+
+
+template < typename TSockTraits >
+inline
+posixx::socket::pool< TSockTraits >::config::config() throw ():
+		max_per_destination(8), max_idle(uint64_t(30) * 1000000000),
+		wait(1000000000), check(true), type(STREAM), protocol(0)
+{
+}
+
+template < typename TSockTraits >
+inline
+posixx::socket::pool< TSockTraits >::destination::destination(
+		const sockaddr_type& addr, std::size_t max):
+		addr(addr), _idle(max), _open(0), _version(0), _waiters(0)
+{
+}
+
+template < typename TSockTraits >
+inline
+std::size_t posixx::socket::pool< TSockTraits >::destination::open() const
+		throw ()
+{
+	return __atomic_load_n(&_open, __ATOMIC_RELAXED);
+}
+
+template < typename TSockTraits >
+inline
+std::size_t posixx::socket::pool< TSockTraits >::destination::idle() const
+		throw ()
+{
+	return _idle.size();
+}
+
+template < typename TSockTraits >
+inline
+posixx::socket::pool< TSockTraits >::lease::lease(pool& p, destination& d)
+		throw (error):
+		_pool(p), _dest(d), _sock(p.checkout(d)), _reuse(true)
+{
+}
+
+template < typename TSockTraits >
+inline
+typename posixx::socket::pool< TSockTraits >::socket_type&
+posixx::socket::pool< TSockTraits >::lease::operator*() const throw ()
+{
+	return *_sock;
+}
+
+template < typename TSockTraits >
+inline
+typename posixx::socket::pool< TSockTraits >::socket_type*
+posixx::socket::pool< TSockTraits >::lease::operator->() const throw ()
+{
+	return _sock;
+}
+
+template < typename TSockTraits >
+inline
+void posixx::socket::pool< TSockTraits >::lease::discard() throw ()
+{
+	_reuse = false;
+}
+
+template < typename TSockTraits >
+inline
+posixx::socket::pool< TSockTraits >::lease::~lease() throw ()
+{
+	_pool.checkin(_dest, _sock, _reuse);
+}
+
+template < typename TSockTraits >
+inline
+posixx::socket::pool< TSockTraits >::pool(const config& c) throw ():
+		_cfg(c), _connects(0)
+{
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+template < typename TSockTraits >
+inline
+typename posixx::socket::pool< TSockTraits >::destination&
+posixx::socket::pool< TSockTraits >::at(const sockaddr_type& addr)
+		throw (error)
+{
+	pthread_mutex_lock(&_mutex);
+	// there are usually just a few destinations
+	for (std::size_t i = 0; i < _dests.size(); ++i) {
+		const sockaddr_type& a = _dests[i]->addr;
+		if (a.length() == addr.length() &&
+				!std::memcmp(&a, &addr, addr.length())) {
+			pthread_mutex_unlock(&_mutex);
+			return *_dests[i];
+		}
+	}
+	destination* d = NULL;
+	try {
+		d = new destination(addr, _cfg.max_per_destination);
+		_dests.push_back(d);
+	}
+	catch (...) {
+		delete d;
+		pthread_mutex_unlock(&_mutex);
+		errno = ENOMEM;
+		throw error("pool destination");
+	}
+	pthread_mutex_unlock(&_mutex);
+	return *d;
+}
+
+template < typename TSockTraits >
+inline
+bool posixx::socket::pool< TSockTraits >::_usable(const entry& e,
+		uint64_t t) const throw ()
+{
+	if (t - e.since > _cfg.max_idle)
+		return false;
+	if (!_cfg.check)
+		return true;
+	try {
+		if (e.sock->template opt< opt::ERROR >())
+			return false;
+	}
+	catch (const error&) {
+		return false;
+	}
+	// a healthy idle connection has nothing to read
+	char c;
+	ssize_t r = ::recv(e.sock->fd(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+	return r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+template < typename TSockTraits >
+inline
+void posixx::socket::pool< TSockTraits >::_close(destination& d,
+		socket_type* s) throw ()
+{
+	delete s;
+	__atomic_sub_fetch(&d._open, 1, __ATOMIC_SEQ_CST);
+	_wake(d);
+}
+
+template < typename TSockTraits >
+inline
+void posixx::socket::pool< TSockTraits >::_wake(destination& d) throw ()
+{
+	__atomic_add_fetch(&d._version, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&d._waiters, __ATOMIC_SEQ_CST))
+		linux::futex::wake(&d._version, 1, false);
+}
+
+template < typename TSockTraits >
+inline
+typename posixx::socket::pool< TSockTraits >::socket_type*
+posixx::socket::pool< TSockTraits >::checkout(destination& d)
+		throw (error)
+{
+	uint64_t start = 0;
+	for (;;) {
+		int version = __atomic_load_n(&d._version, __ATOMIC_SEQ_CST);
+		entry e;
+		if (d._idle.try_pop(e)) {
+			if (_usable(e, tsc::monotonic()))
+				return e.sock;
+			_close(d, e.sock);
+			continue;
+		}
+		int open = __atomic_load_n(&d._open, __ATOMIC_RELAXED);
+		if (std::size_t(open) < _cfg.max_per_destination) {
+			if (!__atomic_compare_exchange_n(&d._open, &open,
+					open + 1, false, __ATOMIC_SEQ_CST,
+					__ATOMIC_RELAXED))
+				continue;
+			socket_type* s = NULL;
+			try {
+				s = new socket_type(_cfg.type, _cfg.protocol);
+				s->connect(d.addr);
+			}
+			catch (...) {
+				int no = errno;
+				if (s)
+					_close(d, s);
+				else
+					__atomic_sub_fetch(&d._open, 1,
+							__ATOMIC_SEQ_CST);
+				errno = no;
+				throw;
+			}
+			__atomic_add_fetch(&_connects, 1, __ATOMIC_RELAXED);
+			return s;
+		}
+		// limit reached, wait for a check in or a close
+		uint64_t t = tsc::monotonic();
+		if (!start)
+			start = t;
+		if (t - start >= _cfg.wait) {
+			errno = EAGAIN;
+			throw error("pool checkout");
+		}
+		uint64_t left = _cfg.wait - (t - start);
+		timespec ts;
+		ts.tv_sec = left / 1000000000;
+		ts.tv_nsec = left % 1000000000;
+		__atomic_add_fetch(&d._waiters, 1, __ATOMIC_SEQ_CST);
+		try {
+			linux::futex::wait(&d._version, version, &ts, false);
+		}
+		catch (...) {
+			__atomic_sub_fetch(&d._waiters, 1, __ATOMIC_SEQ_CST);
+			throw;
+		}
+		__atomic_sub_fetch(&d._waiters, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+template < typename TSockTraits >
+inline
+typename posixx::socket::pool< TSockTraits >::socket_type*
+posixx::socket::pool< TSockTraits >::checkout(const sockaddr_type& addr)
+		throw (error)
+{
+	return checkout(at(addr));
+}
+
+template < typename TSockTraits >
+inline
+void posixx::socket::pool< TSockTraits >::checkin(destination& d,
+		socket_type* s, bool reuse) throw ()
+{
+	if (!reuse) {
+		_close(d, s);
+		return;
+	}
+	entry e;
+	e.sock = s;
+	e.since = tsc::monotonic();
+	// never full, there is room for all the open connections
+	d._idle.try_push(e);
+	_wake(d);
+}
+
+template < typename TSockTraits >
+inline
+std::size_t posixx::socket::pool< TSockTraits >::evict() throw ()
+{
+	pthread_mutex_lock(&_mutex);
+	std::vector< destination* > dests(_dests);
+	pthread_mutex_unlock(&_mutex);
+	std::size_t n = 0;
+	uint64_t t = tsc::monotonic();
+	for (std::size_t i = 0; i < dests.size(); ++i) {
+		destination& d = *dests[i];
+		// go through the current idle connections once, they are
+		// popped oldest first
+		for (std::size_t k = d._idle.size(); k; --k) {
+			entry e;
+			if (!d._idle.try_pop(e))
+				break;
+			// it could have been checked in after t was taken
+			if (e.since >= t || t - e.since <= _cfg.max_idle) {
+				// a checkout could have missed it while it was
+				// out of the queue
+				d._idle.try_push(e);
+				_wake(d);
+				break;
+			}
+			_close(d, e.sock);
+			++n;
+		}
+	}
+	return n;
+}
+
+template < typename TSockTraits >
+inline
+uint64_t posixx::socket::pool< TSockTraits >::connects() const throw ()
+{
+	return __atomic_load_n(&_connects, __ATOMIC_RELAXED);
+}
+
+template < typename TSockTraits >
+inline
+const typename posixx::socket::pool< TSockTraits >::config&
+posixx::socket::pool< TSockTraits >::conf() const throw ()
+{
+	return _cfg;
+}
+
+template < typename TSockTraits >
+inline
+posixx::socket::pool< TSockTraits >::~pool() throw ()
+{
+	for (std::size_t i = 0; i < _dests.size(); ++i) {
+		entry e;
+		while (_dests[i]->_idle.try_pop(e))
+			delete e.sock;
+		delete _dests[i];
+	}
+	pthread_mutex_destroy(&_mutex);
+}
+
+#endif // POSIXX_SOCKET_POOL_HPP_
@@ -0,0 +1,296 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_STATS_HPP_
+#define POSIXX_SOCKET_STATS_HPP_
+
+#include <cerrno> // errno, EAGAIN, EWOULDBLOCK, EINTR
+#include <sys/types.h> // ssize_t
+
+/// @file
+
+namespace posixx { namespace socket {
+
+/**
+ * Socket operations accounted by the statistics policies.
+ *
+ * @see no_stats, atomic_stats
+ */
+enum op
+{
+	SEND,    ///< send(2), sendto(2), sendmsg(2) and sendmmsg(2)
+	RECV,    ///< recv(2), recvfrom(2), recvmsg(2) and recvmmsg(2)
+	ACCEPT,  ///< accept(2)
+	CONNECT, ///< connect(2)
+	OPS      ///< Number of operations (not an operation)
+};
+
+/**
+ * I/O counters.
+ *
+ * This is a plain snapshot of the counters kept by atomic_stats.
+ */
+struct io_counters
+{
+	unsigned long bytes_sent;     ///< Bytes successfully sent
+	unsigned long bytes_received; ///< Bytes successfully received
+	unsigned long calls[OPS];     ///< System calls made, by operation
+	unsigned long again;          ///< Calls failed with EAGAIN
+	unsigned long intr;           ///< Calls failed with EINTR
+	unsigned long errors;         ///< Calls failed with any other error
+};
+
+/**
+ * Statistics policy that does nothing.
+ *
+ * This is the policy used by basic_socket when the socket traits don't define
+ * a stats type. Every method is an empty inline function and the class is
+ * empty, so a basic_socket using it has exactly the same size and code as one
+ * without any statistics support at all.
+ *
+ * A statistics policy must provide:
+ * - A stamp type, holding any state needed between the start of a system
+ *   call and its end (it's usually empty).
+ * - stamp start(op o) throw (): called before each system call.
+ * - void record(op o, const stamp& st, ssize_t r) throw (): called after each
+ *   system call with the operation, the stamp returned by start() and the
+ *   value returned by the system call (-1 means the call failed and errno is
+ *   set).
+ */
+struct no_stats
+{
+
+	/// Nothing to remember.
+	struct stamp {};
+
+	/// Does nothing.
+	stamp start(op o) const throw () { return stamp(); }
+
+	/// Does nothing.
+	void record(op o, const stamp& st, ssize_t r) const throw () {}
+
+};
+
+/**
+ * Statistics policy using relaxed atomic counters.
+ *
+ * The counters are kept both per socket and per family, TFamily is just a
+ * tag used to separate the per family counters (usually the original socket
+ * traits). All counters are updated using relaxed atomic operations, so
+ * they can be scraped from any thread at any time without locking (each
+ * counter is consistent by itself, but they are not consistent with each
+ * other).
+ *
+ * @see stats_traits
+ */
+template < typename TFamily >
+struct atomic_stats
+{
+
+	/// Nothing to remember.
+	typedef no_stats::stamp stamp;
+
+	/// Create a new set of zeroed counters.
+	atomic_stats() throw ();
+
+	/// Does nothing.
+	stamp start(op o) const throw ();
+
+	/// Account for a system call.
+	void record(op o, const stamp& st, ssize_t r) throw ();
+
+	/// Get a snapshot of this socket counters.
+	io_counters counters() const throw ();
+
+	/// Get a snapshot of the counters of all the sockets of this family.
+	static io_counters family_stats() throw ();
+
+	/// Reset the counters of all the sockets of this family.
+	static void reset_family_stats() throw ();
+
+private:
+
+	// Add n to counter c using a relaxed atomic operation
+	static void _add(unsigned long& c, unsigned long n) throw ();
+
+	// Update the counters for a system call
+	static void _record(io_counters& c, op o, ssize_t r, int err) throw ();
+
+	// Get a snapshot of the counters using relaxed atomic loads
+	static io_counters _load(const io_counters& c) throw ();
+
+	// This socket counters
+	io_counters _counters;
+
+	// This family counters
+	static io_counters _family;
+
+};
+
+/**
+ * Socket traits with statistics support.
+ *
+ * This is a thin wrapper over a regular socket traits that adds a stats type,
+ * which makes basic_socket keep statistics using TStats. For example:
+ * @code
+ * typedef posixx::socket::basic_socket<
+ *		posixx::socket::stats_traits< inet::traits > > socket;
+ * socket s(posixx::socket::STREAM);
+ * // ...
+ * posixx::socket::io_counters c = s.io_stats().counters();
+ * @endcode
+ */
+template < typename TSockTraits,
+		typename TStats = atomic_stats< TSockTraits > >
+struct stats_traits: TSockTraits
+{
+
+	/// Statistics policy.
+	typedef TStats stats;
+
+};
+
+/**
+ * Get the statistics policy of a socket traits.
+ *
+ * type is TSockTraits::stats if defined, no_stats otherwise.
+ */
+template < typename TSockTraits >
+struct stats_of
+{
+
+private:
+
+	typedef char yes;
+	typedef char (&no)[2];
+
+	template < typename T >
+	static yes test(typename T::stats*);
+
+	template < typename T >
+	static no test(...);
+
+	template < typename T, bool HasStats >
+	struct select { typedef no_stats type; };
+
+	template < typename T >
+	struct select< T, true > { typedef typename T::stats type; };
+
+public:
+
+	/// Statistics policy.
+	typedef typename select< TSockTraits,
+			sizeof(test< TSockTraits >(0)) == sizeof(yes) >::type type;
+
+};
+
+} } // namespace posixx::socket
+
+
+
+template < typename TFamily >
+posixx::socket::io_counters posixx::socket::atomic_stats< TFamily >::_family;
+
+template < typename TFamily >
+inline
+posixx::socket::atomic_stats< TFamily >::atomic_stats() throw ()
+{
+	io_counters zero = io_counters();
+	_counters = zero;
+}
+
+template < typename TFamily >
+inline
+void posixx::socket::atomic_stats< TFamily >::_add(unsigned long& c,
+		unsigned long n) throw ()
+{
+	__atomic_fetch_add(&c, n, __ATOMIC_RELAXED);
+}
+
+template < typename TFamily >
+inline
+void posixx::socket::atomic_stats< TFamily >::_record(io_counters& c, op o,
+		ssize_t r, int err) throw ()
+{
+	_add(c.calls[o], 1);
+	if (r != -1) {
+		if (o == SEND)
+			_add(c.bytes_sent, r);
+		else if (o == RECV)
+			_add(c.bytes_received, r);
+	}
+	else if (err == EAGAIN || err == EWOULDBLOCK)
+		_add(c.again, 1);
+	else if (err == EINTR)
+		_add(c.intr, 1);
+	else
+		_add(c.errors, 1);
+}
+
+template < typename TFamily >
+inline
+posixx::socket::io_counters posixx::socket::atomic_stats< TFamily >::_load(
+		const io_counters& c) throw ()
+{
+	io_counters s;
+	s.bytes_sent = __atomic_load_n(&c.bytes_sent, __ATOMIC_RELAXED);
+	s.bytes_received = __atomic_load_n(&c.bytes_received, __ATOMIC_RELAXED);
+	for (int i = 0; i < OPS; ++i)
+		s.calls[i] = __atomic_load_n(&c.calls[i], __ATOMIC_RELAXED);
+	s.again = __atomic_load_n(&c.again, __ATOMIC_RELAXED);
+	s.intr = __atomic_load_n(&c.intr, __ATOMIC_RELAXED);
+	s.errors = __atomic_load_n(&c.errors, __ATOMIC_RELAXED);
+	return s;
+}
+
+template < typename TFamily >
+inline
+typename posixx::socket::atomic_stats< TFamily >::stamp
+posixx::socket::atomic_stats< TFamily >::start(op o) const throw ()
+{
+	return stamp();
+}
+
+template < typename TFamily >
+inline
+void posixx::socket::atomic_stats< TFamily >::record(op o, const stamp& st,
+		ssize_t r) throw ()
+{
+	int err = errno; // save it, just in case
+	_record(_counters, o, r, err);
+	_record(_family, o, r, err);
+}
+
+template < typename TFamily >
+inline
+posixx::socket::io_counters posixx::socket::atomic_stats< TFamily >::counters()
+		const throw ()
+{
+	return _load(_counters);
+}
+
+template < typename TFamily >
+inline
+posixx::socket::io_counters
+posixx::socket::atomic_stats< TFamily >::family_stats() throw ()
+{
+	return _load(_family);
+}
+
+template < typename TFamily >
+inline
+void posixx::socket::atomic_stats< TFamily >::reset_family_stats() throw ()
+{
+	__atomic_store_n(&_family.bytes_sent, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&_family.bytes_received, 0, __ATOMIC_RELAXED);
+	for (int i = 0; i < OPS; ++i)
+		__atomic_store_n(&_family.calls[i], 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&_family.again, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&_family.intr, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&_family.errors, 0, __ATOMIC_RELAXED);
+}
+
+#endif // POSIXX_SOCKET_STATS_HPP_
@@ -0,0 +1,293 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_SOCKET_UDP_HPP_
+#define POSIXX_SOCKET_UDP_HPP_
+
+#include "basic_socket.hpp" // posixx::socket::basic_socket, set_length
+#include "cmsg.hpp" // posixx::socket::cmsg
+
+#include <cstring> // memset
+#include <cerrno> // errno, EMSGSIZE
+#include <stdint.h> // uint16_t
+#include <netinet/in.h> // IPPROTO_UDP
+#include <netinet/udp.h> // UDP_SEGMENT, UDP_GRO
+#include <sys/socket.h> // msghdr, MSG_CTRUNC
+#include <sys/uio.h> // iovec
+
+/// @file
+
+namespace posixx { namespace socket {
+
+/**
+ * UDP segmentation offload (Linux only).
+ *
+ * Sending and receiving many small datagrams costs a trip through the
+ * whole network stack for each of them. With generic segmentation offload
+ * (GSO), a single send() of a big buffer is split in datagrams of a fixed
+ * size by the kernel (or the network card) as late as possible, and with
+ * generic receive offload (GRO) consecutive datagrams of the same flow are
+ * delivered together by a single recv(), with the size of each segment.
+ *
+ * The functions here work with any DGRAM inet or inet6 socket
+ * (basic_socket), adding the UDP_SEGMENT control message when sending and
+ * reading the UDP_GRO one when receiving (see cmsg). GSO can also be
+ * enabled for all the sends of a socket with the opt::SEGMENT option.
+ *
+ * @code
+ * using namespace posixx::socket;
+ * // sender: 64 datagrams of 1000 bytes with a single system call
+ * udp::send(s, buf, 64000, 1000, dest);
+ * // receiver
+ * r.opt< udp::opt::GRO >(1);
+ * uint16_t segment;
+ * ssize_t n = udp::recv(r, buf, 65536, segment);
+ * for (ssize_t i = 0; i < n; i += segment)
+ *	handle(buf + i, std::min< ssize_t >(segment, n - i));
+ * @endcode
+ *
+ * @see udp(7)
+ */
+namespace udp {
+
+/**
+ * Maximum number of segments a GSO send can be split in.
+ *
+ * It's the limit of the kernels that introduced GSO (newer ones allow
+ * more), and the total size is limited by the maximum datagram size
+ * anyway.
+ */
+enum { MAX_SEGMENTS = 64 };
+
+/// UDP socket options
+namespace opt {
+
+/**
+ * Segment size for GSO of all the sends (0 disables it).
+ *
+ * A segment size passed to udp::send() overrides it.
+ */
+struct SEGMENT
+{
+	enum
+	{
+		level   = IPPROTO_UDP,
+		optname = UDP_SEGMENT,
+		read    = true,
+		write   = true
+	};
+	typedef int type;
+};
+
+/**
+ * Receive coalesced datagrams (GRO).
+ *
+ * When enabled, a recv() can return many datagrams; udp::recv() tells
+ * the size of each one. Plain recv() calls can't tell where each
+ * datagram ends, so they shouldn't be used when this option is enabled.
+ */
+struct GRO
+{
+	enum
+	{
+		level   = IPPROTO_UDP,
+		optname = UDP_GRO,
+		read    = true,
+		write   = true
+	};
+	typedef int type;
+};
+
+} // namespace opt
+
+/**
+ * Send a buffer as many datagrams of the same size (GSO).
+ *
+ * The socket must be connected.
+ *
+ * @param s DGRAM socket.
+ * @param buf Data to send.
+ * @param n Size of the data (at most segment * MAX_SEGMENTS, and less
+ *          than the maximum datagram size).
+ * @param segment Size of each datagram (the last one can be smaller).
+ * @param flags Flags for sendmsg(2).
+ *
+ * @return The number of bytes sent.
+ */
+template < typename TSockTraits >
+ssize_t send(basic_socket< TSockTraits >& s, const void* buf, size_t n,
+		uint16_t segment, int flags = 0) throw (error);
+
+/**
+ * Send a buffer as many datagrams of the same size (GSO) to an address.
+ *
+ * @param to Destination address.
+ *
+ * @see send(basic_socket< TSockTraits >&, const void*, size_t, uint16_t,
+ *      int)
+ */
+template < typename TSockTraits >
+ssize_t send(basic_socket< TSockTraits >& s, const void* buf, size_t n,
+		uint16_t segment, const typename TSockTraits::sockaddr& to,
+		int flags = 0) throw (error);
+
+/**
+ * Receive one or more coalesced datagrams (GRO).
+ *
+ * The opt::GRO option must be enabled to receive more than one datagram
+ * at a time. All the received datagrams but the last have the same size,
+ * segment.
+ *
+ * @param s DGRAM socket.
+ * @param buf Buffer to store the data (it should be big enough for the
+ *            biggest datagram, 64 KiB, or the data could be truncated).
+ * @param n Size of the buffer.
+ * @param segment Where to store the size of each datagram (if only one
+ *                datagram is received, it's its size).
+ * @param flags Flags for recvmsg(2).
+ *
+ * @return The number of bytes received.
+ *
+ * If the control messages enabled on the socket don't fit in
+ * detail::CONTROL_SIZE bytes, the segment size can't be known and error
+ * is thrown with EMSGSIZE (the data is lost).
+ */
+template < typename TSockTraits >
+ssize_t recv(basic_socket< TSockTraits >& s, void* buf, size_t n,
+		uint16_t& segment, int flags = 0) throw (error);
+
+/**
+ * Receive one or more coalesced datagrams (GRO) and their sender.
+ *
+ * @param from Where to store the sender address.
+ *
+ * @see recv(basic_socket< TSockTraits >&, void*, size_t, uint16_t&, int)
+ */
+template < typename TSockTraits >
+ssize_t recv(basic_socket< TSockTraits >& s, void* buf, size_t n,
+		uint16_t& segment, typename TSockTraits::sockaddr& from,
+		int flags = 0) throw (error);
+
+namespace detail {
+
+// Size of the control data of a recv(), room for UDP_GRO and the control
+// messages enabled by other options (timestamps, IP_PKTINFO, IP_TTL, ...)
+enum { CONTROL_SIZE = 256 };
+
+// Send with an UDP_SEGMENT control message
+template < typename TSockTraits >
+ssize_t send(basic_socket< TSockTraits >& s, const void* buf, size_t n,
+		uint16_t segment, const void* to, socklen_t len, int flags)
+		throw (error);
+
+// Receive and get the UDP_GRO control message
+template < typename TSockTraits >
+ssize_t recv(basic_socket< TSockTraits >& s, void* buf, size_t n,
+		uint16_t& segment, void* from, socklen_t& len, int flags)
+		throw (error);
+
+} // namespace detail
+
+} } } // namespace posixx::socket::udp
+
+
+
+template < typename TSockTraits >
+inline
+ssize_t posixx::socket::udp::detail::send(basic_socket< TSockTraits >& s,
+		const void* buf, size_t n, uint16_t segment, const void* to,
+		socklen_t len, int flags) throw (error)
+{
+	iovec iov;
+	iov.iov_base = const_cast< void* >(buf);
+	iov.iov_len = n;
+	msghdr m;
+	memset(&m, 0, sizeof(m));
+	m.msg_name = const_cast< void* >(to);
+	m.msg_namelen = len;
+	m.msg_iov = &iov;
+	m.msg_iovlen = 1;
+	cmsg::buffer< sizeof(uint16_t) > ctrl;
+	cmsg::writer(m, ctrl).put(IPPROTO_UDP, UDP_SEGMENT, segment);
+	return s.send(&m, flags);
+}
+
+template < typename TSockTraits >
+inline
+ssize_t posixx::socket::udp::detail::recv(basic_socket< TSockTraits >& s,
+		void* buf, size_t n, uint16_t& segment, void* from,
+		socklen_t& len, int flags) throw (error)
+{
+	iovec iov;
+	iov.iov_base = buf;
+	iov.iov_len = n;
+	msghdr m;
+	memset(&m, 0, sizeof(m));
+	m.msg_name = from;
+	m.msg_namelen = len;
+	m.msg_iov = &iov;
+	m.msg_iovlen = 1;
+	cmsg::buffer< CONTROL_SIZE > ctrl;
+	m.msg_control = ctrl.data;
+	m.msg_controllen = sizeof(ctrl.data);
+	ssize_t r = s.recv(&m, flags);
+	len = m.msg_namelen;
+	// UDP_GRO might be the control message that didn't fit
+	if (m.msg_flags & MSG_CTRUNC) {
+		errno = EMSGSIZE;
+		throw error("udp::recv control data truncated");
+	}
+	int gso = 0;
+	if (cmsg::find(m, IPPROTO_UDP, UDP_GRO, gso) && gso > 0 && gso < r)
+		segment = gso;
+	else
+		segment = r;
+	return r;
+}
+
+template < typename TSockTraits >
+inline
+ssize_t posixx::socket::udp::send(basic_socket< TSockTraits >& s,
+		const void* buf, size_t n, uint16_t segment, int flags)
+		throw (error)
+{
+	return detail::send(s, buf, n, segment, NULL, 0, flags);
+}
+
+template < typename TSockTraits >
+inline
+ssize_t posixx::socket::udp::send(basic_socket< TSockTraits >& s,
+		const void* buf, size_t n, uint16_t segment,
+		const typename TSockTraits::sockaddr& to, int flags)
+		throw (error)
+{
+	return detail::send(s, buf, n, segment, &to, to.length(), flags);
+}
+
+template < typename TSockTraits >
+inline
+ssize_t posixx::socket::udp::recv(basic_socket< TSockTraits >& s,
+		void* buf, size_t n, uint16_t& segment, int flags)
+		throw (error)
+{
+	socklen_t len = 0;
+	return detail::recv(s, buf, n, segment, NULL, len, flags);
+}
+
+template < typename TSockTraits >
+inline
+ssize_t posixx::socket::udp::recv(basic_socket< TSockTraits >& s,
+		void* buf, size_t n, uint16_t& segment,
+		typename TSockTraits::sockaddr& from, int flags)
+		throw (error)
+{
+	socklen_t len = sizeof(from);
+	ssize_t r = detail::recv(s, buf, n, segment, &from, len, flags);
+	set_length(from, len);
+	return r;
+}
+
+#endif // POSIXX_SOCKET_UDP_HPP_
@@ -8,11 +8,14 @@
 #define POSIXX_SOCKET_UNIX_HPP_
 
 #include "basic_socket.hpp" // posixx::socket
+#include "../text.hpp" // posixx::text
+#include "../simd.hpp" // posixx::simd::hash
 
 #include <sys/un.h> // sockaddr_un
 #include <string> // std::string
 #include <utility> // std::pair
-#include <cstring> // memset, memcpy, memcmp
+#include <cstring> // memset, memcpy, memcmp, memchr, strlen, strnlen
+#include <cerrno> // errno, ENAMETOOLONG
 
 /// @file
 
@@ -21,11 +24,28 @@ namespace posixx { namespace socket {
 /// Unix (local) sockets
 namespace unix {
 
-/// Unix socket address
+/**
+ * Unix socket address.
+ *
+ * The address can be a filesystem path or, in Linux, a name in the abstract
+ * namespace (see abstract()). Abstract addresses are not files, so binding
+ * to them doesn't need a filesystem lookup nor unlinking stale sockets
+ * first, and they disappear when the socket is closed.
+ *
+ * The length of the address is computed when the address is set and kept
+ * in the object, so passing it to the kernel doesn't need a strlen(3) of
+ * the path. If you modify sun_path directly, use parse() (or assign a new
+ * address) instead to keep the length right.
+ *
+ * @see unix(7)
+ */
 struct sockaddr: sockaddr_un
 {
 
-	/// Create an empty unix socket address.
+	/// Buffer size (including the terminating NUL) for format().
+	enum { TEXT_SIZE = sizeof(sockaddr_un().sun_path) + 1 };
+
+	/// Create an empty (unnamed) unix socket address.
 	sockaddr() throw ();
 
 	/**
@@ -36,15 +56,81 @@ struct sockaddr: sockaddr_un
 	 */
 	sockaddr(const std::string& path) throw (std::logic_error);
 
+	/**
+	 * Create a unix socket address in the abstract namespace (Linux only).
+	 *
+	 * @param name Name of the socket (it can have any byte, including
+	 *             NULs, and it must be shorter than sun_path).
+	 */
+	static sockaddr abstract(const std::string& name)
+			throw (std::logic_error);
+
+	/// Tell if this is an address in the abstract namespace.
+	bool is_abstract() const throw ();
+
 	/// Length of this unix socket address
 	socklen_t length() const throw ();
 
-	/// Get the path of this unix socket address
+	/**
+	 * Set the length of this unix socket address.
+	 *
+	 * Used when the address is filled by the kernel (see
+	 * posixx::socket::set_length()).
+	 */
+	void length(socklen_t len) throw ();
+
+	/**
+	 * Get the path of this unix socket address.
+	 *
+	 * For abstract addresses it's the name, without the leading NUL.
+	 */
 	std::string path() const throw ();
 
 	/// Compare two unix socket addresses
 	bool operator == (const sockaddr& other) const throw ();
 
+	/**
+	 * Hash of the address (consistent with operator==).
+	 *
+	 * Useful to use the address as a key in hash tables (see
+	 * posixx::socket::peer_table).
+	 */
+	uint64_t hash() const throw ();
+
+	/**
+	 * Format the address (its path) into a buffer.
+	 *
+	 * Abstract addresses are formatted as "@name", like ss(8) does.
+	 *
+	 * @param buf Buffer to write to (always NUL terminated if size > 0).
+	 * @param size Size of the buffer (TEXT_SIZE is always enough).
+	 *
+	 * @return Length of the text, like snprintf(3) (if it's equal or
+	 *         bigger than size, the text was truncated).
+	 */
+	std::size_t format(char* buf, std::size_t size) const throw ();
+
+	/**
+	 * Parse an address (its path).
+	 *
+	 * A leading '@' means an abstract address (like format() produces).
+	 *
+	 * @param s NUL terminated path.
+	 *
+	 * @return true on success, false (with errno set to ENAMETOOLONG) if
+	 *         the path doesn't fit in the address, in which case the
+	 *         address is left untouched.
+	 */
+	bool parse(const char* s) throw ();
+
+private:
+
+	/// Size of the name (the path, or the abstract name with its NUL).
+	std::size_t _name_size() const throw ();
+
+	/// Cached length of the address (as passed to the kernel).
+	socklen_t _length;
+
 }; // struct sockaddr
 
 /// Unix socket traits
@@ -65,7 +151,13 @@ typedef std::pair< socket*, socket* > pair_type;
 /// Create a pair of connected unix sockets
 pair_type pair(type type, int protocol = 0) throw (posixx::error);
 
-} } } // namespace posixx::socket::unix
+} // namespace unix
+
+/// Update the cached length of a unix socket address filled by the kernel.
+template <>
+void set_length(unix::sockaddr& addr, socklen_t len) throw ();
+
+} } // namespace posixx::socket
 
 
 
@@ -73,6 +165,8 @@ inline
 posixx::socket::unix::sockaddr::sockaddr() throw ()
 {
 	sun_family = AF_UNIX;
+	sun_path[0] = '\0';
+	_length = sizeof(sun_family);
 }
 
 inline
@@ -83,26 +177,104 @@ posixx::socket::unix::sockaddr::sockaddr(const std::string& path)
 		throw std::logic_error("path too long");
 	sun_family = AF_UNIX;
 	memcpy(sun_path, path.c_str(), path.size() + 1); // \0
+	_length = sizeof(sun_family) + path.size();
+}
+
+inline
+posixx::socket::unix::sockaddr posixx::socket::unix::sockaddr::abstract(
+		const std::string& name) throw (std::logic_error)
+{
+	if (name.size() >= sizeof(sun_path))
+		throw std::logic_error("abstract name too long");
+	sockaddr sa;
+	sa.sun_path[0] = '\0';
+	memcpy(sa.sun_path + 1, name.data(), name.size());
+	sa._length = sizeof(sun_family) + 1 + name.size();
+	return sa;
+}
+
+inline
+bool posixx::socket::unix::sockaddr::is_abstract() const throw ()
+{
+	return _length > sizeof(sun_family) && sun_path[0] == '\0';
 }
 
 inline
 socklen_t posixx::socket::unix::sockaddr::length() const throw ()
 {
-	return sizeof(sun_family) + strlen(sun_path);
+	return _length;
+}
+
+inline
+void posixx::socket::unix::sockaddr::length(socklen_t len) throw ()
+{
+	if (len > sizeof(sockaddr_un))
+		len = sizeof(sockaddr_un);
+	if (len < sizeof(sun_family))
+		len = sizeof(sun_family);
+	std::size_t n = len - sizeof(sun_family);
+	// the kernel may include the NUL terminating a path, but we don't
+	if (n && sun_path[0] != '\0')
+		n = strnlen(sun_path, n);
+	_length = sizeof(sun_family) + n;
+}
+
+inline
+std::size_t posixx::socket::unix::sockaddr::_name_size() const throw ()
+{
+	return _length - sizeof(sun_family);
 }
 
 inline
 std::string posixx::socket::unix::sockaddr::path() const throw ()
 {
-	return std::string(sun_path);
+	if (is_abstract())
+		return std::string(sun_path + 1, _name_size() - 1);
+	return std::string(sun_path, _name_size());
 }
 
 inline
 bool posixx::socket::unix::sockaddr::operator == (const sockaddr& other)
 		const throw ()
 {
-	return sun_family == other.sun_family
-			&& !strncmp(sun_path, other.sun_path, sizeof(sun_path));
+	return sun_family == other.sun_family && _length == other._length
+			&& !memcmp(sun_path, other.sun_path, _name_size());
+}
+
+inline
+uint64_t posixx::socket::unix::sockaddr::hash() const throw ()
+{
+	return simd::hash(sun_path, _name_size());
+}
+
+inline
+std::size_t posixx::socket::unix::sockaddr::format(char* buf,
+		std::size_t size) const throw ()
+{
+	text::writer w(buf, size);
+	if (is_abstract())
+		return w.put('@').put(sun_path + 1, _name_size() - 1).finish();
+	return w.put(sun_path, _name_size()).finish();
+}
+
+inline
+bool posixx::socket::unix::sockaddr::parse(const char* s) throw ()
+{
+	std::size_t n = strlen(s);
+	if (n >= sizeof(sun_path)) {
+		errno = ENAMETOOLONG;
+		return false;
+	}
+	sun_family = AF_UNIX;
+	if (*s == '@') {
+		sun_path[0] = '\0';
+		memcpy(sun_path + 1, s + 1, n - 1);
+	}
+	else {
+		memcpy(sun_path, s, n + 1); // \0
+	}
+	_length = sizeof(sun_family) + n;
+	return true;
 }
 
 inline
@@ -112,4 +284,12 @@ posixx::socket::unix::pair_type posixx::socket::unix::pair(type type,
 	return posixx::socket::pair< socket >(type, protocol);
 }
 
+template <>
+inline
+void posixx::socket::set_length(unix::sockaddr& addr, socklen_t len)
+		throw ()
+{
+	addr.length(len);
+}
+
 #endif // POSIXX_SOCKET_UNIX_HPP_
@@ -7,14 +7,16 @@
 #ifndef POSIXX_SOCKET_UNIX_PRINT_HPP_
 #define POSIXX_SOCKET_UNIX_PRINT_HPP_
 
-#include "../inet.hpp" // posixx::socket::inet::sockaddr
+#include "../unix.hpp" // posixx::socket::unix::sockaddr
 #include <ostream> // std::ostream
 
 inline
 std::ostream& operator << (std::ostream& os,
 		const posixx::socket::unix::sockaddr& sa) throw()
 {
-	return os << "unix::sockaddr(path=" << sa.sun_path << ")";
+	char path[posixx::socket::unix::sockaddr::TEXT_SIZE];
+	sa.format(path, sizeof(path));
+	return os << "unix::sockaddr(path=" << path << ")";
 }
 
 #endif // POSIXX_SOCKET_UNIX_PRINT_HPP_
@@ -0,0 +1,181 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_TEXT_HPP_
+#define POSIXX_TEXT_HPP_
+
+#include <cstddef> // std::size_t
+#include <cstring> // memcpy, strlen
+
+/// @file
+
+/**
+ * Allocation-free text formatting and parsing helpers.
+ *
+ * These are the building blocks of the format() and parse() members of the
+ * socket addresses. They never allocate memory nor use any global state, so
+ * they are safe to use from any thread (and from signal handlers).
+ */
+namespace posixx { namespace text {
+
+/**
+ * Write text to a caller provided buffer.
+ *
+ * It follows snprintf(3) semantics: the text is truncated if it doesn't fit
+ * in the buffer (which is always NUL terminated, unless its size is 0) but
+ * the full length of the text is still accounted for, so finish() can tell
+ * the buffer size needed.
+ */
+struct writer
+{
+
+	/**
+	 * Create a writer.
+	 *
+	 * @param buf Buffer to write to (can be NULL if size is 0).
+	 * @param size Size of the buffer.
+	 */
+	writer(char* buf, std::size_t size) throw ();
+
+	/// Write a character.
+	writer& put(char c) throw ();
+
+	/// Write a NUL terminated string.
+	writer& put(const char* s) throw ();
+
+	/// Write n characters.
+	writer& put(const char* s, std::size_t n) throw ();
+
+	/// Write an unsigned integer in decimal.
+	writer& put(unsigned long n) throw ();
+
+	/**
+	 * NUL terminate the buffer.
+	 *
+	 * @return Length of the full text (not counting the terminating NUL),
+	 *         if it's equal or bigger than the buffer size the text was
+	 *         truncated.
+	 */
+	std::size_t finish() throw ();
+
+private:
+
+	char* _buf;
+	std::size_t _size;
+	std::size_t _len;
+
+};
+
+/**
+ * Parse an unsigned decimal integer.
+ *
+ * At least one digit is required and no signs or blanks are accepted.
+ *
+ * @param s String to parse, advanced past the parsed digits on success.
+ * @param max Maximum accepted value.
+ * @param v Where to store the parsed value (only set on success).
+ *
+ * @return true if a number not bigger than max was parsed.
+ */
+bool parse_uint(const char*& s, unsigned long max, unsigned long& v)
+		throw ();
+
+/**
+ * Consume a character.
+ *
+ * @param s String to parse, advanced one character on success.
+ * @param c Expected character.
+ *
+ * @return true if the first character of s is c.
+ */
+bool expect(const char*& s, char c) throw ();
+
+} } // namespace posixx::text
+
+
+
+inline
+posixx::text::writer::writer(char* buf, std::size_t size) throw ():
+		_buf(buf), _size(size), _len(0)
+{
+}
+
+inline
+posixx::text::writer& posixx::text::writer::put(char c) throw ()
+{
+	if (_len + 1 < _size)
+		_buf[_len] = c;
+	++_len;
+	return *this;
+}
+
+inline
+posixx::text::writer& posixx::text::writer::put(const char* s) throw ()
+{
+	return put(s, strlen(s));
+}
+
+inline
+posixx::text::writer& posixx::text::writer::put(const char* s, std::size_t n)
+		throw ()
+{
+	if (_len + 1 < _size) {
+		std::size_t room = _size - 1 - _len;
+		memcpy(_buf + _len, s, n < room ? n : room);
+	}
+	_len += n;
+	return *this;
+}
+
+inline
+posixx::text::writer& posixx::text::writer::put(unsigned long n) throw ()
+{
+	char digits[3 * sizeof(unsigned long)];
+	std::size_t i = sizeof(digits);
+	do {
+		digits[--i] = '0' + n % 10;
+		n /= 10;
+	} while (n);
+	return put(digits + i, sizeof(digits) - i);
+}
+
+inline
+std::size_t posixx::text::writer::finish() throw ()
+{
+	if (_size)
+		_buf[_len < _size ? _len : _size - 1] = '\0';
+	return _len;
+}
+
+inline
+bool posixx::text::parse_uint(const char*& s, unsigned long max,
+		unsigned long& v) throw ()
+{
+	const char* p = s;
+	unsigned long n = 0;
+	if (*p < '0' || *p > '9')
+		return false;
+	do {
+		unsigned long d = *p++ - '0';
+		if (d > max || n > (max - d) / 10)
+			return false;
+		n = n * 10 + d;
+	} while (*p >= '0' && *p <= '9');
+	s = p;
+	v = n;
+	return true;
+}
+
+inline
+bool posixx::text::expect(const char*& s, char c) throw ()
+{
+	if (*s != c)
+		return false;
+	++s;
+	return true;
+}
+
+#endif // POSIXX_TEXT_HPP_
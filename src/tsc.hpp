@@ -0,0 +1,190 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef POSIXX_TSC_HPP_
+#define POSIXX_TSC_HPP_
+
+#include <stdint.h> // uint64_t
+#include <time.h> // clock_gettime
+
+// The TSC is used only on x86, and only if it's invariant. Define
+// POSIXX_NO_TSC to always use CLOCK_MONOTONIC.
+#if !defined(POSIXX_NO_TSC) && (defined(__x86_64__) || defined(__i386__))
+#	define POSIXX_TSC_X86 1
+#	include <cpuid.h> // __get_cpuid
+#else
+#	define POSIXX_TSC_X86 0
+#endif
+
+/// @file
+
+namespace posixx {
+
+/**
+ * Cheap clock to measure short intervals.
+ *
+ * On x86 CPUs with an invariant TSC (one that ticks at a constant rate and
+ * doesn't stop in deep sleep states, as in any CPU of the last decade) the
+ * clock is read with a single rdtsc instruction, which is cheaper than
+ * clock_gettime(2) even through the vDSO. The TSC frequency is calibrated
+ * against CLOCK_MONOTONIC once, the first time the clock is used (which
+ * takes about 2 ms), so intervals can be converted to nanoseconds with a
+ * multiplication and a shift.
+ *
+ * Everywhere else (or if POSIXX_NO_TSC is defined) ticks are just
+ * CLOCK_MONOTONIC nanoseconds.
+ *
+ * rdtsc is not a serializing instruction, so an interval can be off by the
+ * few cycles the CPU reorders around it. That's fine for things like
+ * system calls, but not for timing a handful of instructions.
+ *
+ * @code
+ * tsc::ticks_type start = tsc::ticks();
+ * do_something();
+ * uint64_t ns = tsc::ns(tsc::ticks() - start);
+ * @endcode
+ */
+namespace tsc {
+
+/// Clock ticks.
+typedef uint64_t ticks_type;
+
+/// Tell if the TSC is used (otherwise a tick is a nanosecond).
+bool available() throw ();
+
+/// Read the clock.
+ticks_type ticks() throw ();
+
+/**
+ * Convert ticks to nanoseconds.
+ *
+ * It's meant for intervals (the difference between two ticks() values),
+ * ticks() itself has an arbitrary origin.
+ */
+uint64_t ns(ticks_type t) throw ();
+
+/// Clock frequency, in ticks per second.
+double frequency() throw ();
+
+/// Read CLOCK_MONOTONIC, in nanoseconds (the fallback clock).
+uint64_t monotonic() throw ();
+
+namespace detail {
+
+// Fixed point precision of the ticks to nanoseconds factor (a 24 bits
+// fraction makes the conversion exact to less than a nanosecond every
+// second and still lets ns() multiply 32 bits halves without overflowing
+// for any TSC faster than 4 MHz)
+enum { SHIFT = 24 };
+
+// Calibration of the clock (done once, see calibration())
+struct calibration
+{
+	// true if the TSC is used
+	bool tsc;
+	// Nanoseconds per tick, in fixed point (SHIFT bits fraction)
+	uint64_t mult;
+	// Ticks per second
+	double hz;
+	// Calibrate
+	calibration() throw ();
+};
+
+// Get the (only) calibration
+const calibration& get() throw ();
+
+// Tell if the TSC is invariant
+bool invariant() throw ();
+
+} // namespace detail
+
+} } // namespace posixx::tsc
+
+
+
+inline
+uint64_t posixx::tsc::monotonic() throw ()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast< uint64_t >(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+inline
+bool posixx::tsc::detail::invariant() throw ()
+{
+#if POSIXX_TSC_X86
+	unsigned a, b, c, d;
+	// CPUID.80000007H:EDX[8] is the invariant TSC flag
+	return __get_cpuid(0x80000007, &a, &b, &c, &d) && (d & (1u << 8));
+#else
+	return false;
+#endif
+}
+
+inline
+posixx::tsc::detail::calibration::calibration() throw ():
+		tsc(false), mult(uint64_t(1) << SHIFT), hz(1e9)
+{
+#if POSIXX_TSC_X86
+	if (!invariant())
+		return;
+	uint64_t t0 = monotonic();
+	uint64_t c0 = __builtin_ia32_rdtsc();
+	uint64_t t1;
+	do
+		t1 = monotonic();
+	while (t1 - t0 < 2000000);
+	uint64_t c1 = __builtin_ia32_rdtsc();
+	// too slow for ns() (or not ticking at all), keep the fallback
+	if (c1 - c0 < (t1 - t0) / 256 || c1 <= c0)
+		return;
+	double ns_per_tick = double(t1 - t0) / double(c1 - c0);
+	tsc = true;
+	mult = uint64_t(ns_per_tick * (uint64_t(1) << SHIFT) + 0.5);
+	hz = 1e9 / ns_per_tick;
+#endif
+}
+
+inline
+const posixx::tsc::detail::calibration& posixx::tsc::detail::get() throw ()
+{
+	static const calibration c;
+	return c;
+}
+
+inline
+bool posixx::tsc::available() throw ()
+{
+	return detail::get().tsc;
+}
+
+inline
+posixx::tsc::ticks_type posixx::tsc::ticks() throw ()
+{
+#if POSIXX_TSC_X86
+	if (detail::get().tsc)
+		return __builtin_ia32_rdtsc();
+#endif
+	return monotonic();
+}
+
+inline
+uint64_t posixx::tsc::ns(ticks_type t) throw ()
+{
+	uint64_t m = detail::get().mult;
+	// split in 32 bits halves so the product doesn't overflow
+	return (((t >> 32) * m) << (32 - detail::SHIFT))
+			+ (((t & 0xffffffffu) * m) >> detail::SHIFT);
+}
+
+inline
+double posixx::tsc::frequency() throw ()
+{
+	return detail::get().hz;
+}
+
+#endif // POSIXX_TSC_HPP_
@@ -8,6 +8,8 @@
 #include <posixx/buffer.hpp> // buffer
 #include <ostream> // std::ostream
 #include <iomanip> // std::hex, setfill, setw
+#include <cstring> // std::strlen
+#include <tr1/unordered_set> // std::tr1::unordered_set
 
 // declared here so boost.Test can see it
 std::ostream& operator << (std::ostream& os, const posixx::buffer& b);
@@ -462,5 +464,44 @@ BOOST_AUTO_TEST_CASE( swap_test )
 	BOOST_CHECK_EQUAL(b2, b2c);
 }
 
+BOOST_AUTO_TEST_CASE( find_test )
+{
+	const char* s = "GET /index.html HTTP/1.1\r\nHost: x\r\n\r\n";
+	const buffer b(s, s + std::strlen(s));
+	BOOST_CHECK_EQUAL(b.find(' '), 3u);
+	BOOST_CHECK_EQUAL(b.find(' ', 4), 15u);
+	BOOST_CHECK_EQUAL(b.find('?'), buffer::npos);
+	BOOST_CHECK_EQUAL(b.find(' ', b.size()), buffer::npos);
+	const buffer::value_type crlf[] = { '\r', '\n' };
+	BOOST_CHECK_EQUAL(b.find(crlf, 2), 24u);
+	BOOST_CHECK_EQUAL(b.find(crlf, 2, 25), 33u);
+	const buffer end(crlf, crlf + 2);
+	BOOST_CHECK_EQUAL(b.find(end, 34), 35u);
+	BOOST_CHECK_EQUAL(b.find(end, 36), buffer::npos);
+	BOOST_CHECK_EQUAL(b.find(crlf, 0, 7), 7u);
+	BOOST_CHECK_EQUAL(b.find(crlf, 0, b.size()), b.size());
+	BOOST_CHECK_EQUAL(b.find(crlf, 0, b.size() + 1), buffer::npos);
+	const buffer::value_type seps[] = { ':', '/' };
+	BOOST_CHECK_EQUAL(b.find_any(seps, 2), 4u);
+	BOOST_CHECK_EQUAL(b.find_any(buffer(seps, seps + 2), 5), 20u);
+	BOOST_CHECK_EQUAL(b.find_any(seps, 0), buffer::npos);
+	BOOST_CHECK_EQUAL(buffer().find('a'), buffer::npos);
+}
+
+BOOST_AUTO_TEST_CASE( hash_test )
+{
+	buffer::value_type a1[5] = { 5, 6, 7, 8, 9 };
+	const buffer b1(a1, a1 + 5);
+	const buffer b2(a1, a1 + 5);
+	const buffer b3(a1, a1 + 4);
+	BOOST_CHECK_EQUAL(hash_value(b1), hash_value(b2));
+	BOOST_CHECK_NE(hash_value(b1), hash_value(b3));
+	BOOST_CHECK_EQUAL(std::tr1::hash< buffer >()(b1), hash_value(b1));
+	std::tr1::unordered_set< buffer > set;
+	set.insert(b1);
+	BOOST_CHECK(set.find(b2) != set.end());
+	BOOST_CHECK(set.find(b3) == set.end());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -0,0 +1,56 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/buffer_pool.hpp> // buffer_pool
+#include <boost/test/unit_test.hpp> // unit testing stuff
+
+using posixx::buffer;
+using posixx::buffer_pool;
+
+BOOST_AUTO_TEST_SUITE( buffer_pool_suite )
+
+BOOST_AUTO_TEST_CASE( get_put )
+{
+	buffer_pool<> p(100, 2);
+	BOOST_CHECK_EQUAL(p.size(), 100u);
+	BOOST_CHECK_EQUAL(p.free(), 0u);
+	buffer* a = p.get();
+	BOOST_CHECK_EQUAL(a->size(), 100u);
+	BOOST_CHECK_EQUAL(p.used(), 1u);
+	p.put(a);
+	BOOST_CHECK_EQUAL(p.used(), 0u);
+	BOOST_CHECK_EQUAL(p.free(), 1u);
+	// the released buffer is reused
+	buffer* b = p.get();
+	BOOST_CHECK_EQUAL(a, b);
+	BOOST_CHECK_EQUAL(p.free(), 0u);
+	// and resized back when released
+	b->resize(10);
+	p.put(b);
+	b = p.get();
+	BOOST_CHECK_EQUAL(b->size(), 100u);
+	p.put(b);
+}
+
+BOOST_AUTO_TEST_CASE( max_free )
+{
+	buffer_pool<> p(10, 2);
+	p.reserve(5);
+	BOOST_CHECK_EQUAL(p.free(), 2u);
+	buffer* b[3];
+	for (int i = 0; i < 3; ++i)
+		b[i] = p.get();
+	BOOST_CHECK_EQUAL(p.used(), 3u);
+	BOOST_CHECK_EQUAL(p.free(), 0u);
+	for (int i = 0; i < 3; ++i)
+		p.put(b[i]);
+	BOOST_CHECK_EQUAL(p.used(), 0u);
+	BOOST_CHECK_EQUAL(p.free(), 2u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -0,0 +1,82 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/histogram.hpp> // posixx::histogram
+
+#include <boost/test/unit_test.hpp>
+
+using posixx::histogram;
+
+BOOST_AUTO_TEST_SUITE( histogram_suite )
+
+BOOST_AUTO_TEST_CASE( buckets_test )
+{
+	for (histogram::value_type v = 0; v < histogram::SUB_BUCKETS; ++v) {
+		BOOST_CHECK_EQUAL( histogram::bucket(v), v );
+		BOOST_CHECK_EQUAL( histogram::bucket_lower(v), v );
+		BOOST_CHECK_EQUAL( histogram::bucket_upper(v), v );
+	}
+	for (std::size_t i = histogram::SUB_BUCKETS; i < histogram::BUCKETS;
+			++i) {
+		histogram::value_type l = histogram::bucket_lower(i);
+		histogram::value_type u = histogram::bucket_upper(i);
+		BOOST_REQUIRE_LE( l, u );
+		BOOST_CHECK_EQUAL( histogram::bucket(l), i );
+		BOOST_CHECK_EQUAL( histogram::bucket(u), i );
+		BOOST_CHECK_EQUAL( histogram::bucket_upper(i - 1) + 1, l );
+	}
+	BOOST_CHECK_EQUAL( histogram::bucket(histogram::value_type(-1)),
+			histogram::BUCKETS - 1 );
+}
+
+BOOST_AUTO_TEST_CASE( percentile_test )
+{
+	histogram h;
+	BOOST_CHECK_EQUAL( h.count(), 0 );
+	BOOST_CHECK_EQUAL( h.percentile(50), 0 );
+	BOOST_CHECK_EQUAL( h.mean(), 0.0 );
+	for (histogram::value_type v = 1; v <= 100; ++v)
+		h.record(v);
+	BOOST_CHECK_EQUAL( h.count(), 100 );
+	BOOST_CHECK_EQUAL( h.sum(), 5050 );
+	BOOST_CHECK_CLOSE( h.mean(), 50.5, 0.001 );
+	BOOST_CHECK_EQUAL( h.percentile(0), 1 );
+	BOOST_CHECK_EQUAL( h.percentile(10), 10 );
+	// 50 is in the bucket [50, 51]
+	BOOST_CHECK_EQUAL( h.percentile(50), 51 );
+	// 99 is in the bucket [96, 99] and 100 in [100, 103]
+	BOOST_CHECK_EQUAL( h.percentile(99), 99 );
+	BOOST_CHECK_EQUAL( h.percentile(100), 103 );
+	// out of range percentiles are clamped
+	BOOST_CHECK_EQUAL( h.percentile(-5), 1 );
+	BOOST_CHECK_EQUAL( h.percentile(150), 103 );
+}
+
+BOOST_AUTO_TEST_CASE( snapshot_merge_test )
+{
+	histogram h1;
+	histogram h2;
+	h1.record(5);
+	h1.record(1000);
+	h2.record(7);
+	histogram s = h1.snapshot();
+	h1.record(3);
+	BOOST_CHECK_EQUAL( s.count(), 2 );
+	BOOST_CHECK_EQUAL( h1.count(), 3 );
+	s.merge(h2.snapshot());
+	BOOST_CHECK_EQUAL( s.count(), 3 );
+	BOOST_CHECK_EQUAL( s.sum(), 1012 );
+	BOOST_CHECK_EQUAL( s.bucket_count(5), 1 );
+	BOOST_CHECK_EQUAL( s.bucket_count(7), 1 );
+	BOOST_CHECK_EQUAL( s.bucket_count(histogram::bucket(1000)), 1 );
+	s.reset();
+	BOOST_CHECK_EQUAL( s.count(), 0 );
+	BOOST_CHECK_EQUAL( s.sum(), 0 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
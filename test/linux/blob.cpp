@@ -0,0 +1,229 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/linux/blob.hpp> // posixx::linux::blob
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <memory> // std::auto_ptr
+#include <string> // std::string
+#include <cerrno> // EMSGSIZE, EPERM
+#include <cstring> // memset, memcmp
+#include <dirent.h> // opendir, readdir, closedir
+#include <fcntl.h> // fcntl, F_ADD_SEALS
+#include <sys/mman.h> // memfd_create
+#include <sys/socket.h> // msghdr, cmsghdr, SCM_RIGHTS
+#include <sys/uio.h> // iovec
+#include <unistd.h> // ftruncate, close, dup
+
+using namespace ::posixx::linux;
+namespace unix = ::posixx::socket::unix;
+
+namespace {
+
+// Connected pair of SEQPACKET unix sockets
+struct fixture
+{
+	std::auto_ptr< unix::socket > a;
+	std::auto_ptr< unix::socket > b;
+	fixture()
+	{
+		unix::pair_type p = unix::pair(posixx::socket::SEQPACKET);
+		a.reset(p.first);
+		b.reset(p.second);
+	}
+};
+
+// Check that the expression throws a posixx::error with errno E
+#define CHECK_ERRNO(expr, E) \
+	try { \
+		expr; \
+		BOOST_ERROR("no exception thrown"); \
+	} \
+	catch (const posixx::error& e) { \
+		BOOST_CHECK_EQUAL(e.no, E); \
+	}
+
+// Send a blob header with some descriptors, like a misbehaving peer
+void send_fds(unix::socket& s, const blob::detail::header& h,
+		const int* fds, std::size_t n)
+{
+	iovec iov = { const_cast< blob::detail::header* >(&h), sizeof(h) };
+	union
+	{
+		cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int) * 4)];
+	} ctrl;
+	msghdr m;
+	memset(&m, 0, sizeof(m));
+	m.msg_iov = &iov;
+	m.msg_iovlen = 1;
+	m.msg_control = ctrl.buf;
+	m.msg_controllen = CMSG_SPACE(sizeof(int) * n);
+	cmsghdr* c = CMSG_FIRSTHDR(&m);
+	c->cmsg_level = SOL_SOCKET;
+	c->cmsg_type = SCM_RIGHTS;
+	c->cmsg_len = CMSG_LEN(sizeof(int) * n);
+	memcpy(CMSG_DATA(c), fds, sizeof(int) * n);
+	s.send(&m);
+}
+
+// Number of open file descriptors
+std::size_t open_fds()
+{
+	DIR* d = ::opendir("/proc/self/fd");
+	BOOST_REQUIRE(d);
+	std::size_t n = 0;
+	while (::readdir(d))
+		++n;
+	::closedir(d);
+	return n;
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE( linux_blob_suite, fixture )
+
+BOOST_AUTO_TEST_CASE( inline_test )
+{
+	blob::view v;
+	blob::send(*a, "hello", 5, 42);
+	blob::recv(*b, v);
+	BOOST_CHECK(!v.mapped());
+	BOOST_CHECK_EQUAL(v.tag(), 42u);
+	BOOST_CHECK_EQUAL(std::string(v.data(), v.size()), "hello");
+	// empty payloads are fine too
+	blob::send(*a, NULL, 0);
+	blob::recv(*b, v);
+	BOOST_CHECK_EQUAL(v.size(), 0u);
+	BOOST_CHECK_EQUAL(v.tag(), 0u);
+	// the limit is inclusive
+	std::string s(blob::INLINE_MAX, 'x');
+	blob::send(*b, s.data(), s.size());
+	blob::recv(*a, v);
+	BOOST_CHECK(!v.mapped());
+	BOOST_CHECK_EQUAL(std::string(v.data(), v.size()), s);
+}
+
+BOOST_AUTO_TEST_CASE( memfd_test )
+{
+	std::string s(4 << 20, 'y');
+	s[12345] = 'z';
+	blob::send(*a, s.data(), s.size(), 7);
+	blob::view v;
+	blob::recv(*b, v);
+	BOOST_CHECK(v.mapped());
+	BOOST_CHECK_EQUAL(v.tag(), 7u);
+	BOOST_REQUIRE_EQUAL(v.size(), s.size());
+	BOOST_CHECK(!memcmp(v.data(), s.data(), s.size()));
+	// the view can be reused, the mapping is released
+	blob::send(*a, "small", 5);
+	blob::recv(*b, v);
+	BOOST_CHECK(!v.mapped());
+	BOOST_CHECK_EQUAL(std::string(v.data(), v.size()), "small");
+	v.reset();
+	BOOST_CHECK_EQUAL(v.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE( buffer_test )
+{
+	blob::buffer buf(1 << 20);
+	BOOST_REQUIRE_EQUAL(buf.size(), 1u << 20);
+	memset(buf.data(), 'b', buf.size());
+	blob::send(*a, buf, 3);
+	BOOST_CHECK_EQUAL(buf.size(), 0u);
+	blob::view v;
+	blob::recv(*b, v);
+	BOOST_CHECK(v.mapped());
+	BOOST_CHECK_EQUAL(v.tag(), 3u);
+	BOOST_REQUIRE_EQUAL(v.size(), 1u << 20);
+	BOOST_CHECK_EQUAL(v.data()[0], 'b');
+	BOOST_CHECK_EQUAL(v.data()[v.size() - 1], 'b');
+	// small buffers fall back to inline
+	blob::buffer small(16);
+	memcpy(small.data(), "0123456789abcdef", 16);
+	blob::send(*a, small);
+	blob::recv(*b, v);
+	BOOST_CHECK(!v.mapped());
+	BOOST_CHECK_EQUAL(std::string(v.data(), v.size()),
+			"0123456789abcdef");
+	// a custom inline limit
+	blob::buffer tiny(16);
+	blob::send(*a, tiny, 0, 8);
+	blob::recv(*b, v, 8);
+	BOOST_CHECK(v.mapped());
+	BOOST_CHECK_EQUAL(v.size(), 16u);
+	// the receiver accepts memfds under its own limit
+	blob::buffer other(16);
+	memset(other.data(), 'o', other.size());
+	blob::send(*a, other, 0, 8);
+	blob::recv(*b, v);
+	BOOST_CHECK(v.mapped());
+	BOOST_REQUIRE_EQUAL(v.size(), 16u);
+	BOOST_CHECK_EQUAL(v.data()[15], 'o');
+}
+
+BOOST_AUTO_TEST_CASE( invalid_test )
+{
+	blob::view v;
+	// not a blob message
+	a->send("x", 1);
+	CHECK_ERRNO(blob::recv(*b, v), EMSGSIZE);
+	// too big for the receiver inline limit
+	blob::send(*a, "0123456789", 10, 0, 10);
+	CHECK_ERRNO(blob::recv(*b, v, 8), EMSGSIZE);
+
+	// an unsealed memfd is rejected
+	int fd = ::memfd_create("posixx-test", MFD_CLOEXEC);
+	BOOST_REQUIRE(fd != -1);
+	BOOST_REQUIRE_EQUAL(::ftruncate(fd, 1 << 20), 0);
+	blob::detail::header h = { 1 << 20, 0, blob::detail::MEMFD, 0 };
+	send_fds(*a, h, &fd, 1);
+	::close(fd);
+	CHECK_ERRNO(blob::recv(*b, v), EPERM);
+	BOOST_CHECK(!v.mapped());
+	// and an empty one (it can't be mapped)
+	fd = ::memfd_create("posixx-test", MFD_CLOEXEC);
+	BOOST_REQUIRE(fd != -1);
+	h.size = 0;
+	send_fds(*a, h, &fd, 1);
+	::close(fd);
+	CHECK_ERRNO(blob::recv(*b, v), EMSGSIZE);
+
+	// peer closed
+	a.reset();
+	CHECK_ERRNO(blob::recv(*b, v), 0);
+}
+
+BOOST_AUTO_TEST_CASE( extra_fds_test )
+{
+	blob::view v;
+	// a properly sealed memfd, sent along with another descriptor
+	blob::buffer buf(1 << 20);
+	std::size_t size = buf.size();
+	int fds[2] = { buf.release(), ::dup(0) };
+	BOOST_REQUIRE(fds[1] != -1);
+	BOOST_REQUIRE_EQUAL(::fcntl(fds[0], F_ADD_SEALS, blob::detail::SEALS),
+			0);
+	blob::detail::header h = { size, 0, blob::detail::MEMFD, 0 };
+	send_fds(*a, h, fds, 2);
+	// an inline payload with a descriptor
+	blob::detail::header hi = { 0, 0, blob::detail::INLINE, 0 };
+	send_fds(*a, hi, fds + 1, 1);
+	::close(fds[0]);
+	::close(fds[1]);
+	std::size_t n = open_fds();
+	CHECK_ERRNO(blob::recv(*b, v), EMSGSIZE);
+	BOOST_CHECK_EQUAL(open_fds(), n);
+	CHECK_ERRNO(blob::recv(*b, v), EMSGSIZE);
+	BOOST_CHECK_EQUAL(open_fds(), n);
+	BOOST_CHECK(!v.mapped());
+	// the socket is still usable
+	blob::send(*a, "ok", 2);
+	blob::recv(*b, v);
+	BOOST_CHECK_EQUAL(std::string(v.data(), v.size()), "ok");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,314 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/linux/executor.hpp> // posixx::linux::executor
+#include <posixx/linux/work_deque.hpp> // posixx::linux::work_deque
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <vector> // std::vector
+#include <cerrno> // errno, EINVAL
+#include <pthread.h> // pthread_create, pthread_join
+#include <stdint.h> // uint64_t
+#include <unistd.h> // pipe, read, write, close, usleep
+
+using namespace ::posixx::linux;
+
+namespace {
+
+const unsigned ITEMS = 100000;
+const unsigned TASKS = 1000;
+
+struct thief_ctx
+{
+	work_deque< unsigned >* d;
+	int* done;
+	uint64_t sum;
+	unsigned count;
+};
+
+void* thief(void* arg)
+{
+	thief_ctx& c = *static_cast< thief_ctx* >(arg);
+	for (;;) {
+		unsigned* v = c.d->steal();
+		if (v) {
+			c.sum += *v;
+			++c.count;
+		}
+		else if (__atomic_load_n(c.done, __ATOMIC_ACQUIRE)
+				&& !c.d->size())
+			break;
+	}
+	return NULL;
+}
+
+void wait_for(unsigned* n, unsigned expected)
+{
+	while (__atomic_load_n(n, __ATOMIC_SEQ_CST) < expected)
+		::usleep(1000);
+}
+
+// Counts how many times it ran, and where
+struct counter: executor::task
+{
+	executor* e;
+	unsigned* total;
+	int worker;
+	bool nap;
+	void run()
+	{
+		worker = e->current();
+		if (nap)
+			::usleep(100);
+		__atomic_add_fetch(total, 1, __ATOMIC_SEQ_CST);
+	}
+};
+
+// Fails with EINVAL
+struct failer: executor::task
+{
+	void run()
+	{
+		errno = EINVAL;
+		throw posixx::error("failer");
+	}
+};
+
+// Submits all the counters to the worker running it
+struct spawner: executor::task
+{
+	executor* e;
+	std::vector< counter >* tasks;
+	void run()
+	{
+		for (std::size_t i = 0; i < tasks->size(); ++i)
+			e->submit(&(*tasks)[i]);
+	}
+};
+
+// Reads a pipe until EOF
+struct reader: executor::io_task
+{
+	int fd;
+	unsigned bytes;
+	unsigned done;
+	int worker;
+	executor* e;
+	bool handle(uint32_t events)
+	{
+		worker = e->current();
+		char buf[16];
+		ssize_t n = ::read(fd, buf, sizeof(buf));
+		if (n > 0) {
+			bytes += n;
+			return true;
+		}
+		::close(fd);
+		__atomic_store_n(&done, 1, __ATOMIC_SEQ_CST);
+		return false;
+	}
+};
+
+void spawn(executor& e, bool nap, std::vector< counter >& tasks,
+		unsigned& total)
+{
+	for (std::size_t i = 0; i < tasks.size(); ++i) {
+		tasks[i].e = &e;
+		tasks[i].total = &total;
+		tasks[i].worker = -1;
+		tasks[i].nap = nap;
+	}
+	spawner s;
+	s.e = &e;
+	s.tasks = &tasks;
+	e.submit(&s, 0);
+	wait_for(&total, tasks.size());
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( linux_executor_suite )
+
+BOOST_AUTO_TEST_CASE( deque_basic )
+{
+	work_deque< unsigned > d(3);
+	BOOST_CHECK_EQUAL(d.capacity(), 4u);
+	unsigned v[5] = { 0, 1, 2, 3, 4 };
+	BOOST_CHECK(d.pop() == NULL);
+	BOOST_CHECK(d.steal() == NULL);
+	for (int i = 0; i < 4; ++i)
+		BOOST_CHECK(d.push(&v[i]));
+	BOOST_CHECK(!d.push(&v[4]));
+	BOOST_CHECK_EQUAL(d.size(), 4u);
+	// the owner pops the newest, thieves steal the oldest
+	BOOST_CHECK_EQUAL(d.pop(), &v[3]);
+	BOOST_CHECK_EQUAL(d.steal(), &v[0]);
+	BOOST_CHECK_EQUAL(d.steal(), &v[1]);
+	BOOST_CHECK_EQUAL(d.pop(), &v[2]);
+	BOOST_CHECK(d.pop() == NULL);
+	BOOST_CHECK_EQUAL(d.size(), 0u);
+	// wrap around
+	for (int i = 0; i < 10; ++i) {
+		BOOST_CHECK(d.push(&v[i % 5]));
+		BOOST_CHECK_EQUAL(d.steal(), &v[i % 5]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( deque_stress )
+{
+	work_deque< unsigned > d(64);
+	std::vector< unsigned > v(ITEMS);
+	int done = 0;
+	thief_ctx c[2];
+	pthread_t t[2];
+	for (int i = 0; i < 2; ++i) {
+		c[i].d = &d;
+		c[i].done = &done;
+		c[i].sum = c[i].count = 0;
+		pthread_create(&t[i], NULL, &thief, &c[i]);
+	}
+	uint64_t sum = 0;
+	unsigned count = 0;
+	for (unsigned i = 0; i < ITEMS; ++i) {
+		v[i] = i;
+		while (!d.push(&v[i])) {
+			unsigned* p = d.pop();
+			if (p) {
+				sum += *p;
+				++count;
+			}
+		}
+		if (i % 3 == 0) {
+			unsigned* p = d.pop();
+			if (p) {
+				sum += *p;
+				++count;
+			}
+		}
+	}
+	for (unsigned* p = d.pop(); p; p = d.pop()) {
+		sum += *p;
+		++count;
+	}
+	__atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+	for (int i = 0; i < 2; ++i) {
+		pthread_join(t[i], NULL);
+		sum += c[i].sum;
+		count += c[i].count;
+	}
+	BOOST_CHECK_EQUAL(count, ITEMS);
+	BOOST_CHECK_EQUAL(sum, uint64_t(ITEMS) * (ITEMS - 1) / 2);
+}
+
+BOOST_AUTO_TEST_CASE( submit )
+{
+	executor::config c;
+	c.threads = 3;
+	executor e(c);
+	BOOST_CHECK_EQUAL(e.size(), 3u);
+	BOOST_CHECK_EQUAL(e.current(), -1);
+	e.start();
+	std::vector< counter > tasks(TASKS);
+	unsigned total = 0;
+	for (unsigned i = 0; i < TASKS; ++i) {
+		tasks[i].e = &e;
+		tasks[i].total = &total;
+		tasks[i].nap = false;
+		e.submit(&tasks[i]);
+	}
+	wait_for(&total, TASKS);
+	e.stop();
+	e.join();
+	BOOST_CHECK_EQUAL(total, TASKS);
+	BOOST_CHECK_THROW(e.submit(&tasks[0], 3), posixx::error);
+}
+
+BOOST_AUTO_TEST_CASE( task_error )
+{
+	executor::config c;
+	c.threads = 3;
+	c.pin = false;
+	c.steal = false;
+	executor e(c);
+	e.start();
+	// join() must not wait for the other workers to be stopped
+	failer f;
+	e.submit(&f, 1);
+	try {
+		e.join();
+		BOOST_ERROR("join() didn't throw");
+	}
+	catch (const posixx::error& x) {
+		BOOST_CHECK_EQUAL(x.no, EINVAL);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( steal )
+{
+	executor::config c;
+	c.threads = 2;
+	c.pin = false;
+	executor e(c);
+	e.start();
+	std::vector< counter > tasks(TASKS / 10);
+	unsigned total = 0;
+	spawn(e, true, tasks, total);
+	e.stop();
+	e.join();
+	// the idle worker took some of the burst
+	BOOST_CHECK_GT(e.stolen(), 0u);
+	unsigned other = 0;
+	for (std::size_t i = 0; i < tasks.size(); ++i)
+		other += tasks[i].worker == 1;
+	BOOST_CHECK_EQUAL(other, e.stolen());
+}
+
+BOOST_AUTO_TEST_CASE( affinity )
+{
+	executor::config c;
+	c.threads = 2;
+	c.steal = false;
+	executor e(c);
+	e.start();
+	std::vector< counter > tasks(TASKS / 10);
+	unsigned total = 0;
+	spawn(e, true, tasks, total);
+	e.stop();
+	e.join();
+	BOOST_CHECK_EQUAL(e.stolen(), 0u);
+	for (std::size_t i = 0; i < tasks.size(); ++i)
+		BOOST_CHECK_EQUAL(tasks[i].worker, 0);
+}
+
+BOOST_AUTO_TEST_CASE( watch )
+{
+	int p[2];
+	BOOST_REQUIRE_EQUAL(::pipe(p), 0);
+	executor::config c;
+	c.threads = 2;
+	c.steal = false;
+	executor e(c);
+	e.start();
+	reader r;
+	r.fd = p[0];
+	r.bytes = r.done = 0;
+	r.worker = -1;
+	r.e = &e;
+	e.watch(p[0], &r, 1);
+	for (int i = 0; i < 10; ++i) {
+		BOOST_CHECK_EQUAL(::write(p[1], "0123456789", 10), 10);
+		::usleep(1000);
+	}
+	::close(p[1]);
+	wait_for(&r.done, 1);
+	e.stop();
+	e.join();
+	BOOST_CHECK_EQUAL(r.bytes, 100u);
+	BOOST_CHECK_EQUAL(r.worker, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
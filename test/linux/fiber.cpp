@@ -0,0 +1,240 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/linux/async.hpp> // async_*
+#include <posixx/linux/fiber.hpp> // fiber_scheduler, stack_pool
+#include <posixx/socket/inet.hpp> // posixx::socket::inet
+#include <posixx/socket/unix.hpp> // posixx::socket::unix
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <string> // std::string
+#include <memory> // std::auto_ptr
+#include <cerrno> // errno, EINVAL, EMSGSIZE
+#include <fcntl.h> // fcntl, O_NONBLOCK
+
+using namespace ::posixx::linux;
+namespace inet = ::posixx::socket::inet;
+namespace unix = ::posixx::socket::unix;
+
+namespace {
+
+struct packet
+{
+	int seq;
+	char data[1000];
+};
+
+const int ROUNDS = 100;
+
+void nonblocking(inet::socket& s)
+{
+	BOOST_REQUIRE_EQUAL(::fcntl(s.fd(), F_SETFL, O_NONBLOCK), 0);
+}
+
+struct echo_ctx
+{
+	inet::socket* listener;
+	int served;
+	int received;
+	int shutdown_no;
+};
+
+void server(void* arg)
+{
+	echo_ctx& c = *static_cast< echo_ctx* >(arg);
+	inet::sockaddr peer;
+	inet::socket* s = async_accept(*c.listener, peer);
+	BOOST_CHECK_EQUAL(peer.addr(), "127.0.0.1");
+	packet p;
+	for (int i = 0; i < ROUNDS; ++i) {
+		async_recv_struct(*s, p);
+		async_send_struct(*s, p);
+		++c.served;
+	}
+	char b;
+	try {
+		async_recv(*s, &b, 1);
+	}
+	catch (const posixx::error& e) {
+		c.shutdown_no = e.no;
+	}
+	delete s;
+}
+
+void client(void* arg)
+{
+	echo_ctx& c = *static_cast< echo_ctx* >(arg);
+	inet::socket s(posixx::socket::STREAM);
+	nonblocking(s);
+	async_connect(s, c.listener->name());
+	packet p;
+	for (int i = 0; i < ROUNDS; ++i) {
+		p.seq = i;
+		p.data[999] = char(i);
+		async_send_struct(s, p);
+		p.seq = -1;
+		async_recv_struct(s, p);
+		BOOST_CHECK_EQUAL(p.seq, i);
+		BOOST_CHECK_EQUAL(p.data[999], char(i));
+		++c.received;
+	}
+}
+
+void appender(void* arg)
+{
+	std::string& s = *static_cast< std::string* >(arg);
+	for (int i = 0; i < 3; ++i) {
+		s += char('a' + s.size() % 2);
+		fiber_scheduler::current()->yield();
+	}
+}
+
+void thrower(void* arg)
+{
+	errno = EINVAL;
+	throw posixx::error("thrower");
+}
+
+void int_thrower(void* arg)
+{
+	throw 42;
+}
+
+struct struct_ctx
+{
+	unix::socket* s;
+	int no[3];
+	int seq;
+};
+
+void struct_receiver(void* arg)
+{
+	struct_ctx& c = *static_cast< struct_ctx* >(arg);
+	packet p;
+	for (int i = 0; i < 2; ++i) {
+		try {
+			async_recv_struct(*c.s, p);
+			c.no[i] = -1;
+		}
+		catch (const posixx::error& e) {
+			c.no[i] = e.no;
+		}
+	}
+	async_recv_struct(*c.s, p);
+	c.seq = p.seq;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( linux_fiber_suite )
+
+BOOST_AUTO_TEST_CASE( stacks )
+{
+	stack_pool p(10000, 1);
+	BOOST_CHECK_EQUAL(p.size() % 4096, 0u);
+	BOOST_CHECK_GE(p.size(), 10000u);
+	void* a = p.get();
+	void* b = p.get();
+	static_cast< char* >(a)[p.size() - 1] = 1;
+	p.put(a);
+	p.put(b); // over max_free, unmapped
+	BOOST_CHECK_EQUAL(p.free(), 1u);
+	BOOST_CHECK_EQUAL(p.get(), a);
+	p.put(a);
+}
+
+BOOST_AUTO_TEST_CASE( yield )
+{
+	reactor r;
+	fiber_scheduler f(r);
+	std::string s;
+	f.spawn(&appender, &s);
+	f.spawn(&appender, &s);
+	BOOST_CHECK_EQUAL(f.size(), 2u);
+	f.run();
+	BOOST_CHECK_EQUAL(f.size(), 0u);
+	BOOST_CHECK_EQUAL(s, "ababab");
+	// stacks are recycled
+	f.spawn(&appender, &s);
+	f.run();
+	BOOST_CHECK_EQUAL(s.size(), 9u);
+}
+
+BOOST_AUTO_TEST_CASE( echo )
+{
+	reactor r;
+	fiber_scheduler f(r);
+	inet::socket l(posixx::socket::STREAM);
+	l.bind(inet::sockaddr("127.0.0.1", 0));
+	l.listen();
+	nonblocking(l);
+	echo_ctx c = { &l, 0, 0, -1 };
+	f.spawn(&server, &c);
+	f.spawn(&client, &c);
+	f.run();
+	BOOST_CHECK_EQUAL(c.served, ROUNDS);
+	BOOST_CHECK_EQUAL(c.received, ROUNDS);
+	// the client closed the connection
+	BOOST_CHECK_EQUAL(c.shutdown_no, 0);
+}
+
+BOOST_AUTO_TEST_CASE( errors )
+{
+	reactor r;
+	fiber_scheduler f(r);
+	std::string s;
+	f.spawn(&thrower, NULL);
+	f.spawn(&appender, &s);
+	BOOST_CHECK_THROW(f.run(), posixx::error);
+	BOOST_CHECK_EQUAL(f.size(), 1u);
+	f.run();
+	BOOST_CHECK_EQUAL(s, "aba");
+	inet::socket l(posixx::socket::STREAM);
+	l.bind(inet::sockaddr("127.0.0.1", 0));
+	l.listen();
+	nonblocking(l);
+	BOOST_CHECK_THROW(async_accept(l), posixx::error);
+}
+
+BOOST_AUTO_TEST_CASE( unknown_errors )
+{
+	reactor r;
+	fiber_scheduler f(r);
+	f.spawn(&int_thrower, NULL);
+	try {
+		f.run();
+		BOOST_ERROR("no exception thrown");
+	}
+	catch (const posixx::error& e) {
+		BOOST_CHECK_EQUAL(e.no, 0);
+	}
+	BOOST_CHECK_EQUAL(f.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE( message_struct )
+{
+	reactor r;
+	fiber_scheduler f(r);
+	unix::pair_type p = unix::pair(posixx::socket::SEQPACKET);
+	std::auto_ptr< unix::socket > a(p.first);
+	std::auto_ptr< unix::socket > b(p.second);
+	// too short, too long and just right
+	packet pk;
+	pk.seq = 7;
+	a->send(&pk, sizeof(pk) - 1);
+	char big[sizeof(packet) + 1] = { 0 };
+	a->send(big, sizeof(big));
+	a->send_struct(pk);
+	struct_ctx c = { b.get(), { 0, 0, 0 }, 0 };
+	f.spawn(&struct_receiver, &c);
+	f.run();
+	BOOST_CHECK_EQUAL(c.no[0], EMSGSIZE);
+	BOOST_CHECK_EQUAL(c.no[1], EMSGSIZE);
+	BOOST_CHECK_EQUAL(c.seq, 7);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -0,0 +1,150 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/linux/queue.hpp> // posixx::linux::queue
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <vector> // std::vector
+#include <pthread.h> // pthread_create, pthread_join
+#include <stdint.h> // uint64_t
+
+using namespace ::posixx::linux;
+
+namespace {
+
+const unsigned ITEMS = 100000;
+
+// Push ITEMS consecutive numbers starting at the given one
+template < typename Q >
+struct producer
+{
+	Q* q;
+	unsigned first;
+	static void* run(void* arg)
+	{
+		producer& p = *static_cast< producer* >(arg);
+		for (unsigned i = 0; i < ITEMS; ++i)
+			if (!p.q->push(p.first + i))
+				return arg;
+		return NULL;
+	}
+};
+
+// Pop until the queue is closed, adding up the values
+template < typename Q >
+struct consumer
+{
+	Q* q;
+	uint64_t sum;
+	unsigned count;
+	static void* run(void* arg)
+	{
+		consumer& c = *static_cast< consumer* >(arg);
+		unsigned v;
+		while (c.q->pop(v)) {
+			c.sum += v;
+			++c.count;
+		}
+		return NULL;
+	}
+};
+
+template < typename Q >
+void stress(unsigned producers, unsigned consumers)
+{
+	Q q(64);
+	std::vector< producer< Q > > p(producers);
+	std::vector< consumer< Q > > c(consumers);
+	std::vector< pthread_t > pt(producers);
+	std::vector< pthread_t > ct(consumers);
+	for (unsigned i = 0; i < consumers; ++i) {
+		c[i].q = &q;
+		c[i].sum = c[i].count = 0;
+		pthread_create(&ct[i], NULL, &consumer< Q >::run, &c[i]);
+	}
+	for (unsigned i = 0; i < producers; ++i) {
+		p[i].q = &q;
+		p[i].first = i * ITEMS;
+		pthread_create(&pt[i], NULL, &producer< Q >::run, &p[i]);
+	}
+	for (unsigned i = 0; i < producers; ++i) {
+		void* r;
+		pthread_join(pt[i], &r);
+		BOOST_CHECK(r == NULL);
+	}
+	q.close();
+	uint64_t sum = 0;
+	unsigned count = 0;
+	for (unsigned i = 0; i < consumers; ++i) {
+		pthread_join(ct[i], NULL);
+		sum += c[i].sum;
+		count += c[i].count;
+	}
+	uint64_t n = uint64_t(producers) * ITEMS;
+	BOOST_CHECK_EQUAL(count, n);
+	BOOST_CHECK_EQUAL(sum, n * (n - 1) / 2);
+}
+
+template < typename Q >
+void basic()
+{
+	Q q(3);
+	BOOST_CHECK_EQUAL(q.capacity(), 4u);
+	int v = 0;
+	BOOST_CHECK(!q.try_pop(v));
+	for (int i = 0; i < 4; ++i)
+		BOOST_CHECK(q.try_push(i));
+	BOOST_CHECK(!q.try_push(4));
+	BOOST_CHECK_EQUAL(q.size(), 4u);
+	timespec t = { 0, 1000000 };
+	BOOST_CHECK(!q.push(4, &t));
+	for (int i = 0; i < 4; ++i) {
+		BOOST_CHECK(q.pop(v));
+		BOOST_CHECK_EQUAL(v, i);
+	}
+	BOOST_CHECK(!q.pop(v, &t));
+	// wrap around a few times
+	for (int i = 0; i < 10; ++i) {
+		BOOST_CHECK(q.try_push(i));
+		BOOST_CHECK(q.try_pop(v));
+		BOOST_CHECK_EQUAL(v, i);
+	}
+	q.push(1);
+	q.close();
+	BOOST_CHECK(q.closed());
+	BOOST_CHECK(!q.try_push(2));
+	BOOST_CHECK(!q.push(2));
+	BOOST_CHECK(q.pop(v));
+	BOOST_CHECK_EQUAL(v, 1);
+	BOOST_CHECK(!q.pop(v));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( linux_queue_suite )
+
+BOOST_AUTO_TEST_CASE( mpmc_test )
+{
+	basic< queue< int > >();
+}
+
+BOOST_AUTO_TEST_CASE( spsc_test )
+{
+	basic< queue< int, SPSC > >();
+}
+
+BOOST_AUTO_TEST_CASE( mpmc_stress_test )
+{
+	stress< queue< unsigned > >(4, 4);
+}
+
+BOOST_AUTO_TEST_CASE( spsc_stress_test )
+{
+	stress< queue< unsigned, SPSC > >(1, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -0,0 +1,234 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/linux/runtime.hpp> // posixx::linux::runtime, listener
+#include <posixx/socket/inet.hpp> // posixx::socket::inet
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <pthread.h> // pthread_create, pthread_join
+#include <unistd.h> // pipe, write, close, usleep
+
+using namespace ::posixx::linux;
+namespace inet = ::posixx::socket::inet;
+
+namespace {
+
+const unsigned MESSAGES = 100000;
+const unsigned CONNECTIONS = 32;
+
+// Counts the events of a file descriptor
+struct counter: reactor::handler
+{
+	int fd;
+	unsigned n;
+	counter(int fd): fd(fd), n(0) {}
+	void ready(uint32_t events)
+	{
+		char c;
+		BOOST_CHECK_EQUAL(::read(fd, &c, 1), 1);
+		++n;
+	}
+};
+
+// Adds up the messages received
+struct adder: channel< unsigned >
+{
+	unsigned n;
+	uint64_t sum;
+	adder(reactor& r): channel< unsigned >(r, 64), n(0), sum(0) {}
+	void received(unsigned& v)
+	{
+		++n;
+		sum += v;
+	}
+};
+
+void* send_all(void* arg)
+{
+	adder& a = *static_cast< adder* >(arg);
+	for (unsigned i = 0; i < MESSAGES; ++i)
+		while (!a.send(i))
+			sched_yield();
+	return NULL;
+}
+
+// Accepts connections in a shard, counting them
+struct acceptor: reactor::handler
+{
+	inet::socket* sock;
+	unsigned n;
+	static unsigned total;
+	void ready(uint32_t events)
+	{
+		delete sock->accept();
+		++n;
+		__atomic_add_fetch(&total, 1, __ATOMIC_SEQ_CST);
+	}
+};
+unsigned acceptor::total = 0;
+
+void serve(shard& s, void* arg)
+{
+	acceptor* a = static_cast< acceptor* >(arg) + s.id();
+	s.loop().add(a->sock->fd(), a);
+}
+
+// Posts a message to the next shard, the last one stops the runtime
+void relay(shard& s, void* arg)
+{
+	unsigned* hops = static_cast< unsigned* >(arg);
+	++*hops;
+	if (*hops == 10)
+		s.owner().stop();
+	else
+		BOOST_CHECK(s.post((s.id() + 1) % s.owner().size(), &relay, arg));
+}
+
+void fail(shard& s, void* arg)
+{
+	errno = EINVAL;
+	throw posixx::error("fail");
+}
+
+// Only the first shard fails, the rest keep running
+void fail_first(shard& s, void* arg)
+{
+	if (s.id() == 0)
+		fail(s, arg);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( linux_runtime_suite )
+
+BOOST_AUTO_TEST_CASE( reactor_poll )
+{
+	int p[2];
+	BOOST_REQUIRE_EQUAL(::pipe(p), 0);
+	reactor r;
+	counter c(p[0]);
+	r.add(p[0], &c);
+	BOOST_CHECK_EQUAL(r.poll(0), 0u);
+	BOOST_CHECK_EQUAL(::write(p[1], "xx", 2), 2);
+	BOOST_CHECK_EQUAL(r.poll(0), 1u);
+	BOOST_CHECK_EQUAL(r.poll(0), 1u);
+	BOOST_CHECK_EQUAL(c.n, 2u);
+	BOOST_CHECK_EQUAL(r.poll(0), 0u);
+	// wake() interrupts a blocked poll without calling any handler
+	r.wake();
+	BOOST_CHECK_EQUAL(r.poll(), 1u);
+	BOOST_CHECK_EQUAL(c.n, 2u);
+	BOOST_CHECK(!r.stopped());
+	r.stop();
+	BOOST_CHECK(r.stopped());
+	r.run(); // returns immediately
+	r.remove(p[0]);
+	BOOST_CHECK_EQUAL(::write(p[1], "x", 1), 1);
+	BOOST_CHECK_EQUAL(r.poll(0), 1u); // the pending stop() wake up
+	BOOST_CHECK_EQUAL(c.n, 2u);
+	::close(p[0]);
+	::close(p[1]);
+}
+
+BOOST_AUTO_TEST_CASE( channel_send )
+{
+	reactor r;
+	adder a(r);
+	BOOST_CHECK(a.send(1));
+	BOOST_CHECK(a.send(2));
+	// a single notification for both messages
+	BOOST_CHECK_EQUAL(r.poll(0), 1u);
+	BOOST_CHECK_EQUAL(a.n, 2u);
+	BOOST_CHECK_EQUAL(a.sum, 3u);
+	BOOST_CHECK_EQUAL(r.poll(0), 0u);
+}
+
+BOOST_AUTO_TEST_CASE( channel_thread )
+{
+	reactor r;
+	adder a(r);
+	pthread_t t;
+	pthread_create(&t, NULL, &send_all, &a);
+	while (a.n < MESSAGES)
+		r.poll();
+	pthread_join(t, NULL);
+	BOOST_CHECK_EQUAL(a.n, MESSAGES);
+	BOOST_CHECK_EQUAL(a.sum, uint64_t(MESSAGES) * (MESSAGES - 1) / 2);
+}
+
+BOOST_AUTO_TEST_CASE( runtime_post )
+{
+	runtime::config c;
+	c.threads = 3;
+	runtime rt(c);
+	BOOST_CHECK_EQUAL(rt.size(), 3u);
+	for (unsigned i = 0; i < rt.size(); ++i)
+		BOOST_CHECK_EQUAL(rt[i].id(), i);
+	unsigned hops = 0;
+	rt.start(NULL, NULL);
+	BOOST_CHECK(rt.post(0, &relay, &hops));
+	rt.join();
+	BOOST_CHECK_EQUAL(hops, 10u);
+	BOOST_CHECK_THROW(rt.post(3, &relay, &hops), posixx::error);
+}
+
+BOOST_AUTO_TEST_CASE( runtime_error )
+{
+	runtime::config c;
+	c.threads = 2;
+	c.pin = false;
+	runtime rt(c);
+	BOOST_CHECK_EQUAL(rt[0].cpu(), -1);
+	rt.start(&fail, NULL);
+	BOOST_CHECK_THROW(rt.join(), posixx::error);
+}
+
+BOOST_AUTO_TEST_CASE( runtime_error_one )
+{
+	runtime::config c;
+	c.threads = 3;
+	c.pin = false;
+	runtime rt(c);
+	// the failing shard stops the others, or join() would never return
+	rt.start(&fail_first, NULL);
+	try {
+		rt.join();
+		BOOST_ERROR("no exception thrown");
+	}
+	catch (const posixx::error& e) {
+		BOOST_CHECK_EQUAL(e.no, EINVAL);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( runtime_reuseport )
+{
+	runtime::config c;
+	c.threads = 2;
+	runtime rt(c);
+	acceptor a[2];
+	a[0].sock = listener< inet::socket >(inet::sockaddr("127.0.0.1", 0));
+	a[1].sock = listener< inet::socket >(a[0].sock->name());
+	a[0].n = a[1].n = 0;
+	rt.start(&serve, a);
+	for (unsigned i = 0; i < CONNECTIONS; ++i) {
+		inet::socket s(posixx::socket::STREAM);
+		s.connect(a[0].sock->name());
+	}
+	while (__atomic_load_n(&acceptor::total, __ATOMIC_SEQ_CST)
+			< CONNECTIONS)
+		::usleep(1000);
+	rt.stop();
+	rt.join();
+	BOOST_CHECK_EQUAL(a[0].n + a[1].n, CONNECTIONS);
+	// the kernel spreads the connections among the listeners
+	BOOST_CHECK_GT(a[0].n, 0u);
+	BOOST_CHECK_GT(a[1].n, 0u);
+	delete a[0].sock;
+	delete a[1].sock;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -0,0 +1,296 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/linux/shm.hpp> // posixx::linux::shm
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <string> // std::string
+#include <vector> // std::vector
+#include <sstream> // std::ostringstream
+#include <cerrno> // EAGAIN, EINVAL, EMSGSIZE, EPIPE
+#include <cstring> // std::memset
+#include <sys/wait.h> // waitpid
+#include <sys/mman.h> // mmap, munmap
+#include <time.h> // timespec
+#include <unistd.h> // fork, getpid, _exit, usleep
+
+using namespace ::posixx::linux;
+
+namespace {
+
+// Receive a message as a string
+std::string recv_str(shm::socket& s, int flags = 0)
+{
+	char buf[256];
+	ssize_t n = s.recv(buf, sizeof(buf), flags);
+	return std::string(buf, n);
+}
+
+// Check that the expression throws a posixx::error with errno E
+#define CHECK_ERRNO(expr, E) \
+	try { \
+		expr; \
+		BOOST_ERROR("no exception thrown"); \
+	} \
+	catch (const posixx::error& e) { \
+		BOOST_CHECK_EQUAL(e.no, E); \
+	}
+
+// Wait for a child process and return its exit status
+int wait_child(pid_t pid)
+{
+	int status = -1;
+	::waitpid(pid, &status, 0);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+struct packet
+{
+	int a;
+	char b;
+	double c;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( linux_shm_suite )
+
+BOOST_AUTO_TEST_CASE( ring_round_test )
+{
+	BOOST_CHECK_EQUAL(shm::ring::round(0), shm::ring::MIN_CAPACITY);
+	BOOST_CHECK_EQUAL(shm::ring::round(4097), 8192u);
+	BOOST_CHECK_EQUAL(shm::ring::round(65536), 65536u);
+	char buf[128];
+	std::memset(buf, 0, sizeof(buf));
+	CHECK_ERRNO(shm::ring r(buf), EINVAL);
+}
+
+BOOST_AUTO_TEST_CASE( pair_test )
+{
+	std::pair< shm::socket*, shm::socket* > p = shm::pair();
+	shm::socket& a = *p.first;
+	shm::socket& b = *p.second;
+	BOOST_CHECK_EQUAL(a.side(), shm::SIDE_A);
+	BOOST_CHECK_EQUAL(b.side(), shm::SIDE_B);
+	BOOST_CHECK_EQUAL(a.max_message(), shm::socket::DEFAULT_CAPACITY - 8);
+	BOOST_CHECK_EQUAL(a.send("hello", 5), 5);
+	BOOST_CHECK_EQUAL(a.send("", 0), 0);
+	BOOST_CHECK_EQUAL(b.send("world", 5), 5);
+	BOOST_CHECK_EQUAL(recv_str(b), "hello");
+	BOOST_CHECK_EQUAL(recv_str(b), "");
+	BOOST_CHECK_EQUAL(recv_str(a), "world");
+	// messages are truncated, like in a SEQPACKET socket
+	a.send("hello world", 11);
+	char buf[5];
+	BOOST_CHECK_EQUAL(b.recv(buf, sizeof(buf)), 5);
+	BOOST_CHECK_EQUAL(std::string(buf, 5), "hello");
+	CHECK_ERRNO(b.recv(buf, sizeof(buf), MSG_DONTWAIT), EAGAIN);
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( struct_test )
+{
+	std::pair< shm::socket*, shm::socket* > p = shm::pair();
+	packet x = { 1, 'x', 2.5 };
+	p.first->send_struct(x);
+	packet y = { 0, 0, 0.0 };
+	p.second->recv_struct(y);
+	BOOST_CHECK_EQUAL(y.a, 1);
+	BOOST_CHECK_EQUAL(y.b, 'x');
+	BOOST_CHECK_EQUAL(y.c, 2.5);
+	p.first->send("x", 1);
+	CHECK_ERRNO(p.second->recv_struct(y), EMSGSIZE);
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( full_test )
+{
+	std::pair< shm::socket*, shm::socket* > p = shm::pair(4096);
+	shm::socket& a = *p.first;
+	shm::socket& b = *p.second;
+	std::string big(a.max_message() + 1, 'x');
+	CHECK_ERRNO(a.send(big.data(), big.size()), EMSGSIZE);
+	// each message uses 16 bytes (header and padding)
+	std::size_t sent = 0;
+	try {
+		for (;;) {
+			a.send("12345678", 8, MSG_DONTWAIT);
+			++sent;
+		}
+	}
+	catch (const posixx::error& e) {
+		BOOST_CHECK_EQUAL(e.no, EAGAIN);
+	}
+	BOOST_CHECK_EQUAL(sent, 4096u / 16);
+	BOOST_CHECK_EQUAL(recv_str(b), "12345678");
+	a.send("abcdefgh", 8, MSG_DONTWAIT);
+	for (std::size_t i = 1; i < sent; ++i)
+		BOOST_CHECK_EQUAL(recv_str(b), "12345678");
+	BOOST_CHECK_EQUAL(recv_str(b), "abcdefgh");
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( wrap_test )
+{
+	std::pair< shm::socket*, shm::socket* > p = shm::pair(4096);
+	shm::socket& a = *p.first;
+	shm::socket& b = *p.second;
+	std::vector< char > out(1000);
+	std::vector< char > in(1000);
+	// sizes not multiple of the capacity to exercise the wrap marker
+	for (unsigned i = 0; i < 2000; ++i) {
+		std::size_t n = (i * 37) % out.size();
+		for (std::size_t j = 0; j < n; ++j)
+			out[j] = char(i + j);
+		a.send(&out[0], n);
+		if (i % 3)
+			continue;
+		// keep a few messages in the ring
+		while (true) {
+			ssize_t r;
+			try {
+				r = b.recv(&in[0], in.size(), MSG_DONTWAIT);
+			}
+			catch (const posixx::error& e) {
+				BOOST_REQUIRE_EQUAL(e.no, EAGAIN);
+				break;
+			}
+			BOOST_REQUIRE(r >= 0);
+		}
+	}
+	a.send("end", 3);
+	while (recv_str(b) != "end")
+		;
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( wrap_blocked_test )
+{
+	// a message that doesn't fit before the end of the ring publishes
+	// just the wrap marker, which must wake up a blocked consumer so it
+	// makes room for the message
+	const std::size_t cap = 4096;
+	void* mem = ::mmap(NULL, shm::ring::size(cap), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	BOOST_REQUIRE(mem != MAP_FAILED);
+	shm::ring::init(mem, cap);
+	const timespec timeout = { 5, 0 };
+	pid_t pid = ::fork();
+	BOOST_REQUIRE(pid != -1);
+	if (pid == 0) {
+		int status = 1;
+		try {
+			shm::ring r(mem);
+			std::vector< char > msg(3500, 'x');
+			if (r.write(&msg[0], 2992, &timeout)) {
+				// let the consumer go to sleep
+				::usleep(100000);
+				if (r.write(&msg[0], msg.size(), &timeout))
+					status = 0;
+			}
+		}
+		catch (...) {
+		}
+		::_exit(status);
+	}
+	shm::ring r(mem);
+	std::vector< char > buf(cap);
+	BOOST_CHECK_EQUAL(r.read(&buf[0], buf.size(), &timeout), 2992);
+	BOOST_CHECK_EQUAL(r.read(&buf[0], buf.size(), &timeout), 3500);
+	BOOST_CHECK_EQUAL(wait_child(pid), 0);
+	::munmap(mem, shm::ring::size(cap));
+}
+
+BOOST_AUTO_TEST_CASE( close_test )
+{
+	std::pair< shm::socket*, shm::socket* > p = shm::pair();
+	p.first->send("bye", 3);
+	p.first->close();
+	// pending messages can still be read
+	BOOST_CHECK_EQUAL(recv_str(*p.second), "bye");
+	CHECK_ERRNO(recv_str(*p.second), 0);
+	CHECK_ERRNO(p.second->send("x", 1), EPIPE);
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( fork_test )
+{
+	shm::socket a(8192);
+	pid_t pid = ::fork();
+	BOOST_REQUIRE(pid != -1);
+	if (pid == 0) {
+		int status = 0;
+		try {
+			shm::socket b(::dup(a.fd()), shm::SIDE_B);
+			for (int i = 0; i < 10000; ++i) {
+				int x;
+				b.recv_struct(x);
+				b.send_struct(x + 1);
+			}
+		}
+		catch (...) {
+			status = 1;
+		}
+		::_exit(status);
+	}
+	for (int i = 0; i < 10000; ++i) {
+		a.send_struct(i);
+		int x = -1;
+		a.recv_struct(x);
+		BOOST_REQUIRE_EQUAL(x, i + 1);
+	}
+	BOOST_CHECK_EQUAL(wait_child(pid), 0);
+}
+
+BOOST_AUTO_TEST_CASE( multi_producer_test )
+{
+	std::ostringstream name;
+	name << "/posixx-test-" << ::getpid();
+	shm::socket a(name.str(), 8192, shm::MULTI_PRODUCER);
+	shm::socket::unlink(name.str());
+	const int producers = 4;
+	const int msgs = 5000;
+	pid_t pids[producers];
+	for (int p = 0; p < producers; ++p) {
+		pid_t pid = pids[p] = ::fork();
+		BOOST_REQUIRE(pid != -1);
+		if (pid == 0) {
+			int status = 0;
+			try {
+				shm::socket b(::dup(a.fd()), shm::SIDE_B);
+				for (int i = 0; i < msgs; ++i)
+					b.send_struct(p * msgs + i);
+			}
+			catch (...) {
+				status = 1;
+			}
+			::_exit(status);
+		}
+	}
+	// messages from each producer arrive in order
+	std::vector< int > next(producers);
+	for (int i = 0; i < producers * msgs; ++i) {
+		int x;
+		a.recv_struct(x);
+		int p = x / msgs;
+		BOOST_REQUIRE(p >= 0 && p < producers);
+		BOOST_REQUIRE_EQUAL(x % msgs, next[p]);
+		++next[p];
+	}
+	for (int p = 0; p < producers; ++p)
+		BOOST_CHECK_EQUAL(wait_child(pids[p]), 0);
+	// the producers closing doesn't close the socket
+	char c;
+	CHECK_ERRNO(a.recv(&c, 1, MSG_DONTWAIT), EAGAIN);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
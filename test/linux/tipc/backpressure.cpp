@@ -0,0 +1,91 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "common.hpp" // output formatting
+#include <posixx/linux/tipc/backpressure.hpp> // rate_controller
+#include <boost/test/unit_test.hpp> // unit testing stuff
+
+using namespace ::posixx::linux::tipc;
+
+namespace {
+
+const uint64_t MS = 1000000;
+
+// 1000 msg/s (one each ms), no bursts and no increase
+rate_controller::config test_config()
+{
+	rate_controller::config cfg;
+	cfg.initial_rate = 1000;
+	cfg.min_rate = 100;
+	cfg.max_rate = 2000;
+	cfg.increase = 0;
+	cfg.burst = 1;
+	cfg.hold = 10 * MS;
+	return cfg;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE( linux_tipc_backpressure_suite )
+
+BOOST_AUTO_TEST_CASE( token_bucket_test )
+{
+	rate_controller rc(test_config(), 0);
+	BOOST_CHECK(rc.acquire(0));
+	BOOST_CHECK(!rc.acquire(0));
+	BOOST_CHECK_GT(rc.wait_time(0), 0u);
+	BOOST_CHECK_LE(rc.wait_time(0), MS + 1);
+	BOOST_CHECK(!rc.acquire(MS / 2));
+	BOOST_CHECK(rc.acquire(MS));
+	// the bucket doesn't fill beyond the burst
+	BOOST_CHECK(rc.acquire(100 * MS));
+	BOOST_CHECK(!rc.acquire(100 * MS));
+	BOOST_CHECK_EQUAL(rc.wait_time(101 * MS), 0u);
+}
+
+BOOST_AUTO_TEST_CASE( overload_test )
+{
+	rate_controller rc(test_config(), 0);
+	// other reasons are not congestion
+	BOOST_CHECK(!rc.returned(ERR_NO_PORT, 0));
+	BOOST_CHECK_EQUAL(rc.rate(), 1000);
+	msg_info info;
+	info.reason = ERR_OVERLOAD;
+	BOOST_CHECK(rc.returned(info, 0));
+	BOOST_CHECK_EQUAL(rc.rate(), 500);
+	BOOST_CHECK(!rc.acquire(0));
+	// overloads in the hold period are counted but ignored
+	BOOST_CHECK(!rc.overload(MS));
+	BOOST_CHECK_EQUAL(rc.rate(), 500);
+	BOOST_CHECK_EQUAL(rc.overloads(), 2u);
+	BOOST_CHECK(rc.overload(10 * MS));
+	BOOST_CHECK_EQUAL(rc.rate(), 250);
+	// the rate is never cut below the minimum
+	for (uint64_t t = 20; t < 100; t += 10)
+		rc.overload(t * MS);
+	BOOST_CHECK_EQUAL(rc.rate(), 100);
+}
+
+BOOST_AUTO_TEST_CASE( increase_test )
+{
+	rate_controller::config cfg = test_config();
+	cfg.increase = 100;
+	cfg.interval = 10 * MS;
+	rate_controller rc(cfg, 0);
+	rc.overload(0);
+	BOOST_CHECK_EQUAL(rc.rate(), 500);
+	rc.acquire(9 * MS);
+	BOOST_CHECK_EQUAL(rc.rate(), 500);
+	rc.acquire(35 * MS);
+	BOOST_CHECK_EQUAL(rc.rate(), 800);
+	// the rate never grows beyond the maximum
+	rc.acquire(1000 * MS);
+	BOOST_CHECK_EQUAL(rc.rate(), 2000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -0,0 +1,137 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "common.hpp" // PTYPE, INST{1,2}, make_event, output formatting
+#include <posixx/linux/tipc/balancer.hpp> // posixx::linux::tipc::port_selector
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <map> // std::map
+
+using namespace ::posixx::linux::tipc;
+
+namespace {
+
+// A table with 3 ports publishing (PTYPE, INST1) and an unrelated one
+void publish(name_table& t)
+{
+	t.apply(make_event(PUBLISHED, PTYPE, INST1, INST1, 1));
+	t.apply(make_event(PUBLISHED, PTYPE, INST1, INST2, 2));
+	t.apply(make_event(PUBLISHED, PTYPE, INST1, INST1, 3));
+	t.apply(make_event(PUBLISHED, PTYPE, INST2, INST2, 4));
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE( linux_tipc_balancer_suite )
+
+BOOST_AUTO_TEST_CASE( candidates_test )
+{
+	name_table t;
+	port_selector s(t, nameseq(PTYPE, INST1));
+	BOOST_CHECK(s.candidates().empty());
+	BOOST_CHECK(s.select() == NULL);
+	publish(t);
+	BOOST_CHECK_EQUAL(s.candidates().size(), 3u);
+	// candidates follow the table
+	t.apply(make_event(WITHDRAWN, PTYPE, INST1, INST1, 3));
+	BOOST_CHECK_EQUAL(s.candidates().size(), 2u);
+	port_selector s2(t, nameseq(PTYPE, INST1, INST2));
+	BOOST_CHECK_EQUAL(s2.candidates().size(), 3u);
+}
+
+BOOST_AUTO_TEST_CASE( round_robin_test )
+{
+	name_table t;
+	publish(t);
+	port_selector s(t, nameseq(PTYPE, INST1), ROUND_ROBIN);
+	std::map< __u32, int > count;
+	for (int i = 0; i < 30; ++i)
+		++count[s.select()->id.ref];
+	BOOST_CHECK_EQUAL(count.size(), 3u);
+	BOOST_CHECK_EQUAL(count[1], 10);
+	BOOST_CHECK_EQUAL(count[2], 10);
+	BOOST_CHECK_EQUAL(count[3], 10);
+}
+
+BOOST_AUTO_TEST_CASE( least_loaded_test )
+{
+	name_table t;
+	publish(t);
+	port_selector s(t, nameseq(PTYPE, INST1), LEAST_LOADED);
+	// load all the ports with one message, except for port 2
+	for (int i = 0; i < 3; ++i) {
+		port_selector::port_state* p = s.select();
+		s.sent(*p);
+		if (p->id.ref == 2)
+			s.complete(p->id);
+	}
+	for (int i = 0; i < 5; ++i)
+		BOOST_CHECK_EQUAL(s.select()->id.ref, 2u);
+}
+
+BOOST_AUTO_TEST_CASE( consistent_hash_test )
+{
+	name_table t;
+	publish(t);
+	port_selector s(t, nameseq(PTYPE, INST1), CONSISTENT_HASH);
+	std::map< uint64_t, __u32 > assigned;
+	std::map< __u32, int > count;
+	for (uint64_t k = 0; k < 300; ++k) {
+		assigned[k] = s.select(k)->id.ref;
+		++count[assigned[k]];
+		// the same key always goes to the same port
+		BOOST_CHECK_EQUAL(s.select(k)->id.ref, assigned[k]);
+	}
+	BOOST_CHECK_EQUAL(count.size(), 3u);
+	// when a port goes away, only its keys move
+	t.apply(make_event(WITHDRAWN, PTYPE, INST1, INST2, 2));
+	for (uint64_t k = 0; k < 300; ++k) {
+		__u32 r = s.select(k)->id.ref;
+		BOOST_CHECK_NE(r, 2u);
+		if (assigned[k] != 2)
+			BOOST_CHECK_EQUAL(r, assigned[k]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( failover_test )
+{
+	name_table t;
+	publish(t);
+	port_selector s(t, nameseq(PTYPE, INST1), ROUND_ROBIN);
+	const portid p1(1, addr(0x01001001));
+	const portid p2(2, addr(0x01001001));
+	s.report(p1, ERR_NO_PORT);
+	s.report(p2, ERR_OVERLOAD);
+	for (int i = 0; i < 5; ++i)
+		BOOST_CHECK_EQUAL(s.select()->id.ref, 3u);
+	s.report(portid(3, addr(0x01001001)), ERR_OVERLOAD);
+	BOOST_CHECK(s.select() == NULL);
+	BOOST_CHECK_EQUAL(s.candidates()[0].errors + s.candidates()[1].errors
+			+ s.candidates()[2].errors, 3u);
+	// reporting unknown ports or OK is harmless
+	s.report(portid(9, addr(0x01001001)), ERR_NO_PORT);
+	s.report(p1, OK);
+}
+
+BOOST_AUTO_TEST_CASE( overload_backoff_test )
+{
+	name_table t;
+	publish(t);
+	port_selector::config cfg;
+	cfg.overload_penalty = 0; // expire immediately
+	cfg.max_overload_penalty = 0;
+	port_selector s(t, nameseq(PTYPE, INST1), ROUND_ROBIN, cfg);
+	const portid p1(1, addr(0x01001001));
+	s.report(p1, ERR_OVERLOAD);
+	// with no penalty the port is usable again right away
+	std::map< __u32, int > count;
+	for (int i = 0; i < 3; ++i)
+		++count[s.select()->id.ref];
+	BOOST_CHECK_EQUAL(count[1], 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
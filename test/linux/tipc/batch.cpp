@@ -0,0 +1,73 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "common.hpp" // output formatting
+#include <posixx/linux/tipc/batch.hpp> // batch_reader
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <string> // std::string
+#include <vector> // std::vector
+#include <cerrno> // EPROTO, EMSGSIZE
+
+using namespace ::posixx::linux::tipc;
+
+BOOST_AUTO_TEST_SUITE( linux_tipc_batch_suite )
+
+BOOST_AUTO_TEST_CASE( batch_reader_test )
+{
+	std::vector< char > b;
+	std::string big(300, 'x');
+	batch_reader::append(b, "hello", 5);
+	batch_reader::append(b, "", 0);
+	batch_reader::append(b, big.data(), big.size());
+	BOOST_CHECK_EQUAL(b.size(), 3 * batch_reader::HEADER + 5 + 300);
+	// the length is in network byte order
+	BOOST_CHECK_EQUAL(b[9], 0x01);
+	BOOST_CHECK_EQUAL(b[10], 0x2c);
+	batch_reader r(&b[0], b.size());
+	const void* d;
+	std::size_t n;
+	BOOST_REQUIRE(r.next(d, n));
+	BOOST_CHECK_EQUAL(std::string(static_cast< const char* >(d), n),
+			"hello");
+	BOOST_REQUIRE(r.next(d, n));
+	BOOST_CHECK_EQUAL(n, 0u);
+	BOOST_REQUIRE(r.next(d, n));
+	BOOST_CHECK_EQUAL(std::string(static_cast< const char* >(d), n), big);
+	BOOST_CHECK(!r.next(d, n));
+	BOOST_CHECK(!batch_reader(NULL, 0).next(d, n));
+}
+
+BOOST_AUTO_TEST_CASE( batch_reader_error_test )
+{
+	std::vector< char > b;
+	std::string huge(batch_reader::MAX_RECORD + 1, 'x');
+	try {
+		batch_reader::append(b, huge.data(), huge.size());
+		BOOST_ERROR("no exception thrown");
+	}
+	catch (const posixx::error& e) {
+		BOOST_CHECK_EQUAL(e.no, EMSGSIZE);
+	}
+	BOOST_CHECK(b.empty());
+	batch_reader::append(b, "hello", 5);
+	b.pop_back();
+	batch_reader r(&b[0], b.size());
+	const void* d;
+	std::size_t n;
+	try {
+		r.next(d, n);
+		BOOST_ERROR("no exception thrown");
+	}
+	catch (const posixx::error& e) {
+		BOOST_CHECK_EQUAL(e.no, EPROTO);
+	}
+	// the rest of the batch is skipped
+	BOOST_CHECK(!r.next(d, n));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -9,6 +9,7 @@
 
 #include <posixx/linux/tipc.hpp> // posixx::linux::tipc
 #include <posixx/linux/tipc/print.hpp> // address output formatting
+#include <cstring> // std::memset
 
 #define PTYPE 10000
 #define INST1 10001
@@ -22,4 +23,21 @@ static posixx::linux::tipc::sockaddr test_address1(
 static posixx::linux::tipc::sockaddr test_address2(
 		posixx::linux::tipc::name(PTYPE, INST2));
 
+// Build a topology event as sent by the topology service
+inline
+posixx::linux::tipc::subscr_event make_event(__u32 event, __u32 type,
+		__u32 lower, __u32 upper, __u32 ref, __u32 node = 0x01001001)
+{
+	using namespace posixx::linux::tipc;
+	subscr_event ev;
+	std::memset(&ev, 0, sizeof(ev));
+	ev.event = event;
+	ev.found_lower = lower;
+	ev.found_upper = upper;
+	ev.port_id() = portid(ref, addr(node));
+	ev.subscription() = subscr(nameseq(type, 0, ~0u), WAIT_FOREVER,
+			SUB_PORTS);
+	return ev;
+}
+
 #endif // TEST_LINUX_TIPC_COMMON_HPP_
@@ -0,0 +1,60 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "common.hpp" // PTYPE, INST1, output formatting
+#include <posixx/linux/tipc/group.hpp> // group_socket, opt::group_req
+#include <posixx/error.hpp> // posixx::error
+#include <boost/test/unit_test.hpp> // unit testing stuff
+
+using namespace ::posixx::linux::tipc;
+
+BOOST_AUTO_TEST_SUITE( linux_tipc_group_suite )
+
+BOOST_AUTO_TEST_CASE( group_req_test )
+{
+	opt::group_req r;
+	BOOST_CHECK_EQUAL(r.type, 0u);
+	BOOST_CHECK_EQUAL(r.flags, 0u);
+	opt::group_req r2(PTYPE, INST1, NODE,
+			opt::GROUP_LOOPBACK | opt::GROUP_MEMBER_EVTS);
+	BOOST_CHECK_EQUAL(r2.type, PTYPE);
+	BOOST_CHECK_EQUAL(r2.instance, INST1);
+	BOOST_CHECK_EQUAL(r2.scope, unsigned(TIPC_NODE_SCOPE));
+	BOOST_CHECK_EQUAL(r2.flags, unsigned(TIPC_GROUP_LOOPBACK
+			| TIPC_GROUP_MEMBER_EVTS));
+	BOOST_CHECK(!opt::GROUP_JOIN::read && opt::GROUP_JOIN::write);
+	BOOST_CHECK(!opt::GROUP_LEAVE::read && opt::GROUP_LEAVE::write);
+	BOOST_CHECK(!opt::MCAST_BROADCAST::read);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// These need a kernel with TIPC support
+BOOST_AUTO_TEST_SUITE( linux_tipc_group_socket_suite )
+
+BOOST_AUTO_TEST_CASE( join_leave_test )
+{
+	group_socket g;
+	BOOST_CHECK_EQUAL(g.group(), 0u);
+	g.join(name(PTYPE, INST1), NODE);
+	BOOST_CHECK_EQUAL(g.group(), unsigned(PTYPE));
+	g.leave();
+	BOOST_CHECK_EQUAL(g.group(), 0u);
+	// it can join again after leaving
+	g.join(name(PTYPE, INST2), NODE, 0);
+	BOOST_CHECK_EQUAL(g.group(), unsigned(PTYPE));
+	g.leave();
+}
+
+BOOST_AUTO_TEST_CASE( leave_not_member_test )
+{
+	group_socket g;
+	BOOST_CHECK_THROW(g.leave(), posixx::error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
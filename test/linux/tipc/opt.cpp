@@ -0,0 +1,55 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "common.hpp" // output formatting
+#include <posixx/linux/tipc.hpp> // posixx::linux::tipc::socket
+#include <posixx/linux/tipc/opt.hpp> // posixx::linux::tipc::opt
+#include <boost/test/unit_test.hpp> // unit testing stuff
+
+using namespace ::posixx::linux::tipc;
+typedef ::posixx::linux::tipc::socket tipc_socket;
+
+BOOST_AUTO_TEST_SUITE( linux_tipc_opt_suite )
+
+BOOST_AUTO_TEST_CASE( traits_test )
+{
+	BOOST_CHECK(!opt::MCAST_BROADCAST::read);
+	BOOST_CHECK(opt::MCAST_BROADCAST::write);
+	BOOST_CHECK(!opt::MCAST_REPLICAST::read);
+	BOOST_CHECK(opt::MCAST_REPLICAST::write);
+	BOOST_CHECK_EQUAL(int(opt::MCAST_BROADCAST::optname),
+			TIPC_MCAST_BROADCAST);
+	BOOST_CHECK_EQUAL(int(opt::MCAST_REPLICAST::optname),
+			TIPC_MCAST_REPLICAST);
+	BOOST_CHECK(opt::SOCK_RECVQ_DEPTH::read);
+	BOOST_CHECK(!opt::SOCK_RECVQ_DEPTH::write);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// These need a kernel with TIPC support
+BOOST_AUTO_TEST_SUITE( linux_tipc_opt_socket_suite )
+
+BOOST_AUTO_TEST_CASE( mcast_test )
+{
+	tipc_socket s(posixx::socket::RDM);
+	// they take no argument, and can be switched back and forth
+	BOOST_CHECK_NO_THROW(s.set_opt< opt::MCAST_BROADCAST >());
+	BOOST_CHECK_NO_THROW(s.set_opt< opt::MCAST_REPLICAST >());
+	BOOST_CHECK_NO_THROW(s.set_opt< opt::MCAST_BROADCAST >());
+	// a value is rejected by the kernel
+	BOOST_CHECK_THROW(s.setsockopt(SOL_TIPC, TIPC_MCAST_BROADCAST, 1),
+			posixx::error);
+}
+
+BOOST_AUTO_TEST_CASE( recvq_depth_test )
+{
+	tipc_socket s(posixx::socket::RDM);
+	BOOST_CHECK_EQUAL(s.opt< opt::SOCK_RECVQ_DEPTH >(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,62 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "common.hpp" // output formatting
+#include <posixx/linux/tipc/queue_sampler.hpp> // queue_sampler
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <cerrno> // EBADF
+
+using namespace ::posixx::linux::tipc;
+
+BOOST_AUTO_TEST_SUITE( linux_tipc_queue_sampler_suite )
+
+BOOST_AUTO_TEST_CASE( record_test )
+{
+	queue_sampler qs(0.5);
+	qs.add(10);
+	qs.add(11);
+	qs.record(0, 4, 400);
+	qs.record(1, 2);
+	qs.commit();
+	BOOST_CHECK_EQUAL(qs.total(), 6u);
+	BOOST_CHECK_EQUAL(qs.max(), 4u);
+	BOOST_CHECK_EQUAL(qs.samples(), 1u);
+	qs.record(0, 0);
+	qs.record(1, 8);
+	qs.commit();
+	BOOST_CHECK_EQUAL(qs.total(), 8u);
+	BOOST_CHECK_EQUAL(qs.max(), 8u);
+	const queue_sampler::queues_type& q = qs.queues();
+	BOOST_CHECK_EQUAL(q[0].max_depth, 4u);
+	BOOST_CHECK_CLOSE(q[0].avg_depth, 1.0, 0.001);
+	BOOST_CHECK_CLOSE(q[1].avg_depth, 4.5, 0.001);
+	BOOST_CHECK_EQUAL(qs.depths().count(), 2u);
+	BOOST_CHECK_EQUAL(qs.depths().sum(), 14u);
+	qs.reset();
+	BOOST_CHECK_EQUAL(q[0].max_depth, 0u);
+	BOOST_CHECK_EQUAL(qs.depths().count(), 0u);
+	BOOST_CHECK(qs.remove(10));
+	BOOST_CHECK(!qs.remove(10));
+	BOOST_CHECK_EQUAL(qs.queues().size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE( sample_error_test )
+{
+	queue_sampler qs;
+	qs.add(-1);
+	try {
+		qs.sample();
+		BOOST_ERROR("no exception thrown");
+	}
+	catch (const posixx::error& e) {
+		BOOST_CHECK_EQUAL(e.no, EBADF);
+	}
+	BOOST_CHECK_EQUAL(qs.samples(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -9,6 +9,7 @@
 #include <posixx/linux/tipc.hpp> // posixx::linux::tipc
 #include <boost/test/unit_test.hpp> // unit testing stuff
 #include <stdint.h>
+#include <cerrno> // errno, EINVAL
 
 using namespace ::posixx::linux::tipc;
 namespace tipc = ::posixx::linux::tipc;
@@ -485,3 +486,63 @@ BOOST_AUTO_TEST_CASE( linux_tipc_sockaddr_nameseq_ctor_test )
 
 }
 
+
+BOOST_AUTO_TEST_CASE( linux_tipc_sockaddr_format_test )
+{
+
+	char buf[tipc::sockaddr::TEXT_SIZE];
+
+	tipc::sockaddr sid(portid(4294967295u, addr(255, 4095, 4095)));
+	BOOST_CHECK_EQUAL( sid.format(buf, sizeof(buf)), 26u );
+	BOOST_CHECK_EQUAL( buf, "<255.4095.4095:4294967295>" );
+
+	tipc::sockaddr sn(name(1000, 7));
+	BOOST_CHECK_EQUAL( sn.format(buf, sizeof(buf)), 8u );
+	BOOST_CHECK_EQUAL( buf, "{1000,7}" );
+
+	tipc::sockaddr snd(name(4294967295u, 4294967295u), ZONE,
+			addr(255, 4095, 4095));
+	BOOST_CHECK_EQUAL( snd.format(buf, sizeof(buf)),
+			sizeof(buf) - 1 );
+	BOOST_CHECK_EQUAL( buf, "{4294967295,4294967295}@255.4095.4095" );
+
+	tipc::sockaddr sns(nameseq(1000, 1, 10));
+	BOOST_CHECK_EQUAL( sns.format(buf, sizeof(buf)), 11u );
+	BOOST_CHECK_EQUAL( buf, "{1000,1,10}" );
+
+	char small[4];
+	BOOST_CHECK_EQUAL( sns.format(small, sizeof(small)), 11u );
+	BOOST_CHECK_EQUAL( small, "{10" );
+
+}
+
+BOOST_AUTO_TEST_CASE( linux_tipc_sockaddr_parse_test )
+{
+
+	tipc::sockaddr sa;
+
+	BOOST_REQUIRE( sa.parse("<1.2.3:4567>") );
+	BOOST_CHECK_EQUAL( sa, tipc::sockaddr(portid(4567, addr(1, 2, 3))) );
+
+	BOOST_REQUIRE( sa.parse("{1000,7}") );
+	BOOST_CHECK_EQUAL( sa, tipc::sockaddr(name(1000, 7)) );
+
+	BOOST_REQUIRE( sa.parse("{1000,7}@1.1.0") );
+	BOOST_CHECK_EQUAL( sa, tipc::sockaddr(name(1000, 7), ZONE,
+			addr(1, 1, 0)) );
+
+	BOOST_REQUIRE( sa.parse("{1000,1,10}") );
+	BOOST_CHECK_EQUAL( sa, tipc::sockaddr(nameseq(1000, 1, 10)) );
+
+	const char* invalid[] = { "", "{", "{1}", "{1,2", "{1,2,3,4}",
+			"{1,2}@", "{1,2}@1.2", "{1,2}x", "<1.2.3>",
+			"<256.1.1:1>", "<1.4096.1:1>", "<1.1.1:4294967296>",
+			"1000,7" };
+	for (std::size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+		errno = 0;
+		BOOST_CHECK_MESSAGE( !sa.parse(invalid[i]), invalid[i] );
+		BOOST_CHECK_EQUAL( errno, EINVAL );
+		BOOST_CHECK_EQUAL( sa, tipc::sockaddr(nameseq(1000, 1, 10)) );
+	}
+
+}
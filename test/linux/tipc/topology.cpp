@@ -0,0 +1,109 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "common.hpp" // PTYPE, INST{1,2}, make_event, output formatting
+#include <posixx/linux/tipc/topology.hpp> // posixx::linux::tipc::name_table
+#include <boost/test/unit_test.hpp> // unit testing stuff
+
+using namespace ::posixx::linux::tipc;
+
+BOOST_AUTO_TEST_SUITE( linux_tipc_topology_suite )
+
+BOOST_AUTO_TEST_CASE( name_table_lookup_test )
+{
+	name_table t;
+	BOOST_CHECK(t.lookup(name(PTYPE, INST1)).empty());
+	BOOST_CHECK(t.apply(make_event(PUBLISHED, PTYPE, INST1, INST1, 1)));
+	BOOST_CHECK(t.apply(make_event(PUBLISHED, PTYPE, INST1, INST2, 2)));
+	BOOST_CHECK(t.apply(make_event(PUBLISHED, PTYPE + 1, INST1, INST1, 3)));
+	BOOST_CHECK_EQUAL(t.published(PTYPE).size(), 2u);
+	BOOST_CHECK_EQUAL(t.published(PTYPE + 2).size(), 0u);
+
+	const name_table::ports& p1 = t.lookup(name(PTYPE, INST1));
+	BOOST_REQUIRE_EQUAL(p1.size(), 2u);
+	BOOST_CHECK_EQUAL(p1[0], portid(1, addr(0x01001001)));
+	BOOST_CHECK_EQUAL(p1[1], portid(2, addr(0x01001001)));
+	const name_table::ports& p2 = t.lookup(name(PTYPE, INST2));
+	BOOST_REQUIRE_EQUAL(p2.size(), 1u);
+	BOOST_CHECK_EQUAL(p2[0].ref, 2u);
+	BOOST_CHECK_EQUAL(t.lookup(name(PTYPE + 1, INST1)).size(), 1u);
+	BOOST_CHECK(t.lookup(name(PTYPE + 1, INST2)).empty());
+}
+
+BOOST_AUTO_TEST_CASE( name_table_update_test )
+{
+	name_table t;
+	// misses are not cached, they see new publications on the next lookup
+	BOOST_CHECK(t.lookup(name(PTYPE, INST1)).empty());
+	t.apply(make_event(PUBLISHED, PTYPE, INST1, INST2, 1));
+	// cached lookups are updated by new events
+	const name_table::ports& p1 = t.lookup(name(PTYPE, INST1));
+	const name_table::ports& p2 = t.lookup(name(PTYPE, INST2));
+	BOOST_CHECK_EQUAL(p1.size(), 1u);
+	BOOST_CHECK_EQUAL(p2.size(), 1u);
+	t.apply(make_event(PUBLISHED, PTYPE, INST2, INST2, 2, 0x01001002));
+	BOOST_CHECK_EQUAL(p1.size(), 1u);
+	BOOST_CHECK_EQUAL(p2.size(), 2u);
+	// withdrawals must match the publication
+	BOOST_CHECK(!t.apply(make_event(WITHDRAWN, PTYPE, INST2, INST2, 1)));
+	BOOST_CHECK(t.apply(make_event(WITHDRAWN, PTYPE, INST1, INST2, 1)));
+	BOOST_CHECK(p1.empty());
+	BOOST_REQUIRE_EQUAL(p2.size(), 1u);
+	BOOST_CHECK_EQUAL(p2[0], portid(2, addr(0x01001002)));
+	BOOST_CHECK_EQUAL(t.published(PTYPE).size(), 1u);
+	// timeouts are ignored
+	BOOST_CHECK(!t.apply(make_event(TIMEOUT, PTYPE, 0, 0, 0)));
+	t.clear();
+	BOOST_CHECK(t.published(PTYPE).empty());
+	BOOST_CHECK(t.lookup(name(PTYPE, INST2)).empty());
+}
+
+BOOST_AUTO_TEST_CASE( name_table_miss_test )
+{
+	name_table t;
+	t.apply(make_event(PUBLISHED, PTYPE, INST1, INST1, 1));
+	// looking up many unpublished names returns the same empty list
+	const name_table::ports& none = t.lookup(name(PTYPE, INST2));
+	BOOST_CHECK(none.empty());
+	for (__u32 i = 0; i < 1000; ++i)
+		BOOST_CHECK_EQUAL(&t.lookup(name(PTYPE + 1, i)), &none);
+	BOOST_CHECK_EQUAL(&t.lookup(name(PTYPE, INST2)), &none);
+	BOOST_CHECK_EQUAL(t.lookup(name(PTYPE, INST1)).size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE( name_table_overlap_test )
+{
+	name_table t;
+	// {INST1, INST2} as reported by two overlapping subscriptions, one of
+	// them covering only INST2
+	BOOST_CHECK(t.apply(make_event(PUBLISHED, PTYPE, INST1, INST2, 1)));
+	const name_table::ports& p1 = t.lookup(name(PTYPE, INST1));
+	const name_table::ports& p2 = t.lookup(name(PTYPE, INST2));
+	BOOST_CHECK(!t.apply(make_event(PUBLISHED, PTYPE, INST1, INST2, 1)));
+	BOOST_CHECK(t.apply(make_event(PUBLISHED, PTYPE, INST2, INST2, 1)));
+	BOOST_CHECK_EQUAL(t.published(PTYPE).size(), 2u);
+	BOOST_CHECK_EQUAL(p1.size(), 1u);
+	BOOST_CHECK_EQUAL(p2.size(), 1u);
+	BOOST_CHECK_EQUAL(t.lookup(name(PTYPE, INST2)).size(), 1u);
+	// a new lookup doesn't see the port twice either
+	t.clear();
+	t.apply(make_event(PUBLISHED, PTYPE, INST1, INST2, 1));
+	t.apply(make_event(PUBLISHED, PTYPE, INST1, INST2, 1));
+	t.apply(make_event(PUBLISHED, PTYPE, INST2, INST2, 1));
+	const name_table::ports& p3 = t.lookup(name(PTYPE, INST2));
+	BOOST_CHECK_EQUAL(p3.size(), 1u);
+	// every subscription withdraws it
+	BOOST_CHECK(!t.apply(make_event(WITHDRAWN, PTYPE, INST1, INST2, 1)));
+	BOOST_CHECK(t.apply(make_event(WITHDRAWN, PTYPE, INST1, INST2, 1)));
+	BOOST_CHECK_EQUAL(p3.size(), 1u);
+	BOOST_CHECK(t.apply(make_event(WITHDRAWN, PTYPE, INST2, INST2, 1)));
+	BOOST_CHECK(p3.empty());
+	BOOST_CHECK(t.published(PTYPE).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
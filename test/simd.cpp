@@ -0,0 +1,205 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/simd.hpp> // posixx::simd
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector> // std::vector
+#include <cstddef> // std::size_t
+#include <cstdlib> // std::rand, std::srand
+
+namespace simd = posixx::simd;
+
+namespace {
+
+// Functions of an implementation level
+struct impl
+{
+	simd::level level;
+	std::size_t (*find_any)(const void*, std::size_t, const void*,
+			std::size_t) throw ();
+	std::size_t (*find_str)(const void*, std::size_t, const void*,
+			std::size_t) throw ();
+	bool (*equal)(const void*, const void*, std::size_t) throw ();
+};
+
+// All the implementations supported by this CPU
+std::vector< impl > impls()
+{
+	std::vector< impl > r;
+	impl s = { simd::SCALAR, &simd::scalar::find_any,
+			&simd::scalar::find, &simd::scalar::equal };
+	r.push_back(s);
+#if POSIXX_SIMD_X86
+	impl s2 = { simd::SSE2, &simd::sse2::find_any,
+			&simd::sse2::find, &simd::sse2::equal };
+	r.push_back(s2);
+	if (simd::supported() >= simd::AVX2) {
+		impl a = { simd::AVX2, &simd::avx2::find_any,
+				&simd::avx2::find,
+				&simd::avx2::equal };
+		r.push_back(a);
+	}
+#endif
+	return r;
+}
+
+// Reference (naive) implementations
+std::size_t ref_find(const unsigned char* p, std::size_t n, unsigned char c)
+{
+	for (std::size_t i = 0; i < n; ++i)
+		if (p[i] == c)
+			return i;
+	return simd::npos;
+}
+
+std::size_t ref_find_any(const unsigned char* p, std::size_t n,
+		const unsigned char* set, std::size_t set_n)
+{
+	for (std::size_t i = 0; i < n; ++i)
+		for (std::size_t k = 0; k < set_n; ++k)
+			if (p[i] == set[k])
+				return i;
+	return simd::npos;
+}
+
+std::size_t ref_find_str(const unsigned char* p, std::size_t n,
+		const unsigned char* s, std::size_t m)
+{
+	for (std::size_t i = 0; i + m <= n; ++i) {
+		std::size_t j = 0;
+		while (j < m && p[i + j] == s[j])
+			++j;
+		if (j == m)
+			return i;
+	}
+	return simd::npos;
+}
+
+// Random data using a small alphabet, so there are plenty of partial matches
+std::vector< unsigned char > random_bytes(std::size_t n)
+{
+	std::vector< unsigned char > v(n + 1);
+	for (std::size_t i = 0; i < n; ++i)
+		v[i] = 'a' + std::rand() % 4;
+	return v;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE( simd_suite )
+
+BOOST_AUTO_TEST_CASE( level_test )
+{
+	BOOST_CHECK_LE(simd::active(), simd::supported());
+	simd::level prev = simd::use(simd::SCALAR);
+	BOOST_CHECK_EQUAL(simd::active(), simd::SCALAR);
+	simd::use(simd::AVX2);
+	BOOST_CHECK_EQUAL(simd::active(), simd::supported());
+	simd::use(prev);
+}
+
+BOOST_AUTO_TEST_CASE( find_test )
+{
+	std::srand(42);
+	for (std::size_t n = 0; n < 200; ++n) {
+		std::vector< unsigned char > v = random_bytes(n);
+		// search from every alignment for a byte that may be absent
+		for (std::size_t off = 0; off < 4 && off <= n; ++off)
+			for (unsigned char c = 'a'; c <= 'e'; ++c)
+				BOOST_CHECK_EQUAL(simd::find(&v[off], n - off, c),
+						ref_find(&v[off], n - off, c));
+	}
+	BOOST_CHECK_EQUAL(simd::find(NULL, 0, 'a'), simd::npos);
+}
+
+BOOST_AUTO_TEST_CASE( find_any_test )
+{
+	std::srand(42);
+	std::vector< impl > is = impls();
+	unsigned char big_set[64];
+	for (std::size_t k = 0; k < sizeof(big_set); ++k)
+		big_set[k] = 'd' + k; // only 'd' is in the data
+	const unsigned char* sets[] = {
+		reinterpret_cast< const unsigned char* >("x"),
+		reinterpret_cast< const unsigned char* >("dx"),
+		reinterpret_cast< const unsigned char* >("xyzd"),
+		big_set,
+	};
+	const std::size_t set_sizes[] = { 1, 2, 4, sizeof(big_set) };
+	for (std::size_t n = 0; n < 200; ++n) {
+		std::vector< unsigned char > v = random_bytes(n);
+		for (std::size_t s = 0; s < 4; ++s)
+			for (std::size_t i = 0; i < is.size(); ++i)
+				BOOST_CHECK_EQUAL(is[i].find_any(&v[0], n,
+						sets[s], set_sizes[s]),
+					ref_find_any(&v[0], n, sets[s],
+						set_sizes[s]));
+	}
+	for (std::size_t i = 0; i < is.size(); ++i)
+		BOOST_CHECK_EQUAL(is[i].find_any("abc", 3, "", 0), simd::npos);
+}
+
+BOOST_AUTO_TEST_CASE( find_str_test )
+{
+	std::srand(42);
+	std::vector< impl > is = impls();
+	for (std::size_t n = 0; n < 200; n += 3) {
+		std::vector< unsigned char > v = random_bytes(n);
+		for (std::size_t m = 0; m < 8; ++m) {
+			std::vector< unsigned char > s = random_bytes(m);
+			for (std::size_t i = 0; i < is.size(); ++i)
+				BOOST_CHECK_EQUAL(is[i].find_str(&v[0], n,
+						&s[0], m),
+					ref_find_str(&v[0], n, &s[0], m));
+		}
+		// a substring found (usually) only at the end
+		if (n >= 40)
+			for (std::size_t i = 0; i < is.size(); ++i)
+				BOOST_CHECK_EQUAL(is[i].find_str(&v[0], n,
+						&v[n - 40], 40),
+					ref_find_str(&v[0], n, &v[n - 40],
+						40));
+	}
+}
+
+BOOST_AUTO_TEST_CASE( equal_test )
+{
+	std::srand(42);
+	std::vector< impl > is = impls();
+	for (std::size_t n = 0; n < 100; ++n) {
+		std::vector< unsigned char > a = random_bytes(n);
+		std::vector< unsigned char > b = a;
+		for (std::size_t i = 0; i < is.size(); ++i)
+			BOOST_CHECK(is[i].equal(&a[0], &b[0], n));
+		// change each position in turn
+		for (std::size_t j = 0; j < n; ++j) {
+			b[j] = 'z';
+			for (std::size_t i = 0; i < is.size(); ++i)
+				BOOST_CHECK(!is[i].equal(&a[0], &b[0], n));
+			b[j] = a[j];
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( hash_test )
+{
+	// XXH64 reference values
+	BOOST_CHECK(simd::hash("", 0) == ((uint64_t(0xef46db37u) << 32)
+			| 0x51d8e999u));
+	// all the input lengths paths give different values
+	std::vector< unsigned char > v = random_bytes(100);
+	for (std::size_t n = 1; n < 100; ++n) {
+		BOOST_CHECK(simd::hash(&v[0], n) != simd::hash(&v[0], n - 1));
+		BOOST_CHECK(simd::hash(&v[0], n) != simd::hash(&v[0], n, 1));
+		BOOST_CHECK(simd::hash(&v[0], n) == simd::hash(&v[0], n));
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
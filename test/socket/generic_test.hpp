@@ -97,7 +97,7 @@
 #endif
 
 
-#if TEST_PF_UNIX // unix sockets are the only that provides pairs
+#ifdef TEST_HAVE_PAIR
 
 BOOST_AUTO_TEST_CASE( pair_test )
 {
@@ -108,7 +108,7 @@ BOOST_AUTO_TEST_CASE( pair_test )
 	delete p.second;
 }
 
-#endif // TEST_PF_UNIX
+#endif // TEST_HAVE_PAIR
 
 BOOST_AUTO_TEST_CASE( constructor_test )
 {
@@ -8,6 +8,8 @@
 #include "common.hpp" // IP, PORT{1,2}, test_address{1,2}
 #include <posixx/socket/inet.hpp> // posixx::socket::inet
 #include <boost/test/unit_test.hpp> // unit testing stuff
+#include <cerrno> // errno, EINVAL
+#include <cstddef> // NULL, std::size_t
 
 namespace inet = posixx::socket::inet;
 
@@ -119,3 +121,63 @@ BOOST_AUTO_TEST_CASE( socket_inet_sockaddr_set_addr_16_16_16_16 )
 	BOOST_CHECK_EQUAL(addr.port(), 0);
 }
 
+
+BOOST_AUTO_TEST_CASE( socket_inet_sockaddr_format )
+{
+	inet::sockaddr addr("255.16.0.1", 65535);
+	char buf[inet::sockaddr::TEXT_SIZE];
+	BOOST_CHECK_EQUAL(addr.format(buf, sizeof(buf)), 16u);
+	BOOST_CHECK_EQUAL(buf, "255.16.0.1:65535");
+	BOOST_CHECK_EQUAL(addr.format_addr(buf, sizeof(buf)), 10u);
+	BOOST_CHECK_EQUAL(buf, "255.16.0.1");
+	addr.set(inet::any, 0);
+	BOOST_CHECK_EQUAL(addr.format(buf, sizeof(buf)), 9u);
+	BOOST_CHECK_EQUAL(buf, "0.0.0.0:0");
+}
+
+BOOST_AUTO_TEST_CASE( socket_inet_sockaddr_format_truncated )
+{
+	inet::sockaddr addr("16.16.16.16", 12345);
+	char buf[8] = "xxxxxxx";
+	BOOST_CHECK_EQUAL(addr.format(buf, sizeof(buf)), 17u);
+	BOOST_CHECK_EQUAL(buf, "16.16.1");
+	BOOST_CHECK_EQUAL(addr.format(buf, 0), 17u);
+	BOOST_CHECK_EQUAL(buf, "16.16.1");
+	BOOST_CHECK_EQUAL(addr.format(NULL, 0), 17u);
+}
+
+BOOST_AUTO_TEST_CASE( socket_inet_sockaddr_parse )
+{
+	inet::sockaddr addr;
+	BOOST_REQUIRE(addr.parse("16.16.16.16:12345"));
+	BOOST_CHECK_EQUAL(addr, inet::sockaddr("16.16.16.16", 12345));
+	BOOST_REQUIRE(addr.parse("255.255.255.255:65535"));
+	BOOST_CHECK_EQUAL(addr.sin_addr.s_addr, inet::broadcast);
+	BOOST_CHECK_EQUAL(addr.port(), 65535);
+	BOOST_REQUIRE(addr.parse_addr("1.2.3.4"));
+	BOOST_CHECK_EQUAL(addr, inet::sockaddr("1.2.3.4", 65535));
+	char buf[inet::sockaddr::TEXT_SIZE];
+	addr.format(buf, sizeof(buf));
+	inet::sockaddr addr2;
+	BOOST_REQUIRE(addr2.parse(buf));
+	BOOST_CHECK_EQUAL(addr, addr2);
+}
+
+BOOST_AUTO_TEST_CASE( socket_inet_sockaddr_parse_invalid )
+{
+	const char* invalid[] = { "", "1.2.3.4", "1.2.3:80", "1.2.3.4:",
+			"1.2.3.256:80", "1.2.3.4:65536", "1.2.3.4:80x",
+			"1.2.3.4 :80", "-1.2.3.4:80", "0x1.2.3.4:80",
+			"1..3.4:80", "99999999999999999999.1.1.1:1" };
+	inet::sockaddr addr("16.16.16.16", 12345);
+	for (std::size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+		errno = 0;
+		BOOST_CHECK_MESSAGE(!addr.parse(invalid[i]), invalid[i]);
+		BOOST_CHECK_EQUAL(errno, EINVAL);
+		BOOST_CHECK_EQUAL(addr, inet::sockaddr("16.16.16.16", 12345));
+	}
+	BOOST_CHECK(!addr.parse_addr("1.2.3.4:80"));
+	BOOST_CHECK(!addr.parse_addr("1.2.3"));
+	BOOST_CHECK_EQUAL(errno, EINVAL);
+	BOOST_CHECK_EQUAL(addr, inet::sockaddr("16.16.16.16", 12345));
+}
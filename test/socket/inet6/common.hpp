@@ -0,0 +1,30 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef TEST_SOCKET_INET6_COMMON_HPP_
+#define TEST_SOCKET_INET6_COMMON_HPP_
+
+#include <posixx/socket/inet6.hpp> // posixx::socket::inet6
+#include <posixx/socket/inet6/print.hpp> // address ostream formatting
+#include <posixx/socket/opt.hpp> // posixx::socket::opt::REUSEADDR
+#include <ostream> // std::ostream
+
+#define IP6 "::1"
+#define PORT1 10011
+#define PORT2 10012
+
+static inline
+void clean_test_address(posixx::socket::inet6::socket& socket,
+		const posixx::socket::inet6::sockaddr& addr)
+{
+	// reuse the socket address (just in case)
+	socket.opt< posixx::socket::opt::REUSEADDR >(true);
+}
+
+static posixx::socket::inet6::sockaddr test_address1(IP6, PORT1);
+static posixx::socket::inet6::sockaddr test_address2(IP6, PORT2);
+
+#endif // TEST_SOCKET_INET6_COMMON_HPP_
@@ -0,0 +1,94 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "common.hpp" // IP6, PORT{1,2}, test_address{1,2}
+#include <posixx/socket/inet/print.hpp> // inet::sockaddr output
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <cerrno> // errno, EINVAL
+#include <cstring> // memcmp, memset
+
+namespace inet = posixx::socket::inet;
+namespace inet6 = posixx::socket::inet6;
+
+BOOST_AUTO_TEST_CASE( socket_inet6_sockaddr_test )
+{
+	BOOST_CHECK_EQUAL(test_address1.sin6_family, AF_INET6);
+	BOOST_CHECK_EQUAL(test_address1.addr(), IP6);
+	BOOST_CHECK_EQUAL(test_address1.port(), PORT1);
+	BOOST_CHECK(!memcmp(&test_address1.sin6_addr, &inet6::loopback,
+			sizeof(in6_addr)));
+	BOOST_CHECK_EQUAL(test_address1.length(), sizeof(sockaddr_in6));
+}
+
+BOOST_AUTO_TEST_CASE( socket_inet6_sockaddr_default )
+{
+	inet6::sockaddr addr;
+	BOOST_CHECK_EQUAL(addr.sin6_family, AF_INET6);
+	BOOST_CHECK_EQUAL(addr.addr(), "::");
+	BOOST_CHECK_EQUAL(addr.port(), 0);
+	BOOST_CHECK_EQUAL(addr, inet6::sockaddr(inet6::any));
+	BOOST_CHECK_EQUAL(addr, inet6::sockaddr("not an address", 0));
+}
+
+BOOST_AUTO_TEST_CASE( socket_inet6_sockaddr_set )
+{
+	inet6::sockaddr addr;
+	addr.set("2001:db8::1", 8080);
+	BOOST_CHECK_EQUAL(addr.addr(), "2001:db8::1");
+	BOOST_CHECK_EQUAL(addr.port(), 8080);
+	addr.port(12345);
+	BOOST_CHECK_EQUAL(addr.port(), 12345);
+	BOOST_CHECK_EQUAL(addr.sin6_port, htons(12345));
+	addr.addr(inet6::loopback);
+	BOOST_CHECK_EQUAL(addr, inet6::sockaddr(IP6, 12345));
+}
+
+BOOST_AUTO_TEST_CASE( socket_inet6_sockaddr_v4_mapped )
+{
+	inet::sockaddr v4("16.16.16.16", 12345);
+	inet6::sockaddr addr(v4);
+	BOOST_CHECK(addr.v4_mapped());
+	BOOST_CHECK_EQUAL(addr.addr(), "::ffff:16.16.16.16");
+	BOOST_CHECK_EQUAL(addr.port(), 12345);
+	BOOST_CHECK_EQUAL(addr.v4(), v4);
+	BOOST_CHECK(!test_address1.v4_mapped());
+}
+
+BOOST_AUTO_TEST_CASE( socket_inet6_sockaddr_format_parse )
+{
+	inet6::sockaddr addr("2001:db8:0:0:1:0:0:1", 65535);
+	char buf[inet6::sockaddr::TEXT_SIZE];
+	BOOST_CHECK_EQUAL(addr.format(buf, sizeof(buf)), 25u);
+	BOOST_CHECK_EQUAL(buf, "[2001:db8::1:0:0:1]:65535");
+	BOOST_CHECK_EQUAL(addr.format_addr(buf, sizeof(buf)), 17u);
+	BOOST_CHECK_EQUAL(buf, "2001:db8::1:0:0:1");
+
+	inet6::sockaddr longest(inet6::any, 65535);
+	memset(longest.sin6_addr.s6_addr, 0xff, sizeof(in6_addr));
+	BOOST_CHECK_EQUAL(longest.format(buf, sizeof(buf)), 47u);
+	BOOST_CHECK_EQUAL(buf,
+			"[ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff]:65535");
+
+	inet6::sockaddr parsed;
+	BOOST_REQUIRE(parsed.parse("[2001:db8::1:0:0:1]:65535"));
+	BOOST_CHECK_EQUAL(parsed, addr);
+	BOOST_REQUIRE(parsed.parse_addr("::1"));
+	BOOST_CHECK_EQUAL(parsed, inet6::sockaddr(IP6, 65535));
+
+	const char* invalid[] = { "", "::1", "[::1]", "[::1]:", "[::1:80",
+			"::1]:80", "[::g]:80", "[::1]:65536", "[1.2.3.4]:80",
+			"[::1]:80 " };
+	for (std::size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+		errno = 0;
+		BOOST_CHECK_MESSAGE(!parsed.parse(invalid[i]), invalid[i]);
+		BOOST_CHECK_EQUAL(errno, EINVAL);
+		BOOST_CHECK_EQUAL(parsed, inet6::sockaddr(IP6, 65535));
+	}
+	BOOST_CHECK(!parsed.parse_addr("[::1]"));
+	BOOST_CHECK_EQUAL(errno, EINVAL);
+}
+
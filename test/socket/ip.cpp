@@ -0,0 +1,132 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/socket/ip.hpp> // posixx::socket::ip
+#include <posixx/socket/ip/print.hpp> // address ostream formatting
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <memory> // std::auto_ptr
+#include <cerrno> // errno, EINVAL
+
+namespace inet = ::posixx::socket::inet;
+namespace inet6 = ::posixx::socket::inet6;
+namespace ip = ::posixx::socket::ip;
+using posixx::socket::STREAM;
+using posixx::socket::DGRAM;
+
+BOOST_AUTO_TEST_SUITE( socket_ip_suite )
+
+BOOST_AUTO_TEST_CASE( sockaddr_test )
+{
+	ip::sockaddr any;
+	BOOST_CHECK_EQUAL(any.family(), AF_INET6);
+	BOOST_CHECK_EQUAL(any.v6(), inet6::sockaddr());
+	BOOST_CHECK_EQUAL(any.length(), sizeof(sockaddr_in6));
+
+	inet::sockaddr v4("16.16.16.16", 12345);
+	ip::sockaddr a4(v4);
+	BOOST_CHECK_EQUAL(a4.family(), AF_INET);
+	BOOST_CHECK_EQUAL(a4.v4(), v4);
+	BOOST_CHECK_EQUAL(a4.port(), 12345);
+	BOOST_CHECK_EQUAL(a4.length(), sizeof(sockaddr_in));
+	BOOST_CHECK_EQUAL(a4.mapped(), inet6::sockaddr(v4));
+
+	// mapped addresses are stored as IPv4
+	ip::sockaddr m = inet6::sockaddr(v4);
+	BOOST_CHECK_EQUAL(m.family(), AF_INET);
+	BOOST_CHECK_EQUAL(m, a4);
+
+	inet6::sockaddr v6("2001:db8::1", 8080);
+	ip::sockaddr a6(v6);
+	BOOST_CHECK_EQUAL(a6.family(), AF_INET6);
+	BOOST_CHECK_EQUAL(a6.v6(), v6);
+	BOOST_CHECK_EQUAL(a6.mapped(), v6);
+	a6.port(80);
+	BOOST_CHECK_EQUAL(a6.v6().port(), 80);
+	BOOST_CHECK(!(a6 == a4));
+}
+
+BOOST_AUTO_TEST_CASE( sockaddr_format_parse_test )
+{
+	char buf[ip::sockaddr::TEXT_SIZE];
+	ip::sockaddr a;
+	BOOST_REQUIRE(a.parse("1.2.3.4:80"));
+	BOOST_CHECK_EQUAL(a, ip::sockaddr(inet::sockaddr("1.2.3.4", 80)));
+	BOOST_CHECK_EQUAL(a.format(buf, sizeof(buf)), 10u);
+	BOOST_CHECK_EQUAL(buf, "1.2.3.4:80");
+	BOOST_REQUIRE(a.parse("[::ffff:1.2.3.4]:81"));
+	BOOST_CHECK_EQUAL(a, ip::sockaddr(inet::sockaddr("1.2.3.4", 81)));
+	BOOST_REQUIRE(a.parse("[::1]:82"));
+	BOOST_CHECK_EQUAL(a.family(), AF_INET6);
+	BOOST_CHECK_EQUAL(a.format(buf, sizeof(buf)), 8u);
+	BOOST_CHECK_EQUAL(buf, "[::1]:82");
+	errno = 0;
+	BOOST_CHECK(!a.parse("::1:82"));
+	BOOST_CHECK_EQUAL(errno, EINVAL);
+	BOOST_CHECK(!a.parse("[1.2.3.4]:80"));
+	BOOST_CHECK_EQUAL(a, ip::sockaddr(inet6::sockaddr("::1", 82)));
+}
+
+BOOST_AUTO_TEST_CASE( dual_stack_accept_test )
+{
+	std::auto_ptr< inet6::socket > l(ip::dual_stack(
+			inet6::sockaddr(inet6::any, 10021)));
+	BOOST_CHECK_EQUAL(l->opt< inet6::opt::V6ONLY >(), 0);
+
+	inet::socket c4(STREAM);
+	c4.connect(inet::sockaddr("127.0.0.1", 10021));
+	ip::sockaddr p4;
+	std::auto_ptr< inet6::socket > s4(ip::accept(*l, p4));
+	BOOST_CHECK_EQUAL(p4.family(), AF_INET);
+	BOOST_CHECK_EQUAL(p4.v4(), c4.name());
+
+	inet6::socket c6(STREAM);
+	c6.connect(inet6::sockaddr(inet6::loopback, 10021));
+	ip::sockaddr p6;
+	std::auto_ptr< inet6::socket > s6(ip::accept(*l, p6));
+	BOOST_CHECK_EQUAL(p6.family(), AF_INET6);
+	BOOST_CHECK_EQUAL(p6.v6(), c6.name());
+
+	char c = 0;
+	s4->send("4", 1);
+	BOOST_CHECK_EQUAL(c4.recv(&c, 1), 1);
+	BOOST_CHECK_EQUAL(c, '4');
+	s6->send("6", 1);
+	BOOST_CHECK_EQUAL(c6.recv(&c, 1), 1);
+	BOOST_CHECK_EQUAL(c, '6');
+}
+
+BOOST_AUTO_TEST_CASE( dual_stack_dgram_test )
+{
+	std::auto_ptr< inet6::socket > s(ip::dual_stack(
+			inet6::sockaddr(inet6::any, 10022), DGRAM));
+
+	inet::socket c4(DGRAM);
+	c4.bind(inet::sockaddr("127.0.0.1", 10023));
+	c4.send("4", 1, inet::sockaddr("127.0.0.1", 10022));
+	inet6::socket c6(DGRAM);
+	c6.bind(inet6::sockaddr(inet6::loopback, 10024));
+	c6.send("6", 1, inet6::sockaddr(inet6::loopback, 10022));
+
+	char c = 0;
+	ip::sockaddr from;
+	BOOST_CHECK_EQUAL(ip::recv(*s, &c, 1, from), 1);
+	BOOST_CHECK_EQUAL(c, '4');
+	BOOST_CHECK_EQUAL(from, ip::sockaddr(c4.name()));
+	BOOST_CHECK_EQUAL(ip::send(*s, "a", 1, from), 1);
+	BOOST_CHECK_EQUAL(c4.recv(&c, 1), 1);
+	BOOST_CHECK_EQUAL(c, 'a');
+
+	BOOST_CHECK_EQUAL(ip::recv(*s, &c, 1, from), 1);
+	BOOST_CHECK_EQUAL(c, '6');
+	BOOST_CHECK_EQUAL(from, ip::sockaddr(c6.name()));
+	BOOST_CHECK_EQUAL(ip::send(*s, "b", 1, from), 1);
+	BOOST_CHECK_EQUAL(c6.recv(&c, 1), 1);
+	BOOST_CHECK_EQUAL(c, 'b');
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -0,0 +1,53 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/socket/latency.hpp> // posixx::socket::latency_stats
+#include <posixx/socket/unix.hpp> // posixx::socket::unix
+#include <boost/test/unit_test.hpp> // unit testing stuff
+
+namespace sock = posixx::socket;
+
+namespace {
+
+typedef sock::latency_stats< sock::unix::traits,
+		sock::atomic_stats< sock::unix::traits > > latency_policy;
+
+typedef sock::basic_socket< sock::stats_traits< sock::unix::traits,
+		latency_policy > > latency_socket;
+
+}
+
+BOOST_AUTO_TEST_SUITE( socket_latency_suite )
+
+BOOST_AUTO_TEST_CASE( send_recv_test )
+{
+	latency_policy::reset_latency();
+	std::pair< latency_socket*, latency_socket* > p =
+			sock::pair< latency_socket >(sock::DGRAM);
+	char buf[] = "hello world!";
+	for (int i = 0; i < 10; ++i) {
+		p.first->send(buf, sizeof(buf));
+		p.second->recv(buf, sizeof(buf));
+	}
+	posixx::histogram s = latency_policy::latency_snapshot(sock::SEND);
+	posixx::histogram r = latency_policy::latency_snapshot(sock::RECV);
+	BOOST_CHECK_EQUAL( s.count(), 10 );
+	BOOST_CHECK_EQUAL( r.count(), 10 );
+	BOOST_CHECK_GT( s.percentile(50), 0 );
+	BOOST_CHECK_LE( s.percentile(50), s.percentile(99) );
+	BOOST_CHECK_EQUAL( latency_policy::latency(sock::ACCEPT).count(), 0 );
+	// the stacked policy is updated too
+	BOOST_CHECK_EQUAL( p.first->io_stats().counters().calls[sock::SEND],
+			10 );
+	BOOST_CHECK_EQUAL( p.second->io_stats().counters().bytes_received,
+			10 * sizeof(buf) );
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
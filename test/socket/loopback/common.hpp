@@ -0,0 +1,22 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef TEST_SOCKET_LOOPBACK_COMMON_HPP_
+#define TEST_SOCKET_LOOPBACK_COMMON_HPP_
+
+#include <posixx/socket/loopback.hpp> // posixx::socket::loopback
+#include <posixx/socket/loopback/print.hpp> // address ostream formatting
+
+#define PORT1 10001
+#define PORT2 10002
+
+// ports are released when the sockets are closed
+#define clean_test_address(socket, addr)
+
+static posixx::socket::loopback::sockaddr test_address1(PORT1);
+static posixx::socket::loopback::sockaddr test_address2(PORT2);
+
+#endif // TEST_SOCKET_LOOPBACK_COMMON_HPP_
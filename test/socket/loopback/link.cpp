@@ -0,0 +1,161 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include "common.hpp" // address output formatting
+#include <posixx/socket/loopback.hpp> // posixx::socket::loopback
+#include <posixx/socket/opt.hpp> // posixx::socket::opt::RCVTIMEO
+#include <posixx/tsc.hpp> // posixx::tsc
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <string> // std::string
+#include <cerrno> // EAGAIN, EPIPE, ECONNREFUSED
+#include <sys/time.h> // timeval
+
+using namespace ::posixx::socket;
+namespace tsc = ::posixx::tsc;
+
+namespace {
+
+// Check that the expression throws a posixx::error with errno E
+#define CHECK_ERRNO(expr, E) \
+	try { \
+		expr; \
+		BOOST_ERROR("no exception thrown"); \
+	} \
+	catch (const posixx::error& e) { \
+		BOOST_CHECK_EQUAL(e.no, E); \
+	}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( socket_loopback_link_suite )
+
+BOOST_AUTO_TEST_CASE( stream_test )
+{
+	loopback::pair_type p = loopback::pair(STREAM);
+	p.first->send("hello ", 6);
+	p.first->send("world", 5);
+	char buf[8];
+	// the stream boundaries are not kept
+	BOOST_CHECK_EQUAL(p.second->recv(buf, 8), 6);
+	BOOST_CHECK_EQUAL(p.second->recv(buf + 6, 2), 2);
+	BOOST_CHECK_EQUAL(std::string(buf, 8), "hello wo");
+	BOOST_CHECK_EQUAL(p.second->recv(buf, 8), 3);
+	BOOST_CHECK_EQUAL(std::string(buf, 3), "rld");
+	CHECK_ERRNO(p.second->recv(buf, 8, MSG_DONTWAIT), EAGAIN);
+	p.first->shutdown(WR);
+	CHECK_ERRNO(p.second->recv(buf, 8), 0);
+	CHECK_ERRNO(p.first->send("x", 1), EPIPE);
+	delete p.first;
+	CHECK_ERRNO(p.second->send("x", 1), EPIPE);
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( seqpacket_test )
+{
+	loopback::pair_type p = loopback::pair(SEQPACKET);
+	p.first->send("hello", 5);
+	p.first->send("world", 5);
+	char buf[3];
+	// messages are truncated
+	BOOST_CHECK_EQUAL(p.second->recv(buf, 3), 3);
+	BOOST_CHECK_EQUAL(std::string(buf, 3), "hel");
+	BOOST_CHECK_EQUAL(p.second->recv(buf, 3), 3);
+	BOOST_CHECK_EQUAL(std::string(buf, 3), "wor");
+	delete p.first;
+	CHECK_ERRNO(p.second->recv(buf, 3), 0);
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( full_test )
+{
+	loopback::pair_type p = loopback::pair(SEQPACKET);
+	loopback::config c;
+	c.rcvbuf = 10;
+	p.second->conf(c);
+	p.first->send("12345678", 8, MSG_DONTWAIT);
+	CHECK_ERRNO(p.first->send("12345678", 8, MSG_DONTWAIT), EAGAIN);
+	char buf[8];
+	p.second->recv(buf, 8);
+	p.first->send("12345678", 8, MSG_DONTWAIT);
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( latency_test )
+{
+	loopback::config c;
+	c.latency = 20000000; // 20ms
+	loopback::pair_type p = loopback::pair(DGRAM);
+	p.first->conf(c);
+	BOOST_CHECK_EQUAL(p.first->conf().latency, c.latency);
+	uint64_t start = tsc::monotonic();
+	p.first->send("a", 1);
+	p.first->send("b", 1);
+	char buf[1];
+	CHECK_ERRNO(p.second->recv(buf, 1, MSG_DONTWAIT), EAGAIN);
+	BOOST_CHECK_EQUAL(p.second->recv(buf, 1), 1);
+	BOOST_CHECK_EQUAL(buf[0], 'a');
+	BOOST_CHECK_GE(tsc::monotonic() - start, c.latency);
+	BOOST_CHECK_EQUAL(p.second->recv(buf, 1), 1);
+	BOOST_CHECK_EQUAL(buf[0], 'b');
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( loss_test )
+{
+	loopback::config c;
+	c.loss = 0.5;
+	loopback::socket a(DGRAM);
+	loopback::socket b(DGRAM);
+	a.conf(c);
+	b.bind(loopback::sockaddr());
+	for (int i = 0; i < 1000; ++i)
+		a.send(&i, sizeof(i), b.name());
+	int received = 0;
+	try {
+		for (;;) {
+			int x;
+			b.recv(&x, sizeof(x), MSG_DONTWAIT);
+			++received;
+		}
+	}
+	catch (const posixx::error& e) {
+		BOOST_CHECK_EQUAL(e.no, EAGAIN);
+	}
+	BOOST_CHECK_GT(received, 350);
+	BOOST_CHECK_LT(received, 650);
+	CHECK_ERRNO(a.send("x", 1, loopback::sockaddr(1)), ECONNREFUSED);
+}
+
+BOOST_AUTO_TEST_CASE( timeout_test )
+{
+	loopback::pair_type p = loopback::pair(DGRAM);
+	timeval tv = { 0, 10000 }; // 10ms
+	p.second->opt< opt::RCVTIMEO >(tv);
+	uint64_t start = tsc::monotonic();
+	char buf[1];
+	CHECK_ERRNO(p.second->recv(buf, 1), EAGAIN);
+	BOOST_CHECK_GE(tsc::monotonic() - start, 10000000u);
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( default_conf_test )
+{
+	loopback::config c;
+	c.rcvbuf = 100;
+	loopback::config old = loopback::default_conf();
+	loopback::default_conf(c);
+	loopback::socket s(DGRAM);
+	loopback::default_conf(old);
+	BOOST_CHECK_EQUAL(s.conf().rcvbuf, 100u);
+	BOOST_CHECK_EQUAL(loopback::socket(DGRAM).conf().rcvbuf, old.rcvbuf);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
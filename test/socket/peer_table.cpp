@@ -0,0 +1,186 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/socket/peer_table.hpp> // posixx::socket::peer_table
+#include <posixx/socket/inet.hpp> // posixx::socket::inet
+#include <posixx/socket/inet6.hpp> // posixx::socket::inet6
+#include <posixx/socket/unix.hpp> // posixx::socket::unix
+#include <posixx/linux/tipc.hpp> // posixx::linux::tipc
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <string> // std::string
+#include <set> // std::set
+#include <stdint.h> // uint32_t, uint64_t
+
+namespace inet = ::posixx::socket::inet;
+namespace inet6 = ::posixx::socket::inet6;
+namespace unix = ::posixx::socket::unix;
+namespace tipc = ::posixx::linux::tipc;
+using posixx::socket::peer_table;
+
+namespace {
+
+inet::sockaddr peer(uint32_t i)
+{
+	return inet::sockaddr(htonl(0x0a000000 | i >> 8), 1000 + (i & 0xff));
+}
+
+struct odd
+{
+	bool operator () (const inet::sockaddr& a, unsigned& v) const
+	{
+		return v % 2;
+	}
+};
+
+struct sum
+{
+	uint64_t* total;
+	void operator () (const inet::sockaddr& a, unsigned& v) const
+	{
+		*total += v;
+	}
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( socket_peer_table_suite )
+
+BOOST_AUTO_TEST_CASE( hash_test )
+{
+	// equal addresses have equal hashes, different ones (almost always)
+	// different
+	BOOST_CHECK_EQUAL( peer(1).hash(), peer(1).hash() );
+	BOOST_CHECK_NE( peer(1).hash(), peer(2).hash() );
+	BOOST_CHECK_NE( peer(1).hash(), peer(257).hash() );
+	BOOST_CHECK_EQUAL( inet6::sockaddr("::1", 80).hash(),
+			inet6::sockaddr(inet6::loopback, 80).hash() );
+	BOOST_CHECK_NE( inet6::sockaddr("::1", 80).hash(),
+			inet6::sockaddr("::2", 80).hash() );
+	BOOST_CHECK_EQUAL( unix::sockaddr("/tmp/a").hash(),
+			unix::sockaddr("/tmp/a").hash() );
+	BOOST_CHECK_NE( unix::sockaddr("/tmp/a").hash(),
+			unix::sockaddr("/tmp/b").hash() );
+	tipc::sockaddr id(tipc::portid(1, tipc::addr(1, 1, 1)));
+	tipc::sockaddr name(tipc::name(1000, 1));
+	tipc::sockaddr seq(tipc::nameseq(1000, 1, 1));
+	tipc::sockaddr id2(tipc::portid(1, tipc::addr(1, 1, 1)));
+	BOOST_CHECK_EQUAL( id.hash(), id2.hash() );
+	BOOST_CHECK_NE( id.hash(), name.hash() );
+	BOOST_CHECK_NE( name.hash(), seq.hash() );
+	tipc::sockaddr name2(tipc::name(1000, 2));
+	BOOST_CHECK_NE( name.hash(), name2.hash() );
+}
+
+BOOST_AUTO_TEST_CASE( insert_find_erase_test )
+{
+	peer_table< inet::sockaddr, unsigned > t;
+	BOOST_CHECK( t.empty() );
+	BOOST_CHECK_EQUAL( t.capacity(), 16u );
+	BOOST_CHECK( !t.find(peer(1)) );
+	BOOST_CHECK( !t.erase(peer(1)) );
+
+	const unsigned n = 100000;
+	for (unsigned i = 0; i < n; ++i) {
+		std::pair< unsigned*, bool > r = t.insert(peer(i), i);
+		BOOST_REQUIRE( r.second );
+		BOOST_REQUIRE_EQUAL( *r.first, i );
+	}
+	BOOST_CHECK_EQUAL( t.size(), n );
+	BOOST_CHECK_LE( t.size(), t.capacity() / 8 * 7 );
+	std::pair< unsigned*, bool > r = t.insert(peer(5), 0);
+	BOOST_CHECK( !r.second );
+	BOOST_CHECK_EQUAL( *r.first, 5u );
+
+	for (unsigned i = 0; i < n; ++i) {
+		unsigned* v = t.find(peer(i));
+		BOOST_REQUIRE( v );
+		BOOST_REQUIRE_EQUAL( *v, i );
+	}
+	BOOST_CHECK( !t.find(peer(n)) );
+
+	for (unsigned i = 0; i < n; i += 2)
+		BOOST_REQUIRE( t.erase(peer(i)) );
+	BOOST_CHECK_EQUAL( t.size(), n / 2 );
+	for (unsigned i = 0; i < n; ++i)
+		BOOST_REQUIRE_EQUAL( t.find(peer(i)) != NULL, i % 2 == 1 );
+
+	t[peer(0)] = 42;
+	BOOST_CHECK_EQUAL( *t.find(peer(0)), 42u );
+	t[peer(0)]++;
+	BOOST_CHECK_EQUAL( *t.find(peer(0)), 43u );
+
+	t.clear();
+	BOOST_CHECK( t.empty() );
+	BOOST_CHECK( !t.find(peer(1)) );
+}
+
+BOOST_AUTO_TEST_CASE( churn_test )
+{
+	// inserting and erasing fills the table with deleted slots, which
+	// must be reclaimed without growing the table
+	peer_table< inet::sockaddr, unsigned > t(1000);
+	std::size_t cap = t.capacity();
+	for (unsigned i = 0; i < 100000; ++i) {
+		t.insert(peer(i), i);
+		if (i >= 500)
+			BOOST_REQUIRE( t.erase(peer(i - 500)) );
+	}
+	BOOST_CHECK_EQUAL( t.size(), 500u );
+	BOOST_CHECK_EQUAL( t.capacity(), cap );
+	for (unsigned i = 100000 - 500; i < 100000; ++i)
+		BOOST_REQUIRE( t.find(peer(i)) );
+}
+
+BOOST_AUTO_TEST_CASE( erase_if_for_each_test )
+{
+	peer_table< inet::sockaddr, unsigned > t;
+	for (unsigned i = 0; i < 1000; ++i)
+		t[peer(i)] = i;
+	BOOST_CHECK_EQUAL( t.erase_if(odd()), 500u );
+	BOOST_CHECK_EQUAL( t.size(), 500u );
+	uint64_t total = 0;
+	sum s = { &total };
+	t.for_each(s);
+	BOOST_CHECK_EQUAL( total, 499u * 500u );
+	t.prefetch(peer(2));
+	BOOST_CHECK_EQUAL( *t.find(peer(2)), 2u );
+}
+
+BOOST_AUTO_TEST_CASE( non_pod_test )
+{
+	peer_table< unix::sockaddr, std::string > t;
+	t.reserve(100);
+	std::size_t cap = t.capacity();
+	BOOST_CHECK_GE( cap / 8 * 7, 100u );
+	for (unsigned i = 0; i < 1000; ++i) {
+		std::string path = "/tmp/peer" + std::string(i % 26 + 1,
+				'a' + i / 26);
+		t[unix::sockaddr(path)] = path;
+	}
+	BOOST_CHECK_EQUAL( t.size(), 1000u );
+	BOOST_CHECK_GT( t.capacity(), cap );
+	std::string* v = t.find(unix::sockaddr("/tmp/peeraa"));
+	BOOST_REQUIRE( v );
+	BOOST_CHECK_EQUAL( *v, "/tmp/peeraa" );
+	BOOST_CHECK( t.erase(unix::sockaddr("/tmp/peeraa")) );
+	BOOST_CHECK( !t.find(unix::sockaddr("/tmp/peeraa")) );
+}
+
+BOOST_AUTO_TEST_CASE( tipc_test )
+{
+	peer_table< tipc::sockaddr, int > t;
+	for (unsigned i = 0; i < 1000; ++i)
+		t[tipc::sockaddr(tipc::portid(i, tipc::addr(1, 1, i % 7)))] = i;
+	BOOST_CHECK_EQUAL( t.size(), 1000u );
+	BOOST_CHECK_EQUAL( *t.find(tipc::sockaddr(tipc::portid(500,
+			tipc::addr(1, 1, 500 % 7)))), 500 );
+	BOOST_CHECK( !t.find(tipc::sockaddr(tipc::portid(500,
+			tipc::addr(1, 1, 501 % 7)))) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
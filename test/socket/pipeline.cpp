@@ -0,0 +1,227 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/socket/pipeline.hpp> // posixx::socket::pipeline
+#include <posixx/socket/unix.hpp> // posixx::socket::unix
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <string> // std::string
+#include <vector> // std::vector
+#include <algorithm> // std::max
+#include <cstring> // std::memcpy
+#include <cerrno> // EPIPE, EMSGSIZE
+#include <sys/socket.h> // MSG_WAITALL
+#include <arpa/inet.h> // htonl, ntohl
+
+namespace unix = ::posixx::socket::unix;
+using posixx::socket::pipeline;
+
+namespace {
+
+typedef pipeline< unix::traits > unix_pipeline;
+typedef unix_pipeline::header header;
+
+struct frame
+{
+	uint32_t id;
+	std::string data;
+};
+
+// Read a request frame on the server side
+frame read_frame(unix::socket& s, bool stream)
+{
+	char buf[1024];
+	frame f;
+	if (stream) {
+		header h;
+		s.recv(&h, sizeof(h), MSG_WAITALL);
+		f.id = ntohl(h.id);
+		std::size_t n = ntohl(h.size);
+		if (n)
+			s.recv(buf, n, MSG_WAITALL);
+		f.data.assign(buf, n);
+	}
+	else {
+		ssize_t n = s.recv(buf, sizeof(buf));
+		header h;
+		std::memcpy(&h, buf, sizeof(h));
+		f.id = ntohl(h.id);
+		BOOST_CHECK_EQUAL(std::size_t(n), sizeof(h) + ntohl(h.size));
+		f.data.assign(buf + sizeof(h), n - sizeof(h));
+	}
+	return f;
+}
+
+// Send a response frame from the server side
+void write_frame(unix::socket& s, uint32_t id, const std::string& data)
+{
+	std::string buf(sizeof(header), '\0');
+	header h;
+	h.id = htonl(id);
+	h.size = htonl(data.size());
+	std::memcpy(&buf[0], &h, sizeof(h));
+	buf += data;
+	s.send(buf.data(), buf.size());
+}
+
+// Counts the calls to completed()
+struct counted: unix_pipeline::request
+{
+	int calls;
+	counted(): calls(0) {}
+	void completed(const char* data, std::size_t n)
+	{
+		++calls;
+		unix_pipeline::request::completed(data, n);
+	}
+};
+
+std::string str(const posixx::buffer& b)
+{
+	return std::string(reinterpret_cast< const char* >(b.c_array()),
+			b.size());
+}
+
+void out_of_order(posixx::socket::type type)
+{
+	unix::pair_type p = unix::pair(type);
+	bool stream = type == posixx::socket::STREAM;
+	unix_pipeline c(*p.first, 4);
+	BOOST_CHECK_EQUAL(c.window(), 4u);
+	const int N = 10;
+	std::string req[N];
+	counted r[N];
+	for (int i = 0; i < N; ++i) {
+		req[i] = std::string(i, 'a' + i);
+		c.submit(r[i], req[i].data(), req[i].size());
+	}
+	BOOST_CHECK_EQUAL(c.queued(), std::size_t(N));
+	BOOST_CHECK_EQUAL(c.flush(), 4u);
+	BOOST_CHECK_EQUAL(c.inflight(), 4u);
+	BOOST_CHECK_EQUAL(c.queued(), std::size_t(N - 4));
+	BOOST_CHECK_EQUAL(r[3].state(), unix_pipeline::request::SENT);
+	BOOST_CHECK_EQUAL(r[4].state(), unix_pipeline::request::QUEUED);
+	int answered = 0;
+	while (answered < N) {
+		// answer the whole window in reverse order
+		std::vector< frame > f;
+		for (std::size_t i = 0; i < c.inflight(); ++i)
+			f.push_back(read_frame(*p.second, stream));
+		for (std::size_t i = f.size(); i; --i)
+			write_frame(*p.second, f[i - 1].id,
+					"re:" + f[i - 1].data);
+		answered += f.size();
+		std::size_t completed = 0;
+		while (completed < f.size())
+			completed += c.poll();
+	}
+	for (int i = 0; i < N; ++i) {
+		BOOST_CHECK(r[i].done());
+		BOOST_CHECK_EQUAL(r[i].calls, 1);
+		BOOST_CHECK_EQUAL(str(r[i].response()), "re:" + req[i]);
+	}
+	BOOST_CHECK_EQUAL(c.inflight(), 0u);
+	BOOST_CHECK_EQUAL(c.queued(), 0u);
+	// requests can be reused
+	c.submit(r[0], "x", 1);
+	c.flush();
+	frame f = read_frame(*p.second, stream);
+	write_frame(*p.second, f.id, "y");
+	c.wait(r[0]);
+	BOOST_CHECK_EQUAL(str(r[0].response()), "y");
+	delete p.first;
+	delete p.second;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( socket_pipeline_suite )
+
+BOOST_AUTO_TEST_CASE( stream )
+{
+	out_of_order(posixx::socket::STREAM);
+}
+
+BOOST_AUTO_TEST_CASE( seqpacket )
+{
+	out_of_order(posixx::socket::SEQPACKET);
+}
+
+BOOST_AUTO_TEST_CASE( failure )
+{
+	unix::pair_type p = unix::pair(posixx::socket::STREAM);
+	unix_pipeline c(*p.first, 2);
+	counted r[3];
+	for (int i = 0; i < 3; ++i)
+		c.submit(r[i], "req", 3);
+	c.flush();
+	frame f = read_frame(*p.second, true);
+	write_frame(*p.second, f.id + 1, "stale"); // unknown ID, ignored
+	write_frame(*p.second, f.id, "ok");
+	delete p.second;
+	BOOST_CHECK_THROW(c.wait(r[2]), posixx::error);
+	BOOST_CHECK_EQUAL(r[0].state(), unix_pipeline::request::DONE);
+	BOOST_CHECK_EQUAL(str(r[0].response()), "ok");
+	for (int i = 1; i < 3; ++i) {
+		BOOST_CHECK_EQUAL(r[i].state(),
+				unix_pipeline::request::FAILED);
+		// r[2] is sent when r[0] completes, to a closed peer
+		BOOST_CHECK_EQUAL(r[i].error_no(), EPIPE);
+		BOOST_CHECK_EQUAL(r[i].calls, 1);
+	}
+	BOOST_CHECK_EQUAL(c.inflight(), 0u);
+	BOOST_CHECK_EQUAL(c.queued(), 0u);
+	delete p.first;
+}
+
+BOOST_AUTO_TEST_CASE( malformed_message )
+{
+	// message size and the payload size in its header: too short for a
+	// header, shorter and longer than the header says, and bigger than
+	// max_response (truncated)
+	const std::size_t sizes[][2] = {
+		{ 3, 0 },
+		{ sizeof(header) + 2, 4 },
+		{ sizeof(header) + 6, 4 },
+		{ sizeof(header) + 100, 100 },
+	};
+	for (std::size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		unix::pair_type p = unix::pair(posixx::socket::SEQPACKET);
+		unix_pipeline c(*p.first, 2, 16);
+		counted r[2];
+		c.submit(r[0], "req", 3);
+		c.submit(r[1], "req", 3);
+		c.flush();
+		frame f = read_frame(*p.second, false);
+		read_frame(*p.second, false);
+		std::string buf(std::max(sizes[i][0], sizeof(header)), 'x');
+		header h;
+		h.id = htonl(f.id);
+		h.size = htonl(sizes[i][1]);
+		std::memcpy(&buf[0], &h, sizeof(h));
+		p.second->send(buf.data(), sizes[i][0]);
+		// a good response after the bad one is not taken as part of
+		// it
+		write_frame(*p.second, f.id, "ok");
+		try {
+			c.poll();
+			BOOST_ERROR("poll() didn't throw");
+		}
+		catch (const posixx::error& e) {
+			BOOST_CHECK_EQUAL(e.no, EMSGSIZE);
+		}
+		for (int j = 0; j < 2; ++j) {
+			BOOST_CHECK_EQUAL(r[j].state(),
+					unix_pipeline::request::FAILED);
+			BOOST_CHECK_EQUAL(r[j].error_no(), EMSGSIZE);
+		}
+		delete p.first;
+		delete p.second;
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -0,0 +1,211 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/socket/pool.hpp> // posixx::socket::pool
+#include <posixx/socket/inet.hpp> // posixx::socket::inet
+#include <posixx/socket/inet/print.hpp> // address ostream formatting
+#include <posixx/socket/unix.hpp> // posixx::socket::unix
+#include <posixx/tsc.hpp> // posixx::tsc
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <pthread.h> // pthread_create, pthread_join
+#include <stdint.h> // uint64_t
+#include <unistd.h> // usleep, unlink
+
+namespace inet = ::posixx::socket::inet;
+namespace unix = ::posixx::socket::unix;
+namespace tsc = ::posixx::tsc;
+using posixx::socket::pool;
+using posixx::socket::STREAM;
+
+namespace {
+
+typedef pool< inet::traits > inet_pool;
+
+struct server
+{
+	inet::socket sock;
+	inet::sockaddr addr;
+	server(): sock(STREAM)
+	{
+		sock.bind(inet::sockaddr("127.0.0.1", 0));
+		sock.listen(16);
+		addr = sock.name();
+	}
+};
+
+struct evictor_ctx
+{
+	inet_pool* pool;
+	int stop;
+	int runs;
+};
+
+void* evictor(void* arg)
+{
+	evictor_ctx& c = *static_cast< evictor_ctx* >(arg);
+	while (!__atomic_load_n(&c.stop, __ATOMIC_RELAXED)) {
+		c.pool->evict();
+		__atomic_add_fetch(&c.runs, 1, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( socket_pool_suite )
+
+BOOST_AUTO_TEST_CASE( reuse )
+{
+	server srv;
+	inet_pool p;
+	inet_pool::destination& d = p.at(srv.addr);
+	BOOST_CHECK_EQUAL(&p.at(srv.addr), &d);
+	BOOST_CHECK_EQUAL(d.addr, srv.addr);
+	inet::socket* a = p.checkout(d);
+	BOOST_CHECK_EQUAL(d.open(), 1u);
+	BOOST_CHECK_EQUAL(d.idle(), 0u);
+	p.checkin(d, a);
+	BOOST_CHECK_EQUAL(d.idle(), 1u);
+	inet::socket* b = p.checkout(srv.addr);
+	BOOST_CHECK_EQUAL(a, b);
+	BOOST_CHECK_EQUAL(p.connects(), 1u);
+	p.checkin(d, b, false);
+	BOOST_CHECK_EQUAL(d.open(), 0u);
+	BOOST_CHECK_EQUAL(d.idle(), 0u);
+	{
+		inet_pool::lease c(p, d);
+		BOOST_CHECK_EQUAL(c->peer_name(), srv.addr);
+	}
+	BOOST_CHECK_EQUAL(p.connects(), 2u);
+	BOOST_CHECK_EQUAL(d.idle(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE( limit )
+{
+	server srv;
+	inet_pool::config c;
+	c.max_per_destination = 2;
+	c.wait = 10000000;
+	inet_pool p(c);
+	inet_pool::destination& d = p.at(srv.addr);
+	inet::socket* a = p.checkout(d);
+	inet::socket* b = p.checkout(d);
+	try {
+		p.checkout(d);
+		BOOST_ERROR("checkout over the limit didn't fail");
+	}
+	catch (const posixx::error& e) {
+		BOOST_CHECK_EQUAL(e.no, EAGAIN);
+	}
+	p.checkin(d, a);
+	BOOST_CHECK_EQUAL(p.checkout(d), a);
+	p.checkin(d, a);
+	p.checkin(d, b);
+	BOOST_CHECK_EQUAL(p.connects(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE( health )
+{
+	server srv;
+	inet_pool p;
+	inet_pool::destination& d = p.at(srv.addr);
+	inet::socket* a = p.checkout(d);
+	p.checkin(d, a);
+	// the server closes the connection
+	delete srv.sock.accept();
+	::usleep(10000);
+	inet::socket* b = p.checkout(d);
+	BOOST_CHECK_EQUAL(p.connects(), 2u);
+	BOOST_CHECK_EQUAL(d.open(), 1u);
+	p.checkin(d, b);
+	// unexpected data pending
+	inet::socket* s = srv.sock.accept();
+	s->send("x", 1);
+	::usleep(10000);
+	b = p.checkout(d);
+	BOOST_CHECK_EQUAL(p.connects(), 3u);
+	p.checkin(d, b);
+	delete s;
+}
+
+BOOST_AUTO_TEST_CASE( evict )
+{
+	server srv;
+	inet_pool::config c;
+	c.max_idle = 1000000;
+	inet_pool p(c);
+	inet_pool::destination& d = p.at(srv.addr);
+	inet::socket* a = p.checkout(d);
+	inet::socket* b = p.checkout(d);
+	p.checkin(d, a);
+	::usleep(5000);
+	p.checkin(d, b);
+	BOOST_CHECK_EQUAL(p.evict(), 1u);
+	BOOST_CHECK_EQUAL(d.open(), 1u);
+	BOOST_CHECK_EQUAL(d.idle(), 1u);
+	::usleep(5000);
+	// too old to be reused
+	b = p.checkout(d);
+	BOOST_CHECK_EQUAL(p.connects(), 3u);
+	p.checkin(d, b);
+}
+
+BOOST_AUTO_TEST_CASE( evict_race )
+{
+	server srv;
+	inet_pool::config c;
+	c.max_per_destination = 1;
+	c.wait = 1000000000;
+	inet_pool p(c);
+	inet_pool::destination& d = p.at(srv.addr);
+	p.checkin(d, p.checkout(d));
+	// evict() takes the only (fresh) connection out of the queue and
+	// puts it back all the time, a checkout that finds the queue empty
+	// then must be woken up instead of waiting until it times out
+	evictor_ctx ctx = { &p, 0, 0 };
+	pthread_t t;
+	BOOST_REQUIRE_EQUAL(pthread_create(&t, NULL, &evictor, &ctx), 0);
+	while (!__atomic_load_n(&ctx.runs, __ATOMIC_RELAXED))
+		::usleep(100);
+	int failed = 0;
+	uint64_t end = tsc::monotonic() + 300000000;
+	while (tsc::monotonic() < end) {
+		try {
+			p.checkin(d, p.checkout(d));
+		}
+		catch (const posixx::error&) {
+			++failed;
+			break;
+		}
+	}
+	__atomic_store_n(&ctx.stop, 1, __ATOMIC_RELAXED);
+	pthread_join(t, NULL);
+	BOOST_CHECK_EQUAL(failed, 0);
+	BOOST_CHECK_EQUAL(p.connects(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE( unix_pool )
+{
+	unix::sockaddr addr("/tmp/posixx-test-pool");
+	::unlink(addr.path().c_str());
+	unix::socket srv(STREAM);
+	srv.bind(addr);
+	srv.listen();
+	pool< unix::traits > p;
+	{
+		pool< unix::traits >::lease c(p, p.at(addr));
+		BOOST_CHECK_EQUAL(c->peer_name().path(), addr.path());
+	}
+	{
+		pool< unix::traits >::lease c(p, p.at(addr));
+	}
+	BOOST_CHECK_EQUAL(p.connects(), 1u);
+	::unlink(addr.path().c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -0,0 +1,144 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/socket/stats.hpp> // posixx::socket::stats_traits
+#include <posixx/socket/unix.hpp> // posixx::socket::unix
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <cerrno> // EAGAIN
+#include <cstring> // std::memset, std::strlen
+#include <string> // std::string
+#include <sys/uio.h> // iovec
+
+namespace sock = posixx::socket;
+
+namespace {
+
+typedef sock::basic_socket< sock::stats_traits< sock::unix::traits > >
+		stats_socket;
+
+typedef std::pair< stats_socket*, stats_socket* > pair_type;
+
+}
+
+BOOST_AUTO_TEST_SUITE( socket_stats_suite )
+
+BOOST_AUTO_TEST_CASE( no_stats_test )
+{
+	BOOST_CHECK_EQUAL( sizeof(sock::unix::socket), sizeof(int) );
+	BOOST_CHECK_GE( sizeof(stats_socket), sizeof(int)
+			+ sizeof(sock::io_counters) );
+}
+
+BOOST_AUTO_TEST_CASE( send_recv_test )
+{
+	stats_socket::stats_type::reset_family_stats();
+	pair_type p = sock::pair< stats_socket >(sock::DGRAM);
+	char buf[] = "hello world!";
+	p.first->send(buf, sizeof(buf));
+	p.first->send(buf, 5);
+	BOOST_CHECK_EQUAL( p.second->recv(buf, sizeof(buf)), sizeof(buf) );
+	sock::io_counters c1 = p.first->io_stats().counters();
+	BOOST_CHECK_EQUAL( c1.calls[sock::SEND], 2 );
+	BOOST_CHECK_EQUAL( c1.calls[sock::RECV], 0 );
+	BOOST_CHECK_EQUAL( c1.bytes_sent, sizeof(buf) + 5 );
+	BOOST_CHECK_EQUAL( c1.bytes_received, 0 );
+	sock::io_counters c2 = p.second->io_stats().counters();
+	BOOST_CHECK_EQUAL( c2.calls[sock::SEND], 0 );
+	BOOST_CHECK_EQUAL( c2.calls[sock::RECV], 1 );
+	BOOST_CHECK_EQUAL( c2.bytes_received, sizeof(buf) );
+	BOOST_CHECK_EQUAL( c2.errors, 0 );
+	sock::io_counters f = stats_socket::stats_type::family_stats();
+	BOOST_CHECK_EQUAL( f.calls[sock::SEND], 2 );
+	BOOST_CHECK_EQUAL( f.calls[sock::RECV], 1 );
+	BOOST_CHECK_EQUAL( f.bytes_sent, sizeof(buf) + 5 );
+	BOOST_CHECK_EQUAL( f.bytes_received, sizeof(buf) );
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( msg_test )
+{
+	stats_socket::stats_type::reset_family_stats();
+	pair_type p = sock::pair< stats_socket >(sock::DGRAM);
+	char h[] = "hello ";
+	char w[] = "world!";
+	iovec iov[2] = { { h, 6 }, { w, 6 } };
+	msghdr m;
+	std::memset(&m, 0, sizeof(m));
+	m.msg_iov = iov;
+	m.msg_iovlen = 2;
+	BOOST_CHECK_EQUAL( p.first->send(&m), 12 );
+	// an empty message is not an error
+	m.msg_iovlen = 0;
+	BOOST_CHECK_EQUAL( p.first->send(&m), 0 );
+	char buf[32];
+	iovec in = { buf, sizeof(buf) };
+	m.msg_iov = &in;
+	m.msg_iovlen = 1;
+	BOOST_CHECK_EQUAL( p.second->recv(&m), 12 );
+	BOOST_CHECK_EQUAL( std::string(buf, 12), "hello world!" );
+	BOOST_CHECK_EQUAL( p.second->recv(&m), 0 );
+	sock::io_counters f = stats_socket::stats_type::family_stats();
+	BOOST_CHECK_EQUAL( f.calls[sock::SEND], 2 );
+	BOOST_CHECK_EQUAL( f.calls[sock::RECV], 2 );
+	BOOST_CHECK_EQUAL( f.bytes_sent, 12 );
+	BOOST_CHECK_EQUAL( f.bytes_received, 12 );
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( mmsg_test )
+{
+	stats_socket::stats_type::reset_family_stats();
+	pair_type p = sock::pair< stats_socket >(sock::DGRAM);
+	char bufs[3][8] = { "one", "two", "three" };
+	iovec iov[3];
+	mmsghdr m[3];
+	std::memset(m, 0, sizeof(m));
+	for (int i = 0; i < 3; ++i) {
+		iov[i].iov_base = bufs[i];
+		iov[i].iov_len = std::strlen(bufs[i]);
+		m[i].msg_hdr.msg_iov = &iov[i];
+		m[i].msg_hdr.msg_iovlen = 1;
+	}
+	BOOST_CHECK_EQUAL( p.first->send(m, 3), 3u );
+	std::memset(bufs, 0, sizeof(bufs));
+	for (int i = 0; i < 3; ++i)
+		iov[i].iov_len = sizeof(bufs[i]);
+	BOOST_CHECK_EQUAL( p.second->recv(m, 3, MSG_WAITFORONE), 3u );
+	BOOST_CHECK_EQUAL( m[2].msg_len, 5u );
+	BOOST_CHECK_EQUAL( std::string(bufs[2]), "three" );
+	sock::io_counters f = stats_socket::stats_type::family_stats();
+	BOOST_CHECK_EQUAL( f.calls[sock::SEND], 1 );
+	BOOST_CHECK_EQUAL( f.calls[sock::RECV], 1 );
+	BOOST_CHECK_EQUAL( f.bytes_sent, 11 );
+	BOOST_CHECK_EQUAL( f.bytes_received, 11 );
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_CASE( errors_test )
+{
+	pair_type p = sock::pair< stats_socket >(sock::DGRAM);
+	char buf[5];
+	try {
+		p.second->recv(buf, sizeof(buf), MSG_DONTWAIT);
+	} catch (const posixx::error& e) {
+		BOOST_CHECK_EQUAL( e.no, EAGAIN );
+	}
+	sock::io_counters c = p.second->io_stats().counters();
+	BOOST_CHECK_EQUAL( c.calls[sock::RECV], 1 );
+	BOOST_CHECK_EQUAL( c.again, 1 );
+	BOOST_CHECK_EQUAL( c.intr, 0 );
+	BOOST_CHECK_EQUAL( c.errors, 0 );
+	BOOST_CHECK_EQUAL( c.bytes_received, 0 );
+	delete p.first;
+	delete p.second;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
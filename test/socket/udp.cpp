@@ -0,0 +1,153 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/socket/udp.hpp> // posixx::socket::udp
+#include <posixx/socket/cmsg.hpp> // posixx::socket::cmsg
+#include <posixx/socket/inet.hpp> // posixx::socket::inet
+#include <posixx/socket/inet/print.hpp> // address ostream formatting
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <vector> // std::vector
+#include <cstring> // memset
+#include <stdint.h> // uint16_t, uint64_t
+#include <sys/socket.h> // msghdr, SO_TIMESTAMPNS
+#include <netinet/in.h> // IP_PKTINFO, IP_RECVTTL, IP_RECVTOS
+
+namespace inet = ::posixx::socket::inet;
+namespace udp = ::posixx::socket::udp;
+namespace cmsg = ::posixx::socket::cmsg;
+using posixx::socket::DGRAM;
+
+namespace {
+
+// Receive n bytes sent as datagrams of segment bytes, checking that each
+// byte is its datagram number
+void recv_segments(inet::socket& s, std::size_t n, uint16_t segment)
+{
+	std::vector< char > buf(65536);
+	std::size_t got = 0;
+	while (got < n) {
+		uint16_t seg;
+		inet::sockaddr from;
+		ssize_t r = udp::recv(s, &buf[0], buf.size(), seg, from);
+		BOOST_REQUIRE_GT(r, 0);
+		BOOST_CHECK_EQUAL(from.addr(), "127.0.0.1");
+		// every datagram but the last one has the full size
+		BOOST_REQUIRE(seg == segment || got + r == n);
+		for (ssize_t i = 0; i < r; ++i)
+			BOOST_REQUIRE_EQUAL(buf[i], char((got + i) / segment));
+		got += r;
+	}
+	BOOST_CHECK_EQUAL(got, n);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( socket_udp_suite )
+
+BOOST_AUTO_TEST_CASE( cmsg_test )
+{
+	msghdr m;
+	memset(&m, 0, sizeof(m));
+	char buf[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(uint64_t))];
+	cmsg::writer w(m, buf, sizeof(buf));
+	BOOST_CHECK(w.put(SOL_SOCKET, 1, 42));
+	BOOST_CHECK(w.put(SOL_SOCKET, 2, uint64_t(43)));
+	BOOST_CHECK(!w.put(SOL_SOCKET, 3, 44));
+	BOOST_CHECK_EQUAL(m.msg_controllen, sizeof(buf));
+	int i = 0;
+	uint64_t u = 0;
+	BOOST_CHECK(cmsg::find(m, SOL_SOCKET, 1, i));
+	BOOST_CHECK_EQUAL(i, 42);
+	BOOST_CHECK(cmsg::find(m, SOL_SOCKET, 2, u));
+	BOOST_CHECK_EQUAL(u, 43u);
+	BOOST_CHECK(!cmsg::find(m, SOL_SOCKET, 3, i));
+	BOOST_CHECK(!cmsg::find(m, IPPROTO_UDP, 1, i));
+	// the data is too small for an uint64_t
+	BOOST_CHECK(!cmsg::find(m, SOL_SOCKET, 1, u));
+	BOOST_CHECK_EQUAL(i, 42);
+
+	cmsg::buffer< sizeof(int) > one;
+	cmsg::writer w1(m, one);
+	BOOST_CHECK(w1.put(SOL_SOCKET, 5, 45));
+	BOOST_CHECK(!w1.put(SOL_SOCKET, 6, 46));
+	BOOST_CHECK(cmsg::find(m, SOL_SOCKET, 5, i));
+	BOOST_CHECK_EQUAL(i, 45);
+}
+
+BOOST_AUTO_TEST_CASE( gso_gro_test )
+{
+	inet::sockaddr addr("127.0.0.1", 10031);
+	inet::socket rx(DGRAM);
+	rx.bind(addr);
+	rx.opt< udp::opt::GRO >(1);
+	BOOST_CHECK_EQUAL(rx.opt< udp::opt::GRO >(), 1);
+	inet::socket tx(DGRAM);
+
+	// 10 full datagrams and a smaller one
+	std::vector< char > buf(10500);
+	for (std::size_t i = 0; i < buf.size(); ++i)
+		buf[i] = i / 1000;
+	BOOST_CHECK_EQUAL(udp::send(tx, &buf[0], buf.size(), 1000, addr),
+			ssize_t(buf.size()));
+	recv_segments(rx, buf.size(), 1000);
+
+	// connected, without GRO (one datagram per recv)
+	rx.opt< udp::opt::GRO >(0);
+	tx.connect(addr);
+	BOOST_CHECK_EQUAL(udp::send(tx, &buf[0], 4000, 1000), 4000);
+	for (int i = 0; i < 4; ++i) {
+		uint16_t seg = 0;
+		BOOST_CHECK_EQUAL(udp::recv(rx, &buf[0], buf.size(), seg),
+				1000);
+		BOOST_CHECK_EQUAL(seg, 1000);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( gro_cmsg_test )
+{
+	inet::sockaddr addr("127.0.0.1", 10033);
+	inet::socket rx(DGRAM);
+	rx.bind(addr);
+	rx.opt< udp::opt::GRO >(1);
+	// other control messages come along with UDP_GRO
+	rx.setsockopt(SOL_SOCKET, SO_TIMESTAMPNS, 1);
+	rx.setsockopt(IPPROTO_IP, IP_PKTINFO, 1);
+	rx.setsockopt(IPPROTO_IP, IP_RECVTTL, 1);
+	rx.setsockopt(IPPROTO_IP, IP_RECVTOS, 1);
+	inet::socket tx(DGRAM);
+	std::vector< char > buf(5000);
+	for (std::size_t i = 0; i < buf.size(); ++i)
+		buf[i] = i / 1000;
+	BOOST_CHECK_EQUAL(udp::send(tx, &buf[0], buf.size(), 1000, addr),
+			ssize_t(buf.size()));
+	// all the datagrams are full, so the segment is always known
+	for (ssize_t got = 0; got < ssize_t(buf.size()); ) {
+		uint16_t seg = 0;
+		ssize_t r = udp::recv(rx, &buf[0], buf.size(), seg);
+		BOOST_REQUIRE_GT(r, 0);
+		BOOST_CHECK_EQUAL(seg, 1000);
+		got += r;
+	}
+}
+
+BOOST_AUTO_TEST_CASE( segment_opt_test )
+{
+	inet::sockaddr addr("127.0.0.1", 10032);
+	inet::socket rx(DGRAM);
+	rx.bind(addr);
+	inet::socket tx(DGRAM);
+	tx.opt< udp::opt::SEGMENT >(500);
+	BOOST_CHECK_EQUAL(tx.opt< udp::opt::SEGMENT >(), 500);
+	// plain sends are segmented too
+	std::vector< char > buf(1500);
+	for (std::size_t i = 0; i < buf.size(); ++i)
+		buf[i] = i / 500;
+	tx.send(&buf[0], buf.size(), addr);
+	recv_segments(rx, buf.size(), 500);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
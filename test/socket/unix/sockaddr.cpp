@@ -7,6 +7,15 @@
 
 #include "common.hpp" // PATH{1,2}, test_address{1,2}
 #include <boost/test/unit_test.hpp> // unit testing stuff
+#include <string> // std::string
+#include <sstream> // std::ostringstream
+#include <stdexcept> // std::logic_error
+#include <cstring> // memset
+#include <cerrno> // errno, ENAMETOOLONG
+#include <unistd.h> // getpid
+#include <sys/un.h> // sockaddr_un
+
+namespace unix = ::posixx::socket::unix;
 
 BOOST_AUTO_TEST_CASE( socket_unix_sockaddr_test )
 {
@@ -14,3 +23,107 @@ BOOST_AUTO_TEST_CASE( socket_unix_sockaddr_test )
 	BOOST_CHECK_EQUAL(test_address2.path(), PATH2);
 }
 
+
+BOOST_AUTO_TEST_CASE( socket_unix_sockaddr_format )
+{
+	char buf[posixx::socket::unix::sockaddr::TEXT_SIZE];
+	BOOST_CHECK_EQUAL(test_address1.format(buf, sizeof(buf)),
+			sizeof(PATH1) - 1);
+	BOOST_CHECK_EQUAL(buf, PATH1);
+	char small[5];
+	BOOST_CHECK_EQUAL(test_address1.format(small, sizeof(small)),
+			sizeof(PATH1) - 1);
+	BOOST_CHECK_EQUAL(small, "/tmp");
+}
+
+BOOST_AUTO_TEST_CASE( socket_unix_sockaddr_format_full )
+{
+	// a path filling sun_path is not NUL terminated (it can only be
+	// reported by the kernel, so the length is set as it would do)
+	posixx::socket::unix::sockaddr addr;
+	memset(addr.sun_path, 'x', sizeof(addr.sun_path));
+	addr.length(sizeof(sockaddr_un));
+	char buf[posixx::socket::unix::sockaddr::TEXT_SIZE];
+	BOOST_CHECK_EQUAL(addr.format(buf, sizeof(buf)),
+			sizeof(addr.sun_path));
+	BOOST_CHECK_EQUAL(std::string(buf),
+			std::string(sizeof(addr.sun_path), 'x'));
+}
+
+BOOST_AUTO_TEST_CASE( socket_unix_sockaddr_parse )
+{
+	posixx::socket::unix::sockaddr addr;
+	BOOST_REQUIRE(addr.parse(PATH2));
+	BOOST_CHECK_EQUAL(addr, test_address2);
+	BOOST_CHECK_EQUAL(addr.length(), test_address2.length());
+	std::string path(sizeof(addr.sun_path), 'x');
+	errno = 0;
+	BOOST_CHECK(!addr.parse(path.c_str()));
+	BOOST_CHECK_EQUAL(errno, ENAMETOOLONG);
+	BOOST_CHECK_EQUAL(addr, test_address2);
+	path.resize(sizeof(addr.sun_path) - 1);
+	BOOST_CHECK(addr.parse(path.c_str()));
+	BOOST_CHECK_EQUAL(addr.path(), path);
+}
+
+BOOST_AUTO_TEST_CASE( socket_unix_sockaddr_length )
+{
+	unix::sockaddr empty;
+	BOOST_CHECK_EQUAL(empty.length(), sizeof(sa_family_t));
+	BOOST_CHECK_EQUAL(empty.path(), "");
+	BOOST_CHECK_EQUAL(test_address1.length(),
+			sizeof(sa_family_t) + sizeof(PATH1) - 1);
+	// the kernel reports the terminating NUL of paths, we don't
+	unix::sockaddr addr = test_address1;
+	addr.length(test_address1.length() + 1);
+	BOOST_CHECK_EQUAL(addr, test_address1);
+	BOOST_CHECK_EQUAL(addr.hash(), test_address1.hash());
+}
+
+BOOST_AUTO_TEST_CASE( socket_unix_sockaddr_abstract )
+{
+	std::string name("posixx\0test", 11);
+	unix::sockaddr addr = unix::sockaddr::abstract(name);
+	BOOST_CHECK(addr.is_abstract());
+	BOOST_CHECK(!test_address1.is_abstract());
+	BOOST_CHECK(!unix::sockaddr().is_abstract());
+	BOOST_CHECK_EQUAL(addr.length(), sizeof(sa_family_t) + 1 + 11);
+	BOOST_CHECK_EQUAL(addr.path(), name);
+	BOOST_CHECK(!(addr == unix::sockaddr::abstract("posixx")));
+	BOOST_CHECK_NE(addr.hash(), unix::sockaddr::abstract("posixx").hash());
+	BOOST_CHECK_THROW(unix::sockaddr::abstract(
+			std::string(sizeof(addr.sun_path), 'x')),
+			std::logic_error);
+
+	char buf[unix::sockaddr::TEXT_SIZE];
+	addr = unix::sockaddr::abstract("posixx");
+	BOOST_CHECK_EQUAL(addr.format(buf, sizeof(buf)), 7u);
+	BOOST_CHECK_EQUAL(buf, "@posixx");
+	unix::sockaddr parsed;
+	BOOST_REQUIRE(parsed.parse(buf));
+	BOOST_CHECK_EQUAL(parsed, addr);
+	BOOST_CHECK(parsed.is_abstract());
+}
+
+BOOST_AUTO_TEST_CASE( socket_unix_sockaddr_abstract_dgram )
+{
+	std::ostringstream os;
+	os << "posixx_test_" << getpid();
+	unix::sockaddr a1 = unix::sockaddr::abstract(os.str() + "_1");
+	unix::sockaddr a2 = unix::sockaddr::abstract(os.str() + "_2");
+	// no files to clean up
+	unix::socket s1(posixx::socket::DGRAM);
+	unix::socket s2(posixx::socket::DGRAM);
+	s1.bind(a1);
+	s2.bind(a2);
+	BOOST_CHECK_EQUAL(s1.name(), a1);
+	s1.send("hello", 5, a2);
+	char buf[16];
+	unix::sockaddr from;
+	BOOST_CHECK_EQUAL(s2.recv(buf, sizeof(buf), from), 5);
+	BOOST_CHECK_EQUAL(from, a1);
+	BOOST_CHECK(from.is_abstract());
+	// the same name can't be bound twice while in use
+	unix::socket s3(posixx::socket::DGRAM);
+	BOOST_CHECK_THROW(s3.bind(a1), posixx::error);
+}
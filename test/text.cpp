@@ -0,0 +1,65 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/text.hpp> // posixx::text
+
+#include <boost/test/unit_test.hpp>
+
+namespace text = posixx::text;
+
+BOOST_AUTO_TEST_SUITE( text_suite )
+
+BOOST_AUTO_TEST_CASE( writer_test )
+{
+	char buf[16];
+	text::writer w(buf, sizeof(buf));
+	w.put('a').put("bc").put("defg", 2).put(0ul).put(4294967295ul);
+	BOOST_CHECK_EQUAL( w.finish(), 16u );
+	BOOST_CHECK_EQUAL( buf, "abcde0429496729" ); // truncated
+}
+
+BOOST_AUTO_TEST_CASE( writer_empty_test )
+{
+	char buf[1] = { 'x' };
+	BOOST_CHECK_EQUAL( text::writer(buf, 0).put("abc").finish(), 3u );
+	BOOST_CHECK_EQUAL( buf[0], 'x' );
+	BOOST_CHECK_EQUAL( text::writer(buf, 1).put("abc").finish(), 3u );
+	BOOST_CHECK_EQUAL( buf[0], '\0' );
+}
+
+BOOST_AUTO_TEST_CASE( parse_uint_test )
+{
+	const char* s = "123,";
+	unsigned long v = 0;
+	BOOST_REQUIRE( text::parse_uint(s, 123, v) );
+	BOOST_CHECK_EQUAL( v, 123u );
+	BOOST_CHECK_EQUAL( *s, ',' );
+	BOOST_CHECK( !text::parse_uint(s, 123, v) );
+	BOOST_REQUIRE( text::expect(s, ',') );
+	BOOST_CHECK( !text::expect(s, ',') );
+	BOOST_CHECK_EQUAL( *s, '\0' );
+
+	s = "124";
+	BOOST_CHECK( !text::parse_uint(s, 123, v) );
+	BOOST_CHECK_EQUAL( *s, '1' );
+	BOOST_CHECK_EQUAL( v, 123u );
+
+	s = "5";
+	BOOST_CHECK( !text::parse_uint(s, 0, v) );
+	s = "007";
+	BOOST_REQUIRE( text::parse_uint(s, 7, v) );
+	BOOST_CHECK_EQUAL( v, 7u );
+
+	s = "18446744073709551616";
+	BOOST_CHECK( !text::parse_uint(s, static_cast< unsigned long >(-1),
+			v) );
+	s = "+1";
+	BOOST_CHECK( !text::parse_uint(s, 10, v) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -0,0 +1,44 @@
+// Copyright Leandro Lucarella 2008 - 2010.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+
+#include <posixx/tsc.hpp> // posixx::tsc
+#include <boost/test/unit_test.hpp> // unit testing stuff
+#include <stdint.h> // uint64_t
+#include <time.h> // nanosleep, timespec
+
+namespace tsc = posixx::tsc;
+
+BOOST_AUTO_TEST_SUITE( tsc_suite )
+
+BOOST_AUTO_TEST_CASE( ns_test )
+{
+	BOOST_CHECK_EQUAL(tsc::ns(0), 0u);
+	BOOST_CHECK_GT(tsc::frequency(), 0.0);
+	if (!tsc::available())
+		BOOST_CHECK_EQUAL(tsc::ns(12345), 12345u);
+	// big intervals don't overflow
+	tsc::ticks_type hour = tsc::ticks_type(tsc::frequency() * 3600);
+	BOOST_CHECK_CLOSE(double(tsc::ns(hour)), 3600e9, 0.01);
+}
+
+BOOST_AUTO_TEST_CASE( interval_test )
+{
+	tsc::ticks_type t0 = tsc::ticks();
+	uint64_t m0 = tsc::monotonic();
+	timespec ts = { 0, 20000000 };
+	nanosleep(&ts, NULL);
+	tsc::ticks_type t1 = tsc::ticks();
+	uint64_t m1 = tsc::monotonic();
+	BOOST_CHECK_GT(t1, t0);
+	// the clocks are not read at the very same time, so allow some slack
+	uint64_t ns = tsc::ns(t1 - t0);
+	BOOST_CHECK_GE(ns + 1000000, m1 - m0);
+	BOOST_CHECK_LE(ns, m1 - m0 + 1000000);
+	BOOST_CHECK_GE(ns, 20000000u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()